@@ -7,10 +7,16 @@
 #include <sys/ioctl.h>  /* For device control operations */
 #include <signal.h>     /* For signal handling */
 #include <errno.h>      /* For error number definitions */
+#include <stdarg.h>     /* For formatted record output */
+#include <stdint.h>     /* For fixed width record fields */
+#include <poll.h>       /* For waiting on button events */
+#include <time.h>       /* For record timestamps */
+
+#include "../include/gpio_control.h"   /* Button event records and IOCTLs */
+#include "gpio_app_probes.h"            /* USDT probes */
 
 /* Device paths for accessing LED and button devices */
 #define LED_DEVICE_BASE     "/dev/gpio_led"    /* Base path for LED devices */
-#define BUTTON_DEVICE       "/dev/gpio_button"  /* Path for button device */
 #define NUM_LEDS           3                    /* Total number of LEDs */
 
 /* IOCTL command definitions for LED control */
@@ -20,9 +26,59 @@
 #define GPIO_IOC_LED_TOGGLE _IO(GPIO_IOC_MAGIC, 3)    /* Toggle LED state */
 #define GPIO_IOC_GET_STATUS _IOR(GPIO_IOC_MAGIC, 4, int) /* Get LED status */
 
-/* IOCTL command definitions for Button control */
-#define BUTTON_IOC_MAGIC     'b'               /* Magic number for Button IOCTL */
-#define BUTTON_IOC_GET_STATUS _IOR(BUTTON_IOC_MAGIC, 1, int) /* Get button status */
+/* Structured output, see --format */
+#define OUT_BUF_SIZE        (64 * 1024)         /* Bytes buffered between writes */
+#define DEFAULT_FLUSH_MS    100                 /* Default --flush-ms */
+#define EVENT_BATCH         64                  /* Button events per read() */
+#define NSEC_PER_MSEC       1000000ULL
+
+/* Script mode, see run_script() */
+#define SCRIPT_LINE_MAX     256                 /* Longest script line */
+#define SCRIPT_ARGS_MAX     8                   /* Words per script command */
+
+enum out_format {
+    FMT_TEXT,           /* Human readable, the default */
+    FMT_JSONL,          /* One JSON object per line */
+    FMT_CSV,            /* Header line, then one row per record */
+    FMT_BINARY,         /* struct out_record_hdr + payload, native endian */
+};
+
+/* Record kinds, shared by all formats */
+enum out_kind {
+    REC_LED = 1,        /* Payload struct out_led */
+    REC_BUTTON = 2,     /* Payload struct out_led, index 0 */
+    REC_EVENT = 3,      /* Payload struct button_event */
+};
+
+/*
+ * Binary stream: every record starts with this header, followed by
+ * len payload bytes. Readers skip kinds they do not know by len
+ */
+struct out_record_hdr {
+    uint16_t kind;
+    uint16_t len;
+    uint32_t reserved;
+    uint64_t timestamp_ns;  /* CLOCK_MONOTONIC */
+};
+
+struct out_led {
+    uint32_t index;
+    uint32_t on;
+};
+
+static const char *const kind_names[] = { "", "led", "button", "event" };
+static const char *const format_names[] = { "text", "jsonl", "csv", "binary" };
+static const char *const event_names[] = { "", "press", "chord", "multi_press", "overrun" };
+
+/* Output buffer, written out in large chunks */
+static struct {
+    enum out_format format;
+    char buf[OUT_BUF_SIZE];
+    size_t len;
+    uint64_t flush_ns;      /* Flush interval */
+    uint64_t last_flush;
+    int csv_header_done;
+} out = { .format = FMT_TEXT, .flush_ns = DEFAULT_FLUSH_MS * NSEC_PER_MSEC };
 
 /* Array of LED names for display purposes */
 static const char* led_names[] = {
@@ -33,6 +89,7 @@ static const char* led_names[] = {
 
 /* Global variables for device file descriptors and program state */
 static int led_fds[NUM_LEDS] = {-1, -1, -1};  /* File descriptors for LED devices */
+static char led_paths[NUM_LEDS][32];           /* LED device nodes, for probes */
 static int button_fd = -1;                     /* File descriptor for button device */
 static int running = 1;                        /* Program running flag */
 
@@ -41,9 +98,196 @@ static int running = 1;                        /* Program running flag */
  * @sig: Signal number received
  */
 void signal_handler(int sig) {
+    static const char msg[] = "\nExiting...\n";
+
     (void)sig;  /* Suppress unused parameter warning */
     running = 0;
-    printf("\nExiting...\n");
+    /* stderr, stdout may carry a binary stream */
+    if (write(STDERR_FILENO, msg, sizeof(msg) - 1) < 0) {
+        /* Nothing to do about it in a signal handler */
+    }
+}
+
+/*
+ * Monotonic time in ns, same clock as the driver event timestamps
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Time since t0 for a probe, 0 if no timestamp was taken
+ */
+static uint64_t probe_latency(uint64_t t0) {
+    return t0 ? monotonic_ns() - t0 : 0;
+}
+
+/*
+ * Write the output buffer to stdout
+ * Returns: 0 on success, -1 on a write error
+ */
+static int out_flush(void) {
+    uint64_t t0 = GPIO_PROBE_ACTIVE(render) ? monotonic_ns() : 0;
+    size_t done = 0, len = out.len;
+
+    while (done < out.len) {
+        ssize_t n = write(STDOUT_FILENO, out.buf + done, out.len - done);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            GPIO_PROBE4(render, format_names[out.format], done, probe_latency(t0), -errno);
+            perror("Failed to write output");
+            out.len = 0;
+            return -1;
+        }
+        done += n;
+    }
+    out.len = 0;
+    out.last_flush = monotonic_ns();
+    if (len)
+        GPIO_PROBE4(render, format_names[out.format], len, probe_latency(t0), 0);
+    return 0;
+}
+
+/*
+ * Flush once the flush interval has passed since the last write
+ */
+static void out_maybe_flush(uint64_t now) {
+    if (out.len && now - out.last_flush >= out.flush_ns)
+        out_flush();
+}
+
+static void out_append(const void *data, size_t len) {
+    if (out.len + len > sizeof(out.buf))
+        out_flush();
+    memcpy(out.buf + out.len, data, len);
+    out.len += len;
+}
+
+static void out_printf(const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(out.buf + out.len, sizeof(out.buf) - out.len, fmt, ap);
+    va_end(ap);
+
+    if (n >= 0 && out.len + n >= sizeof(out.buf)) {
+        /* Did not fit, flush and format again into the empty buffer */
+        out_flush();
+        va_start(ap, fmt);
+        n = vsnprintf(out.buf, sizeof(out.buf), fmt, ap);
+        va_end(ap);
+    }
+    if (n > 0)
+        out.len += n;
+}
+
+static void out_binary(enum out_kind kind, uint64_t ts, const void *payload, uint16_t len) {
+    struct out_record_hdr hdr = { .kind = kind, .len = len, .timestamp_ns = ts };
+
+    out_append(&hdr, sizeof(hdr));
+    out_append(payload, len);
+}
+
+/*
+ * One CSV layout for every record kind:
+ * timestamp_ns,record,seq,type,key,value
+ */
+static void out_csv_header(void) {
+    if (out.csv_header_done)
+        return;
+    out_printf("timestamp_ns,record,seq,type,key,value\n");
+    out.csv_header_done = 1;
+}
+
+/*
+ * Emit an LED or button state record
+ */
+static void out_state(enum out_kind kind, uint64_t ts, unsigned int index, int on) {
+    struct out_led rec = { .index = index, .on = on };
+
+    switch (out.format) {
+    case FMT_JSONL:
+        out_printf("{\"ts\":%llu,\"record\":\"%s\",\"index\":%u,\"on\":%d}\n",
+                   (unsigned long long)ts, kind_names[kind], index, on);
+        break;
+    case FMT_CSV:
+        out_csv_header();
+        out_printf("%llu,%s,,,%u,%d\n", (unsigned long long)ts, kind_names[kind], index, on);
+        break;
+    case FMT_BINARY:
+        out_binary(kind, ts, &rec, sizeof(rec));
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Emit one button event, timestamped by the driver
+ */
+static void out_event(const struct button_event *ev) {
+    const char *type = ev->type < sizeof(event_names) / sizeof(event_names[0]) ?
+                       event_names[ev->type] : "unknown";
+
+    switch (out.format) {
+    case FMT_JSONL:
+        out_printf("{\"ts\":%llu,\"record\":\"event\",\"seq\":%llu,\"type\":\"%s\","
+                   "\"key\":%u,\"value\":%u}\n",
+                   (unsigned long long)ev->timestamp, (unsigned long long)ev->seq,
+                   type, ev->key, ev->value);
+        break;
+    case FMT_CSV:
+        out_csv_header();
+        out_printf("%llu,event,%llu,%s,%u,%u\n", (unsigned long long)ev->timestamp,
+                   (unsigned long long)ev->seq, type, ev->key, ev->value);
+        break;
+    case FMT_BINARY:
+        out_binary(REC_EVENT, ev->timestamp, ev, sizeof(*ev));
+        break;
+    default:
+        out_printf("[%llu.%06llu] #%llu %s key %u value %u\n",
+                   (unsigned long long)ev->timestamp / 1000000000ULL,
+                   (unsigned long long)(ev->timestamp / 1000) % 1000000ULL,
+                   (unsigned long long)ev->seq, type, ev->key, ev->value);
+        break;
+    }
+}
+
+/*
+ * Strip --format and --flush-ms from argv, leaving the command
+ * Returns: 0 on success, -1 on a bad option
+ */
+static int parse_output_options(int *argc, char *argv[]) {
+    int i, n = 1;
+
+    for (i = 1; i < *argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < *argc) {
+            const char *f = argv[++i];
+            if (strcmp(f, "text") == 0)
+                out.format = FMT_TEXT;
+            else if (strcmp(f, "jsonl") == 0)
+                out.format = FMT_JSONL;
+            else if (strcmp(f, "csv") == 0)
+                out.format = FMT_CSV;
+            else if (strcmp(f, "binary") == 0)
+                out.format = FMT_BINARY;
+            else {
+                fprintf(stderr, "Unknown format: %s (text, jsonl, csv, binary)\n", f);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--flush-ms") == 0 && i + 1 < *argc) {
+            out.flush_ns = strtoull(argv[++i], NULL, 0) * NSEC_PER_MSEC;
+        } else {
+            argv[n++] = argv[i];
+        }
+    }
+    *argc = n;
+    return 0;
 }
 
 /*
@@ -51,15 +295,14 @@ void signal_handler(int sig) {
  * Returns: 0 on success, -1 on failure
  */
 int open_devices(void) {
-    char device_path[64];
     int i;
     
     /* Open each LED device */
     for (i = 0; i < NUM_LEDS; i++) {
-        snprintf(device_path, sizeof(device_path), "%s%d", LED_DEVICE_BASE, i);
-        led_fds[i] = open(device_path, O_RDWR);
+        snprintf(led_paths[i], sizeof(led_paths[i]), "%s%d", LED_DEVICE_BASE, i);
+        led_fds[i] = open(led_paths[i], O_RDWR);
         if (led_fds[i] < 0) {
-            fprintf(stderr, "Failed to open %s: %s\n", device_path, strerror(errno));
+            fprintf(stderr, "Failed to open %s: %s\n", led_paths[i], strerror(errno));
             goto cleanup;
         }
     }
@@ -117,20 +360,28 @@ int led_control(int led_index, const char* command) {
         return -1;
     }
     
-    int result = 0;
+    unsigned long request;
+    uint64_t t0;
+    int result;
     
-    /* Execute requested command */
+    /* Map the command to its IOCTL */
     if (strcmp(command, "on") == 0) {
-        result = ioctl(led_fds[led_index], GPIO_IOC_LED_ON);
+        request = GPIO_IOC_LED_ON;
     } else if (strcmp(command, "off") == 0) {
-        result = ioctl(led_fds[led_index], GPIO_IOC_LED_OFF);
+        request = GPIO_IOC_LED_OFF;
     } else if (strcmp(command, "toggle") == 0) {
-        result = ioctl(led_fds[led_index], GPIO_IOC_LED_TOGGLE);
+        request = GPIO_IOC_LED_TOGGLE;
     } else {
         fprintf(stderr, "Invalid command: %s\n", command);
         return -1;
     }
     
+    t0 = GPIO_PROBE_ACTIVE(cmd_done) ? monotonic_ns() : 0;
+    GPIO_PROBE2(cmd_start, led_paths[led_index], command);
+    result = ioctl(led_fds[led_index], request);
+    GPIO_PROBE4(cmd_done, led_paths[led_index], command, probe_latency(t0),
+                result < 0 ? -errno : 0);
+    
     if (result < 0) {
         perror("LED control failed");
         return -1;
@@ -172,13 +423,18 @@ int all_leds_control(const char* command) {
  * Returns: 1 if LED is on, 0 if off, -1 on error
  */
 int get_led_status(int led_index) {
-    int status;
+    uint64_t t0;
+    int status, ret;
     
     if (led_index < 0 || led_index >= NUM_LEDS || led_fds[led_index] < 0) {
         return -1;
     }
     
-    if (ioctl(led_fds[led_index], GPIO_IOC_GET_STATUS, &status) < 0) {
+    t0 = GPIO_PROBE_ACTIVE(status_read) ? monotonic_ns() : 0;
+    ret = ioctl(led_fds[led_index], GPIO_IOC_GET_STATUS, &status);
+    GPIO_PROBE4(status_read, led_paths[led_index], "get_status", probe_latency(t0),
+                ret < 0 ? -errno : status);
+    if (ret < 0) {
         return -1;
     }
     
@@ -190,13 +446,18 @@ int get_led_status(int led_index) {
  * Returns: 1 if button is pressed, 0 if released, -1 on error
  */
 int get_button_status(void) {
-    int status;
+    uint64_t t0;
+    int status, ret;
     
     if (button_fd < 0) {
         return -1;
     }
     
-    if (ioctl(button_fd, BUTTON_IOC_GET_STATUS, &status) < 0) {
+    t0 = GPIO_PROBE_ACTIVE(status_read) ? monotonic_ns() : 0;
+    ret = ioctl(button_fd, BUTTON_IOC_GET_STATUS, &status);
+    GPIO_PROBE4(status_read, BUTTON_DEVICE, "get_status", probe_latency(t0),
+                ret < 0 ? -errno : status);
+    if (ret < 0) {
         return -1;
     }
     
@@ -215,7 +476,10 @@ int read_button_device(void) {
         return -1;
     }
     
+    uint64_t t0 = GPIO_PROBE_ACTIVE(status_read) ? monotonic_ns() : 0;
     ssize_t bytes_read = read(button_fd, buffer, sizeof(buffer) - 1);
+    GPIO_PROBE4(status_read, BUTTON_DEVICE, "read", probe_latency(t0),
+                bytes_read < 0 ? -errno : (int)bytes_read);
     if (bytes_read < 0) {
         perror("Failed to read button device");
         return -1;
@@ -229,10 +493,24 @@ int read_button_device(void) {
 
 /*
  * Prints comprehensive status of all LEDs and button
+ * In a structured format emits one record per LED and one for the button
  */
 void print_status(void) {
+    uint64_t t0;
     int i;
     
+    if (out.format != FMT_TEXT) {
+        uint64_t ts = monotonic_ns();
+
+        for (i = 0; i < NUM_LEDS; i++)
+            out_state(REC_LED, ts, i, get_led_status(i) == 1);
+        out_state(REC_BUTTON, ts, 0, get_button_status() == 1);
+        out_flush();
+        return;
+    }
+    
+    t0 = GPIO_PROBE_ACTIVE(render) ? monotonic_ns() : 0;
+    
     /* Display LED Status */
     printf("=== LED Status ===\n");
     for (i = 0; i < NUM_LEDS; i++) {
@@ -254,6 +532,230 @@ void print_status(void) {
     printf("\n=== Detailed Button Info ===\n");
     read_button_device();
     printf("========================\n");
+    
+    if (t0) {
+        fflush(stdout);
+        GPIO_PROBE4(render, "text", 0, probe_latency(t0), 0);
+    }
+}
+
+/*
+ * Streams button events until interrupted
+ * Events are read in batches and written in large chunks; the driver
+ * reports anything this reader missed as an overrun event
+ * Returns: 0 on success, -1 on failure
+ */
+int stream_events(void) {
+    struct button_event batch[EVENT_BATCH];
+    struct pollfd pfd = { .fd = button_fd, .events = POLLIN };
+    int on = 1, ret = 0;
+
+    if (ioctl(button_fd, BUTTON_IOC_EVENT_MODE, &on) < 0) {
+        perror("Failed to enable button event mode");
+        return -1;
+    }
+    fcntl(button_fd, F_SETFL, fcntl(button_fd, F_GETFL) | O_NONBLOCK);
+    out.last_flush = monotonic_ns();
+
+    while (running) {
+        uint64_t now = monotonic_ns(), recv;
+        int timeout = -1;
+        ssize_t n;
+        int i;
+
+        /* Only wake up on a timer while buffered output is waiting */
+        if (out.len)
+            timeout = now - out.last_flush >= out.flush_ns ? 0 :
+                      (int)((out.flush_ns - (now - out.last_flush)) / NSEC_PER_MSEC) + 1;
+        if (poll(&pfd, 1, timeout) < 0 && errno != EINTR) {
+            perror("poll failed");
+            ret = -1;
+            break;
+        }
+
+        for (;;) {
+            n = read(button_fd, batch, sizeof(batch));
+            if (n <= 0)
+                break;
+            recv = GPIO_PROBE_ACTIVE(event_recv) ? monotonic_ns() : 0;
+            for (i = 0; i < n / (ssize_t)sizeof(batch[0]); i++) {
+                GPIO_PROBE4(event_recv, BUTTON_DEVICE,
+                            batch[i].type < sizeof(event_names) / sizeof(event_names[0]) ?
+                            event_names[batch[i].type] : "unknown",
+                            recv ? recv - batch[i].timestamp : 0, batch[i].seq);
+                out_event(&batch[i]);
+            }
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            perror("Failed to read button events");
+            ret = -1;
+            break;
+        }
+        out_maybe_flush(monotonic_ns());
+    }
+
+    out_flush();
+    return ret;
+}
+
+/*
+ * Executes one command on the open devices
+ * @argc, @argv: Command and its arguments, argv[0] is the command
+ * @show_status: Dump the full status after an LED command
+ * Returns: 0 on success, -1 on failure or an invalid command
+ */
+int run_command(int argc, char *argv[], int show_status) {
+    if (argc == 3 && strcmp(argv[0], "led") == 0) {
+        /* Control specific LED: ./gpio_app led 0 on */
+        int led_index = atoi(argv[1]);
+        if (led_control(led_index, argv[2]) < 0)
+            return -1;
+        printf("LED%d (%s) %s\n", led_index, led_names[led_index], argv[2]);
+        if (show_status)
+            print_status();
+    } else if (argc == 2 && strcmp(argv[0], "all") == 0) {
+        /* Control all LEDs: ./gpio_app all on */
+        if (all_leds_control(argv[1]) < 0)
+            return -1;
+        if (show_status)
+            print_status();
+    } else if (argc == 1 && strcmp(argv[0], "status") == 0) {
+        /* Show all status: ./gpio_app status */
+        print_status();
+    } else if (argc == 1 && strcmp(argv[0], "button") == 0) {
+        /* Show button status: ./gpio_app button */
+        if (out.format != FMT_TEXT) {
+            out_state(REC_BUTTON, monotonic_ns(), 0, get_button_status() == 1);
+            out_flush();
+        } else {
+            printf("=== Button Status ===\n");
+            if (read_button_device() < 0)
+                return -1;
+            printf("====================\n");
+        }
+    } else if (argc == 1 && strcmp(argv[0], "events") == 0) {
+        /* Stream events: ./gpio_app --format jsonl events */
+        return stream_events();
+    } else {
+        fprintf(stderr, "Invalid command. Check documentation for usage.\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Sleeps until an absolute CLOCK_MONOTONIC deadline
+ * Returns early only when the program is interrupted
+ */
+static void sleep_until(uint64_t deadline) {
+    struct timespec ts = {
+        .tv_sec = deadline / 1000000000ULL,
+        .tv_nsec = deadline % 1000000000ULL,
+    };
+
+    while (running && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+/*
+ * Executes a command script with one set of open devices
+ * One command per line, same words as on the command line; blank lines
+ * and lines starting with '#' are skipped. A line may start with a
+ * schedule, deadlines are absolute so they do not drift:
+ *   @<ms>   run at <ms> after the script started
+ *   @+<ms>  run <ms> after the previous scheduled line
+ * "events" is not allowed, it never returns
+ * @path: Script file, "-" for stdin
+ * @quiet: Skip the status dump after LED commands
+ * Stops at the first failing command. A timing summary goes to stderr,
+ * stdout may carry a binary stream
+ * Returns: 0 if every command succeeded, -1 otherwise
+ */
+int run_script(const char *path, int quiet) {
+    char line[SCRIPT_LINE_MAX];
+    char *args[SCRIPT_ARGS_MAX];
+    FILE *f = stdin;
+    uint64_t start, deadline, t0, lat;
+    uint64_t lat_min = UINT64_MAX, lat_max = 0, lat_sum = 0, late_max = 0;
+    unsigned int lineno = 0, done = 0, scheduled = 0;
+    int ret = 0;
+
+    if (strcmp(path, "-") != 0) {
+        f = fopen(path, "r");
+        if (!f) {
+            fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+
+    start = deadline = monotonic_ns();
+    while (running && fgets(line, sizeof(line), f)) {
+        int n = 0;
+        char *word;
+
+        lineno++;
+        for (word = strtok(line, " \t\r\n"); word && n < SCRIPT_ARGS_MAX;
+             word = strtok(NULL, " \t\r\n"))
+            args[n++] = word;
+        if (n == 0 || args[0][0] == '#')
+            continue;
+
+        /* Optional schedule */
+        if (args[0][0] == '@') {
+            uint64_t ms;
+
+            if (args[0][1] == '+') {
+                ms = strtoull(args[0] + 2, NULL, 10);
+                deadline += ms * NSEC_PER_MSEC;
+            } else {
+                ms = strtoull(args[0] + 1, NULL, 10);
+                deadline = start + ms * NSEC_PER_MSEC;
+            }
+            sleep_until(deadline);
+            if (!running)
+                break;
+            t0 = monotonic_ns();
+            if (t0 > deadline && t0 - deadline > late_max)
+                late_max = t0 - deadline;
+            scheduled++;
+            if (--n == 0)
+                continue;
+            memmove(args, args + 1, n * sizeof(args[0]));
+        }
+
+        if (strcmp(args[0], "events") == 0) {
+            fprintf(stderr, "%s:%u: events cannot be scripted\n", path, lineno);
+            ret = -1;
+            break;
+        }
+
+        t0 = monotonic_ns();
+        if (run_command(n, args, !quiet) < 0) {
+            fprintf(stderr, "%s:%u: command failed\n", path, lineno);
+            ret = -1;
+            break;
+        }
+        lat = monotonic_ns() - t0;
+        lat_sum += lat;
+        if (lat < lat_min)
+            lat_min = lat;
+        if (lat > lat_max)
+            lat_max = lat;
+        done++;
+    }
+    if (f != stdin)
+        fclose(f);
+
+    fflush(stdout);
+    fprintf(stderr, "Script: %u commands in %.3f ms%s\n", done,
+            (monotonic_ns() - start) / 1e6, ret < 0 ? ", stopped on error" : "");
+    if (done)
+        fprintf(stderr, "  command latency: min %.1f us, avg %.1f us, max %.1f us\n",
+                lat_min / 1e3, lat_sum / 1e3 / done, lat_max / 1e3);
+    if (scheduled)
+        fprintf(stderr, "  schedule: %u lines, max lateness %.1f us\n",
+                scheduled, late_max / 1e3);
+    return ret;
 }
 
 /*
@@ -263,12 +765,23 @@ void print_status(void) {
  * - all <command>: Control all LEDs
  * - status: Show system status
  * - button: Show button status
+ * - events: Stream button events until Ctrl+C
+ * - run [--quiet] <file|->: Execute a command script, see run_script()
+ * Options, before or after the command:
+ * - --format text|jsonl|csv|binary: Output format for status and events
+ * - --flush-ms <ms>: Longest time output is buffered (default 100)
+ * Exits with 1 if the command failed
  */
 int main(int argc, char *argv[]) {
+    int ret;
+
     /* Set up signal handlers for graceful termination */
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
+    if (parse_output_options(&argc, argv) < 0)
+        return 1;
+    
     /* Initialize devices */
     if (open_devices() < 0) {
         fprintf(stderr, "Failed to open devices. Make sure drivers are loaded.\n");
@@ -276,33 +789,19 @@ int main(int argc, char *argv[]) {
     }
     
     /* Parse and execute commands */
-    if (argc == 4 && strcmp(argv[1], "led") == 0) {
-        /* Control specific LED: ./gpio_app led 0 on */
-        int led_index = atoi(argv[2]);
-        if (led_control(led_index, argv[3]) == 0) {
-            printf("LED%d (%s) %s\n", led_index, led_names[led_index], argv[3]);
-            print_status();
-        }
-    } else if (argc == 3 && strcmp(argv[1], "all") == 0) {
-        /* Control all LEDs: ./gpio_app all on */
-        if (all_leds_control(argv[2]) == 0) {
-            print_status();
-        }
-    } else if (argc == 2 && strcmp(argv[1], "status") == 0) {
-        /* Show all status: ./gpio_app status */
-        print_status();
-    } else if (argc == 2 && strcmp(argv[1], "button") == 0) {
-        /* Show button status: ./gpio_app button */
-        printf("=== Button Status ===\n");
-        read_button_device();
-        printf("====================\n");
+    if (argc >= 3 && strcmp(argv[1], "run") == 0) {
+        /* Run a script: ./gpio_app run --quiet provision.txt */
+        int quiet = argc == 4 && strcmp(argv[2], "--quiet") == 0;
+
+        if (argc == 3 + quiet)
+            ret = run_script(argv[2 + quiet], quiet);
+        else
+            ret = run_command(argc - 1, argv + 1, 1);
     } else {
-        fprintf(stderr, "Invalid command. Check documentation for usage.\n");
-        close_devices();
-        return 1;
+        ret = run_command(argc - 1, argv + 1, 1);
     }
     
     /* Cleanup and exit */
     close_devices();
-    return 0;
+    return ret < 0 ? 1 : 0;
 }
@@ -0,0 +1,85 @@
+/*
+ * Demo for the coroutine client: many logical waiters on one thread
+ *
+ * Starts <waiters> coroutines that all wait for button presses on one
+ * reactor. Press N toggles LED (N % 3) once per press, through the
+ * first waiter only; every waiter counts presses so the fan-out cost is
+ * visible. A multi-press resolution is printed as it arrives.
+ *
+ * Usage: button_led_demo [waiters]
+ */
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "gpio_client.hpp"
+
+namespace {
+
+gpio::Reactor *g_reactor;
+unsigned long g_wakeups;
+
+void on_signal(int) {
+    g_reactor->stop();
+}
+
+gpio::Task press_waiter(gpio::ButtonDevice &button, std::vector<gpio::LedDevice> &leds, bool driver) {
+    unsigned int presses = 0;
+
+    for (;;) {
+        auto ev = co_await button.next_press();
+        if (!ev)
+            co_return;
+        g_wakeups++;
+        if (!driver)
+            continue;
+
+        auto &led = leds[presses++ % leds.size()];
+        if (auto ec = co_await led.toggle())
+            std::fprintf(stderr, "LED %d: %s\n", led.index(), ec.message().c_str());
+        std::printf("press key %u seq %llu -> led %d, %lu wakeups so far\n", ev->key,
+                    static_cast<unsigned long long>(ev->seq), led.index(), g_wakeups);
+    }
+}
+
+gpio::Task multi_press_logger(gpio::ButtonDevice &button) {
+    for (;;) {
+        auto ev = co_await button.next_event();
+        if (!ev)
+            co_return;
+        if (ev->type == BUTTON_EV_MULTI_PRESS)
+            std::printf("multi-press: %u presses\n", ev->value);
+        else if (ev->type == BUTTON_EV_OVERRUN)
+            std::printf("overrun: %u events lost\n", ev->value);
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    unsigned long waiters = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 1000;
+
+    try {
+        gpio::Reactor reactor;
+        gpio::ButtonDevice button(reactor);
+        std::vector<gpio::LedDevice> leds;
+
+        for (int i = 0; i < 3; i++)
+            leds.emplace_back(i);
+
+        g_reactor = &reactor;
+        std::signal(SIGINT, on_signal);
+
+        for (unsigned long i = 0; i < waiters; i++)
+            press_waiter(button, leds, i == 0);
+        multi_press_logger(button);
+
+        std::printf("%lu waiters on one thread, press the button (Ctrl-C to quit)\n", waiters);
+        reactor.run();
+    } catch (const std::system_error &e) {
+        std::fprintf(stderr, "%s: %s\n", e.what(), e.code().message().c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * C++20 coroutine client for the Mock_project GPIO drivers
+ * See gpio_client.hpp for the usage model
+ */
+#include "gpio_client.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <exception>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace gpio {
+
+namespace {
+
+std::error_code last_error() {
+    return { errno, std::generic_category() };
+}
+
+[[noreturn]] void throw_errno(const char *what) {
+    throw std::system_error(last_error(), what);
+}
+
+} // namespace
+
+Fd &Fd::operator=(Fd &&other) noexcept {
+    if (this != &other)
+        reset(other.release());
+    return *this;
+}
+
+void Fd::reset(int fd) {
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = fd;
+}
+
+void Task::promise_type::unhandled_exception() noexcept {
+    // Nobody can observe a detached task, fail loudly instead of losing it
+    std::fputs("gpio::Task: unhandled exception\n", stderr);
+    std::terminate();
+}
+
+/* Reactor */
+
+Reactor::Reactor()
+    : epoll_(::epoll_create1(EPOLL_CLOEXEC)), wake_(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    if (!epoll_ || !wake_)
+        throw_errno("Failed to create reactor");
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;      // nullptr marks the wake eventfd
+    if (::epoll_ctl(epoll_.get(), EPOLL_CTL_ADD, wake_.get(), &ev) < 0)
+        throw_errno("Failed to watch wake eventfd");
+}
+
+void Reactor::add(Pollable &p) {
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &p;
+    if (::epoll_ctl(epoll_.get(), EPOLL_CTL_ADD, p.fd(), &ev) < 0)
+        throw_errno("Failed to watch device");
+}
+
+void Reactor::remove(Pollable &p) noexcept {
+    ::epoll_ctl(epoll_.get(), EPOLL_CTL_DEL, p.fd(), nullptr);
+}
+
+void Reactor::run() {
+    epoll_event events[32];
+
+    stopping_ = false;
+    while (!stopping_) {
+        int n = ::epoll_wait(epoll_.get(), events, 32, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_errno("epoll_wait failed");
+        }
+        for (int i = 0; i < n; i++) {
+            auto *p = static_cast<Pollable *>(events[i].data.ptr);
+            if (!p) {
+                std::uint64_t count;
+                if (::read(wake_.get(), &count, sizeof(count)) == sizeof(count))
+                    stopping_ = true;
+                continue;
+            }
+            if (events[i].events & EPOLLIN)
+                p->on_readable();
+            else if (events[i].events & (EPOLLERR | EPOLLHUP))
+                p->on_error(std::make_error_code(std::errc::io_error));
+        }
+    }
+}
+
+void Reactor::stop() noexcept {
+    std::uint64_t one = 1;
+
+    // Only async-signal-safe calls here
+    if (::write(wake_.get(), &one, sizeof(one)) < 0) {
+        // Counter saturated, a wakeup is already pending
+    }
+}
+
+/* ButtonDevice */
+
+bool ButtonAwaiter::await_ready() const noexcept {
+    // A failed device completes immediately with an empty result
+    return static_cast<bool>(dev_.error_);
+}
+
+void ButtonAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+    handle_ = h;
+    dev_.enqueue(this);
+}
+
+ButtonDevice::ButtonDevice(Reactor &reactor, const char *path)
+    : reactor_(reactor), fd_(::open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC)) {
+    int on = 1;
+
+    if (!fd_)
+        throw_errno("Failed to open button device");
+    if (::ioctl(fd_.get(), BUTTON_IOC_EVENT_MODE, &on) < 0)
+        throw_errno("Failed to enable button event mode");
+    reactor_.add(*this);
+}
+
+ButtonDevice::~ButtonDevice() {
+    reactor_.remove(*this);
+    fail_all(std::make_error_code(std::errc::operation_canceled));
+}
+
+bool ButtonDevice::pressed() const {
+    int value = 0;
+
+    if (::ioctl(fd_.get(), BUTTON_IOC_GET_STATUS, &value) < 0)
+        throw_errno("Failed to read button status");
+    return value != 0;
+}
+
+void ButtonDevice::set_chord_window(int ms) {
+    if (::ioctl(fd_.get(), BUTTON_IOC_SET_CHORD_WINDOW, &ms) < 0)
+        throw_errno("Failed to set chord window");
+}
+
+void ButtonDevice::enqueue(ButtonAwaiter *w) noexcept {
+    w->next_ = nullptr;
+    if (tail_)
+        tail_->next_ = w;
+    else
+        head_ = w;
+    tail_ = w;
+}
+
+void ButtonDevice::on_readable() {
+    for (;;) {
+        ssize_t n = ::read(fd_.get(), buf_.data(), buf_.capacity() * sizeof(button_event));
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR)
+                return;
+            on_error(last_error());
+            return;
+        }
+        if (n == 0)
+            return;
+        buf_.resize(n / sizeof(button_event));
+        dispatch(buf_.events());
+        if (buf_.size() < buf_.capacity())
+            return;
+    }
+}
+
+/*
+ * Hand a batch to the current waiters. The list is detached first so a
+ * resumed coroutine that awaits again queues for the next batch instead
+ * of being resumed twice by this one
+ */
+void ButtonDevice::dispatch(std::span<const button_event> batch) {
+    ButtonAwaiter *w = head_;
+    ButtonAwaiter *keep_head = nullptr, *keep_tail = nullptr;
+
+    head_ = tail_ = nullptr;
+    while (w) {
+        ButtonAwaiter *next = w->next_;
+        const button_event *match = nullptr;
+
+        if (w->batch_) {
+            std::size_t n = batch.size() < w->batch_->capacity() ? batch.size() : w->batch_->capacity();
+            std::copy_n(batch.begin(), n, w->batch_->data());
+            w->batch_->resize(n);
+            match = n ? &batch[0] : nullptr;
+        } else {
+            for (const auto &ev : batch) {
+                if ((!w->type_ || ev.type == w->type_) && (w->key_ < 0 || ev.key == w->key_)) {
+                    match = &ev;
+                    break;
+                }
+            }
+        }
+
+        if (match) {
+            w->result_ = *match;
+            w->handle_.resume();
+        } else {
+            w->next_ = nullptr;
+            if (keep_tail)
+                keep_tail->next_ = w;
+            else
+                keep_head = w;
+            keep_tail = w;
+        }
+        w = next;
+    }
+
+    // Unmatched waiters go back in front of anything queued meanwhile
+    if (keep_head) {
+        keep_tail->next_ = head_;
+        if (!head_)
+            tail_ = keep_tail;
+        head_ = keep_head;
+    }
+}
+
+void ButtonDevice::on_error(std::error_code ec) {
+    reactor_.remove(*this);
+    fail_all(ec);
+}
+
+void ButtonDevice::fail_all(std::error_code ec) noexcept {
+    ButtonAwaiter *w = head_;
+
+    error_ = ec;
+    head_ = tail_ = nullptr;
+    while (w) {
+        ButtonAwaiter *next = w->next_;
+        w->result_.reset();
+        w->handle_.resume();
+        w = next;
+    }
+}
+
+/* LedDevice */
+
+LedDevice::LedDevice(int index) : index_(index) {
+    char path[32];
+
+    std::snprintf(path, sizeof(path), "/dev/gpio_led%d", index);
+    fd_.reset(::open(path, O_RDWR | O_CLOEXEC));
+    if (!fd_)
+        throw_errno("Failed to open LED device");
+}
+
+bool LedDevice::state() const {
+    int status = 0;
+
+    if (::ioctl(fd_.get(), cmd_status, &status) < 0)
+        throw_errno("Failed to read LED status");
+    return status != 0;
+}
+
+std::error_code LedDevice::ioctl_cmd(unsigned long cmd) const noexcept {
+    if (::ioctl(fd_.get(), cmd) < 0)
+        return last_error();
+    return {};
+}
+
+} // namespace gpio
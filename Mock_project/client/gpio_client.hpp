@@ -0,0 +1,228 @@
+/*
+ * C++20 coroutine client for the Mock_project GPIO drivers
+ *
+ * Wraps /dev/gpio_button and /dev/gpio_ledN behind RAII handles and
+ * awaitables, all driven by one epoll Reactor thread:
+ *
+ *     gpio::Task blink(gpio::ButtonDevice &button, gpio::LedDevice &led) {
+ *         for (;;) {
+ *             auto ev = co_await button.next_press();
+ *             if (!ev)
+ *                 co_return;              // Device failed or closed
+ *             co_await led.toggle();
+ *         }
+ *     }
+ *
+ * Awaiters live in the awaiting coroutine's frame and are linked into an
+ * intrusive list on the device, so waiting never allocates. Any number
+ * of coroutines may wait on the same device; each event wakes every
+ * waiter whose filter matches, in the order they started waiting.
+ *
+ * Threading: a Reactor and the devices attached to it must only be used
+ * from the thread calling Reactor::run(), except Reactor::stop().
+ */
+#ifndef GPIO_CLIENT_HPP
+#define GPIO_CLIENT_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <system_error>
+
+#include "../include/gpio_control.h"
+
+namespace gpio {
+
+/* Owning file descriptor, closed on destruction */
+class Fd {
+public:
+    Fd() = default;
+    explicit Fd(int fd) : fd_(fd) {}
+    Fd(Fd &&other) noexcept : fd_(other.release()) {}
+    Fd &operator=(Fd &&other) noexcept;
+    Fd(const Fd &) = delete;
+    Fd &operator=(const Fd &) = delete;
+    ~Fd() { reset(); }
+
+    int get() const { return fd_; }
+    int release() { int fd = fd_; fd_ = -1; return fd; }
+    void reset(int fd = -1);
+    explicit operator bool() const { return fd_ >= 0; }
+
+private:
+    int fd_ = -1;
+};
+
+/* Fire-and-forget coroutine, starts immediately and frees itself on completion */
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() noexcept;
+    };
+};
+
+/* Something the reactor watches for readability */
+class Pollable {
+public:
+    virtual ~Pollable() = default;
+    virtual int fd() const = 0;
+    virtual void on_readable() = 0;
+    virtual void on_error(std::error_code ec) = 0;
+};
+
+/* Single threaded epoll loop */
+class Reactor {
+public:
+    Reactor();
+    Reactor(const Reactor &) = delete;
+    Reactor &operator=(const Reactor &) = delete;
+
+    void add(Pollable &p);
+    void remove(Pollable &p) noexcept;
+
+    /* Dispatch readiness until stop() is called */
+    void run();
+    /* Make run() return, callable from any thread or a signal handler */
+    void stop() noexcept;
+
+private:
+    Fd epoll_;
+    Fd wake_;           // eventfd written by stop()
+    bool stopping_ = false;
+};
+
+/* Fixed capacity, move-only buffer of button events */
+class EventBuffer {
+public:
+    explicit EventBuffer(std::size_t capacity)
+        : data_(std::make_unique<button_event[]>(capacity)), capacity_(capacity) {}
+    EventBuffer(EventBuffer &&) noexcept = default;
+    EventBuffer &operator=(EventBuffer &&) noexcept = default;
+    EventBuffer(const EventBuffer &) = delete;
+    EventBuffer &operator=(const EventBuffer &) = delete;
+
+    std::span<const button_event> events() const { return { data_.get(), size_ }; }
+    std::size_t size() const { return size_; }
+    std::size_t capacity() const { return capacity_; }
+    button_event *data() { return data_.get(); }
+    void resize(std::size_t n) { size_ = n < capacity_ ? n : capacity_; }
+
+private:
+    std::unique_ptr<button_event[]> data_;
+    std::size_t capacity_;
+    std::size_t size_ = 0;
+};
+
+class ButtonDevice;
+
+/* Awaiter shared by next_press(), next_event() and next_batch() */
+class ButtonAwaiter {
+public:
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> h) noexcept;
+    std::optional<button_event> await_resume() const noexcept { return result_; }
+
+private:
+    friend class ButtonDevice;
+    ButtonAwaiter(ButtonDevice &dev, std::uint16_t type, int key, EventBuffer *batch)
+        : dev_(dev), type_(type), key_(key), batch_(batch) {}
+
+    ButtonDevice &dev_;
+    std::uint16_t type_;            // 0 = any type
+    int key_;                       // -1 = any key
+    EventBuffer *batch_;            // Receives the whole read batch
+    std::coroutine_handle<> handle_;
+    ButtonAwaiter *next_ = nullptr;
+    std::optional<button_event> result_;
+};
+
+/* /dev/gpio_button in event mode */
+class ButtonDevice : public Pollable {
+public:
+    explicit ButtonDevice(Reactor &reactor, const char *path = BUTTON_DEVICE);
+    ~ButtonDevice() override;
+    ButtonDevice(const ButtonDevice &) = delete;
+    ButtonDevice &operator=(const ButtonDevice &) = delete;
+
+    /* Next debounced press, of @key or of any key when -1 */
+    ButtonAwaiter next_press(int key = -1) { return { *this, BUTTON_EV_PRESS, key, nullptr }; }
+    /* Next event of any type, including CHORD, MULTI_PRESS and OVERRUN */
+    ButtonAwaiter next_event() { return { *this, 0, -1, nullptr }; }
+    /* Next read batch copied into @buf; resumes with its first event */
+    ButtonAwaiter next_batch(EventBuffer &buf) { return { *this, 0, -1, &buf }; }
+
+    /* Key 0 pressed state, synchronous */
+    bool pressed() const;
+    void set_chord_window(int ms);
+
+    /* Set once the device failed; pending and later awaits resume empty */
+    std::error_code error() const { return error_; }
+
+    int fd() const override { return fd_.get(); }
+    void on_readable() override;
+    void on_error(std::error_code ec) override;
+
+private:
+    friend class ButtonAwaiter;
+    void enqueue(ButtonAwaiter *w) noexcept;
+    void dispatch(std::span<const button_event> batch);
+    void fail_all(std::error_code ec) noexcept;
+
+    Reactor &reactor_;
+    Fd fd_;
+    EventBuffer buf_{64};
+    ButtonAwaiter *head_ = nullptr;
+    ButtonAwaiter *tail_ = nullptr;
+    std::error_code error_;
+};
+
+/*
+ * Awaiter for LED ioctls. The driver completes them without blocking,
+ * so the awaiting coroutine never suspends and just gets the result
+ */
+class LedAwaiter {
+public:
+    bool await_ready() const noexcept { return true; }
+    void await_suspend(std::coroutine_handle<>) const noexcept {}
+    std::error_code await_resume() const noexcept { return ec_; }
+
+private:
+    friend class LedDevice;
+    explicit LedAwaiter(std::error_code ec) : ec_(ec) {}
+    std::error_code ec_;
+};
+
+/* /dev/gpio_ledN */
+class LedDevice {
+public:
+    explicit LedDevice(int index);
+    LedDevice(LedDevice &&) noexcept = default;
+    LedDevice &operator=(LedDevice &&) noexcept = default;
+
+    LedAwaiter set(bool on) { return LedAwaiter(ioctl_cmd(on ? cmd_on : cmd_off)); }
+    LedAwaiter toggle() { return LedAwaiter(ioctl_cmd(cmd_toggle)); }
+    /* Current state as tracked by the driver, synchronous */
+    bool state() const;
+    int index() const { return index_; }
+
+private:
+    static constexpr unsigned long cmd_on = _IO(LED_IOC_MAGIC, 1);
+    static constexpr unsigned long cmd_off = _IO(LED_IOC_MAGIC, 2);
+    static constexpr unsigned long cmd_toggle = _IO(LED_IOC_MAGIC, 3);
+    static constexpr unsigned long cmd_status = _IOR(LED_IOC_MAGIC, 4, int);
+
+    std::error_code ioctl_cmd(unsigned long cmd) const noexcept;
+
+    Fd fd_;
+    int index_;
+};
+
+} // namespace gpio
+
+#endif // GPIO_CLIENT_HPP
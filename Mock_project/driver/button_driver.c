@@ -11,317 +11,1764 @@
 #include <linux/uaccess.h>      /* For copy_to/from_user */
 #include <linux/timer.h>        /* For timer functionality */
 #include <linux/workqueue.h>    /* For workqueue */
+#include <linux/slab.h>         /* For kzalloc/kfree */
+#include <linux/poll.h>         /* For poll support */
+#include <linux/wait.h>         /* For wait queues */
+#include <linux/spinlock.h>     /* For event queue lock */
+#include <linux/mutex.h>        /* For per-reader lock */
+#include <linux/ktime.h>        /* For ns timestamps */
+#include <linux/bitops.h>       /* For key bitmaps */
 #include <linux/of.h>           /* For device tree support */
+#include <linux/uio.h>          /* For read_iter */
+#include <linux/io_uring.h>     /* For uring_cmd event waits */
+#include <linux/rcupdate.h>     /* For the rule table */
+#include <linux/seqlock.h>      /* For the status snapshot */
+#include <linux/irq.h>          /* For IRQ affinity */
+#include <linux/cpumask.h>      /* For IRQ affinity masks */
+#include <linux/percpu.h>       /* For per-CPU IRQ counts */
+#include <linux/sched.h>        /* For the IRQ thread */
+#include <linux/sched/task.h>   /* For IRQ thread references */
+#include <uapi/linux/sched/types.h> /* For struct sched_attr */
+#include <linux/pm.h>           /* For dev_pm_ops */
+#include <linux/pm_wakeup.h>    /* For wakeup-source */
+#include <kunit/static_stub.h>  /* For KUnit fake clock and GPIO backend */
+
+#include "gpio_control.h"       /* Shared event and IOCTL definitions */
+#include "gpio_status.h"        /* /proc/gpio_ctl_status */
+#include "gpio_debounce.h"      /* Adaptive debounce estimator */
+
+#define CREATE_TRACE_POINTS
+#include "button_trace.h"       /* Pipeline tracepoints */
 
 /* Device and timing constants */
 #define DEVICE_NAME "gpio_button"
 #define DEVICE_CLASS "gpio_button_class"
-#define DEBOUNCE_TIME_MS 50        /* Debounce time in milliseconds */
+#define DEBOUNCE_MIN_MS 2          /* Default lower bound of the debounce window */
+#define DEBOUNCE_MAX_MS 50         /* Default upper bound, also the starting window */
+#define DEBOUNCE_LIMIT_MS 1000     /* Largest bound accepted from the device tree */
 #define MULTI_PRESS_TIMEOUT_MS 1000 /* Timeout for multi-press detection */
+#define DEFAULT_CHORD_WINDOW_MS 150 /* Keys pressed within this window form a chord */
+#define EVENT_RING_SIZE 256        /* Event queue entries, power of two */
+#define EVENT_RING_MASK (EVENT_RING_SIZE - 1)
+#define READ_BATCH 16              /* Events copied per lock hold in read */
+#define NUM_LEDS 3                 /* LEDs driven by the rules */
+#define LED_MASK_ALL GENMASK(NUM_LEDS - 1, 0)
+#define PATTERN_STEP_MIN_MS 10
+#define PATTERN_STEP_MAX_MS 10000
+#define WAKE_WINDOW_MS 500         /* A key IRQ this soon after resume woke the system */
 
-/* External function declaration from LED driver */
-extern struct gpio_desc *led_get_gpio(int index);
+/* LED provider API from led_driver, get returns -EPROBE_DEFER until it has probed */
+extern int led_provider_get(struct device *consumer, struct device_node *np);
+extern int led_provider_set(u32 mask, u32 value);
+
+/*
+ * Per-key state, kept small so the keys a handler touches stay in as
+ * few cache lines as possible. Only the key that fired is accessed
+ */
+struct button_key {
+    struct gpio_debounce db;              /* Adaptive debounce over both edges */
+    u32 accepted;                         /* Edges accepted as presses */
+    struct gpio_desc *gpio;               /* GPIO descriptor for this key */
+    int irq;                              /* IRQ number for this key */
+    u8 index;                             /* Position in button-gpios */
+    struct task_struct *thread;           /* IRQ thread, NULL if not threaded or not seen yet */
+};
 
 /* GPIO and device related variables */
-static struct gpio_desc *button_gpio;     /* GPIO descriptor for button */
-static int button_irq;                    /* IRQ number for button */
+static struct button_key keys[BUTTON_MAX_KEYS]; /* Configured keys */
+static unsigned int num_keys;             /* Number of button-gpios entries */
+static u32 debounce_min_ns = DEBOUNCE_MIN_MS * NSEC_PER_MSEC; /* Window bounds */
+static u32 debounce_max_ns = DEBOUNCE_MAX_MS * NSEC_PER_MSEC;
 static dev_t dev_number;                  /* Device number */
 static struct class *dev_class;           /* Device class */
 static struct cdev button_cdev;           /* Character device structure */
 static struct device *button_device;      /* Device structure */
 
+/*
+ * IRQ placement, set from the device tree and then sysfs, the same for
+ * every key. The affinity hint (and affinity) goes on each key's IRQ; when
+ * the IRQ is threaded (threadirqs, PREEMPT_RT) the thread gets the policy
+ * and priority as soon as it first runs the handler
+ */
+static struct cpumask button_irq_affinity; /* Hint, referenced by the IRQ core; empty = none */
+static int button_irq_policy = -1;        /* SCHED_*, -1 = leave the IRQ thread alone */
+static unsigned int button_irq_prio;      /* 1 to MAX_RT_PRIO - 1 for SCHED_FIFO/SCHED_RR */
+static DEFINE_MUTEX(irq_config_lock);     /* Serializes the knobs and applying them */
+static struct work_struct irq_sched_work; /* Applies the policy to newly seen threads */
+static DEFINE_PER_CPU(unsigned long, button_irq_count); /* Handler runs, all keys */
+
+static const char *const irq_policy_names[] = {
+    [SCHED_NORMAL] = "other",
+    [SCHED_FIFO] = "fifo",
+    [SCHED_RR] = "rr",
+};
+
 /* Button press handling variables */
 static int press_count = 0;               /* Count of button presses */
 static struct timer_list press_timer;     /* Timer for multi-press detection */
 static struct work_struct button_work;    /* Work structure for button processing */
 static bool button_pressed = false;       /* Button press state */
 
-/* LED control variables */
-static struct gpio_desc *led_gpios[3];    /* Array of LED GPIO descriptors */
-static int current_led_state = 0;         /* Current LED state:
-                                            0 = all off
-                                            1-3 = individual LEDs
-                                            4 = all on */
+/*
+ * Shared event queue: one ring for all keys, ordered by a global
+ * sequence number assigned under event_lock. Every open file in event
+ * mode keeps its own cursor into the ring
+ */
+static struct button_event event_ring[EVENT_RING_SIZE];
+static u64 event_seq;                     /* Last assigned sequence number */
+static DEFINE_SPINLOCK(event_lock);       /* Protects ring, event_seq, chord state */
+/*
+ * Lets the status file read event_seq, the newest entry and the wake
+ * record without event_lock
+ */
+static seqcount_spinlock_t event_seqcount = SEQCNT_SPINLOCK_ZERO(event_seqcount, &event_lock);
+static DECLARE_WAIT_QUEUE_HEAD(event_wait);
+
+/*
+ * Wake latency record, written under event_lock inside event_seqcount
+ * so button_wake_snapshot() can read it locklessly. Opened by resume_noirq; the
+ * first key IRQ within WAKE_WINDOW_MS is taken as the wake edge and its
+ * first PRESS is followed until the rule worker and a reader have it
+ */
+static struct {
+    u64 suspend_ns;                       /* CLOCK_BOOTTIME at suspend */
+    u64 resume_ns;                        /* Open record, 0 = none */
+    u64 seq;                              /* PRESS queued after the wake edge, 0 = none yet */
+    bool irq_seen;
+    bool rules_seen;
+    bool read_seen;
+    struct button_wake_info info;
+} wake;
+static unsigned long wake_armed;          /* Keys with IRQ wake enabled while suspended */
+
+/* Chord detection: keys pressed within chord_window_ms of the first one */
+static struct timer_list chord_timer;     /* Closes the chord window */
+static unsigned long chord_mask;          /* Keys pressed in the open window */
+static unsigned int chord_window_ms = DEFAULT_CHORD_WINDOW_MS;
+
+/*
+ * Pending BUTTON_URING_CMD_WAIT. Listed on uring_waiters under event_lock
+ * until an event or the timeout takes it off, then completed from the
+ * submitting task, which copies the event out and frees it
+ */
+struct button_uring_waiter {
+    struct list_head node;
+    struct io_uring_cmd *ioucmd;
+    struct button_event __user *uevent;
+    struct button_event event;            /* Event that completed the wait */
+    struct timer_list timeout;
+    int status;                           /* 0 while pending, then the CQE result */
+    u16 type;                             /* 0 = any type */
+    u16 key;                              /* BUTTON_URING_ANY_KEY = any key */
+};
+static LIST_HEAD(uring_waiters);
+
+/* Per-open-file reader state */
+struct button_reader {
+    struct mutex lock;                    /* Serializes reads on one file */
+    bool event_mode;                      /* read() returns struct button_event */
+    u64 next_seq;                         /* Next sequence number to return */
+    /* Filter, changed and applied under event_lock */
+    u32 filter_types;                     /* Bit N = deliver type N, 0 = all */
+    u32 filter_keys;                      /* Keys of interest, 0 = all */
+    u64 min_interval_ns;                  /* Rate limit, 0 = off */
+    u64 last_delivered;                   /* Timestamp of the last event passed */
+};
+
+/* LED control variables */
+static int current_led_state = 0;         /* Current LED state:
+                                            0 = all off
+                                            1-3 = individual LEDs
+                                            4 = all on
+                                            5 = other combination */
+static unsigned long led_mask;            /* Current LED levels, bit N = LED N */
+static DEFINE_MUTEX(led_lock);            /* Serializes rule actions and patterns */
+
+/*
+ * Active rule table. Readers are the rule worker under rcu_read_lock(),
+ * updates swap the whole table under rules_lock and free the old one
+ * after a grace period, so an ioctl never stalls event processing
+ */
+struct button_rule_set {
+    struct rcu_head rcu;
+    unsigned int count;
+    struct button_rule rules[];
+};
+static struct button_rule_set __rcu *button_rules;
+static DEFINE_MUTEX(rules_lock);
+
+/* Built-in table, the press count mapping this driver always had */
+static const struct button_rule default_rules[] = {
+    { .type = BUTTON_EV_MULTI_PRESS, .min = 1, .max = 1,
+      .action = BUTTON_RULE_SET, .mask = LED_MASK_ALL, .value = BIT(0) },  /* Green */
+    { .type = BUTTON_EV_MULTI_PRESS, .min = 2, .max = 2,
+      .action = BUTTON_RULE_SET, .mask = LED_MASK_ALL, .value = BIT(1) },  /* White */
+    { .type = BUTTON_EV_MULTI_PRESS, .min = 3, .max = 3,
+      .action = BUTTON_RULE_SET, .mask = LED_MASK_ALL, .value = BIT(2) },  /* Yellow */
+    { .type = BUTTON_EV_MULTI_PRESS, .min = 4, .max = 4,
+      .action = BUTTON_RULE_SET, .mask = LED_MASK_ALL, .value = LED_MASK_ALL },
+    { .type = BUTTON_EV_MULTI_PRESS, .min = 5, .max = U32_MAX,
+      .action = BUTTON_RULE_CLEAR, .mask = LED_MASK_ALL },
+};
+
+/*
+ * The rule engine is one more reader of the event queue, drained by
+ * rule_work so actions run in process context right after the event
+ */
+static struct work_struct rule_work;
+static struct button_reader rule_reader;
+
+/* Pattern being played by a BUTTON_RULE_PATTERN action */
+static struct {
+    struct delayed_work work;
+    struct button_rule rule;
+    unsigned int step;
+    unsigned int played;
+    bool active;
+} led_pattern;
+
+/* Function prototypes for file operations */
+static int button_open(struct inode *, struct file *);
+static int button_release(struct inode *, struct file *);
+static ssize_t button_read_iter(struct kiocb *, struct iov_iter *);
+static ssize_t button_write(struct file *, const char __user *, size_t, loff_t *);
+static __poll_t button_poll(struct file *, poll_table *);
+static long button_ioctl(struct file *, unsigned int, unsigned long);
+static int button_uring_cmd(struct io_uring_cmd *, unsigned int);
+static void button_uring_match(const struct button_event *ev, struct list_head *done);
+static void button_uring_complete_list(struct list_head *done);
+static int button_fetch_events(struct button_reader *reader, struct button_event *out, int max);
+static void button_rules_kick(void);
+
+/* File operations structure */
+static struct file_operations fops = {
+    .owner = THIS_MODULE,
+    .open = button_open,
+    .release = button_release,
+    .read_iter = button_read_iter,
+    .write = button_write,
+    .poll = button_poll,
+    .unlocked_ioctl = button_ioctl,
+    .uring_cmd = button_uring_cmd,
+};
+
+/*
+ * Append one event to the shared queue and wake readers
+ * Callable from IRQ, timer and process context
+ */
+static void button_queue_event(u16 type, u16 key, u32 value)
+{
+    struct button_event *ev;
+    unsigned long flags;
+    LIST_HEAD(done);
+
+    spin_lock_irqsave(&event_lock, flags);
+    write_seqcount_begin(&event_seqcount);
+    ev = &event_ring[++event_seq & EVENT_RING_MASK];
+    ev->seq = event_seq;
+    ev->timestamp = ktime_get_ns();
+    ev->type = type;
+    ev->key = key;
+    ev->value = value;
+    if (unlikely(wake.irq_seen && !wake.seq) && type == BUTTON_EV_PRESS) {
+        wake.seq = ev->seq;
+        wake.info.resume_event_ns = ev->timestamp - wake.resume_ns;
+    }
+    write_seqcount_end(&event_seqcount);
+    trace_button_event(ev->seq, type, key, value);
+    if (!list_empty(&uring_waiters))
+        button_uring_match(ev, &done);
+    spin_unlock_irqrestore(&event_lock, flags);
+
+    wake_up_interruptible(&event_wait);
+    button_uring_complete_list(&done);
+    button_rules_kick();
+}
+
+/*
+ * Add a key to the chord window, opening the window on the first key
+ * Called from the IRQ handler of the key that was pressed
+ */
+static void button_chord_add(u8 index)
+{
+    unsigned long flags;
+    bool first;
+
+    spin_lock_irqsave(&event_lock, flags);
+    first = !chord_mask;
+    chord_mask |= BIT(index);
+    spin_unlock_irqrestore(&event_lock, flags);
+
+    if (first)
+        mod_timer(&chord_timer, jiffies + msecs_to_jiffies(chord_window_ms));
+}
+
+/*
+ * Timer callback closing the chord window
+ * Two or more keys pressed inside the window are reported as one chord
+ */
+static void chord_timer_callback(struct timer_list *timer)
+{
+    unsigned long flags, mask;
+
+    spin_lock_irqsave(&event_lock, flags);
+    mask = chord_mask;
+    chord_mask = 0;
+    spin_unlock_irqrestore(&event_lock, flags);
+
+    if (hweight_long(mask) >= 2) {
+        pr_info("Chord detected: key mask 0x%lx\n", mask);
+        button_queue_event(BUTTON_EV_CHORD, 0, mask);
+    }
+}
+
+/*
+ * Current time for debouncing, in ns. Bounce gaps are well below a
+ * jiffy, so the estimator needs the high resolution clock
+ * Replaced by a fake clock in the KUnit tests
+ */
+static u64 button_now(void)
+{
+    KUNIT_STATIC_STUB_REDIRECT(button_now);
+    return ktime_get_ns();
+}
+
+/*
+ * Forget what a key has learnt, start from the conservative upper bound
+ */
+static void button_debounce_reset(struct button_key *key)
+{
+    gpio_debounce_reset(&key->db, debounce_max_ns);
+    key->accepted = 0;
+}
+
+/*
+ * Adaptive per-key debounce over both edges, see gpio_debounce.h.
+ * Releases bounce too: an accepted release opens the window the same
+ * way, so its bounces are rejected instead of counted as presses, and
+ * their gaps are learnt like those of a press
+ * @pressed: Line level after the edge, true for a press
+ * Returns true if the edge is a press
+ */
+static bool button_debounce(struct button_key *key, u64 now, bool pressed)
+{
+    u64 gap = key->db.last_edge ? now - key->db.last_edge : 0;
+    u32 window = key->db.window_ns;
+    bool accepted;
+
+    accepted = gpio_debounce_edge(&key->db, now, pressed, debounce_min_ns, debounce_max_ns);
+    trace_button_edge(key->index, accepted, !pressed, gap, window);
+    if (!accepted || !pressed)
+        return false;
+    key->accepted++;
+    return true;
+}
+
+/*
+ * Level of a key right after its edge. Pull-up input, pressed pulls the
+ * line low. Replaced by fake pins in the KUnit tests
+ */
+static bool button_key_pressed(struct button_key *key)
+{
+    KUNIT_STATIC_STUB_REDIRECT(button_key_pressed, key);
+    return gpiod_get_value(key->gpio) == 0;
+}
+
+/*
+ * Drive the LEDs from a bitmask, bit N = LED N
+ * Goes through led_driver so LED event readers see the change
+ * Replaced by a fake LED backend in the KUnit tests
+ */
+static void button_set_leds(unsigned long mask)
+{
+    int ret;
+
+    KUNIT_STATIC_STUB_REDIRECT(button_set_leds, mask);
+
+    ret = led_provider_set(LED_MASK_ALL, mask);
+    if (ret)
+        pr_warn("Failed to set LEDs to 0x%lx: %d\n", mask, ret);
+}
+
+/*
+ * Legacy state code of a LED mask, see current_led_state
+ */
+static int button_led_state(unsigned long mask)
+{
+    if (!mask)
+        return 0;
+    if (mask == LED_MASK_ALL)
+        return 4;
+    if (hweight_long(mask) == 1)
+        return __ffs(mask) + 1;
+    return 5;
+}
+
+/*
+ * Set the LEDs and remember the levels
+ * Called with led_lock held, or before any event can be processed
+ */
+static void button_apply_leds(unsigned long mask)
+{
+    led_mask = mask & LED_MASK_ALL;
+    current_led_state = button_led_state(led_mask);
+    button_set_leds(led_mask);
+}
+
+/* 
+ * Turn off all connected LEDs
+ * Called during initialization and state changes
+ */
+static void turn_off_all_leds(void)
+{
+    mutex_lock(&led_lock);
+    led_pattern.active = false;
+    button_apply_leds(0);
+    mutex_unlock(&led_lock);
+    pr_info("All LEDs turned OFF\n");
+}
+
+/*
+ * Allocate an empty rule table for @count rules
+ */
+static struct button_rule_set *button_rules_alloc(unsigned int count)
+{
+    struct button_rule_set *set;
+
+    set = kzalloc(struct_size(set, rules, count), GFP_KERNEL);
+    if (set)
+        set->count = count;
+    return set;
+}
+
+/*
+ * Check one uploaded rule
+ * Returns: 0 if the rule can be evaluated, -EINVAL otherwise
+ */
+static int button_rule_validate(const struct button_rule *r)
+{
+    if (r->type != BUTTON_EV_PRESS && r->type != BUTTON_EV_CHORD &&
+        r->type != BUTTON_EV_MULTI_PRESS)
+        return -EINVAL;
+    if (r->min > r->max || (r->mask & ~LED_MASK_ALL) || (r->flags & ~BUTTON_RULE_F_CONTINUE))
+        return -EINVAL;
+    if (r->type == BUTTON_EV_PRESS && r->key >= BUTTON_MAX_KEYS && r->key != BUTTON_RULE_ANY_KEY)
+        return -EINVAL;
+
+    switch (r->action) {
+        case BUTTON_RULE_SET:
+        case BUTTON_RULE_CLEAR:
+        case BUTTON_RULE_TOGGLE:
+            return 0;
+        case BUTTON_RULE_PATTERN:
+            if (r->steps < 1 || r->steps > BUTTON_RULE_PATTERN_STEPS ||
+                r->step_ms < PATTERN_STEP_MIN_MS || r->step_ms > PATTERN_STEP_MAX_MS)
+                return -EINVAL;
+            return 0;
+        default:
+            return -EINVAL;
+    }
+}
+
+/*
+ * Make @set the active table; NULL removes the table
+ * The old table is freed once no rule worker can still be using it
+ */
+static void button_rules_publish(struct button_rule_set *set)
+{
+    struct button_rule_set *old;
+
+    mutex_lock(&rules_lock);
+    old = rcu_replace_pointer(button_rules, set, lockdep_is_held(&rules_lock));
+    mutex_unlock(&rules_lock);
+
+    if (old)
+        kfree_rcu(old, rcu);
+}
+
+/*
+ * Install the built-in table
+ */
+static int button_rules_set_default(void)
+{
+    struct button_rule_set *set = button_rules_alloc(ARRAY_SIZE(default_rules));
+
+    if (!set)
+        return -ENOMEM;
+    memcpy(set->rules, default_rules, sizeof(default_rules));
+    button_rules_publish(set);
+    return 0;
+}
+
+/*
+ * BUTTON_IOC_SET_RULES: validate and swap in a table from userspace
+ */
+static int button_rules_upload(const struct button_rule_table __user *utable)
+{
+    struct button_rule_table table;
+    struct button_rule_set *set;
+    unsigned int i;
+
+    if (copy_from_user(&table, utable, sizeof(table)))
+        return -EFAULT;
+    if (!table.rules)
+        return button_rules_set_default();
+    if (table.count > BUTTON_RULES_MAX)
+        return -EINVAL;
+
+    set = button_rules_alloc(table.count);
+    if (!set)
+        return -ENOMEM;
+    if (copy_from_user(set->rules, u64_to_user_ptr(table.rules),
+                       table.count * sizeof(set->rules[0]))) {
+        kfree(set);
+        return -EFAULT;
+    }
+    for (i = 0; i < set->count; i++) {
+        if (button_rule_validate(&set->rules[i])) {
+            kfree(set);
+            return -EINVAL;
+        }
+    }
+
+    button_rules_publish(set);
+    pr_info("Loaded %u button rules\n", set->count);
+    return 0;
+}
+
+/*
+ * BUTTON_IOC_GET_RULES: copy out the active table
+ */
+static int button_rules_download(struct button_rule_table __user *utable)
+{
+    struct button_rule_table table;
+    const struct button_rule_set *set;
+    unsigned int n;
+    int ret = 0;
+
+    if (copy_from_user(&table, utable, sizeof(table)))
+        return -EFAULT;
+
+    mutex_lock(&rules_lock);
+    set = rcu_dereference_protected(button_rules, lockdep_is_held(&rules_lock));
+    n = set ? set->count : 0;
+    if (set && table.rules && copy_to_user(u64_to_user_ptr(table.rules), set->rules,
+                                    min(n, table.count) * sizeof(set->rules[0])))
+        ret = -EFAULT;
+    mutex_unlock(&rules_lock);
+
+    table.count = n;
+    if (!ret && copy_to_user(utable, &table, sizeof(table)))
+        ret = -EFAULT;
+    return ret;
+}
+
+/*
+ * True if @r is triggered by @ev
+ */
+static bool button_rule_match(const struct button_rule *r, const struct button_event *ev)
+{
+    if (r->type != ev->type)
+        return false;
+    if (ev->type == BUTTON_EV_PRESS)
+        return r->key == BUTTON_RULE_ANY_KEY || r->key == ev->key;
+    return ev->value >= r->min && ev->value <= r->max;
+}
+
+/* Outcome of running one event through the rule table */
+struct button_rule_result {
+    unsigned long mask;                   /* LED levels after the plain actions */
+    bool leds;                            /* A SET/CLEAR/TOGGLE rule matched */
+    const struct button_rule *pattern;    /* Last matching PATTERN rule */
+};
+
+/*
+ * Run one event through a rule table
+ * @mask: LED levels before the event
+ */
+static void button_rules_eval(const struct button_rule_set *set, const struct button_event *ev,
+                              unsigned long mask, struct button_rule_result *res)
+{
+    const struct button_rule *r;
+    unsigned int i;
+
+    res->leds = false;
+    res->pattern = NULL;
+    for (i = 0; i < set->count; i++) {
+        r = &set->rules[i];
+        if (!button_rule_match(r, ev))
+            continue;
+
+        switch (r->action) {
+            case BUTTON_RULE_SET:
+                mask = (mask & ~r->mask) | (r->value & r->mask);
+                res->leds = true;
+                break;
+            case BUTTON_RULE_CLEAR:
+                mask &= ~r->mask;
+                res->leds = true;
+                break;
+            case BUTTON_RULE_TOGGLE:
+                mask ^= r->mask;
+                res->leds = true;
+                break;
+            case BUTTON_RULE_PATTERN:
+                res->pattern = r;
+                break;
+        }
+        if (!(r->flags & BUTTON_RULE_F_CONTINUE))
+            break;
+    }
+    res->mask = mask;
+}
+
+/*
+ * Advance the running pattern by one step
+ */
+static void button_pattern_work(struct work_struct *work)
+{
+    const struct button_rule *r = &led_pattern.rule;
+    unsigned long levels;
+
+    mutex_lock(&led_lock);
+    if (!led_pattern.active)
+        goto out;
+
+    levels = (r->pattern >> (4 * led_pattern.step)) & LED_MASK_ALL;
+    button_apply_leds((led_mask & ~r->mask) | (levels & r->mask));
+
+    if (++led_pattern.step == r->steps) {
+        led_pattern.step = 0;
+        if (r->repeat && ++led_pattern.played >= r->repeat) {
+            led_pattern.active = false;
+            goto out;
+        }
+    }
+    schedule_delayed_work(&led_pattern.work, msecs_to_jiffies(r->step_ms));
+out:
+    mutex_unlock(&led_lock);
+}
+
+/*
+ * Apply one event: plain actions take effect at once, a matching
+ * pattern replaces the running one, and any action stops a pattern
+ * Called with led_lock held and inside rcu_read_lock()
+ */
+static void button_rules_apply(const struct button_rule_set *set, const struct button_event *ev)
+{
+    struct button_rule_result res;
+
+    button_rules_eval(set, ev, led_mask, &res);
+    trace_button_rule(ev->seq, ev->type, res.leds, res.mask);
+    if (res.leds) {
+        led_pattern.active = false;
+        button_apply_leds(res.mask);
+    }
+    if (res.pattern) {
+        led_pattern.rule = *res.pattern;
+        led_pattern.step = 0;
+        led_pattern.played = 0;
+        led_pattern.active = true;
+        mod_delayed_work(system_wq, &led_pattern.work, 0);
+    }
+}
+
+/*
+ * Rule worker: evaluate every event queued since the last run
+ */
+static void button_rule_work_handler(struct work_struct *work)
+{
+    struct button_event batch[READ_BATCH];
+    const struct button_rule_set *set;
+    int n, i;
+
+    mutex_lock(&led_lock);
+    do {
+        n = button_fetch_events(&rule_reader, batch, READ_BATCH);
+
+        rcu_read_lock();
+        set = rcu_dereference(button_rules);
+        for (i = 0; set && i < n; i++) {
+            if (batch[i].type != BUTTON_EV_OVERRUN)
+                button_rules_apply(set, &batch[i]);
+        }
+        rcu_read_unlock();
+    } while (n == READ_BATCH);
+    mutex_unlock(&led_lock);
+}
+
+/*
+ * Schedule the rule worker after an event was queued
+ * Callable from any context; the KUnit tests run the worker by hand
+ */
+static void button_rules_kick(void)
+{
+    KUNIT_STATIC_STUB_REDIRECT(button_rules_kick);
+
+    if (rcu_access_pointer(button_rules))
+        schedule_work(&rule_work);
+}
+
+/*
+ * Work queue handler for processing button presses
+ * Called after button press timeout or 5 presses
+ * Queues the MULTI_PRESS event; the rule table decides what the LEDs do
+ */
+static void button_work_handler(struct work_struct *work)
+{
+    pr_info("Processing %d button presses\n", press_count);
+    button_queue_event(BUTTON_EV_MULTI_PRESS, 0, press_count);
+    
+    /* Reset press count after processing */
+    press_count = 0;
+}
+
+/*
+ * Timer callback for multi-press timeout
+ * Called after MULTI_PRESS_TIMEOUT_MS if no more presses
+ */
+static void press_timer_callback(struct timer_list *timer)
+{
+    if (press_count > 0) {
+        trace_button_press_window(press_count);
+        /* Schedule work to process the button presses */
+        schedule_work(&button_work);
+    }
+}
+
+/*
+ * Task running the handler when the IRQ is threaded, NULL in hard IRQ
+ * context. The KUnit tests call the handler from a kthread and fake it
+ */
+static struct task_struct *button_irq_thread(void)
+{
+    KUNIT_STATIC_STUB_REDIRECT(button_irq_thread);
+    return in_task() ? current : NULL;
+}
+
+/*
+ * Remember the IRQ thread of @key the first time it runs the handler
+ * and have the thread policy applied to it
+ */
+static void button_irq_thread_seen(struct button_key *key, struct task_struct *thread)
+{
+    get_task_struct(thread);
+    if (cmpxchg(&key->thread, NULL, thread)) {
+        put_task_struct(thread);
+        return;
+    }
+    schedule_work(&irq_sched_work);
+}
+
+/*
+ * Open a wake record, called from resume_noirq
+ */
+static void button_wake_open(void)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&event_lock, flags);
+    write_seqcount_begin(&event_seqcount);
+    wake.info.resumes++;
+    wake.info.asleep_ns = wake.suspend_ns ? ktime_get_boottime_ns() - wake.suspend_ns : 0;
+    wake.resume_ns = ktime_get_ns();
+    wake.seq = 0;
+    wake.irq_seen = false;
+    wake.rules_seen = false;
+    wake.read_seen = false;
+    write_seqcount_end(&event_seqcount);
+    spin_unlock_irqrestore(&event_lock, flags);
+}
+
+/*
+ * First key IRQ after resume. Inside WAKE_WINDOW_MS it is the wake edge,
+ * later the system woke for something else and the record is dropped
+ */
+static void button_wake_irq(void)
+{
+    unsigned long flags;
+    u64 ns;
+
+    spin_lock_irqsave(&event_lock, flags);
+    if (wake.resume_ns && !wake.irq_seen) {
+        ns = ktime_get_ns() - wake.resume_ns;
+        write_seqcount_begin(&event_seqcount);
+        if (ns > WAKE_WINDOW_MS * NSEC_PER_MSEC) {
+            wake.resume_ns = 0;
+        } else {
+            wake.irq_seen = true;
+            wake.info.key_wakes++;
+            wake.info.resume_irq_ns = ns;
+        }
+        write_seqcount_end(&event_seqcount);
+    }
+    spin_unlock_irqrestore(&event_lock, flags);
+}
+
+/*
+ * The wake PRESS was handed to @reader, NULL for an io_uring wait
+ * Called with event_lock held
+ */
+static void button_wake_delivered(const struct button_reader *reader)
+{
+    u64 ns = ktime_get_ns() - wake.resume_ns;
+
+    if (reader == &rule_reader) {
+        if (!wake.rules_seen) {
+            write_seqcount_begin(&event_seqcount);
+            wake.rules_seen = true;
+            wake.info.resume_rules_ns = ns;
+            write_seqcount_end(&event_seqcount);
+        }
+        return;
+    }
+    if (wake.read_seen)
+        return;
+    write_seqcount_begin(&event_seqcount);
+    wake.read_seen = true;
+    wake.info.delivered++;
+    wake.info.resume_read_ns = ns;
+    wake.info.resume_read_sum_ns += ns;
+    wake.info.resume_read_max_ns = max(wake.info.resume_read_max_ns, ns);
+    write_seqcount_end(&event_seqcount);
+}
+
+/*
+ * Copy out the wake latency counters without event_lock, so the
+ * /proc status callback stays off the driver's locks
+ */
+static void button_wake_snapshot(struct button_wake_info *info)
+{
+    unsigned int seq;
+
+    do {
+        seq = read_seqcount_begin(&event_seqcount);
+        *info = wake.info;
+    } while (read_seqcount_retry(&event_seqcount, seq));
+}
+
+/*
+ * IRQ handler for both edges of a key, one IRQ per key
+ * @dev_id: struct button_key of the key that fired
+ * Implements adaptive per-key debouncing; on a press queues a PRESS event and feeds the
+ * chord window. Key 0 also drives the multi-press LED control and
+ * schedules work immediately on 5 presses
+ */
+static irqreturn_t button_irq_handler(int irq, void *dev_id)
+{
+    struct button_key *key = dev_id;
+    struct task_struct *thread;
+    
+    this_cpu_inc(button_irq_count);
+    thread = button_irq_thread();
+    if (unlikely(thread && !key->thread))
+        button_irq_thread_seen(key, thread);
+    if (unlikely(READ_ONCE(wake.resume_ns) && !READ_ONCE(wake.irq_seen)))
+        button_wake_irq();
+    
+    if (!button_debounce(key, button_now(), button_key_pressed(key)))
+        return IRQ_HANDLED;
+    
+    button_pressed = true;
+    button_queue_event(BUTTON_EV_PRESS, key->index, 0);
+    if (num_keys > 1)
+        button_chord_add(key->index);
+
+    if (key->index != 0)
+        return IRQ_HANDLED;
+
+    press_count++;
+    
+    pr_info("Button pressed! Count: %d\n", press_count);
+    
+    /* Reset or start the timer for multi-press detection */
+    mod_timer(&press_timer, jiffies + msecs_to_jiffies(MULTI_PRESS_TIMEOUT_MS));
+    
+    /* If we reach 5 presses, process immediately */
+    if (press_count >= 5) {
+        del_timer(&press_timer);
+        trace_button_press_window(press_count);
+        schedule_work(&button_work);
+    }
+    
+    return IRQ_HANDLED;
+}
+
+/*
+ * Check an event against the reader's filter
+ * Called with event_lock held
+ */
+static bool button_filter_pass(const struct button_reader *reader, const struct button_event *ev)
+{
+    unsigned long keys;
+
+    if (reader->filter_types && !(reader->filter_types & BIT(ev->type)))
+        return false;
+    if (reader->filter_keys) {
+        keys = ev->type == BUTTON_EV_CHORD ? ev->value : BIT(ev->key);
+        if (!(keys & reader->filter_keys))
+            return false;
+    }
+    if (reader->min_interval_ns && reader->last_delivered &&
+        ev->timestamp - reader->last_delivered < reader->min_interval_ns)
+        return false;
+    return true;
+}
+
+/*
+ * Step the reader's cursor over queued events its filter rejects, so
+ * poll and blocking reads only wake up for events it will get
+ * Called with event_lock held
+ */
+static void button_skip_filtered(struct button_reader *reader)
+{
+    /* A lapped reader is handled by the OVERRUN path in button_fetch_events */
+    if (event_seq >= EVENT_RING_SIZE && reader->next_seq <= event_seq - EVENT_RING_SIZE)
+        return;
+    while (reader->next_seq <= event_seq &&
+           !button_filter_pass(reader, &event_ring[reader->next_seq & EVENT_RING_MASK]))
+        reader->next_seq++;
+}
+
+/*
+ * True when the reader has queued events it has not consumed yet
+ * Both sequence numbers are u64, only read under event_lock so 32-bit
+ * builds cannot see them torn
+ */
+static bool button_event_ready(struct button_reader *reader)
+{
+    unsigned long flags;
+    bool ready;
+
+    spin_lock_irqsave(&event_lock, flags);
+    if (reader->filter_types || reader->filter_keys || reader->min_interval_ns)
+        button_skip_filtered(reader);
+    ready = reader->next_seq <= event_seq;
+    spin_unlock_irqrestore(&event_lock, flags);
+    return ready;
+}
+
+/*
+ * Copy up to @max events for a reader out of the queue
+ * Events the reader's filter rejects are skipped without being copied.
+ * A reader that was lapped gets one OVERRUN event carrying the lost count
+ * Returns: number of events stored in @out
+ */
+static int button_fetch_events(struct button_reader *reader, struct button_event *out, int max)
+{
+    const struct button_event *ev;
+    unsigned long flags;
+    u64 lost;
+    int n = 0;
+
+    spin_lock_irqsave(&event_lock, flags);
+    if (event_seq >= EVENT_RING_SIZE && reader->next_seq <= event_seq - EVENT_RING_SIZE) {
+        lost = event_seq - EVENT_RING_SIZE + 1 - reader->next_seq;
+        memset(&out[n], 0, sizeof(out[n]));
+        out[n].seq = reader->next_seq;
+        out[n].timestamp = ktime_get_ns();
+        out[n].type = BUTTON_EV_OVERRUN;
+        out[n].value = lost;
+        reader->next_seq += lost;
+        n++;
+    }
+    while (n < max && reader->next_seq <= event_seq) {
+        ev = &event_ring[reader->next_seq & EVENT_RING_MASK];
+        if (button_filter_pass(reader, ev)) {
+            out[n++] = *ev;
+            reader->last_delivered = ev->timestamp;
+            if (unlikely(ev->seq == wake.seq))
+                button_wake_delivered(reader);
+        }
+        reader->next_seq++;
+    }
+    spin_unlock_irqrestore(&event_lock, flags);
+
+    return n;
+}
+
+/* File operation implementations */
+
+/*
+ * Called when device file is opened
+ * Files start in text status mode; event mode only sees new events
+ */
+static int button_open(struct inode *inode, struct file *file)
+{
+    struct button_reader *reader;
+
+    reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+    if (!reader)
+        return -ENOMEM;
+
+    mutex_init(&reader->lock);
+    file->private_data = reader;
+    /* read_iter honours IOCB_NOWAIT, io_uring can poll instead of blocking a worker */
+    file->f_mode |= FMODE_NOWAIT;
+
+    pr_info("Button device opened\n");
+    return 0;
+}
+
+/*
+ * Called when device file is closed
+ */
+static int button_release(struct inode *inode, struct file *file)
+{
+    kfree(file->private_data);
+    pr_info("Button device closed\n");
+    return 0;
+}
+
+/*
+ * Event mode read - returns whole struct button_event records
+ * Blocks until at least one event is queued unless non-blocking or
+ * IOCB_NOWAIT (io_uring), which get -EAGAIN and poll instead
+ */
+static ssize_t button_read_events(struct kiocb *iocb, struct iov_iter *to)
+{
+    struct file *file = iocb->ki_filp;
+    struct button_reader *reader = file->private_data;
+    struct button_event batch[READ_BATCH];
+    bool nowait = iocb->ki_flags & IOCB_NOWAIT;
+    size_t len = iov_iter_count(to), copied = 0, bytes;
+    int n, ret;
+
+    if (len < sizeof(batch[0]))
+        return -EINVAL;
+
+    if (nowait) {
+        if (!mutex_trylock(&reader->lock))
+            return -EAGAIN;
+    } else {
+        mutex_lock(&reader->lock);
+    }
+    for (;;) {
+        while (copied + sizeof(batch[0]) <= len) {
+            n = button_fetch_events(reader, batch,
+                                    min_t(size_t, READ_BATCH, (len - copied) / sizeof(batch[0])));
+            if (!n)
+                break;
+            bytes = n * sizeof(batch[0]);
+            if (copy_to_iter(batch, bytes, to) != bytes) {
+                mutex_unlock(&reader->lock);
+                return copied ? copied : -EFAULT;
+            }
+            copied += bytes;
+        }
+        if (copied || nowait || (file->f_flags & O_NONBLOCK))
+            break;
+
+        mutex_unlock(&reader->lock);
+        ret = wait_event_interruptible(event_wait, button_event_ready(reader));
+        if (ret)
+            return ret;
+        mutex_lock(&reader->lock);
+    }
+    mutex_unlock(&reader->lock);
+
+    return copied ? copied : -EAGAIN;
+}
+
+/*
+ * Read implementation - returns button and LED status
+ * Returns:
+ * - Button pressed/released state
+ * - Press count
+ * - Current LED state
+ */
+static ssize_t button_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    struct button_reader *reader = iocb->ki_filp->private_data;
+    char status_msg[200];
+    int msg_len;
+    const char *led_status;
+    
+    if (reader->event_mode)
+        return button_read_events(iocb, to);
+
+    if (iocb->ki_pos != 0)
+        return 0;
+    
+    switch (current_led_state) {
+        case 0: led_status = "All LEDs OFF"; break;
+        case 1: led_status = "LED 0 (Green) ON"; break;
+        case 2: led_status = "LED 1 (White) ON"; break;
+        case 3: led_status = "LED 2 (Yellow) ON"; break;
+        case 4: led_status = "All LEDs ON"; break;
+        case 5: led_status = "Several LEDs ON"; break;
+        default: led_status = "Unknown state"; break;
+    }
+    
+    msg_len = snprintf(status_msg, sizeof(status_msg), "Button Status: %s\nPress Count: %d\nCurrent State: %s\n", button_pressed ? "Pressed" : "Released", press_count, led_status);
+    
+    if (iov_iter_count(to) < msg_len)
+        return -EINVAL;
+    
+    if (copy_to_iter(status_msg, msg_len, to) != msg_len)
+        return -EFAULT;
+    
+    iocb->ki_pos += msg_len;
+    button_pressed = false; /* Reset after read */
+    return msg_len;
+}
+
+/*
+ * Write implementation - accepts commands:
+ * 'r' - Reset all states
+ * 's' - Print status to kernel log
+ */
+static ssize_t button_write(struct file *file, const char __user *buffer, size_t len, loff_t *off)
+{
+    char cmd;
+    
+    if (len < 1 || copy_from_user(&cmd, buffer, 1))
+        return -EFAULT;
+    
+    switch (cmd) {
+        case 'r': /* Reset */
+            press_count = 0;
+            turn_off_all_leds();
+            pr_info("Button driver reset\n");
+            break;
+        case 's': /* Status */
+            pr_info("Current LED state: %d, Press count: %d\n", current_led_state, press_count);
+            break;
+        default:
+            return -EINVAL;
+    }
+    
+    return len;
+}
+
+/*
+ * Poll implementation - readable when an event mode file has unread events
+ */
+static __poll_t button_poll(struct file *file, poll_table *wait)
+{
+    struct button_reader *reader = file->private_data;
+
+    if (!reader->event_mode)
+        return EPOLLIN | EPOLLRDNORM;
+
+    poll_wait(file, &event_wait, wait);
+    if (button_event_ready(reader))
+        return EPOLLIN | EPOLLRDNORM;
+    return 0;
+}
+
+/*
+ * Copy the debounce state of every key to user space. The fields are
+ * updated by the IRQ handlers and read without stopping them, so one
+ * key's numbers may straddle an edge
+ */
+static long button_debounce_info(struct button_debounce_info __user *uinfo)
+{
+    struct button_debounce_info *info;
+    unsigned int i;
+    long ret = 0;
+
+    info = kzalloc(sizeof(*info), GFP_KERNEL);
+    if (!info)
+        return -ENOMEM;
+
+    info->min_ns = debounce_min_ns;
+    info->max_ns = debounce_max_ns;
+    info->num_keys = num_keys;
+    for (i = 0; i < num_keys; i++) {
+        info->key[i].window_ns = READ_ONCE(keys[i].db.window_ns);
+        info->key[i].bounce_avg_ns = READ_ONCE(keys[i].db.avg);
+        info->key[i].bounce_dev_ns = READ_ONCE(keys[i].db.dev);
+        info->key[i].accepted = READ_ONCE(keys[i].accepted);
+        info->key[i].bounces = READ_ONCE(keys[i].db.bounces);
+        info->key[i].late = READ_ONCE(keys[i].db.late);
+    }
+
+    if (copy_to_user(uinfo, info, sizeof(*info)))
+        ret = -EFAULT;
+    kfree(info);
+    return ret;
+}
+
+/*
+ * IOCTL implementation
+ * - BUTTON_IOC_GET_STATUS: 1 if key 0 is pressed, 0 if released
+ * - BUTTON_IOC_EVENT_MODE: Switch this file between text and event reads
+ * - BUTTON_IOC_SET_CHORD_WINDOW: Set chord window in milliseconds
+ * - BUTTON_IOC_SET_RULES / GET_RULES: Replace or read the LED rule table
+ * - BUTTON_IOC_SET_FILTER: Set the event filter of this file
+ * - BUTTON_IOC_GET_DEBOUNCE: Read the adaptive debounce state of every key
+ * - BUTTON_IOC_GET_WAKE: Read the wake latency of the last resumes
+ */
+static long button_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct button_reader *reader = file->private_data;
+    struct gpio_event_filter filter;
+    struct button_wake_info wake_info;
+    unsigned long flags;
+    int value;
+
+    switch (cmd) {
+        case BUTTON_IOC_GET_STATUS:
+            /* Pull-up input, pressed pulls the line low */
+            value = gpiod_get_value(keys[0].gpio) == 0 ? 1 : 0;
+            if (copy_to_user((int __user *)arg, &value, sizeof(value)))
+                return -EFAULT;
+            break;
+
+        case BUTTON_IOC_EVENT_MODE:
+            if (copy_from_user(&value, (int __user *)arg, sizeof(value)))
+                return -EFAULT;
+            mutex_lock(&reader->lock);
+            reader->event_mode = value != 0;
+            spin_lock_irqsave(&event_lock, flags);
+            reader->next_seq = event_seq + 1;
+            spin_unlock_irqrestore(&event_lock, flags);
+            mutex_unlock(&reader->lock);
+            break;
+
+        case BUTTON_IOC_SET_CHORD_WINDOW:
+            if (copy_from_user(&value, (int __user *)arg, sizeof(value)))
+                return -EFAULT;
+            if (value < 1 || value > MULTI_PRESS_TIMEOUT_MS)
+                return -EINVAL;
+            WRITE_ONCE(chord_window_ms, value);
+            pr_info("Chord window set to %d ms\n", value);
+            break;
+
+        case BUTTON_IOC_GET_DEBOUNCE:
+            return button_debounce_info((struct button_debounce_info __user *)arg);
+
+        case BUTTON_IOC_GET_WAKE:
+            button_wake_snapshot(&wake_info);
+            if (copy_to_user((void __user *)arg, &wake_info, sizeof(wake_info)))
+                return -EFAULT;
+            break;
+
+        case BUTTON_IOC_SET_RULES:
+            return button_rules_upload((struct button_rule_table __user *)arg);
+
+        case BUTTON_IOC_GET_RULES:
+            return button_rules_download((struct button_rule_table __user *)arg);
+
+        case BUTTON_IOC_SET_FILTER:
+            if (copy_from_user(&filter, (void __user *)arg, sizeof(filter)))
+                return -EFAULT;
+            spin_lock_irqsave(&event_lock, flags);
+            reader->filter_types = filter.types;
+            reader->filter_keys = filter.mask;
+            reader->min_interval_ns = (u64)filter.min_interval_ms * NSEC_PER_MSEC;
+            reader->last_delivered = 0;
+            spin_unlock_irqrestore(&event_lock, flags);
+            break;
+
+        default:
+            return -ENOTTY;
+    }
+    return 0;
+}
+
+/*
+ * Take every waiter matching @ev off uring_waiters and onto @done
+ * Called with event_lock held, from any context
+ */
+static void button_uring_match(const struct button_event *ev, struct list_head *done)
+{
+    struct button_uring_waiter *w, *tmp;
+
+    list_for_each_entry_safe(w, tmp, &uring_waiters, node) {
+        if ((w->type && w->type != ev->type) ||
+            (w->key != BUTTON_URING_ANY_KEY && w->key != ev->key))
+            continue;
+        w->event = *ev;
+        w->status = ev->type;
+        list_move_tail(&w->node, done);
+        if (unlikely(ev->seq == wake.seq))
+            button_wake_delivered(NULL);
+    }
+}
+
+/*
+ * Task work: runs in the submitting task, so the event can be copied to
+ * its memory. Frees the waiter and posts the CQE
+ */
+static void button_uring_task_done(struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+    struct button_uring_waiter *w = *(struct button_uring_waiter **)ioucmd->pdu;
+    int ret = w->status;
+
+    timer_delete_sync(&w->timeout);
+    if (ret > 0 && w->uevent && copy_to_user(w->uevent, &w->event, sizeof(w->event)))
+        ret = -EFAULT;
+    kfree(w);
+    io_uring_cmd_done(ioucmd, ret, 0, issue_flags);
+}
+
+/*
+ * Complete waiters taken off uring_waiters
+ * Callable from any context, the CQE is posted from task work
+ */
+static void button_uring_complete_list(struct list_head *done)
+{
+    struct button_uring_waiter *w, *tmp;
+
+    list_for_each_entry_safe(w, tmp, done, node) {
+        list_del_init(&w->node);
+        io_uring_cmd_complete_in_task(w->ioucmd, button_uring_task_done);
+    }
+}
+
+/*
+ * Wait timeout, completes the waiter with -ETIME unless an event got it first
+ */
+static void button_uring_timeout(struct timer_list *t)
+{
+    struct button_uring_waiter *w = from_timer(w, t, timeout);
+    unsigned long flags;
+    LIST_HEAD(done);
+
+    spin_lock_irqsave(&event_lock, flags);
+    if (!w->status) {
+        w->status = -ETIME;
+        list_move_tail(&w->node, &done);
+    }
+    spin_unlock_irqrestore(&event_lock, flags);
+
+    button_uring_complete_list(&done);
+}
+
+/*
+ * Complete pending waits with @status, only those submitted through
+ * @file when it is not NULL
+ * Returns: number of waits completed
+ */
+static int button_uring_cancel(struct file *file, int status)
+{
+    struct button_uring_waiter *w, *tmp;
+    unsigned long flags;
+    LIST_HEAD(done);
+    int n = 0;
+
+    spin_lock_irqsave(&event_lock, flags);
+    list_for_each_entry_safe(w, tmp, &uring_waiters, node) {
+        if (file && w->ioucmd->file != file)
+            continue;
+        w->status = status;
+        list_move_tail(&w->node, &done);
+        n++;
+    }
+    spin_unlock_irqrestore(&event_lock, flags);
+
+    button_uring_complete_list(&done);
+    return n;
+}
+
+/*
+ * Ring teardown or task exit cancelling a parked WAIT (IO_URING_F_CANCEL)
+ * A waiter already taken off the list by an event, the timeout or
+ * BUTTON_URING_CMD_CANCEL is left to its pending task work
+ */
+static void button_uring_cancel_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+    struct button_uring_waiter *w = *(struct button_uring_waiter **)ioucmd->pdu;
+    unsigned long flags;
+    bool pending;
+
+    spin_lock_irqsave(&event_lock, flags);
+    pending = !w->status;
+    if (pending) {
+        w->status = -ECANCELED;
+        list_del_init(&w->node);
+    }
+    spin_unlock_irqrestore(&event_lock, flags);
+    if (!pending)
+        return;
+
+    timer_delete_sync(&w->timeout);
+    kfree(w);
+    io_uring_cmd_done(ioucmd, -ECANCELED, 0, issue_flags);
+}
+
+/*
+ * io_uring command handler, see BUTTON_URING_CMD_* in gpio_control.h
+ * WAIT parks the command until a matching event; nothing polls and the
+ * IRQ path only walks the waiter list when it is non-empty. Parked waits
+ * are cancelable, so tearing down the ring does not wait on a press
+ */
+static int button_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+    const struct button_uring_wait *cmd = io_uring_sqe_cmd(ioucmd->sqe);
+    struct button_uring_waiter *w;
+    unsigned long flags;
+    u32 timeout_ms;
+
+    BUILD_BUG_ON(sizeof(w) > sizeof(ioucmd->pdu));
+
+    if (issue_flags & IO_URING_F_CANCEL) {
+        button_uring_cancel_cmd(ioucmd, issue_flags);
+        return 0;
+    }
+
+    switch (ioucmd->cmd_op) {
+        case BUTTON_URING_CMD_WAIT:
+            break;
+        case BUTTON_URING_CMD_CANCEL:
+            return button_uring_cancel(ioucmd->file, -ECANCELED);
+        default:
+            return -ENOTTY;
+    }
+
+    w = kzalloc(sizeof(*w), GFP_KERNEL);
+    if (!w)
+        return -ENOMEM;
+
+    w->ioucmd = ioucmd;
+    w->uevent = u64_to_user_ptr(READ_ONCE(cmd->event));
+    w->type = READ_ONCE(cmd->type);
+    w->key = READ_ONCE(cmd->key);
+    timeout_ms = READ_ONCE(cmd->timeout_ms);
+    timer_setup(&w->timeout, button_uring_timeout, 0);
+    *(struct button_uring_waiter **)ioucmd->pdu = w;
+    io_uring_cmd_mark_cancelable(ioucmd, issue_flags);
 
-/* Function prototypes for file operations */
-static int button_open(struct inode *, struct file *);
-static int button_release(struct inode *, struct file *);
-static ssize_t button_read(struct file *, char __user *, size_t, loff_t *);
-static ssize_t button_write(struct file *, const char __user *, size_t, loff_t *);
+    spin_lock_irqsave(&event_lock, flags);
+    list_add_tail(&w->node, &uring_waiters);
+    if (timeout_ms)
+        mod_timer(&w->timeout, jiffies + msecs_to_jiffies(timeout_ms));
+    spin_unlock_irqrestore(&event_lock, flags);
 
-/* File operations structure */
-static struct file_operations fops = {
-    .owner = THIS_MODULE,
-    .open = button_open,
-    .release = button_release,
-    .read = button_read,
-    .write = button_write
-};
+    return -EIOCBQUEUED;
+}
 
-/* 
- * Turn off all connected LEDs
- * Called during initialization and state changes
+/*
+ * Apply the IRQ thread policy to every thread seen so far
+ * Called with irq_config_lock held
  */
-static void turn_off_all_leds(void)
+static void button_irq_sched_apply(void)
 {
-    int i;
-    for (i = 0; i < 3; i++) {
-        if (led_gpios[i]) {
-            gpiod_set_value(led_gpios[i], 0);
-        }
+    struct sched_attr attr = {
+        .size = sizeof(attr),
+        .sched_policy = button_irq_policy,
+        .sched_priority = button_irq_policy == SCHED_NORMAL ? 0 : button_irq_prio,
+    };
+    struct task_struct *thread;
+    unsigned int i;
+    int ret;
+
+    lockdep_assert_held(&irq_config_lock);
+    if (button_irq_policy < 0)
+        return;
+
+    for (i = 0; i < num_keys; i++) {
+        thread = READ_ONCE(keys[i].thread);
+        if (!thread)
+            continue;
+        ret = sched_setattr_nocheck(thread, &attr);
+        if (ret)
+            pr_warn("Failed to set IRQ %d thread to %s %u: %d\n", keys[i].irq,
+                    irq_policy_names[button_irq_policy], attr.sched_priority, ret);
     }
-    pr_info("All LEDs turned OFF\n");
+}
+
+static void button_irq_sched_work(struct work_struct *work)
+{
+    mutex_lock(&irq_config_lock);
+    button_irq_sched_apply();
+    mutex_unlock(&irq_config_lock);
 }
 
 /*
- * Turn on all connected LEDs
- * Called when button is pressed 4 times
+ * Set the affinity hint, and with it the affinity, of every key's IRQ
+ * An empty mask drops the hint and leaves the affinity where it is
+ * Called with irq_config_lock held
+ * Returns: 0 or the first error from the IRQ core
  */
-static void turn_on_all_leds(void)
+static int button_irq_affinity_apply(void)
 {
-    int i;
-    for (i = 0; i < 3; i++) {
-        if (led_gpios[i]) {
-            gpiod_set_value(led_gpios[i], 1);
-        }
+    const struct cpumask *mask = cpumask_empty(&button_irq_affinity) ? NULL : &button_irq_affinity;
+    unsigned int i;
+    int ret;
+
+    lockdep_assert_held(&irq_config_lock);
+    for (i = 0; i < num_keys; i++) {
+        ret = irq_set_affinity_and_hint(keys[i].irq, mask);
+        if (ret)
+            return ret;
     }
-    pr_info("All LEDs turned ON\n");
+    return 0;
 }
 
 /*
- * Control specific LED
- * @led_index: Index of LED to control (0-2)
- * Turns off all LEDs then turns on specified LED
+ * IRQ placement defaults from the device tree:
+ *   irq-affinity = <cpu ...>;        CPUs for the button IRQs
+ *   irq-thread-policy = "fifo";      "other", "fifo" or "rr"
+ *   irq-thread-priority = <prio>;    1-99, default 50 like the IRQ core
+ * Bad values are ignored with a warning
  */
-static void control_led(int led_index)
+static void button_irq_config_dt(struct device *dev)
 {
-    if (led_index >= 0 && led_index < 3 && led_gpios[led_index]) {
-        /* Turn off all LEDs first */
-        turn_off_all_leds();
-        /* Turn on specific LED */
-        gpiod_set_value(led_gpios[led_index], 1);
-        pr_info("LED %d turned ON, others OFF\n", led_index);
+    struct device_node *np = dev->of_node;
+    const char *policy;
+    u32 cpu, prio;
+    int i, n, ret;
+
+    cpumask_clear(&button_irq_affinity);
+    n = of_property_count_u32_elems(np, "irq-affinity");
+    for (i = 0; i < n; i++) {
+        if (of_property_read_u32_index(np, "irq-affinity", i, &cpu) ||
+            cpu >= nr_cpu_ids || !cpu_possible(cpu)) {
+            dev_warn(dev, "Ignoring bad irq-affinity entry %d\n", i);
+            continue;
+        }
+        cpumask_set_cpu(cpu, &button_irq_affinity);
+    }
+
+    button_irq_policy = -1;
+    button_irq_prio = MAX_RT_PRIO / 2;
+    if (!of_property_read_string(np, "irq-thread-policy", &policy)) {
+        ret = match_string(irq_policy_names, ARRAY_SIZE(irq_policy_names), policy);
+        if (ret < 0)
+            dev_warn(dev, "Unknown irq-thread-policy \"%s\"\n", policy);
+        else
+            button_irq_policy = ret;
+    }
+    if (!of_property_read_u32(np, "irq-thread-priority", &prio)) {
+        if (prio < 1 || prio >= MAX_RT_PRIO)
+            dev_warn(dev, "Bad irq-thread-priority %u\n", prio);
+        else
+            button_irq_prio = prio;
     }
 }
 
 /*
- * Work queue handler for processing button presses
- * Called after button press timeout or 5 presses
- * Controls LEDs based on number of presses:
- * 1 press = Green LED
- * 2 presses = White LED  
- * 3 presses = Yellow LED
- * 4 presses = All LEDs on
- * 5+ presses = All LEDs off
+ * Devres action registered after the IRQs are requested, so it runs before
+ * they are freed. The hints point at button_irq_affinity and __free_irq()
+ * warns about any hint still set
  */
-static void button_work_handler(struct work_struct *work)
+static void button_irq_unhint(void *data)
 {
-    pr_info("Processing %d button presses\n", press_count);
-    
-    switch (press_count) {
-        case 1:
-            current_led_state = 1;
-            control_led(0); /* LED 0 (green) */
-            break;
-        case 2:
-            current_led_state = 2;
-            control_led(1); /* LED 1 (white) */
-            break;
-        case 3:
-            current_led_state = 3;
-            control_led(2); /* LED 2 (yellow) */
-            break;
-        case 4:
-            current_led_state = 4;
-            turn_on_all_leds(); /* All LEDs on */
-            break;
-        case 5:
-        default:
-            current_led_state = 0;
-            turn_off_all_leds(); /* All LEDs off */
-            break;
+    unsigned int i;
+
+    for (i = 0; i < num_keys; i++) {
+        if (keys[i].irq > 0)
+            irq_update_affinity_hint(keys[i].irq, NULL);
     }
-    
-    /* Reset press count after processing */
-    press_count = 0;
 }
 
 /*
- * Timer callback for multi-press timeout
- * Called after MULTI_PRESS_TIMEOUT_MS if no more presses
+ * Devres action registered before the IRQs are requested, so it runs after
+ * they were freed: no handler can record a thread or queue work any more
  */
-static void press_timer_callback(struct timer_list *timer)
+static void button_irq_release(void *data)
 {
-    if (press_count > 0) {
-        /* Schedule work to process the button presses */
-        schedule_work(&button_work);
+    unsigned int i;
+
+    cancel_work_sync(&irq_sched_work);
+    for (i = 0; i < BUTTON_MAX_KEYS; i++) {
+        if (keys[i].thread) {
+            put_task_struct(keys[i].thread);
+            keys[i].thread = NULL;
+        }
     }
 }
 
 /*
- * IRQ handler for button press
- * Implements debouncing and tracks press count
- * Schedules work immediately on 5 presses
+ * Get all button-gpios entries and request one IRQ per key
  */
-static irqreturn_t button_irq_handler(int irq, void *dev_id)
+static int button_setup_keys(struct device *dev)
 {
-    unsigned long current_time = jiffies;
-    static unsigned long last_irq_time = 0;
-    
-    /* Simple debouncing */
-    if (time_before(current_time, last_irq_time + msecs_to_jiffies(DEBOUNCE_TIME_MS))) {
-        return IRQ_HANDLED;
+    struct gpio_descs *descs;
+    unsigned int i;
+    int ret;
+
+    descs = devm_gpiod_get_array(dev, "button", GPIOD_IN);
+    if (IS_ERR(descs)) {
+        dev_err(dev, "Failed to get button GPIOs\n");
+        return PTR_ERR(descs);
     }
-    last_irq_time = current_time;
-    
-    button_pressed = true;
-    press_count++;
-    
-    pr_info("Button pressed! Count: %d\n", press_count);
-    
-    /* Reset or start the timer for multi-press detection */
-    mod_timer(&press_timer, jiffies + msecs_to_jiffies(MULTI_PRESS_TIMEOUT_MS));
-    
-    /* If we reach 5 presses, process immediately */
-    if (press_count >= 5) {
-        del_timer(&press_timer);
-        schedule_work(&button_work);
+
+    if (descs->ndescs > BUTTON_MAX_KEYS) {
+        dev_err(dev, "Too many button GPIOs (%u, max %d)\n", descs->ndescs, BUTTON_MAX_KEYS);
+        return -EINVAL;
     }
-    
-    return IRQ_HANDLED;
-}
+    num_keys = descs->ndescs;
 
-/* File operation implementations */
+    for (i = 0; i < num_keys; i++) {
+        keys[i].gpio = descs->desc[i];
+        keys[i].index = i;
+        button_debounce_reset(&keys[i]);
+
+        /* The handler reads the level to tell presses from releases */
+        if (gpiod_cansleep(keys[i].gpio)) {
+            dev_err(dev, "Button GPIO %u sleeps, cannot sample in IRQ\n", i);
+            return -EINVAL;
+        }
+
+        keys[i].irq = gpiod_to_irq(keys[i].gpio);
+        if (keys[i].irq < 0) {
+            dev_err(dev, "Failed to get IRQ for button GPIO %u\n", i);
+            return keys[i].irq;
+        }
+
+        ret = devm_request_irq(dev, keys[i].irq, button_irq_handler,
+                               IRQF_TRIGGER_FALLING | IRQF_TRIGGER_RISING,
+                               "button_irq", &keys[i]);
+        if (ret) {
+            dev_err(dev, "Failed to request IRQ for button %u\n", i);
+            return ret;
+        }
+    }
 
-/*
- * Called when device file is opened
- */
-static int button_open(struct inode *inode, struct file *file)
-{
-    pr_info("Button device opened\n");
     return 0;
 }
 
 /*
- * Called when device file is closed
+ * /proc/gpio_ctl_status: one line for the device with the event queue
+ * (events, last_event_ns, last_event_type) and the multi-press and LED
+ * state, then one line per key with its debounce counters
  */
-static int button_release(struct inode *inode, struct file *file)
+static void button_status_show(struct seq_file *m)
 {
-    pr_info("Button device closed\n");
-    return 0;
+    struct button_wake_info wi;
+    u64 events, last_ns = 0;
+    u16 last_type = 0;
+    unsigned int seq, i;
+
+    do {
+        seq = read_seqcount_begin(&event_seqcount);
+        events = event_seq;
+        if (events) {
+            last_ns = event_ring[events & EVENT_RING_MASK].timestamp;
+            last_type = event_ring[events & EVENT_RING_MASK].type;
+        }
+    } while (read_seqcount_retry(&event_seqcount, seq));
+
+    seq_printf(m, "driver=button_driver dev=%s keys=%u pressed=%d press_count=%d leds=%lu "
+               "events=%llu last_event_ns=%llu last_event_type=%u\n",
+               DEVICE_NAME, num_keys, READ_ONCE(button_pressed), READ_ONCE(press_count),
+               READ_ONCE(led_mask), events, last_ns, last_type);
+
+    /* u32 counters, each read in one access */
+    for (i = 0; i < num_keys; i++)
+        seq_printf(m, "driver=button_driver dev=%s key=%u accepted=%u bounces=%u late=%u window_ns=%u\n",
+                   DEVICE_NAME, i, READ_ONCE(keys[i].accepted), READ_ONCE(keys[i].db.bounces),
+                   READ_ONCE(keys[i].db.late), READ_ONCE(keys[i].db.window_ns));
+
+    button_wake_snapshot(&wi);
+    seq_printf(m, "driver=button_driver dev=%s resumes=%u key_wakes=%u delivered=%u "
+               "asleep_ns=%llu resume_irq_ns=%llu resume_event_ns=%llu resume_rules_ns=%llu "
+               "resume_read_ns=%llu resume_read_max_ns=%llu\n",
+               DEVICE_NAME, wi.resumes, wi.key_wakes, wi.delivered, wi.asleep_ns, wi.resume_irq_ns,
+               wi.resume_event_ns, wi.resume_rules_ns, wi.resume_read_ns, wi.resume_read_max_ns);
 }
 
+static struct gpio_status_source button_status_source = {
+    .show = button_status_show,
+};
+
 /*
- * Read implementation - returns button and LED status
- * Returns:
- * - Button pressed/released state
- * - Press count
- * - Current LED state
+ * Probe-to-ready timing. The first attempt is remembered across
+ * deferrals so the log shows how long the LED dependency held us up
+ */
+static ktime_t probe_first_attempt;
+static unsigned int probe_deferrals;
+
+/*
+ * Devres action: drop the wakeup source, on probe failure and unbind
  */
-static ssize_t button_read(struct file *file, char __user *buffer, size_t len, loff_t *offset)
+static void button_wakeup_release(void *data)
 {
-    char status_msg[200];
-    int msg_len;
-    const char *led_status;
-    
-    if (*offset != 0)
-        return 0;
-    
-    switch (current_led_state) {
-        case 0: led_status = "All LEDs OFF"; break;
-        case 1: led_status = "LED 0 (Green) ON"; break;
-        case 2: led_status = "LED 1 (White) ON"; break;
-        case 3: led_status = "LED 2 (Yellow) ON"; break;
-        case 4: led_status = "All LEDs ON"; break;
-        default: led_status = "Unknown state"; break;
-    }
-    
-    msg_len = snprintf(status_msg, sizeof(status_msg), "Button Status: %s\nPress Count: %d\nCurrent State: %s\n", button_pressed ? "Pressed" : "Released", press_count, led_status);
-    
-    if (len < msg_len)
-        return -EINVAL;
-    
-    if (copy_to_user(buffer, status_msg, msg_len))
-        return -EFAULT;
-    
-    *offset += msg_len;
-    button_pressed = false; /* Reset after read */
-    return msg_len;
+    device_init_wakeup(data, false);
 }
 
 /*
- * Write implementation - accepts commands:
- * 'r' - Reset all states
- * 's' - Print status to kernel log
+ * Bind to the LEDs of led_driver. An optional "leds" phandle selects the
+ * LED node; without it the bound led_driver instance is used
  */
-static ssize_t button_write(struct file *file, const char __user *buffer, size_t len, loff_t *off)
+static int button_get_leds(struct device *dev)
 {
-    char cmd;
-    
-    if (len < 1 || copy_from_user(&cmd, buffer, 1))
-        return -EFAULT;
-    
-    switch (cmd) {
-        case 'r': /* Reset */
-            press_count = 0;
-            current_led_state = 0;
-            turn_off_all_leds();
-            pr_info("Button driver reset\n");
-            break;
-        case 's': /* Status */
-            pr_info("Current LED state: %d, Press count: %d\n", current_led_state, press_count);
-            break;
-        default:
-            return -EINVAL;
-    }
-    
-    return len;
-}
+    struct device_node *np;
+    int ret;
 
+    np = of_parse_phandle(dev->of_node, "leds", 0);
+    ret = led_provider_get(dev, np);
+    of_node_put(np);
 
+    if (ret == -EPROBE_DEFER)
+        probe_deferrals++;
+    return ret;
+}
 
 static int button_probe(struct platform_device *pdev)
 {
-    int ret, i;
+    int ret;
+    u32 min_ms, max_ms;
     struct device *dev = &pdev->dev;
+    ktime_t start = ktime_get();
     
     pr_info("Button driver probe started\n");
+    if (!probe_first_attempt)
+        probe_first_attempt = start;
     
-    /* Get button GPIO */
-    button_gpio = devm_gpiod_get(dev, "button", GPIOD_IN);
-    if (IS_ERR(button_gpio)) {
-        dev_err(dev, "Failed to get button GPIO\n");
-        return PTR_ERR(button_gpio);
-    }
-    
-    /* Get LED GPIOs from led_driver */
-    for (i = 0; i < 3; i++) {
-        led_gpios[i] = led_get_gpio(i);
-        if (!led_gpios[i]) {
-            dev_err(dev, "Failed to get LED GPIO %d from led_driver\n", i);
-            return -ENODEV;
-        }
-        pr_info("Got LED GPIO %d from led_driver\n", i);
-    }
+    if (of_property_read_u32(dev->of_node, "chord-window-ms", &chord_window_ms) ||
+        chord_window_ms == 0 || chord_window_ms > MULTI_PRESS_TIMEOUT_MS)
+        chord_window_ms = DEFAULT_CHORD_WINDOW_MS;
     
-    /* Setup IRQ */
-    button_irq = gpiod_to_irq(button_gpio);
-    if (button_irq < 0) {
-        dev_err(dev, "Failed to get IRQ for button GPIO\n");
-        return button_irq;
+    /* Debounce window bounds, the window adapts between them per key */
+    if (of_property_read_u32(dev->of_node, "debounce-min-ms", &min_ms))
+        min_ms = DEBOUNCE_MIN_MS;
+    if (of_property_read_u32(dev->of_node, "debounce-max-ms", &max_ms))
+        max_ms = DEBOUNCE_MAX_MS;
+    if (min_ms == 0 || min_ms > max_ms || max_ms > DEBOUNCE_LIMIT_MS) {
+        dev_warn(dev, "Bad debounce bounds %u-%u ms, using defaults\n", min_ms, max_ms);
+        min_ms = DEBOUNCE_MIN_MS;
+        max_ms = DEBOUNCE_MAX_MS;
     }
+    debounce_min_ns = min_ms * NSEC_PER_MSEC;
+    debounce_max_ns = max_ms * NSEC_PER_MSEC;
     
-    ret = devm_request_irq(dev, button_irq, button_irq_handler,
-                          IRQF_TRIGGER_FALLING,
-                          "button_irq", NULL);
-    if (ret) {
-        dev_err(dev, "Failed to request IRQ\n");
-        return ret;
-    }
+    /* Bind to the LEDs of led_driver, deferring until it is ready */
+    ret = button_get_leds(dev);
+    if (ret)
+        return dev_err_probe(dev, ret, "Failed to bind to led_driver\n");
     
-    /* Initialize timer and work queue */
+    /* Initialize timers and work queue before any IRQ can fire */
     timer_setup(&press_timer, press_timer_callback, 0);
+    timer_setup(&chord_timer, chord_timer_callback, 0);
     INIT_WORK(&button_work, button_work_handler);
+    INIT_WORK(&rule_work, button_rule_work_handler);
+    INIT_DELAYED_WORK(&led_pattern.work, button_pattern_work);
+    rule_reader.next_seq = event_seq + 1;
+
+    /* IRQ placement, applied once the IRQs exist */
+    button_irq_config_dt(dev);
+    INIT_WORK(&irq_sched_work, button_irq_sched_work);
+    ret = devm_add_action_or_reset(dev, button_irq_release, NULL);
+    if (ret)
+        return ret;
+
+    /* Get button GPIOs and setup one IRQ per key */
+    ret = button_setup_keys(dev);
+    if (ret)
+        return ret;
+    ret = devm_add_action_or_reset(dev, button_irq_unhint, NULL);
+    if (ret)
+        return ret;
+    
+    mutex_lock(&irq_config_lock);
+    ret = button_irq_affinity_apply();
+    mutex_unlock(&irq_config_lock);
+    if (ret)
+        dev_warn(dev, "Failed to set IRQ affinity to %*pbl: %d\n",
+                 cpumask_pr_args(&button_irq_affinity), ret);
+    
+    /* Keys can always wake the system, on by default with wakeup-source */
+    device_set_wakeup_capable(dev, true);
+    ret = devm_add_action_or_reset(dev, button_wakeup_release, dev);
+    if (ret)
+        return ret;
+    if (of_property_read_bool(dev->of_node, "wakeup-source"))
+        device_wakeup_enable(dev);
     
     /* Create character device */
     ret = alloc_chrdev_region(&dev_number, 0, 1, DEVICE_NAME);
@@ -356,11 +1803,24 @@ static int button_probe(struct platform_device *pdev)
     /* Initialize LED state (all off) */
     turn_off_all_leds();
     
-    pr_info("Button driver probe completed successfully\n");
+    ret = button_rules_set_default();
+    if (ret)
+        goto cleanup_device;
+    
+    gpio_status_attach(&button_status_source);
+    
+    pr_info("Button driver probe completed successfully (%u keys)\n", num_keys);
+    pr_info("Probe took %lld us, ready %lld us after first attempt (%u deferrals)\n",
+            ktime_us_delta(ktime_get(), start),
+            ktime_us_delta(ktime_get(), probe_first_attempt), probe_deferrals);
+    probe_first_attempt = 0;
+    probe_deferrals = 0;
     pr_info("Created device /dev/%s\n", DEVICE_NAME);
     
     return 0;
     
+cleanup_device:
+    device_destroy(dev_class, dev_number);
 cleanup_cdev:
     cdev_del(&button_cdev);
 cleanup_class:
@@ -378,10 +1838,24 @@ static void button_remove(struct platform_device *pdev)
 {
     pr_info("Button driver remove started\n");
     
+    gpio_status_detach(&button_status_source);
+    
+    /* Fail any io_uring waits still parked on the device */
+    button_uring_cancel(NULL, -ENODEV);
+    
     /* Clean up timer and work */
     del_timer_sync(&press_timer);
+    del_timer_sync(&chord_timer);
     cancel_work_sync(&button_work);
     
+    /* Stop rule processing, then free the table */
+    button_rules_publish(NULL);
+    cancel_work_sync(&rule_work);
+    mutex_lock(&led_lock);
+    led_pattern.active = false;
+    mutex_unlock(&led_lock);
+    cancel_delayed_work_sync(&led_pattern.work);
+    
     /* Turn off all LEDs before removing */
     turn_off_all_leds();
     
@@ -394,6 +1868,213 @@ static void button_remove(struct platform_device *pdev)
     pr_info("Button driver removed successfully\n");
 }
 
+/*
+ * System suspend. With wakeup enabled (wakeup-source, or power/wakeup in
+ * sysfs) the key IRQs stay armed and a press resumes the system
+ */
+static int button_suspend(struct device *dev)
+{
+    unsigned long flags;
+    unsigned int i;
+    int ret;
+
+    /*
+     * Resolve open multi-press and chord windows now instead of against
+     * a stale clock after resume, then land the LED changes they cause
+     * before led_driver, our supplier, suspends. A running pattern stops
+     */
+    if (del_timer_sync(&press_timer))
+        press_timer_callback(&press_timer);
+    if (del_timer_sync(&chord_timer))
+        chord_timer_callback(&chord_timer);
+    flush_work(&button_work);
+    flush_work(&rule_work);
+    mutex_lock(&led_lock);
+    led_pattern.active = false;
+    mutex_unlock(&led_lock);
+    cancel_delayed_work_sync(&led_pattern.work);
+
+    wake_armed = 0;
+    if (device_may_wakeup(dev)) {
+        for (i = 0; i < num_keys; i++) {
+            ret = enable_irq_wake(keys[i].irq);
+            if (ret)
+                dev_warn(dev, "Key %u IRQ %d cannot wake the system: %d\n", i, keys[i].irq, ret);
+            else
+                __set_bit(i, &wake_armed);
+        }
+    }
+    spin_lock_irqsave(&event_lock, flags);
+    write_seqcount_begin(&event_seqcount);
+    wake.suspend_ns = ktime_get_boottime_ns();
+    write_seqcount_end(&event_seqcount);
+    spin_unlock_irqrestore(&event_lock, flags);
+    return 0;
+}
+
+/*
+ * First callback after wakeup. Device IRQs are still off, so the key IRQ
+ * that woke the system is replayed after this and lands in the record
+ */
+static int button_resume_noirq(struct device *dev)
+{
+    button_wake_open();
+    return 0;
+}
+
+static int button_resume(struct device *dev)
+{
+    unsigned int i;
+
+    for_each_set_bit(i, &wake_armed, num_keys)
+        disable_irq_wake(keys[i].irq);
+    wake_armed = 0;
+    return 0;
+}
+
+static const struct dev_pm_ops button_pm_ops = {
+    SYSTEM_SLEEP_PM_OPS(button_suspend, button_resume)
+    NOIRQ_SYSTEM_SLEEP_PM_OPS(NULL, button_resume_noirq)
+};
+
+
+/*
+ * sysfs on the platform device, one set per instance:
+ *   irq_affinity         cpulist for the button IRQs, empty = kernel default
+ *   irq_thread_policy    default (leave alone), other, fifo or rr
+ *   irq_thread_priority  1-99 for fifo and rr
+ *   irq_effective        per key: IRQ, effective affinity, thread settings
+ *   irq_counts           handler runs per possible CPU, all keys
+ */
+static ssize_t irq_affinity_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%*pbl\n", cpumask_pr_args(&button_irq_affinity));
+}
+
+static ssize_t irq_affinity_store(struct device *dev, struct device_attribute *attr,
+                                  const char *buf, size_t count)
+{
+    struct cpumask old;
+    int ret;
+
+    mutex_lock(&irq_config_lock);
+    cpumask_copy(&old, &button_irq_affinity);
+    ret = cpulist_parse(buf, &button_irq_affinity);
+    if (!ret && !cpumask_empty(&button_irq_affinity) &&
+        !cpumask_intersects(&button_irq_affinity, cpu_online_mask))
+        ret = -EINVAL;
+    if (!ret)
+        ret = button_irq_affinity_apply();
+    if (ret) {
+        cpumask_copy(&button_irq_affinity, &old);
+        button_irq_affinity_apply();
+    }
+    mutex_unlock(&irq_config_lock);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(irq_affinity);
+
+static ssize_t irq_thread_policy_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    int policy = READ_ONCE(button_irq_policy);
+
+    return sysfs_emit(buf, "%s\n", policy < 0 ? "default" : irq_policy_names[policy]);
+}
+
+/* "default" stops managing the thread, it keeps its current settings */
+static ssize_t irq_thread_policy_store(struct device *dev, struct device_attribute *attr,
+                                       const char *buf, size_t count)
+{
+    int policy = sysfs_match_string(irq_policy_names, buf);
+
+    if (policy < 0 && !sysfs_streq(buf, "default"))
+        return -EINVAL;
+
+    mutex_lock(&irq_config_lock);
+    button_irq_policy = policy < 0 ? -1 : policy;
+    button_irq_sched_apply();
+    mutex_unlock(&irq_config_lock);
+    return count;
+}
+static DEVICE_ATTR_RW(irq_thread_policy);
+
+static ssize_t irq_thread_priority_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", READ_ONCE(button_irq_prio));
+}
+
+static ssize_t irq_thread_priority_store(struct device *dev, struct device_attribute *attr,
+                                         const char *buf, size_t count)
+{
+    unsigned int prio;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &prio);
+    if (ret)
+        return ret;
+    if (prio < 1 || prio >= MAX_RT_PRIO)
+        return -EINVAL;
+
+    mutex_lock(&irq_config_lock);
+    button_irq_prio = prio;
+    button_irq_sched_apply();
+    mutex_unlock(&irq_config_lock);
+    return count;
+}
+static DEVICE_ATTR_RW(irq_thread_priority);
+
+/*
+ * One line per key, what the kernel actually uses:
+ * key=0 irq=45 affinity=3 thread=112 policy=fifo priority=80
+ * thread is 0 (and policy/priority -) until a threaded IRQ has fired
+ */
+static ssize_t irq_effective_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct task_struct *thread;
+    unsigned int i;
+    int len = 0;
+
+    mutex_lock(&irq_config_lock);
+    for (i = 0; i < num_keys; i++) {
+        len += sysfs_emit_at(buf, len, "key=%u irq=%d affinity=%*pbl", i, keys[i].irq,
+                             cpumask_pr_args(irq_get_effective_affinity_mask(keys[i].irq)));
+        thread = READ_ONCE(keys[i].thread);
+        if (thread && thread->policy < ARRAY_SIZE(irq_policy_names) && irq_policy_names[thread->policy])
+            len += sysfs_emit_at(buf, len, " thread=%d policy=%s priority=%u\n",
+                                 task_pid_nr(thread), irq_policy_names[thread->policy],
+                                 thread->rt_priority);
+        else if (thread)
+            len += sysfs_emit_at(buf, len, " thread=%d policy=%u priority=%u\n",
+                                 task_pid_nr(thread), thread->policy, thread->rt_priority);
+        else
+            len += sysfs_emit_at(buf, len, " thread=0 policy=- priority=-\n");
+    }
+    mutex_unlock(&irq_config_lock);
+    return len;
+}
+static DEVICE_ATTR_RO(irq_effective);
+
+/* Space separated, one count per possible CPU in CPU order */
+static ssize_t irq_counts_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    int cpu, len = 0;
+
+    for_each_possible_cpu(cpu)
+        len += sysfs_emit_at(buf, len, "%s%lu", len ? " " : "", per_cpu(button_irq_count, cpu));
+    len += sysfs_emit_at(buf, len, "\n");
+    return len;
+}
+static DEVICE_ATTR_RO(irq_counts);
+
+static struct attribute *button_irq_attrs[] = {
+    &dev_attr_irq_affinity.attr,
+    &dev_attr_irq_thread_policy.attr,
+    &dev_attr_irq_thread_priority.attr,
+    &dev_attr_irq_effective.attr,
+    &dev_attr_irq_counts.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(button_irq);
 
 static const struct of_device_id button_of_match[] = {
     { .compatible = "custom,gpio-button" },
@@ -409,6 +2090,9 @@ static struct platform_driver button_driver = {
     .driver = {
         .name = "button_driver",
         .of_match_table = button_of_match,
+        .dev_groups = button_irq_groups,
+        .pm = pm_sleep_ptr(&button_pm_ops),
+        .probe_type = PROBE_PREFER_ASYNCHRONOUS,
     },
 };
 
@@ -418,3 +2102,12 @@ module_platform_driver(button_driver);
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("AnhPH58");
 MODULE_DESCRIPTION("GPIO Button driver with LED control");
+MODULE_SOFTDEP("pre: gpio_status");
+
+/*
+ * Tests reach the static state machines by being part of this file.
+ * Kconfig selects them in-tree, make KUNIT=1 out of tree
+ */
+#if IS_ENABLED(CONFIG_BUTTON_DRIVER_KUNIT_TEST) || defined(BUTTON_DRIVER_KUNIT)
+#include "button_driver_kunit.c"
+#endif
@@ -0,0 +1,678 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests and microbenchmarks for button_driver.c
+ *
+ * Included at the end of button_driver.c when
+ * CONFIG_BUTTON_DRIVER_KUNIT_TEST is set, or BUTTON_DRIVER_KUNIT is
+ * defined by make KUNIT=1, so the static state machines can be driven
+ * directly. button_now() and button_set_leds() are
+ * replaced by a fake clock and a fake LED backend, so no GPIO hardware
+ * is needed and the suite runs under UML. The rule worker is not
+ * scheduled from the test thread; tests run it by hand:
+ *
+ *   ./tools/testing/kunit/kunit.py run --kunitconfig=drivers/misc/my_custom
+ *
+ * Benchmarks are marked slow and report ns/op through kunit_info(), which
+ * ends up as a "# name: N.N ns/op" line in the KTAP output. Times include
+ * the static stub lookup on the redirected calls
+ */
+#include <kunit/test.h>
+
+#include "gpio_kunit_bench.h"      /* Shared ns/op reporting */
+
+#define BUTTON_BENCH_ITERS 100000
+
+/* Fake backends */
+static u64 fake_ns;
+static unsigned long fake_released;       /* Keys whose line is high, bit N = key N */
+static unsigned long fake_led_mask;
+static unsigned int fake_led_writes;
+
+static u64 fake_button_now(void)
+{
+    return fake_ns;
+}
+
+static void fake_button_set_leds(unsigned long mask)
+{
+    fake_led_mask = mask;
+    fake_led_writes++;
+}
+
+static bool fake_button_key_pressed(struct button_key *key)
+{
+    return !test_bit(key->index, &fake_released);
+}
+
+static void fake_button_rules_kick(void)
+{
+}
+
+/* Tests call the handler from process context, not an IRQ thread */
+static struct task_struct *fake_button_irq_thread(void)
+{
+    return NULL;
+}
+
+static int button_test_init(struct kunit *test)
+{
+    unsigned int i;
+
+    /* The driver keeps single instance state, don't clobber a bound device */
+    if (button_device)
+        kunit_skip(test, "button_driver is bound to a device");
+
+    memset(keys, 0, sizeof(keys));
+    debounce_min_ns = DEBOUNCE_MIN_MS * NSEC_PER_MSEC;
+    debounce_max_ns = DEBOUNCE_MAX_MS * NSEC_PER_MSEC;
+    for (i = 0; i < BUTTON_MAX_KEYS; i++) {
+        keys[i].index = i;
+        button_debounce_reset(&keys[i]);
+    }
+    num_keys = 1;
+    press_count = 0;
+    button_pressed = false;
+    current_led_state = 0;
+    led_mask = 0;
+    led_pattern.active = false;
+    event_seq = 0;
+    rule_reader.next_seq = 1;
+    chord_mask = 0;
+    chord_window_ms = DEFAULT_CHORD_WINDOW_MS;
+    memset(&wake, 0, sizeof(wake));
+    timer_setup(&press_timer, press_timer_callback, 0);
+    timer_setup(&chord_timer, chord_timer_callback, 0);
+    INIT_WORK(&button_work, button_work_handler);
+    INIT_WORK(&rule_work, button_rule_work_handler);
+    INIT_DELAYED_WORK(&led_pattern.work, button_pattern_work);
+
+    fake_ns = 100 * NSEC_PER_SEC;
+    fake_released = 0;
+    fake_led_mask = 0;
+    fake_led_writes = 0;
+    kunit_activate_static_stub(test, button_now, fake_button_now);
+    kunit_activate_static_stub(test, button_set_leds, fake_button_set_leds);
+    kunit_activate_static_stub(test, button_rules_kick, fake_button_rules_kick);
+    kunit_activate_static_stub(test, button_key_pressed, fake_button_key_pressed);
+    kunit_activate_static_stub(test, button_irq_thread, fake_button_irq_thread);
+    return button_rules_set_default();
+}
+
+static void button_test_exit(struct kunit *test)
+{
+    if (button_device)
+        return;
+    del_timer_sync(&press_timer);
+    del_timer_sync(&chord_timer);
+    cancel_work_sync(&button_work);
+    button_rules_publish(NULL);
+    cancel_work_sync(&rule_work);
+    led_pattern.active = false;
+    cancel_delayed_work_sync(&led_pattern.work);
+}
+
+static const struct button_event *last_event(void)
+{
+    return &event_ring[event_seq & EVENT_RING_MASK];
+}
+
+static void press(unsigned int key)
+{
+    button_irq_handler(0, &keys[key]);
+}
+
+/* Rising edge, the line back high */
+static void release(unsigned int key)
+{
+    __set_bit(key, &fake_released);
+    button_irq_handler(0, &keys[key]);
+    __clear_bit(key, &fake_released);
+}
+
+static const struct button_rule_set *active_rules(void)
+{
+    return rcu_dereference_protected(button_rules, true);
+}
+
+static void eval(const struct button_rule_set *set, u16 type, u16 key, u32 value,
+                 unsigned long mask, struct button_rule_result *res)
+{
+    struct button_event ev = { .type = type, .key = key, .value = value };
+
+    button_rules_eval(set, &ev, mask, res);
+}
+
+/* Built-in rules, the old press count mapping */
+
+struct resolve_case {
+    int count;
+    unsigned long mask;     /* Starting from LED 1 on */
+};
+
+static const struct resolve_case resolve_cases[] = {
+    { 0, 0x2 },
+    { 1, 0x1 },
+    { 2, 0x2 },
+    { 3, 0x4 },
+    { 4, 0x7 },
+    { 5, 0x0 },
+    { 9, 0x0 },
+};
+
+static void resolve_case_desc(const struct resolve_case *c, char *desc)
+{
+    snprintf(desc, KUNIT_PARAM_DESC_SIZE, "%d presses", c->count);
+}
+
+KUNIT_ARRAY_PARAM(resolve, resolve_cases, resolve_case_desc);
+
+static void button_test_resolve(struct kunit *test)
+{
+    const struct resolve_case *c = test->param_value;
+    struct button_rule_result res;
+
+    eval(active_rules(), BUTTON_EV_MULTI_PRESS, 0, c->count, 0x2, &res);
+    KUNIT_EXPECT_EQ(test, res.mask, c->mask);
+    KUNIT_EXPECT_EQ(test, res.leds, c->count != 0);
+    KUNIT_EXPECT_PTR_EQ(test, res.pattern, NULL);
+}
+
+static void button_test_work_applies_state(struct kunit *test)
+{
+    press_count = 3;
+    button_work_handler(&button_work);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 0U);
+    button_rule_work_handler(&rule_work);
+
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 1U);
+    KUNIT_EXPECT_EQ(test, fake_led_mask, 0x4UL);
+    KUNIT_EXPECT_EQ(test, current_led_state, 3);
+    KUNIT_EXPECT_EQ(test, press_count, 0);
+    KUNIT_EXPECT_EQ(test, last_event()->type, BUTTON_EV_MULTI_PRESS);
+    KUNIT_EXPECT_EQ(test, last_event()->value, 3U);
+}
+
+/* Debounce, driven by the fake clock */
+
+static void button_test_debounce(struct kunit *test)
+{
+    u64 window = keys[1].db.window_ns;
+
+    KUNIT_EXPECT_EQ(test, window, (u64)debounce_max_ns);
+    press(1);
+    KUNIT_EXPECT_EQ(test, event_seq, 1ULL);
+
+    fake_ns += window - 1;
+    press(1);
+    KUNIT_EXPECT_EQ(test, event_seq, 1ULL);
+
+    /* Every bounce restarts the quiet period */
+    fake_ns += window - 1;
+    press(1);
+    KUNIT_EXPECT_EQ(test, event_seq, 1ULL);
+    KUNIT_EXPECT_EQ(test, keys[1].db.bounces, 2U);
+
+    fake_ns += window;
+    press(1);
+    KUNIT_EXPECT_EQ(test, event_seq, 2ULL);
+    KUNIT_EXPECT_EQ(test, last_event()->type, BUTTON_EV_PRESS);
+    KUNIT_EXPECT_EQ(test, last_event()->key, 1);
+}
+
+static void button_test_debounce_adapt(struct kunit *test)
+{
+    struct button_key *key = &keys[1];
+    int i;
+
+    /* Clean presses walk the window down to the lower bound */
+    for (i = 0; i < 3; i++) {
+        press(1);
+        fake_ns += 200 * NSEC_PER_MSEC;
+    }
+    KUNIT_EXPECT_EQ(test, key->db.window_ns, debounce_min_ns);
+    KUNIT_EXPECT_EQ(test, key->db.avg, 0U);
+
+    /* A 3 ms bounce gets through the 2 ms window once, then is learnt */
+    press(1);
+    fake_ns += NSEC_PER_MSEC;
+    press(1);
+    fake_ns += 3 * NSEC_PER_MSEC;
+    press(1);
+    KUNIT_EXPECT_EQ(test, event_seq, 5ULL);
+    KUNIT_EXPECT_EQ(test, key->db.late, 1U);
+    KUNIT_EXPECT_GT(test, key->db.window_ns, 3 * NSEC_PER_MSEC);
+
+    fake_ns += 200 * NSEC_PER_MSEC;
+    press(1);
+    fake_ns += NSEC_PER_MSEC;
+    press(1);
+    fake_ns += 3 * NSEC_PER_MSEC;
+    press(1);
+    KUNIT_EXPECT_EQ(test, event_seq, 6ULL);
+    KUNIT_EXPECT_EQ(test, key->db.late, 1U);
+    KUNIT_EXPECT_EQ(test, key->db.bounces, 3U);
+}
+
+static void button_test_debounce_bounds(struct kunit *test)
+{
+    struct button_key *key = &keys[1];
+    int i;
+
+    /* 15 ms bounces on a switch bounded at 20 ms: the window opens to the bound, no further */
+    debounce_max_ns = 20 * NSEC_PER_MSEC;
+    key->db.window_ns = debounce_min_ns;
+    for (i = 0; i < 20; i++) {
+        press(1);
+        fake_ns += 15 * NSEC_PER_MSEC;
+        press(1);
+        fake_ns += 100 * NSEC_PER_MSEC;
+        KUNIT_EXPECT_GE(test, key->db.window_ns, debounce_min_ns);
+        KUNIT_EXPECT_LE(test, key->db.window_ns, debounce_max_ns);
+    }
+    KUNIT_EXPECT_EQ(test, key->db.window_ns, debounce_max_ns);
+    KUNIT_EXPECT_EQ(test, key->db.late, 1U);
+    KUNIT_EXPECT_EQ(test, event_seq, 21ULL);
+}
+
+/* Release bounce is rejected and learnt, not counted as presses */
+static void button_test_debounce_release(struct kunit *test)
+{
+    struct button_key *key = &keys[1];
+
+    press(1);
+    fake_ns += 300 * NSEC_PER_MSEC;
+    release(1);
+    KUNIT_EXPECT_EQ(test, event_seq, 1ULL);
+    KUNIT_EXPECT_EQ(test, key->db.edges, 2U);
+
+    /* The clean press primed the window down to the lower bound */
+    KUNIT_EXPECT_EQ(test, key->db.window_ns, debounce_min_ns);
+    fake_ns += NSEC_PER_MSEC;
+    press(1);
+    fake_ns += NSEC_PER_MSEC;
+    release(1);
+    KUNIT_EXPECT_EQ(test, event_seq, 1ULL);
+    KUNIT_EXPECT_EQ(test, key->accepted, 1U);
+    KUNIT_EXPECT_EQ(test, key->db.bounces, 2U);
+    KUNIT_EXPECT_EQ(test, key->db.burst_gap, NSEC_PER_MSEC);
+
+    /* The next press folds the release bounce into the estimate */
+    fake_ns += 200 * NSEC_PER_MSEC;
+    press(1);
+    KUNIT_EXPECT_EQ(test, event_seq, 2ULL);
+    KUNIT_EXPECT_EQ(test, key->db.avg, NSEC_PER_MSEC / 8);
+    KUNIT_EXPECT_EQ(test, key->db.dev, NSEC_PER_MSEC / 4);
+}
+
+/* A 30 ms tap is a short hold, not a bounce the window missed */
+static void button_test_debounce_quick_tap(struct kunit *test)
+{
+    struct button_key *key = &keys[1];
+    int i;
+
+    press(1);
+    fake_ns += 300 * NSEC_PER_MSEC;
+    release(1);
+    KUNIT_EXPECT_EQ(test, key->db.window_ns, debounce_min_ns);
+
+    fake_ns += 200 * NSEC_PER_MSEC;
+    for (i = 0; i < 4; i++) {
+        press(1);
+        fake_ns += 30 * NSEC_PER_MSEC;
+        release(1);
+        fake_ns += 30 * NSEC_PER_MSEC;
+    }
+    KUNIT_EXPECT_EQ(test, event_seq, 5ULL);
+    KUNIT_EXPECT_EQ(test, key->db.late, 0U);
+    KUNIT_EXPECT_EQ(test, key->db.avg, 0U);
+    KUNIT_EXPECT_EQ(test, key->db.window_ns, debounce_min_ns);
+}
+
+static void button_test_debounce_per_key(struct kunit *test)
+{
+    num_keys = 3;
+    press(1);
+    press(2);
+    press(1);
+    KUNIT_EXPECT_EQ(test, event_seq, 2ULL);
+}
+
+static void button_test_five_presses(struct kunit *test)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        press(0);
+        fake_ns += debounce_max_ns;
+    }
+    KUNIT_EXPECT_EQ(test, press_count, 4);
+    KUNIT_EXPECT_TRUE(test, timer_pending(&press_timer));
+
+    /* The fifth press resolves without waiting for the timeout */
+    press(0);
+    flush_work(&button_work);
+    flush_work(&rule_work);
+    button_rule_work_handler(&rule_work);
+    KUNIT_EXPECT_FALSE(test, timer_pending(&press_timer));
+    KUNIT_EXPECT_EQ(test, press_count, 0);
+    KUNIT_EXPECT_EQ(test, current_led_state, 0);
+    KUNIT_EXPECT_EQ(test, last_event()->type, BUTTON_EV_MULTI_PRESS);
+    KUNIT_EXPECT_EQ(test, last_event()->value, 5U);
+}
+
+/* Uploaded rules */
+
+static struct button_rule_set *make_rules(struct kunit *test, const struct button_rule *rules,
+                                          unsigned int count)
+{
+    struct button_rule_set *set = button_rules_alloc(count);
+    unsigned int i;
+
+    KUNIT_ASSERT_NOT_NULL(test, set);
+    memcpy(set->rules, rules, count * sizeof(*rules));
+    for (i = 0; i < count; i++)
+        KUNIT_EXPECT_EQ(test, button_rule_validate(&set->rules[i]), 0);
+    return set;
+}
+
+static void button_test_rule_actions(struct kunit *test)
+{
+    static const struct button_rule rules[] = {
+        { .type = BUTTON_EV_PRESS, .key = 1, .action = BUTTON_RULE_TOGGLE,
+          .flags = BUTTON_RULE_F_CONTINUE, .mask = 0x1 },
+        { .type = BUTTON_EV_PRESS, .key = BUTTON_RULE_ANY_KEY, .action = BUTTON_RULE_SET,
+          .mask = 0x6, .value = 0x4 },
+        { .type = BUTTON_EV_PRESS, .key = BUTTON_RULE_ANY_KEY, .action = BUTTON_RULE_CLEAR,
+          .mask = 0x7 },
+        { .type = BUTTON_EV_CHORD, .min = 0x6, .max = 0x6, .action = BUTTON_RULE_CLEAR,
+          .mask = 0x5 },
+    };
+    struct button_rule_set *set = make_rules(test, rules, ARRAY_SIZE(rules));
+    struct button_rule_result res;
+
+    /* Toggle continues into the SET, which stops before the CLEAR */
+    eval(set, BUTTON_EV_PRESS, 1, 0, 0x2, &res);
+    KUNIT_EXPECT_TRUE(test, res.leds);
+    KUNIT_EXPECT_EQ(test, res.mask, 0x5UL);
+
+    eval(set, BUTTON_EV_PRESS, 2, 0, 0x3, &res);
+    KUNIT_EXPECT_EQ(test, res.mask, 0x5UL);
+
+    eval(set, BUTTON_EV_CHORD, 0, 0x6, 0x7, &res);
+    KUNIT_EXPECT_EQ(test, res.mask, 0x2UL);
+
+    /* No rule for this chord or for multi-press */
+    eval(set, BUTTON_EV_CHORD, 0, 0x3, 0x7, &res);
+    KUNIT_EXPECT_FALSE(test, res.leds);
+    KUNIT_EXPECT_EQ(test, res.mask, 0x7UL);
+    eval(set, BUTTON_EV_MULTI_PRESS, 0, 2, 0x7, &res);
+    KUNIT_EXPECT_FALSE(test, res.leds);
+    kfree(set);
+}
+
+static void button_test_rule_pattern(struct kunit *test)
+{
+    static const struct button_rule rules[] = {
+        { .type = BUTTON_EV_MULTI_PRESS, .min = 2, .max = 3, .action = BUTTON_RULE_PATTERN,
+          .mask = 0x7, .pattern = 0x0421, .step_ms = 100, .steps = 4, .repeat = 2 },
+    };
+    struct button_rule_set *set = make_rules(test, rules, ARRAY_SIZE(rules));
+    struct button_rule_result res;
+
+    eval(set, BUTTON_EV_MULTI_PRESS, 0, 3, 0x1, &res);
+    KUNIT_EXPECT_FALSE(test, res.leds);
+    KUNIT_EXPECT_PTR_EQ(test, res.pattern, &set->rules[0]);
+    kfree(set);
+}
+
+static void button_test_rule_validate(struct kunit *test)
+{
+    const struct button_rule good = {
+        .type = BUTTON_EV_CHORD, .min = 3, .max = 3, .action = BUTTON_RULE_PATTERN,
+        .mask = 0x7, .step_ms = 10, .steps = 8,
+    };
+    struct button_rule r;
+
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&good), 0);
+
+    r = good; r.type = BUTTON_EV_OVERRUN;
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&r), -EINVAL);
+    r = good; r.min = 4;
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&r), -EINVAL);
+    r = good; r.mask = 0x8;
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&r), -EINVAL);
+    r = good; r.action = 0;
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&r), -EINVAL);
+    r = good; r.flags = 0x80;
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&r), -EINVAL);
+    r = good; r.steps = 9;
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&r), -EINVAL);
+    r = good; r.step_ms = PATTERN_STEP_MIN_MS - 1;
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&r), -EINVAL);
+
+    /* PRESS rules name one key or the wildcard */
+    r = good; r.type = BUTTON_EV_PRESS; r.key = BUTTON_MAX_KEYS - 1;
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&r), 0);
+    r.key = BUTTON_RULE_ANY_KEY;
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&r), 0);
+    r.key = BUTTON_MAX_KEYS;
+    KUNIT_EXPECT_EQ(test, button_rule_validate(&r), -EINVAL);
+}
+
+/* The worker consumes each queued event exactly once */
+static void button_test_rule_worker(struct kunit *test)
+{
+    num_keys = 3;
+    press(1);
+    button_work_handler(&button_work);      /* 0 presses, no rule */
+    press_count = 4;
+    button_work_handler(&button_work);
+
+    button_rule_work_handler(&rule_work);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 1U);
+    KUNIT_EXPECT_EQ(test, fake_led_mask, 0x7UL);
+    KUNIT_EXPECT_EQ(test, current_led_state, 4);
+    KUNIT_EXPECT_EQ(test, rule_reader.next_seq, event_seq + 1);
+
+    button_rule_work_handler(&rule_work);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 1U);
+}
+
+/* Chords and the event queue */
+
+static void button_test_chord(struct kunit *test)
+{
+    num_keys = 3;
+    press(1);
+    press(2);
+    KUNIT_EXPECT_EQ(test, chord_mask, 0x6UL);
+
+    del_timer_sync(&chord_timer);
+    chord_timer_callback(&chord_timer);
+    KUNIT_EXPECT_EQ(test, chord_mask, 0UL);
+    KUNIT_EXPECT_EQ(test, last_event()->type, BUTTON_EV_CHORD);
+    KUNIT_EXPECT_EQ(test, last_event()->value, 0x6U);
+}
+
+static void button_test_single_key_no_chord(struct kunit *test)
+{
+    num_keys = 3;
+    press(2);
+
+    del_timer_sync(&chord_timer);
+    chord_timer_callback(&chord_timer);
+    KUNIT_EXPECT_EQ(test, event_seq, 1ULL);
+    KUNIT_EXPECT_EQ(test, last_event()->type, BUTTON_EV_PRESS);
+}
+
+static void button_test_overrun(struct kunit *test)
+{
+    struct button_reader reader = { .next_seq = 1 };
+    struct button_event out[2];
+    int i;
+
+    for (i = 0; i < EVENT_RING_SIZE + 10; i++)
+        button_queue_event(BUTTON_EV_PRESS, 0, i);
+
+    KUNIT_ASSERT_EQ(test, button_fetch_events(&reader, out, 2), 2);
+    KUNIT_EXPECT_EQ(test, out[0].type, BUTTON_EV_OVERRUN);
+    KUNIT_EXPECT_EQ(test, out[0].value, 10U);
+    KUNIT_EXPECT_EQ(test, out[1].seq, 11ULL);
+    KUNIT_EXPECT_EQ(test, out[1].value, 10U);
+}
+
+/* Per-reader filters skip events without copying them */
+static void button_test_filter(struct kunit *test)
+{
+    struct button_reader reader = { .next_seq = 1 };
+    struct button_event out[8];
+    int i;
+
+    button_queue_event(BUTTON_EV_PRESS, 0, 0);
+    button_queue_event(BUTTON_EV_PRESS, 2, 0);
+    button_queue_event(BUTTON_EV_CHORD, 0, 0x6);
+    button_queue_event(BUTTON_EV_MULTI_PRESS, 0, 2);
+
+    /* Presses and chords involving key 2 */
+    reader.filter_types = BIT(BUTTON_EV_PRESS) | BIT(BUTTON_EV_CHORD);
+    reader.filter_keys = BIT(2);
+    KUNIT_ASSERT_EQ(test, button_fetch_events(&reader, out, 8), 2);
+    KUNIT_EXPECT_EQ(test, out[0].seq, 2ULL);
+    KUNIT_EXPECT_EQ(test, out[1].type, BUTTON_EV_CHORD);
+    KUNIT_EXPECT_EQ(test, reader.next_seq, 5ULL);
+
+    /* Rejected events do not make the reader ready */
+    button_queue_event(BUTTON_EV_PRESS, 1, 0);
+    KUNIT_EXPECT_FALSE(test, button_event_ready(&reader));
+    KUNIT_EXPECT_EQ(test, reader.next_seq, 6ULL);
+
+    /* Rate limit, timestamps 0.4 ms apart against a 1 ms interval */
+    reader = (struct button_reader){ .next_seq = event_seq + 1, .min_interval_ns = NSEC_PER_MSEC };
+    for (i = 0; i < 6; i++) {
+        button_queue_event(BUTTON_EV_PRESS, 0, i);
+        event_ring[event_seq & EVENT_RING_MASK].timestamp = 1000000000ULL + i * 400000ULL;
+    }
+    KUNIT_ASSERT_EQ(test, button_fetch_events(&reader, out, 8), 2);
+    KUNIT_EXPECT_EQ(test, out[0].value, 0U);
+    KUNIT_EXPECT_EQ(test, out[1].value, 3U);
+}
+
+/* Wake latency: resume, the wake edge, its PRESS to the rule worker and a reader */
+static void button_test_wake(struct kunit *test)
+{
+    struct button_reader reader = { .next_seq = 1 };
+    struct button_event out[4];
+
+    button_wake_open();
+    press(0);
+    KUNIT_EXPECT_EQ(test, wake.info.resumes, 1U);
+    KUNIT_EXPECT_EQ(test, wake.info.key_wakes, 1U);
+    KUNIT_EXPECT_EQ(test, wake.seq, event_seq);
+    KUNIT_EXPECT_GE(test, wake.info.resume_event_ns, wake.info.resume_irq_ns);
+
+    KUNIT_ASSERT_EQ(test, button_fetch_events(&reader, out, 4), 1);
+    KUNIT_EXPECT_EQ(test, wake.info.delivered, 1U);
+    KUNIT_EXPECT_GE(test, wake.info.resume_read_ns, wake.info.resume_event_ns);
+    KUNIT_EXPECT_EQ(test, wake.info.resume_read_sum_ns, wake.info.resume_read_ns);
+
+    /* A second reader of the same press is not a second delivery */
+    reader.next_seq = 1;
+    button_fetch_events(&reader, out, 4);
+    KUNIT_EXPECT_EQ(test, wake.info.delivered, 1U);
+
+    button_rule_work_handler(&rule_work);
+    KUNIT_EXPECT_TRUE(test, wake.rules_seen);
+    KUNIT_EXPECT_GE(test, wake.info.resume_rules_ns, wake.info.resume_event_ns);
+}
+
+/* A key IRQ long after resume did not wake the system */
+static void button_test_wake_window(struct kunit *test)
+{
+    button_wake_open();
+    wake.resume_ns -= 2ULL * WAKE_WINDOW_MS * NSEC_PER_MSEC;
+    press(0);
+    KUNIT_EXPECT_EQ(test, wake.info.key_wakes, 0U);
+    KUNIT_EXPECT_EQ(test, wake.resume_ns, 0ULL);
+    KUNIT_EXPECT_EQ(test, wake.seq, 0ULL);
+}
+
+/* Microbenchmarks */
+
+static void button_bench_irq_accept(struct kunit *test)
+{
+    u64 start;
+    int i;
+
+    start = ktime_get_ns();
+    for (i = 0; i < BUTTON_BENCH_ITERS; i++) {
+        fake_ns += debounce_max_ns;
+        press(1);
+    }
+    gpio_kunit_bench_report(test, "irq_handler_accept", ktime_get_ns() - start, BUTTON_BENCH_ITERS);
+    KUNIT_EXPECT_EQ(test, event_seq, (u64)BUTTON_BENCH_ITERS);
+}
+
+static void button_bench_irq_debounced(struct kunit *test)
+{
+    u64 start;
+    int i;
+
+    press(1);
+    start = ktime_get_ns();
+    for (i = 0; i < BUTTON_BENCH_ITERS; i++)
+        press(1);
+    gpio_kunit_bench_report(test, "irq_handler_debounced", ktime_get_ns() - start, BUTTON_BENCH_ITERS);
+    KUNIT_EXPECT_EQ(test, event_seq, 1ULL);
+}
+
+static void button_bench_resolve(struct kunit *test)
+{
+    const struct button_rule_set *set = active_rules();
+    struct button_rule_result res;
+    unsigned long acc = 0;
+    u64 start;
+    int i;
+
+    start = ktime_get_ns();
+    for (i = 0; i < BUTTON_BENCH_ITERS; i++) {
+        eval(set, BUTTON_EV_MULTI_PRESS, 0, i % 6, 0, &res);
+        acc += res.mask;
+    }
+    gpio_kunit_bench_report(test, "rules_eval_default", ktime_get_ns() - start, BUTTON_BENCH_ITERS);
+    KUNIT_EXPECT_NE(test, acc, 0UL);
+}
+
+static struct kunit_case button_test_cases[] = {
+    KUNIT_CASE_PARAM(button_test_resolve, resolve_gen_params),
+    KUNIT_CASE(button_test_work_applies_state),
+    KUNIT_CASE(button_test_rule_actions),
+    KUNIT_CASE(button_test_rule_pattern),
+    KUNIT_CASE(button_test_rule_validate),
+    KUNIT_CASE(button_test_rule_worker),
+    KUNIT_CASE(button_test_debounce),
+    KUNIT_CASE(button_test_debounce_adapt),
+    KUNIT_CASE(button_test_debounce_bounds),
+    KUNIT_CASE(button_test_debounce_release),
+    KUNIT_CASE(button_test_debounce_quick_tap),
+    KUNIT_CASE(button_test_debounce_per_key),
+    KUNIT_CASE(button_test_five_presses),
+    KUNIT_CASE(button_test_chord),
+    KUNIT_CASE(button_test_single_key_no_chord),
+    KUNIT_CASE(button_test_overrun),
+    KUNIT_CASE(button_test_filter),
+    KUNIT_CASE(button_test_wake),
+    KUNIT_CASE(button_test_wake_window),
+    KUNIT_CASE_SLOW(button_bench_irq_accept),
+    KUNIT_CASE_SLOW(button_bench_irq_debounced),
+    KUNIT_CASE_SLOW(button_bench_resolve),
+    {}
+};
+
+static struct kunit_suite button_test_suite = {
+    .name = "button_driver",
+    .init = button_test_init,
+    .exit = button_test_exit,
+    .test_cases = button_test_cases,
+};
+
+kunit_test_suite(button_test_suite);
@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Tracepoints along the button pipeline, consumed by tools/pipeline_latency
+ *
+ *   button_edge          every edge, press or release, after the debounce decision
+ *   button_event         an event entered the queue, with its sequence number
+ *   button_press_window  the multi-press window closed (timeout or 5 presses)
+ *   button_rule          the rule worker evaluated event @seq
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gpio_button
+
+#if !defined(_BUTTON_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _BUTTON_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(button_edge,
+    TP_PROTO(u8 key, bool accepted, bool release, u64 gap_ns, u64 window_ns),
+    TP_ARGS(key, accepted, release, gap_ns, window_ns),
+    TP_STRUCT__entry(
+        __field(u8, key)
+        __field(bool, accepted)
+        __field(bool, release)
+        __field(u64, gap_ns)
+        __field(u64, window_ns)
+    ),
+    TP_fast_assign(
+        __entry->key = key;
+        __entry->accepted = accepted;
+        __entry->release = release;
+        __entry->gap_ns = gap_ns;
+        __entry->window_ns = window_ns;
+    ),
+    TP_printk("key=%u accepted=%d release=%d gap_ns=%llu window_ns=%llu",
+              __entry->key, __entry->accepted, __entry->release, __entry->gap_ns,
+              __entry->window_ns)
+);
+
+TRACE_EVENT(button_event,
+    TP_PROTO(u64 seq, u16 type, u16 key, u32 value),
+    TP_ARGS(seq, type, key, value),
+    TP_STRUCT__entry(
+        __field(u64, seq)
+        __field(u16, type)
+        __field(u16, key)
+        __field(u32, value)
+    ),
+    TP_fast_assign(
+        __entry->seq = seq;
+        __entry->type = type;
+        __entry->key = key;
+        __entry->value = value;
+    ),
+    TP_printk("seq=%llu type=%u key=%u value=%u",
+              __entry->seq, __entry->type, __entry->key, __entry->value)
+);
+
+TRACE_EVENT(button_press_window,
+    TP_PROTO(int count),
+    TP_ARGS(count),
+    TP_STRUCT__entry(
+        __field(int, count)
+    ),
+    TP_fast_assign(
+        __entry->count = count;
+    ),
+    TP_printk("count=%d", __entry->count)
+);
+
+TRACE_EVENT(button_rule,
+    TP_PROTO(u64 seq, u16 type, bool leds, u32 mask),
+    TP_ARGS(seq, type, leds, mask),
+    TP_STRUCT__entry(
+        __field(u64, seq)
+        __field(u16, type)
+        __field(bool, leds)
+        __field(u32, mask)
+    ),
+    TP_fast_assign(
+        __entry->seq = seq;
+        __entry->type = type;
+        __entry->leds = leds;
+        __entry->mask = mask;
+    ),
+    TP_printk("seq=%llu type=%u leds=%d mask=0x%x",
+              __entry->seq, __entry->type, __entry->leds, __entry->mask)
+);
+
+#endif /* _BUTTON_TRACE_H */
+
+/* Out of tree: the header sits next to the driver, see ccflags-y */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE button_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,606 @@
+#include <linux/module.h>        /* For module_platform_driver */
+#include <linux/platform_device.h> /* For platform driver support */
+#include <linux/gpio/consumer.h> /* For GPIO descriptor interface */
+#include <linux/interrupt.h>     /* For interrupt handling */
+#include <linux/jiffies.h>      /* For jiffies counter */
+#include <linux/kernel.h>       /* For kernel functions */
+#include <linux/fs.h>           /* For file operations */
+#include <linux/cdev.h>         /* For character device */
+#include <linux/device.h>       /* For device creation */
+#include <linux/uaccess.h>      /* For copy_to/from_user */
+#include <linux/slab.h>         /* For kzalloc/kfree */
+#include <linux/poll.h>         /* For poll support */
+#include <linux/wait.h>         /* For wait queues */
+#include <linux/atomic.h>       /* For lock-free counters */
+#include <linux/ktime.h>        /* For ns timestamps */
+#include <linux/mutex.h>        /* For per-reader lock */
+#include <linux/of.h>           /* For device tree support */
+#include <linux/bitops.h>       /* For the AB sample */
+
+#include "gpio_control.h"       /* Shared event and IOCTL definitions */
+
+/* Device and timing constants */
+#define DEVICE_NAME "gpio_encoder"
+#define DEVICE_CLASS "gpio_encoder_class"
+#define DEBOUNCE_TIME_MS 50        /* Push switch debounce time */
+#define DEFAULT_STEPS_PER_DETENT 4 /* Quadrature transitions per detent */
+#define EVENT_RING_SIZE 256        /* Event ring entries, power of two */
+#define EVENT_RING_MASK (EVENT_RING_SIZE - 1)
+
+/*
+ * Quadrature decode table, indexed by (previous AB << 2) | current AB
+ * The clockwise Gray sequence is 00 -> 01 -> 11 -> 10 -> 00
+ * QUAD_INVALID marks a jump over one state (both lines changed), which
+ * means an edge was lost and the direction cannot be known
+ */
+#define QUAD_INVALID 2
+static const s8 quad_table[16] = {
+     0, +1, -1, QUAD_INVALID,
+    -1,  0, QUAD_INVALID, +1,
+    +1, QUAD_INVALID,  0, -1,
+    QUAD_INVALID, -1, +1,  0,
+};
+
+/*
+ * Acceleration table: a detent arriving within max_interval_ns of the
+ * previous one counts as factor steps. Checked in order, first match wins
+ */
+static const struct {
+    u64 max_interval_ns;
+    s32 factor;
+} accel_table[] = {
+    { 10 * NSEC_PER_MSEC, 8 },
+    { 20 * NSEC_PER_MSEC, 4 },
+    { 40 * NSEC_PER_MSEC, 2 },
+};
+
+/* GPIO and device related variables */
+static struct gpio_descs *enc_descs;      /* Channels A and B, sampled together */
+static struct gpio_desc *enc_a_gpio;      /* Encoder channel A */
+static struct gpio_desc *enc_b_gpio;      /* Encoder channel B */
+static struct gpio_desc *push_gpio;       /* Optional push switch */
+static dev_t dev_number;                  /* Device number */
+static struct class *dev_class;           /* Device class */
+static struct cdev encoder_cdev;          /* Character device structure */
+static struct device *encoder_device;     /* Device structure */
+static u32 steps_per_detent = DEFAULT_STEPS_PER_DETENT;
+
+/*
+ * Decoder state, only touched with atomics so the A and B handlers can
+ * run concurrently on different CPUs without a lock
+ */
+static atomic_t quad_state;               /* Last sampled AB value */
+static atomic_t quad_accum;               /* Transitions since last detent */
+static atomic_t position;                 /* Accelerated position */
+static atomic64_t last_step_ns;           /* Timestamp of previous detent */
+
+/* Statistics, see struct encoder_stats */
+static atomic64_t stat_steps;
+static atomic64_t stat_transitions;
+static atomic64_t stat_invalid;
+static atomic64_t stat_dropped;
+static atomic64_t stat_min_step_ns;
+
+/*
+ * Event ring: producers reserve a sequence number with one atomic
+ * increment and publish the slot by storing that number last. Readers
+ * keep their own cursor, so every open file sees every event
+ */
+static struct encoder_event event_ring[EVENT_RING_SIZE];
+static atomic64_t event_head;             /* Last reserved sequence number */
+static DECLARE_WAIT_QUEUE_HEAD(event_wait);
+
+/* Per-open-file reader state */
+struct encoder_reader {
+    struct mutex lock;                    /* Serializes reads on one file */
+    u64 next_seq;                         /* Next sequence number to return */
+};
+
+/* Function prototypes for file operations */
+static int encoder_open(struct inode *, struct file *);
+static int encoder_release(struct inode *, struct file *);
+static ssize_t encoder_read(struct file *, char __user *, size_t, loff_t *);
+static __poll_t encoder_poll(struct file *, poll_table *);
+static long encoder_ioctl(struct file *, unsigned int, unsigned long);
+
+/* File operations structure */
+static struct file_operations fops = {
+    .owner = THIS_MODULE,
+    .open = encoder_open,
+    .release = encoder_release,
+    .read = encoder_read,
+    .poll = encoder_poll,
+    .unlocked_ioctl = encoder_ioctl,
+};
+
+/*
+ * Publish one event to the ring and wake readers
+ * Safe from hard IRQ context on any CPU, takes no lock on the fast path
+ */
+static void encoder_push_event(u32 type, s32 delta, s32 accel, s32 pos, u32 value, u64 now)
+{
+    u64 seq = atomic64_inc_return(&event_head);
+    struct encoder_event *slot = &event_ring[seq & EVENT_RING_MASK];
+
+    /* Invalidate the slot first so a lapping reader never sees torn data */
+    WRITE_ONCE(slot->seq, 0);
+    smp_wmb();
+
+    slot->timestamp = now;
+    slot->type = type;
+    slot->delta = delta;
+    slot->accel = accel;
+    slot->position = pos;
+    slot->value = value;
+
+    smp_store_release(&slot->seq, seq);
+
+    if (wq_has_sleeper(&event_wait))
+        wake_up_interruptible(&event_wait);
+}
+
+/*
+ * Convert the interval since the previous detent into a step multiplier
+ * Also tracks the shortest detent interval seen
+ */
+static s32 encoder_accel(u64 now)
+{
+    u64 prev = atomic64_xchg(&last_step_ns, now);
+    u64 interval, min;
+    int i;
+
+    if (!prev)
+        return 1;
+
+    interval = now - prev;
+    min = atomic64_read(&stat_min_step_ns);
+    while (!min || interval < min) {
+        u64 old = atomic64_cmpxchg(&stat_min_step_ns, min, interval);
+        if (old == min)
+            break;
+        min = old;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(accel_table); i++) {
+        if (interval < accel_table[i].max_interval_ns)
+            return accel_table[i].factor;
+    }
+    return 1;
+}
+
+/*
+ * Sample A and B with one array read, so an edge cannot land between two
+ * separate reads. On a single GPIO chip this is one register read
+ * Returns: AB as a 2-bit value, or -errno
+ */
+static int encoder_sample(void)
+{
+    unsigned long bits = 0;
+    int ret;
+
+    ret = gpiod_get_array_value(enc_descs->ndescs, enc_descs->desc, enc_descs->info, &bits);
+    if (ret)
+        return ret;
+    return ((bits & BIT(0)) << 1) | ((bits & BIT(1)) >> 1);
+}
+
+/*
+ * IRQ handler for both encoder channels
+ * Samples A and B, decodes the transition through quad_table and emits
+ * a STEP event every steps_per_detent transitions in the same direction
+ */
+static irqreturn_t encoder_irq_handler(int irq, void *dev_id)
+{
+    u64 now = ktime_get_ns();
+    int cur = encoder_sample();
+    int prev, dir, old, new, step;
+    s32 accel;
+
+    if (cur < 0)
+        return IRQ_HANDLED;
+
+    prev = atomic_xchg(&quad_state, cur);
+    dir = quad_table[(prev << 2) | cur];
+
+    /* Same state: the other channel's IRQ already consumed this edge */
+    if (dir == 0)
+        return IRQ_HANDLED;
+
+    if (dir == QUAD_INVALID) {
+        atomic64_inc(&stat_invalid);
+        atomic_set(&quad_accum, 0);
+        return IRQ_HANDLED;
+    }
+    atomic64_inc(&stat_transitions);
+
+    /* Accumulate transitions and take one detent out when complete */
+    do {
+        old = atomic_read(&quad_accum);
+        new = old + dir;
+        step = 0;
+        if (new >= (int)steps_per_detent) {
+            new -= steps_per_detent;
+            step = 1;
+        } else if (new <= -(int)steps_per_detent) {
+            new += steps_per_detent;
+            step = -1;
+        }
+    } while (atomic_cmpxchg(&quad_accum, old, new) != old);
+
+    if (step) {
+        accel = encoder_accel(now);
+        atomic64_inc(&stat_steps);
+        encoder_push_event(ENCODER_EV_STEP, step, accel,
+                           atomic_add_return(step * accel, &position), 0, now);
+    }
+
+    return IRQ_HANDLED;
+}
+
+/*
+ * IRQ handler for the optional push switch
+ * Uses the same jiffies debounce as the button driver
+ */
+static irqreturn_t push_irq_handler(int irq, void *dev_id)
+{
+    unsigned long current_time = jiffies;
+    static unsigned long last_irq_time = 0;
+
+    if (time_before(current_time, last_irq_time + msecs_to_jiffies(DEBOUNCE_TIME_MS))) {
+        return IRQ_HANDLED;
+    }
+    last_irq_time = current_time;
+
+    encoder_push_event(ENCODER_EV_PUSH, 0, 0, atomic_read(&position), 1, ktime_get_ns());
+    return IRQ_HANDLED;
+}
+
+/*
+ * Copy the next event for a reader out of the ring
+ * Returns true if @ev was filled, false if the reader is up to date
+ * A reader that was lapped gets one OVERRUN event carrying the lost count
+ */
+static bool encoder_fetch_event(struct encoder_reader *reader, struct encoder_event *ev)
+{
+    u64 head = atomic64_read(&event_head);
+    struct encoder_event *slot;
+    u64 seq, oldest, lost;
+
+    if (reader->next_seq > head)
+        return false;
+
+    slot = &event_ring[reader->next_seq & EVENT_RING_MASK];
+    seq = smp_load_acquire(&slot->seq);
+    if (seq == reader->next_seq) {
+        *ev = *slot;
+        smp_rmb();
+        if (READ_ONCE(slot->seq) == reader->next_seq) {
+            reader->next_seq++;
+            return true;
+        }
+    } else if (seq < reader->next_seq && head - reader->next_seq < EVENT_RING_SIZE) {
+        /* Reserved but not yet published */
+        return false;
+    }
+
+    /* Overwritten: skip to the oldest event still in the ring */
+    head = atomic64_read(&event_head);
+    oldest = head >= EVENT_RING_SIZE ? head - EVENT_RING_SIZE + 1 : 1;
+    lost = oldest > reader->next_seq ? oldest - reader->next_seq : 1;
+    atomic64_add(lost, &stat_dropped);
+
+    memset(ev, 0, sizeof(*ev));
+    ev->seq = reader->next_seq;
+    ev->timestamp = ktime_get_ns();
+    ev->type = ENCODER_EV_OVERRUN;
+    ev->value = lost;
+    reader->next_seq += lost;
+    return true;
+}
+
+/*
+ * True when encoder_fetch_event() would return an event: the reader's
+ * next slot is published, or the reader has been lapped
+ */
+static bool encoder_event_ready(struct encoder_reader *reader)
+{
+    u64 head = atomic64_read(&event_head);
+    u64 next = READ_ONCE(reader->next_seq);
+
+    if (next > head)
+        return false;
+    if (head - next >= EVENT_RING_SIZE)
+        return true;
+    return smp_load_acquire(&event_ring[next & EVENT_RING_MASK].seq) >= next;
+}
+
+/* File operation implementations */
+
+/*
+ * Called when device file is opened
+ * Each file starts at the current head and only sees new events
+ */
+static int encoder_open(struct inode *inode, struct file *file)
+{
+    struct encoder_reader *reader;
+
+    reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+    if (!reader)
+        return -ENOMEM;
+
+    mutex_init(&reader->lock);
+    reader->next_seq = atomic64_read(&event_head) + 1;
+    file->private_data = reader;
+
+    pr_info("Encoder device opened\n");
+    return 0;
+}
+
+/*
+ * Called when device file is closed
+ */
+static int encoder_release(struct inode *inode, struct file *file)
+{
+    kfree(file->private_data);
+    pr_info("Encoder device closed\n");
+    return 0;
+}
+
+/*
+ * Read implementation - returns as many whole struct encoder_event
+ * records as fit in the buffer. Blocks until at least one event is
+ * available unless the file is non-blocking
+ */
+static ssize_t encoder_read(struct file *file, char __user *buffer, size_t len, loff_t *offset)
+{
+    struct encoder_reader *reader = file->private_data;
+    struct encoder_event ev;
+    size_t copied = 0;
+    int ret;
+
+    if (len < sizeof(ev))
+        return -EINVAL;
+
+    mutex_lock(&reader->lock);
+    for (;;) {
+        while (copied + sizeof(ev) <= len && encoder_fetch_event(reader, &ev)) {
+            if (copy_to_user(buffer + copied, &ev, sizeof(ev))) {
+                mutex_unlock(&reader->lock);
+                return copied ? copied : -EFAULT;
+            }
+            copied += sizeof(ev);
+        }
+        if (copied || (file->f_flags & O_NONBLOCK))
+            break;
+
+        mutex_unlock(&reader->lock);
+        ret = wait_event_interruptible(event_wait, encoder_event_ready(reader));
+        if (ret)
+            return ret;
+        mutex_lock(&reader->lock);
+    }
+    mutex_unlock(&reader->lock);
+
+    return copied ? copied : -EAGAIN;
+}
+
+/*
+ * Poll implementation - readable when the reader has unread events
+ */
+static __poll_t encoder_poll(struct file *file, poll_table *wait)
+{
+    struct encoder_reader *reader = file->private_data;
+
+    poll_wait(file, &event_wait, wait);
+    if (encoder_event_ready(reader))
+        return EPOLLIN | EPOLLRDNORM;
+    return 0;
+}
+
+/*
+ * IOCTL implementation
+ * - ENCODER_IOC_GET_STATS: Copy decoder statistics
+ * - ENCODER_IOC_RESET: Zero position and statistics
+ */
+static long encoder_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct encoder_stats stats;
+
+    switch (cmd) {
+        case ENCODER_IOC_GET_STATS:
+            stats.steps = atomic64_read(&stat_steps);
+            stats.transitions = atomic64_read(&stat_transitions);
+            stats.invalid = atomic64_read(&stat_invalid);
+            stats.dropped = atomic64_read(&stat_dropped);
+            stats.min_step_ns = atomic64_read(&stat_min_step_ns);
+            if (copy_to_user((void __user *)arg, &stats, sizeof(stats)))
+                return -EFAULT;
+            break;
+
+        case ENCODER_IOC_RESET:
+            atomic_set(&position, 0);
+            atomic_set(&quad_accum, 0);
+            atomic64_set(&last_step_ns, 0);
+            atomic64_set(&stat_steps, 0);
+            atomic64_set(&stat_transitions, 0);
+            atomic64_set(&stat_invalid, 0);
+            atomic64_set(&stat_dropped, 0);
+            atomic64_set(&stat_min_step_ns, 0);
+            pr_info("Encoder reset\n");
+            break;
+
+        default:
+            return -ENOTTY;
+    }
+    return 0;
+}
+
+/*
+ * Request a both-edge IRQ for one encoder channel
+ * The decoder samples in hard IRQ context, so the GPIO must not sleep
+ */
+static int encoder_request_irq(struct device *dev, struct gpio_desc *gpio, const char *name)
+{
+    int irq;
+
+    if (gpiod_cansleep(gpio)) {
+        dev_err(dev, "%s GPIO sleeps, cannot sample in IRQ\n", name);
+        return -EINVAL;
+    }
+
+    irq = gpiod_to_irq(gpio);
+    if (irq < 0) {
+        dev_err(dev, "Failed to get IRQ for %s\n", name);
+        return irq;
+    }
+
+    return devm_request_irq(dev, irq, encoder_irq_handler,
+                            IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
+                            name, NULL);
+}
+
+static int encoder_probe(struct platform_device *pdev)
+{
+    int ret, irq;
+    struct device *dev = &pdev->dev;
+
+    pr_info("Encoder driver probe started\n");
+
+    /* Get encoder channels as one array and the optional push switch */
+    enc_descs = devm_gpiod_get_array(dev, "encoder", GPIOD_IN);
+    if (IS_ERR(enc_descs)) {
+        dev_err(dev, "Failed to get encoder GPIOs\n");
+        return PTR_ERR(enc_descs);
+    }
+    if (enc_descs->ndescs != 2) {
+        dev_err(dev, "Expected 2 encoder GPIOs, got %u\n", enc_descs->ndescs);
+        return -EINVAL;
+    }
+    enc_a_gpio = enc_descs->desc[0];
+    enc_b_gpio = enc_descs->desc[1];
+
+    push_gpio = devm_gpiod_get_optional(dev, "push", GPIOD_IN);
+    if (IS_ERR(push_gpio)) {
+        dev_err(dev, "Failed to get push GPIO\n");
+        return PTR_ERR(push_gpio);
+    }
+
+    if (of_property_read_u32(dev->of_node, "steps-per-detent", &steps_per_detent) ||
+        steps_per_detent == 0 || steps_per_detent > 4)
+        steps_per_detent = DEFAULT_STEPS_PER_DETENT;
+
+    /* Seed the decoder with the resting state before enabling IRQs */
+    ret = encoder_sample();
+    if (ret < 0)
+        return dev_err_probe(dev, ret, "Failed to sample encoder GPIOs\n");
+    atomic_set(&quad_state, ret);
+
+    /* Setup IRQs */
+    ret = encoder_request_irq(dev, enc_a_gpio, "encoder_a_irq");
+    if (ret)
+        return ret;
+
+    ret = encoder_request_irq(dev, enc_b_gpio, "encoder_b_irq");
+    if (ret)
+        return ret;
+
+    if (push_gpio) {
+        irq = gpiod_to_irq(push_gpio);
+        if (irq < 0) {
+            dev_err(dev, "Failed to get IRQ for push GPIO\n");
+            return irq;
+        }
+
+        ret = devm_request_irq(dev, irq, push_irq_handler,
+                               IRQF_TRIGGER_FALLING, "encoder_push_irq", NULL);
+        if (ret) {
+            dev_err(dev, "Failed to request push IRQ\n");
+            return ret;
+        }
+    }
+
+    /* Create character device */
+    ret = alloc_chrdev_region(&dev_number, 0, 1, DEVICE_NAME);
+    if (ret < 0) {
+        dev_err(dev, "Failed to allocate char device region\n");
+        return ret;
+    }
+
+    dev_class = class_create(DEVICE_CLASS);
+    if (IS_ERR(dev_class)) {
+        dev_err(dev, "Failed to create device class\n");
+        ret = PTR_ERR(dev_class);
+        goto cleanup_chrdev;
+    }
+
+    cdev_init(&encoder_cdev, &fops);
+    encoder_cdev.owner = THIS_MODULE;
+
+    ret = cdev_add(&encoder_cdev, dev_number, 1);
+    if (ret < 0) {
+        dev_err(dev, "Failed to add cdev\n");
+        goto cleanup_class;
+    }
+
+    encoder_device = device_create(dev_class, NULL, dev_number, NULL, DEVICE_NAME);
+    if (IS_ERR(encoder_device)) {
+        dev_err(dev, "Failed to create device\n");
+        ret = PTR_ERR(encoder_device);
+        goto cleanup_cdev;
+    }
+
+    pr_info("Encoder driver probe completed successfully (%u steps/detent%s)\n",
+            steps_per_detent, push_gpio ? ", push switch" : "");
+    pr_info("Created device /dev/%s\n", DEVICE_NAME);
+
+    return 0;
+
+cleanup_cdev:
+    cdev_del(&encoder_cdev);
+cleanup_class:
+    class_destroy(dev_class);
+cleanup_chrdev:
+    unregister_chrdev_region(dev_number, 1);
+    return ret;
+}
+
+/*
+ * Remove function - called when device is removed
+ * Cleans up all resources
+ */
+static void encoder_remove(struct platform_device *pdev)
+{
+    pr_info("Encoder driver remove started\n");
+
+    device_destroy(dev_class, dev_number);
+    cdev_del(&encoder_cdev);
+    class_destroy(dev_class);
+    unregister_chrdev_region(dev_number, 1);
+
+    pr_info("Encoder driver removed successfully\n");
+}
+
+
+static const struct of_device_id encoder_of_match[] = {
+    { .compatible = "custom,gpio-encoder" },
+    { },
+};
+
+MODULE_DEVICE_TABLE(of, encoder_of_match);
+
+
+static struct platform_driver encoder_driver = {
+    .probe = encoder_probe,
+    .remove_new = encoder_remove,
+    .driver = {
+        .name = "encoder_driver",
+        .of_match_table = encoder_of_match,
+    },
+};
+
+
+module_platform_driver(encoder_driver);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("AnhPH58");
+MODULE_DESCRIPTION("GPIO quadrature rotary encoder driver");
@@ -0,0 +1,87 @@
+/*
+ * Aggregated status file for the GPIO control drivers, see gpio_status.h
+ *
+ * Sources are kept on an RCU list: registration is serialized by a mutex,
+ * a read walks the list without locks and every source prints its own
+ * lock-free snapshot, so a scrape never stalls an IRQ or an LED write
+ */
+#include <linux/module.h>        /* For module_init */
+#include <linux/kernel.h>       /* For kernel functions */
+#include <linux/proc_fs.h>      /* For /proc/gpio_ctl_status */
+#include <linux/seq_file.h>     /* For single_open output */
+#include <linux/rculist.h>      /* For the source list */
+#include <linux/mutex.h>        /* For registration */
+#include <linux/ktime.h>        /* For the read timestamp */
+
+#include "gpio_status.h"        /* Source registration */
+
+#define STATUS_NAME "gpio_ctl_status"
+#define STATUS_VERSION 1        /* Bump on incompatible format changes */
+
+static LIST_HEAD(status_sources);
+static DEFINE_MUTEX(status_lock);       /* Serializes list updates */
+static struct proc_dir_entry *status_entry;
+
+/*
+ * Print the header line and one line per bound instance
+ */
+static int gpio_status_show(struct seq_file *m, void *v)
+{
+    struct gpio_status_source *src;
+
+    seq_printf(m, "version=%d now_ns=%llu\n", STATUS_VERSION, ktime_get_ns());
+
+    rcu_read_lock();
+    list_for_each_entry_rcu(src, &status_sources, node)
+        src->show(m);
+    rcu_read_unlock();
+    return 0;
+}
+
+/*
+ * Add a source, called by the drivers through gpio_status_attach()
+ */
+void gpio_status_register(struct gpio_status_source *src)
+{
+    mutex_lock(&status_lock);
+    list_add_tail_rcu(&src->node, &status_sources);
+    mutex_unlock(&status_lock);
+}
+EXPORT_SYMBOL_GPL(gpio_status_register);
+
+/*
+ * Remove a source and wait for readers still inside its show callback
+ */
+void gpio_status_unregister(struct gpio_status_source *src)
+{
+    mutex_lock(&status_lock);
+    list_del_rcu(&src->node);
+    mutex_unlock(&status_lock);
+    synchronize_rcu();
+}
+EXPORT_SYMBOL_GPL(gpio_status_unregister);
+
+static int __init gpio_status_init(void)
+{
+    status_entry = proc_create_single(STATUS_NAME, 0444, NULL, gpio_status_show);
+    if (!status_entry) {
+        pr_err("Failed to create /proc/%s\n", STATUS_NAME);
+        return -ENOMEM;
+    }
+    pr_info("Created /proc/%s\n", STATUS_NAME);
+    return 0;
+}
+
+/* Every source holds a module reference, so the list is empty here */
+static void __exit gpio_status_exit(void)
+{
+    proc_remove(status_entry);
+}
+
+module_init(gpio_status_init);
+module_exit(gpio_status_exit);
+
+/* Module information */
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("AnhPH58");
+MODULE_DESCRIPTION("Aggregated status for the GPIO control drivers");
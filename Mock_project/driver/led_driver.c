@@ -8,11 +8,40 @@
 #include <linux/device.h>       /* For device creation */
 #include <linux/uaccess.h>      /* For copy_to/from_user */
 #include <linux/of.h>           /* For device tree support */
+#include <linux/hrtimer.h>      /* For waveform playback timer */
+#include <linux/spinlock.h>     /* For waveform state lock */
+#include <linux/wait.h>         /* For waiting on a free buffer */
+#include <linux/ktime.h>        /* For ns timestamps */
+#include <linux/log2.h>         /* For lateness histogram */
+#include <linux/math64.h>       /* For 64-bit division */
+#include <linux/mutex.h>        /* For provider registration */
+#include <linux/io_uring.h>     /* For uring_cmd */
+#include <linux/debugfs.h>      /* For timing histograms */
+#include <linux/seq_file.h>     /* For debugfs output */
+#include <linux/percpu.h>       /* For per-CPU histograms */
+#include <linux/jump_label.h>   /* For the timing static key */
+#include <linux/poll.h>         /* For event polling */
+#include <linux/slab.h>         /* For per-file state */
+#include <linux/seqlock.h>      /* For the status snapshot */
+#include <linux/pm_runtime.h>   /* For runtime PM */
+#include <linux/pinctrl/consumer.h> /* For the sleep pin state */
+#include <linux/workqueue.h>    /* For the waveform idle request */
+
+#include "gpio_control.h"       /* Shared event and IOCTL definitions */
+#include "gpio_status.h"        /* /proc/gpio_ctl_status */
+
+#define CREATE_TRACE_POINTS
+#include "led_trace.h"          /* LED change tracepoint */
 
 /* Device name and class definitions */
 #define DEVICE_NAME "gpio_led"
 #define DEVICE_CLASS "gpio_led_class"
 #define NUM_DEVICES 3           /* Number of LED devices */
+#define LED_MASK_ALL GENMASK(NUM_DEVICES - 1, 0)
+#define LED_EVENT_RING_SIZE 256 /* Event queue entries, power of two */
+#define LED_EVENT_RING_MASK (LED_EVENT_RING_SIZE - 1)
+#define LED_READ_BATCH 16       /* Events copied per lock hold in read */
+#define LED_AUTOSUSPEND_MS 2000 /* Idle time with all LEDs off before runtime suspend */
 
 /* IOCTL command definitions */
 #define GPIO_IOC_MAGIC 'k'      /* Magic number for IOCTL */
@@ -22,6 +51,7 @@
 #define GPIO_IOC_GET_STATUS _IOR(GPIO_IOC_MAGIC, 4, int) /* Get LED status */
 
 /* GPIO and state tracking variables */
+static struct gpio_descs *led_descs;              /* All LEDs, for array writes */
 static struct gpio_desc *led_gpio[NUM_DEVICES];   /* GPIO descriptors for LEDs */
 static bool led_state[NUM_DEVICES] = {false, false, false}; /* LED states */
 
@@ -31,6 +61,32 @@ static struct class *dev_class; /* Device class */
 static struct cdev led_cdev[NUM_DEVICES];    /* Character device structures */
 static struct device *led_device[NUM_DEVICES]; /* Device structures */
 
+/* Single LED commands from write() and the LED ioctls */
+enum led_cmd {
+    LED_CMD_OFF,
+    LED_CMD_ON,
+    LED_CMD_TOGGLE,
+};
+
+/*
+ * LED change events, one queue for all LEDs. Every level change goes
+ * through led_bank_write() or the waveform timer, which publish it here
+ */
+static struct led_event led_event_ring[LED_EVENT_RING_SIZE];
+static u64 led_event_seq;                 /* Last assigned sequence number */
+static DEFINE_SPINLOCK(led_event_lock);
+static DECLARE_WAIT_QUEUE_HEAD(led_event_wait);
+static DEFINE_MUTEX(led_set_lock);        /* Serializes process context LED writes */
+static struct device *led_pm_dev;         /* Platform device, for runtime PM */
+static bool led_asleep;                   /* System suspended, under led_set_lock */
+
+/* Per-LED change counters for the status file, written in led_publish() */
+static struct {
+    u64 changes;
+    u64 last_change_ns;
+} led_stat[NUM_DEVICES];
+static seqcount_spinlock_t led_stat_seq = SEQCNT_SPINLOCK_ZERO(led_stat_seq, &led_event_lock);
+
 /* LED device information structure */
 struct my_led {
     const char *name;   /* LED name (green/white/yellow) */
@@ -38,18 +94,121 @@ struct my_led {
 };
 
 /* LED device configurations */
+/* Per-open-file state */
+struct led_file {
+    struct my_led *led;                   /* LED of this minor */
+    struct mutex lock;                    /* Serializes event reads on one file */
+    bool event_mode;                      /* read() returns struct led_event */
+    u64 next_seq;                         /* Next sequence number to return */
+    /* Filter, changed and applied under led_event_lock */
+    u32 filter_types;                     /* Bit N = deliver type N, 0 = all */
+    u32 filter_leds;                      /* LEDs of interest, 0 = all */
+    u64 min_interval_ns;                  /* Rate limit, 0 = off */
+    u64 last_delivered;                   /* Timestamp of the last event passed */
+};
+
 static struct my_led leds[NUM_DEVICES] = {
     { .name = "green_led" , .index = 0},   /* Green LED */
     { .name = "white_led" , .index = 1},   /* White LED */
     { .name = "yellow_led" , .index = 2},  /* Yellow LED */
 };
 
+/* Waveform playback buffer states */
+enum wave_buf_state {
+    WAVE_FREE,          /* Can be filled by LED_IOC_WAVE_QUEUE */
+    WAVE_FILLING,       /* Being copied from userspace */
+    WAVE_READY,         /* Queued behind the playing buffer */
+    WAVE_PLAYING,       /* Owned by the playback timer */
+};
+
+struct wave_buf {
+    struct led_wave_step steps[LED_WAVE_MAX_STEPS];
+    u32 count;
+    u32 flags;
+    u32 seq;            /* Queue order, lower plays first */
+    enum wave_buf_state state;
+};
+
+/*
+ * Waveform playback state. Two buffers let userspace refill one while
+ * the hrtimer plays the other, so long sequences stream without gaps
+ */
+static struct {
+    struct wave_buf buf[2];
+    struct hrtimer timer;
+    ktime_t next;       /* Absolute time of the next transition */
+    int play;           /* Buffer being played */
+    u32 pos;            /* Next step in the playing buffer */
+    u32 queue_seq;
+    bool running;
+    struct led_wave_stats stats;
+    u64 late_sum;
+    struct work_struct idle_work;   /* Lets the bank idle once playback ends by itself */
+} wave;
+static DEFINE_SPINLOCK(wave_lock);
+static DECLARE_WAIT_QUEUE_HEAD(wave_wait);
+
+/* Operations timed by the syscall path instrumentation */
+enum led_op {
+    LED_OP_READ,
+    LED_OP_WRITE,
+    LED_OP_IOC_ON,
+    LED_OP_IOC_OFF,
+    LED_OP_IOC_TOGGLE,
+    LED_OP_IOC_GET_STATUS,
+    LED_OP_IOC_WAVE_QUEUE,
+    LED_OP_IOC_WAVE_START,
+    LED_OP_IOC_WAVE_STOP,
+    LED_OP_IOC_WAVE_STATS,
+    LED_OP_IOC_OTHER,
+    LED_OP_URING,
+    LED_OP_COUNT,
+};
+
+static const char *const led_op_names[LED_OP_COUNT] = {
+    [LED_OP_READ]           = "read",
+    [LED_OP_WRITE]          = "write",
+    [LED_OP_IOC_ON]         = "ioctl_on",
+    [LED_OP_IOC_OFF]        = "ioctl_off",
+    [LED_OP_IOC_TOGGLE]     = "ioctl_toggle",
+    [LED_OP_IOC_GET_STATUS] = "ioctl_get_status",
+    [LED_OP_IOC_WAVE_QUEUE] = "ioctl_wave_queue",
+    [LED_OP_IOC_WAVE_START] = "ioctl_wave_start",
+    [LED_OP_IOC_WAVE_STOP]  = "ioctl_wave_stop",
+    [LED_OP_IOC_WAVE_STATS] = "ioctl_wave_stats",
+    [LED_OP_IOC_OTHER]      = "ioctl_other",
+    [LED_OP_URING]          = "uring_cmd",
+};
+
+#define LED_TIMING_BUCKETS 32   /* Bucket 0 counts 0 ns, bucket N counts [2^(N-1), 2^N) ns */
+
+struct led_op_timing {
+    u64 count;
+    u64 sum_ns;
+    u64 max_ns;
+    u32 hist[LED_TIMING_BUCKETS];
+};
+
+/*
+ * Per-CPU so concurrent callers never share a cache line. Only updated
+ * from process context with preemption off; debugfs sums the CPUs without
+ * locking, so a read racing an update can be off by the op in flight
+ */
+struct led_timing {
+    struct led_op_timing op[LED_OP_COUNT];
+};
+static DEFINE_PER_CPU(struct led_timing, led_timing);
+static DEFINE_STATIC_KEY_FALSE(led_timing_enabled);
+static struct dentry *led_debugfs_dir;
+
 /* Function prototypes for file operations */
 static int led_open(struct inode *, struct file *);
 static int led_release(struct inode *, struct file *);
 static ssize_t led_read(struct file *, char __user *, size_t, loff_t *);
 static ssize_t led_write(struct file *, const char __user *, size_t, loff_t *);
 static long led_ioctl(struct file *, unsigned int, unsigned long);
+static __poll_t led_poll(struct file *, poll_table *);
+static int led_uring_cmd(struct io_uring_cmd *, unsigned int);
 
 /* File operations structure */
 static struct file_operations fops = {
@@ -59,35 +218,652 @@ static struct file_operations fops = {
     .read = led_read,
     .write = led_write,
     .unlocked_ioctl = led_ioctl,
+    .poll = led_poll,
+    .uring_cmd = led_uring_cmd,
+};
+
+/* Device tree matching table, also checked by led_provider_get() */
+static const struct of_device_id led_of_match[] = {
+    { .compatible = "custom,gpio-led" },
+    { }    
 };
 
+MODULE_DEVICE_TABLE(of, led_of_match);
+
+/*
+ * Bound LED device, set at the end of probe and cleared first thing in
+ * remove. Consumers look the LEDs up through led_provider_get()
+ */
+static struct device *led_provider;
+static DEFINE_MUTEX(led_provider_lock);
+
+/*
+ * Bind a consumer driver such as button_driver to the LEDs
+ * @consumer: device of the calling driver, must be probing
+ * @np: LED node the consumer points at, or NULL for any
+ *
+ * A device link is added so the driver core unbinds the consumer before
+ * the LEDs go away, and drops it again if the consumer probe fails.
+ * The consumer then drives the LEDs with led_provider_set(), so its
+ * changes are published to LED event readers like any other.
+ * Returns: 0, -EPROBE_DEFER until the LED device has probed, -ENODEV if
+ * @np is not a node this driver binds to or another one is bound, or -errno
+ */
+int led_provider_get(struct device *consumer, struct device_node *np)
+{
+    int ret = 0;
+
+    mutex_lock(&led_provider_lock);
+    if (!led_provider) {
+        /* Only worth waiting for a node that led_driver will bind */
+        if (np && (!of_match_node(led_of_match, np) || !of_device_is_available(np)))
+            ret = -ENODEV;
+        else
+            ret = -EPROBE_DEFER;
+        goto out;
+    }
+    if (np && led_provider->of_node != np) {
+        /* Single instance, bound to another node */
+        ret = -ENODEV;
+        goto out;
+    }
+    if (!device_link_add(consumer, led_provider, DL_FLAG_AUTOREMOVE_CONSUMER))
+        ret = -EINVAL;
+out:
+    mutex_unlock(&led_provider_lock);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(led_provider_get);
+
+/*
+ * Current LED levels as a bitmask, bit N = LED N
+ */
+static u32 led_current_mask(void)
+{
+    u32 mask = 0;
+    int i;
+
+    for (i = 0; i < NUM_DEVICES; i++) {
+        if (led_state[i])
+            mask |= BIT(i);
+    }
+    return mask;
+}
+
+/*
+ * Queue a change event if any LED level differs and wake readers
+ * Callable from any context, including the hard IRQ waveform timer
+ */
+static void led_publish(u32 before, u32 after, u16 source)
+{
+    struct led_event *ev;
+    unsigned long flags, changed = before ^ after;
+    int i;
+
+    if (before == after)
+        return;
+
+    spin_lock_irqsave(&led_event_lock, flags);
+    ev = &led_event_ring[++led_event_seq & LED_EVENT_RING_MASK];
+    ev->seq = led_event_seq;
+    ev->timestamp = ktime_get_ns();
+    ev->type = LED_EV_CHANGE;
+    ev->source = source;
+    ev->changed = before ^ after;
+    ev->value = after;
+    ev->reserved = 0;
+    trace_led_change(ev->seq, source, ev->changed, after);
+
+    write_seqcount_begin(&led_stat_seq);
+    for_each_set_bit(i, &changed, NUM_DEVICES) {
+        led_stat[i].changes++;
+        led_stat[i].last_change_ns = ev->timestamp;
+    }
+    write_seqcount_end(&led_stat_seq);
+    spin_unlock_irqrestore(&led_event_lock, flags);
+
+    wake_up_interruptible(&led_event_wait);
+}
+
+/*
+ * Drive every LED with one array write, runtime resuming the bank first
+ * Called with led_set_lock held
+ */
+static void led_hw_write(unsigned long bits)
+{
+    int ret;
+
+    lockdep_assert_held(&led_set_lock);
+
+    ret = pm_runtime_resume_and_get(led_pm_dev);
+    if (ret < 0)
+        dev_warn_ratelimited(led_pm_dev, "Runtime resume failed: %d\n", ret);
+    gpiod_set_array_value_cansleep(led_descs->ndescs, led_descs->desc, led_descs->info, &bits);
+    if (ret >= 0) {
+        pm_runtime_mark_last_busy(led_pm_dev);
+        pm_runtime_put_autosuspend(led_pm_dev);
+    }
+}
+
+/*
+ * Set the LEDs in @mask to the matching bits of @value
+ * All LEDs are written with one array write, then the change is published.
+ * While the system is suspended only led_state changes, resume writes it
+ * Called with led_set_lock held
+ * Returns: the new LED bitmask
+ */
+static u32 led_bank_write(u32 mask, u32 value, u16 source)
+{
+    u32 before = led_current_mask();
+    unsigned long bits = (before & ~mask) | (value & mask);
+    int i;
+
+    lockdep_assert_held(&led_set_lock);
+
+    if (!led_asleep)
+        led_hw_write(bits);
+    for (i = 0; i < NUM_DEVICES; i++)
+        led_state[i] = bits & BIT(i);
+    led_publish(before, bits, source);
+    return bits;
+}
+
+/*
+ * Apply an on/off/toggle command to one LED from write() or ioctl()
+ * Returns: the new level of the LED, or -EBUSY while a waveform is playing
+ */
+static int led_apply(int index, enum led_cmd cmd)
+{
+    u32 bit = BIT(index);
+    u32 value;
+
+    mutex_lock(&led_set_lock);
+    if (READ_ONCE(wave.running)) {
+        mutex_unlock(&led_set_lock);
+        return -EBUSY;
+    }
+    switch (cmd) {
+        case LED_CMD_ON:     value = bit; break;
+        case LED_CMD_OFF:    value = 0; break;
+        default:             value = ~led_current_mask(); break;
+    }
+    value = led_bank_write(bit, value, LED_SRC_FILE);
+    mutex_unlock(&led_set_lock);
+
+    return !!(value & bit);
+}
+
+/*
+ * Drive LEDs on behalf of a consumer bound with led_provider_get()
+ * @mask:  LEDs to change, bit N = LED N
+ * @value: New levels of those LEDs
+ * Process context only. Returns: 0, -EBUSY while a waveform is playing,
+ * -ENODEV when no LED device is bound
+ */
+int led_provider_set(u32 mask, u32 value)
+{
+    int ret = 0;
+
+    mutex_lock(&led_provider_lock);
+    if (!led_provider) {
+        ret = -ENODEV;
+        goto out;
+    }
+    mutex_lock(&led_set_lock);
+    if (READ_ONCE(wave.running))
+        ret = -EBUSY;
+    else
+        led_bank_write(mask & LED_MASK_ALL, value, LED_SRC_PROVIDER);
+    mutex_unlock(&led_set_lock);
+out:
+    mutex_unlock(&led_provider_lock);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(led_provider_set);
+
+/*
+ * Start timing a file operation
+ * Returns: start timestamp, or 0 while timing is off. With the key
+ * disabled this is a single patched-out jump
+ */
+static __always_inline u64 led_timing_start(void)
+{
+    if (static_branch_unlikely(&led_timing_enabled))
+        return ktime_get_ns();
+    return 0;
+}
+
+/*
+ * Account one operation started at @start into this CPU's histogram
+ */
+static void led_timing_record(enum led_op op, u64 start)
+{
+    u64 ns = ktime_get_ns() - start;
+    int bucket = min_t(int, fls64(ns), LED_TIMING_BUCKETS - 1);
+    struct led_op_timing *t = &get_cpu_ptr(&led_timing)->op[op];
+
+    t->count++;
+    t->sum_ns += ns;
+    if (ns > t->max_ns)
+        t->max_ns = ns;
+    t->hist[bucket]++;
+    put_cpu_ptr(&led_timing);
+}
+
+/*
+ * Timing class of an ioctl command
+ */
+static enum led_op led_ioctl_op(unsigned int cmd)
+{
+    switch (cmd) {
+        case GPIO_IOC_LED_ON:       return LED_OP_IOC_ON;
+        case GPIO_IOC_LED_OFF:      return LED_OP_IOC_OFF;
+        case GPIO_IOC_LED_TOGGLE:   return LED_OP_IOC_TOGGLE;
+        case GPIO_IOC_GET_STATUS:   return LED_OP_IOC_GET_STATUS;
+        case LED_IOC_WAVE_QUEUE:    return LED_OP_IOC_WAVE_QUEUE;
+        case LED_IOC_WAVE_START:    return LED_OP_IOC_WAVE_START;
+        case LED_IOC_WAVE_STOP:     return LED_OP_IOC_WAVE_STOP;
+        case LED_IOC_WAVE_STATS:    return LED_OP_IOC_WAVE_STATS;
+        default:                    return LED_OP_IOC_OTHER;
+    }
+}
+
+/*
+ * debugfs "timing": per operation count, mean, max and the non-empty
+ * log2 buckets, summed over all CPUs
+ */
+static int led_timing_show(struct seq_file *s, void *unused)
+{
+    struct led_op_timing sum;
+    int op, cpu, b;
+
+    seq_printf(s, "timing %s\n", static_key_enabled(&led_timing_enabled) ? "on" : "off");
+    for (op = 0; op < LED_OP_COUNT; op++) {
+        memset(&sum, 0, sizeof(sum));
+        for_each_possible_cpu(cpu) {
+            const struct led_op_timing *t = &per_cpu_ptr(&led_timing, cpu)->op[op];
+
+            sum.count += t->count;
+            sum.sum_ns += t->sum_ns;
+            sum.max_ns = max(sum.max_ns, t->max_ns);
+            for (b = 0; b < LED_TIMING_BUCKETS; b++)
+                sum.hist[b] += t->hist[b];
+        }
+        if (!sum.count)
+            continue;
+
+        seq_printf(s, "%s count %llu mean_ns %llu max_ns %llu\n", led_op_names[op],
+                   sum.count, div64_u64(sum.sum_ns, sum.count), sum.max_ns);
+        for (b = 0; b < LED_TIMING_BUCKETS; b++) {
+            if (sum.hist[b])
+                seq_printf(s, "  < %llu ns: %u\n", b ? 1ULL << b : 1ULL, sum.hist[b]);
+        }
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(led_timing);
+
+/*
+ * debugfs "timing_enable": 1 patches the timing calls in, 0 out
+ */
+static int led_timing_enable_get(void *data, u64 *val)
+{
+    *val = static_key_enabled(&led_timing_enabled);
+    return 0;
+}
+
+static int led_timing_enable_set(void *data, u64 val)
+{
+    if (val)
+        static_branch_enable(&led_timing_enabled);
+    else
+        static_branch_disable(&led_timing_enabled);
+    return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(led_timing_enable_fops, led_timing_enable_get,
+                         led_timing_enable_set, "%llu\n");
+
+/*
+ * debugfs "timing_reset": any write clears the histograms
+ */
+static int led_timing_reset_set(void *data, u64 val)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(&led_timing, cpu), 0, sizeof(struct led_timing));
+    return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(led_timing_reset_fops, NULL, led_timing_reset_set, "%llu\n");
+
+/*
+ * One /proc/gpio_ctl_status line per LED:
+ * on, changes, last_change_ns and wave (waveform playing)
+ */
+static void led_status_show(struct seq_file *m)
+{
+    u64 changes[NUM_DEVICES], last[NUM_DEVICES];
+    unsigned int seq;
+    int i;
+
+    do {
+        seq = read_seqcount_begin(&led_stat_seq);
+        for (i = 0; i < NUM_DEVICES; i++) {
+            changes[i] = led_stat[i].changes;
+            last[i] = led_stat[i].last_change_ns;
+        }
+    } while (read_seqcount_retry(&led_stat_seq, seq));
+
+    for (i = 0; i < NUM_DEVICES; i++)
+        seq_printf(m, "driver=led_driver dev=%s%d name=%s on=%d changes=%llu last_change_ns=%llu wave=%d\n",
+                   DEVICE_NAME, i, leds[i].name, READ_ONCE(led_state[i]), changes[i], last[i],
+                   READ_ONCE(wave.running));
+}
+
+static struct gpio_status_source led_status_source = {
+    .show = led_status_show,
+};
+
+static void led_debugfs_init(void)
+{
+    led_debugfs_dir = debugfs_create_dir(DEVICE_NAME, NULL);
+    debugfs_create_file("timing", 0444, led_debugfs_dir, NULL, &led_timing_fops);
+    debugfs_create_file_unsafe("timing_enable", 0644, led_debugfs_dir, NULL,
+                               &led_timing_enable_fops);
+    debugfs_create_file_unsafe("timing_reset", 0200, led_debugfs_dir, NULL,
+                               &led_timing_reset_fops);
+}
+
+/*
+ * Drive all LEDs from one bitmask with a single array write
+ * Called from the playback timer in hard IRQ context
+ */
+static void led_wave_apply(u32 value)
+{
+    unsigned long bits = value & LED_MASK_ALL;
+    u32 before = led_current_mask();
+    int i;
+
+    gpiod_set_array_value(led_descs->ndescs, led_descs->desc, led_descs->info, &bits);
+    for (i = 0; i < NUM_DEVICES; i++)
+        led_state[i] = value & BIT(i);
+    led_publish(before, bits, LED_SRC_WAVE);
+}
+
+/*
+ * Record how late a transition was issued
+ */
+static void led_wave_account(u64 late)
+{
+    struct led_wave_stats *st = &wave.stats;
+    u64 us = div_u64(late, NSEC_PER_USEC);
+    int bucket = us ? min_t(int, ilog2(us) + 1, ARRAY_SIZE(st->late_hist) - 1) : 0;
+
+    if (!st->transitions || late < st->late_min_ns)
+        st->late_min_ns = late;
+    if (late > st->late_max_ns)
+        st->late_max_ns = late;
+    wave.late_sum += late;
+    st->transitions++;
+    st->late_hist[bucket]++;
+}
+
+/*
+ * Find the READY buffer queued first, or -1
+ * Called with wave_lock held
+ */
+static int led_wave_next_ready(void)
+{
+    int i, best = -1;
+
+    for (i = 0; i < 2; i++) {
+        if (wave.buf[i].state == WAVE_READY &&
+            (best < 0 || (s32)(wave.buf[i].seq - wave.buf[best].seq) < 0))
+            best = i;
+    }
+    return best;
+}
+
+/*
+ * Playback timer: issue one transition and schedule the next one
+ * Switches to the other buffer without a gap when it is ready
+ */
+static enum hrtimer_restart led_wave_timer_fn(struct hrtimer *timer)
+{
+    struct wave_buf *buf;
+    ktime_t now = ktime_get();
+    unsigned long flags;
+    int next;
+
+    spin_lock_irqsave(&wave_lock, flags);
+    if (!wave.running) {
+        spin_unlock_irqrestore(&wave_lock, flags);
+        return HRTIMER_NORESTART;
+    }
+
+    buf = &wave.buf[wave.play];
+    led_wave_apply(buf->steps[wave.pos].value);
+    led_wave_account(ktime_after(now, wave.next) ? ktime_to_ns(ktime_sub(now, wave.next)) : 0);
+
+    if (++wave.pos == buf->count) {
+        /* Buffer done, hand it back and continue with the queued one */
+        buf->state = WAVE_FREE;
+        wave.stats.buffers++;
+        wake_up_interruptible(&wave_wait);
+
+        next = led_wave_next_ready();
+        if (next < 0) {
+            if (buf->flags & LED_WAVE_MORE)
+                wave.stats.underruns++;
+            wave.running = false;
+            spin_unlock_irqrestore(&wave_lock, flags);
+            schedule_work(&wave.idle_work);
+            return HRTIMER_NORESTART;
+        }
+        wave.play = next;
+        wave.pos = 0;
+        wave.buf[next].state = WAVE_PLAYING;
+        buf = &wave.buf[next];
+    }
+
+    wave.next = ktime_add_ns(wave.next, buf->steps[wave.pos].delta_ns);
+    hrtimer_set_expires(timer, wave.next);
+    spin_unlock_irqrestore(&wave_lock, flags);
+    return HRTIMER_RESTART;
+}
+
+/*
+ * Playback ended on its own. Runtime suspend was refused with -EBUSY
+ * while it played and is not retried, so ask for it again. A work item
+ * because the timer runs in hard IRQ context
+ */
+static void led_wave_idle_work(struct work_struct *work)
+{
+    pm_runtime_mark_last_busy(led_pm_dev);
+    pm_request_autosuspend(led_pm_dev);
+}
+
+/*
+ * Copy a waveform into a free buffer, waiting for one unless non-blocking
+ */
+static int led_wave_queue(struct file *file, unsigned long arg)
+{
+    struct led_wave_buffer req;
+    struct wave_buf *buf = NULL;
+    unsigned long flags;
+    int i, ret;
+
+    if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+        return -EFAULT;
+    if (req.count == 0 || req.count > LED_WAVE_MAX_STEPS)
+        return -EINVAL;
+
+    for (;;) {
+        spin_lock_irqsave(&wave_lock, flags);
+        for (i = 0; i < 2; i++) {
+            if (wave.buf[i].state == WAVE_FREE) {
+                buf = &wave.buf[i];
+                buf->state = WAVE_FILLING;
+                break;
+            }
+        }
+        spin_unlock_irqrestore(&wave_lock, flags);
+        if (buf)
+            break;
+
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(wave_wait,
+                                       READ_ONCE(wave.buf[0].state) == WAVE_FREE ||
+                                       READ_ONCE(wave.buf[1].state) == WAVE_FREE);
+        if (ret)
+            return ret;
+    }
+
+    if (copy_from_user(buf->steps, u64_to_user_ptr(req.steps), req.count * sizeof(buf->steps[0]))) {
+        ret = -EFAULT;
+        goto release;
+    }
+
+    /* Shorter steps would re-arm the timer in the past, back to back in hard IRQ */
+    for (i = 0; i < req.count; i++) {
+        if (buf->steps[i].delta_ns < LED_WAVE_MIN_DELTA_NS) {
+            ret = -EINVAL;
+            goto release;
+        }
+    }
+
+    spin_lock_irqsave(&wave_lock, flags);
+    buf->count = req.count;
+    buf->flags = req.flags;
+    buf->seq = wave.queue_seq++;
+    buf->state = WAVE_READY;
+    spin_unlock_irqrestore(&wave_lock, flags);
+    return 0;
+
+release:
+    /* Hand the buffer back to writers waiting for one */
+    spin_lock_irqsave(&wave_lock, flags);
+    buf->state = WAVE_FREE;
+    spin_unlock_irqrestore(&wave_lock, flags);
+    wake_up_interruptible(&wave_wait);
+    return ret;
+}
+
 /*
- * Export GPIO access function for button driver
- * @index: LED index (0-2)
- * Returns: GPIO descriptor pointer or NULL if invalid index
+ * Start playing the oldest queued buffer
  */
-struct gpio_desc *led_get_gpio(int index) {
-    if(index >= 0 && index < NUM_DEVICES){
-        return led_gpio[index];
+static int led_wave_start(void)
+{
+    unsigned long flags;
+    int next, i, ret;
+
+    for (i = 0; i < NUM_DEVICES; i++) {
+        if (gpiod_cansleep(led_gpio[i]))
+            return -EOPNOTSUPP;
     }
-    return NULL;
+
+    /* Resume the bank; once running, the waveform keeps it from idling */
+    ret = pm_runtime_resume_and_get(led_pm_dev);
+    if (ret < 0)
+        return ret;
+
+    /* Under led_set_lock, so process context writers see running change atomically */
+    mutex_lock(&led_set_lock);
+    spin_lock_irqsave(&wave_lock, flags);
+    if (wave.running) {
+        ret = -EBUSY;
+        goto out;
+    }
+    next = led_wave_next_ready();
+    if (next < 0) {
+        ret = -ENODATA;
+        goto out;
+    }
+
+    memset(&wave.stats, 0, sizeof(wave.stats));
+    wave.late_sum = 0;
+    wave.play = next;
+    wave.pos = 0;
+    wave.buf[next].state = WAVE_PLAYING;
+    wave.next = ktime_add_ns(ktime_get(), wave.buf[next].steps[0].delta_ns);
+    wave.running = true;
+    hrtimer_start(&wave.timer, wave.next, HRTIMER_MODE_ABS_HARD);
+    ret = 0;
+out:
+    spin_unlock_irqrestore(&wave_lock, flags);
+    mutex_unlock(&led_set_lock);
+    pm_runtime_mark_last_busy(led_pm_dev);
+    pm_runtime_put_autosuspend(led_pm_dev);
+
+    if (!ret)
+        pr_info("Waveform playback started\n");
+    return ret;
+}
+
+/*
+ * Stop playback and drop everything queued
+ */
+static void led_wave_stop(void)
+{
+    unsigned long flags;
+    int i;
+
+    spin_lock_irqsave(&wave_lock, flags);
+    wave.running = false;
+    spin_unlock_irqrestore(&wave_lock, flags);
+
+    hrtimer_cancel(&wave.timer);
+
+    spin_lock_irqsave(&wave_lock, flags);
+    for (i = 0; i < 2; i++) {
+        if (wave.buf[i].state != WAVE_FILLING)
+            wave.buf[i].state = WAVE_FREE;
+    }
+    spin_unlock_irqrestore(&wave_lock, flags);
+    wake_up_interruptible(&wave_wait);
+
+    /* The bank may idle again if the waveform left every LED off */
+    pm_runtime_mark_last_busy(led_pm_dev);
+    pm_request_autosuspend(led_pm_dev);
+}
+
+/*
+ * Snapshot playback statistics
+ */
+static void led_wave_get_stats(struct led_wave_stats *st)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&wave_lock, flags);
+    *st = wave.stats;
+    st->late_mean_ns = st->transitions ? div64_u64(wave.late_sum, st->transitions) : 0;
+    st->running = wave.running;
+    spin_unlock_irqrestore(&wave_lock, flags);
 }
-EXPORT_SYMBOL(led_get_gpio);
 
 /*
  * Open file operation
- * Validates minor number and stores LED info in private_data
+ * Validates minor number and allocates the per-file state
+ * Files start in text status mode
  */
 static int led_open(struct inode *inode, struct file *file){
     int minor = iminor(inode);
+    struct led_file *lf;
 
     if (minor >= NUM_DEVICES) {
         pr_err("Invalid minor number: %d\n", minor);
         return -ENODEV;
     }
 
+    lf = kzalloc(sizeof(*lf), GFP_KERNEL);
+    if (!lf)
+        return -ENOMEM;
+    lf->led = &leds[minor];
+    mutex_init(&lf->lock);
+
     pr_info("Opening led %s (minor %d)\n", leds[minor].name, minor);
-    file->private_data = &leds[minor];
+    file->private_data = lf;
     return 0;
 }
 
@@ -98,6 +874,152 @@ static int led_open(struct inode *inode, struct file *file){
 static int led_release(struct inode *inode, struct file *file){
     int minor = iminor(inode);
     pr_info("Releasing led %s (minor %d)\n", leds[minor].name, minor);
+    kfree(file->private_data);
+    return 0;
+}
+
+/*
+ * Check an event against the reader's filter
+ * Called with led_event_lock held
+ */
+static bool led_filter_pass(const struct led_file *lf, const struct led_event *ev)
+{
+    if (lf->filter_types && !(lf->filter_types & BIT(ev->type)))
+        return false;
+    if (lf->filter_leds && !(ev->changed & lf->filter_leds))
+        return false;
+    if (lf->min_interval_ns && lf->last_delivered &&
+        ev->timestamp - lf->last_delivered < lf->min_interval_ns)
+        return false;
+    return true;
+}
+
+/*
+ * Step the reader's cursor over queued events its filter rejects, so
+ * poll and blocking reads only wake up for events it will get
+ * Called with led_event_lock held
+ */
+static void led_skip_filtered(struct led_file *lf)
+{
+    /* A lapped reader is handled by the OVERRUN path in led_fetch_events */
+    if (led_event_seq >= LED_EVENT_RING_SIZE && lf->next_seq <= led_event_seq - LED_EVENT_RING_SIZE)
+        return;
+    while (lf->next_seq <= led_event_seq &&
+           !led_filter_pass(lf, &led_event_ring[lf->next_seq & LED_EVENT_RING_MASK]))
+        lf->next_seq++;
+}
+
+/*
+ * True when the reader has queued events it has not consumed yet
+ * Both sequence numbers are u64, only read under led_event_lock so
+ * 32-bit builds cannot see them torn
+ */
+static bool led_event_ready(struct led_file *lf)
+{
+    unsigned long flags;
+    bool ready;
+
+    spin_lock_irqsave(&led_event_lock, flags);
+    if (lf->filter_types || lf->filter_leds || lf->min_interval_ns)
+        led_skip_filtered(lf);
+    ready = lf->next_seq <= led_event_seq;
+    spin_unlock_irqrestore(&led_event_lock, flags);
+    return ready;
+}
+
+/*
+ * Copy up to @max events for a reader out of the queue
+ * Events the reader's filter rejects are skipped without being copied.
+ * A reader that was lapped gets one OVERRUN event carrying the lost count
+ * Returns: number of events stored in @out
+ */
+static int led_fetch_events(struct led_file *lf, struct led_event *out, int max)
+{
+    const struct led_event *ev;
+    unsigned long flags;
+    u64 lost;
+    int n = 0;
+
+    spin_lock_irqsave(&led_event_lock, flags);
+    if (led_event_seq >= LED_EVENT_RING_SIZE && lf->next_seq <= led_event_seq - LED_EVENT_RING_SIZE) {
+        lost = led_event_seq - LED_EVENT_RING_SIZE + 1 - lf->next_seq;
+        memset(&out[n], 0, sizeof(out[n]));
+        out[n].seq = lf->next_seq;
+        out[n].timestamp = ktime_get_ns();
+        out[n].type = LED_EV_OVERRUN;
+        out[n].changed = lost;
+        out[n].value = led_current_mask();
+        lf->next_seq += lost;
+        n++;
+    }
+    while (n < max && lf->next_seq <= led_event_seq) {
+        ev = &led_event_ring[lf->next_seq & LED_EVENT_RING_MASK];
+        if (led_filter_pass(lf, ev)) {
+            out[n++] = *ev;
+            lf->last_delivered = ev->timestamp;
+        }
+        lf->next_seq++;
+    }
+    spin_unlock_irqrestore(&led_event_lock, flags);
+
+    return n;
+}
+
+/*
+ * Event mode read - returns whole struct led_event records, as many as fit
+ * Blocks until at least one event is queued unless O_NONBLOCK
+ */
+static ssize_t led_read_events(struct file *file, char __user *buffer, size_t len)
+{
+    struct led_file *lf = file->private_data;
+    struct led_event batch[LED_READ_BATCH];
+    size_t copied = 0, bytes;
+    int n, ret;
+
+    if (len < sizeof(batch[0]))
+        return -EINVAL;
+
+    mutex_lock(&lf->lock);
+    for (;;) {
+        while (copied + sizeof(batch[0]) <= len) {
+            n = led_fetch_events(lf, batch,
+                                 min_t(size_t, LED_READ_BATCH, (len - copied) / sizeof(batch[0])));
+            if (!n)
+                break;
+            bytes = n * sizeof(batch[0]);
+            if (copy_to_user(buffer + copied, batch, bytes)) {
+                mutex_unlock(&lf->lock);
+                return copied ? copied : -EFAULT;
+            }
+            copied += bytes;
+        }
+        if (copied || (file->f_flags & O_NONBLOCK))
+            break;
+
+        mutex_unlock(&lf->lock);
+        ret = wait_event_interruptible(led_event_wait, led_event_ready(lf));
+        if (ret)
+            return ret;
+        mutex_lock(&lf->lock);
+    }
+    mutex_unlock(&lf->lock);
+
+    return copied ? copied : -EAGAIN;
+}
+
+/*
+ * Poll file operation - readable when an event mode file has unread events
+ */
+static __poll_t led_poll(struct file *file, poll_table *wait)
+{
+    struct led_file *lf = file->private_data;
+
+    if (!lf->event_mode)
+        return EPOLLIN | EPOLLRDNORM;
+
+    poll_wait(file, &led_event_wait, wait);
+    if (led_event_ready(lf))
+        return EPOLLIN | EPOLLRDNORM;
     return 0;
 }
 
@@ -108,49 +1030,59 @@ static int led_release(struct inode *inode, struct file *file){
  * '0' - Turn LED off
  * 't' - Toggle LED state
  */
-static ssize_t led_write(struct file *file, const char __user *buffer, size_t len, loff_t *off)
+static ssize_t led_do_write(struct file *file, const char __user *buffer, size_t len, loff_t *off)
 {
     char cmd;
-    struct my_led *dev = file->private_data;
+    struct led_file *lf = file->private_data;
+    struct my_led *dev = lf->led;
     int led_index = dev->index;
+    enum led_cmd op;
+    int ret;
 
     if (len < 1 || copy_from_user(&cmd, buffer, 1))
         return -EFAULT;
 
     switch (cmd) {
-        case '1':
-            led_state[led_index] = true;
-            gpiod_set_value(led_gpio[led_index], 1);
-            pr_info("Led %s is ON\n", dev->name);
-            break;
-        case '0':
-            led_state[led_index] = false;
-            gpiod_set_value(led_gpio[led_index], 0);
-            pr_info("Led %s is OFF\n", dev->name);
-            break;
-        case 't':
-            led_state[led_index] = !led_state[led_index];
-            gpiod_set_value(led_gpio[led_index], led_state[led_index]);
-            pr_info("Led %s is %s\n", dev->name, led_state[led_index] ? "ON" : "OFF");
-            break;
+        case '1': op = LED_CMD_ON; break;
+        case '0': op = LED_CMD_OFF; break;
+        case 't': op = LED_CMD_TOGGLE; break;
         default:
             pr_err("Invalid command: %c\n", cmd);
             return -EINVAL;
     }
+
+    ret = led_apply(led_index, op);
+    if (ret < 0)
+        return ret;
+    pr_info("Led %s is %s\n", dev->name, ret ? "ON" : "OFF");
     return len;
 }
 
+static ssize_t led_write(struct file *file, const char __user *buffer, size_t len, loff_t *off)
+{
+    u64 start = led_timing_start();
+    ssize_t ret = led_do_write(file, buffer, len, off);
+
+    if (start)
+        led_timing_record(LED_OP_WRITE, start);
+    return ret;
+}
+
 /*
  * Read file operation
- * Returns current LED state as string
+ * Returns current LED state as string, or events in event mode
  */
-static ssize_t led_read(struct file *file, char __user *buffer, size_t len, loff_t *offset)
+static ssize_t led_do_read(struct file *file, char __user *buffer, size_t len, loff_t *offset)
 {
     char status_msg[100];
     int msg_len;
-    struct my_led *dev = file->private_data;
+    struct led_file *lf = file->private_data;
+    struct my_led *dev = lf->led;
     int led_index = dev->index;
 
+    if (lf->event_mode)
+        return led_read_events(file, buffer, len);
+
     if(*offset != 0)
         return 0;
 
@@ -166,6 +1098,16 @@ static ssize_t led_read(struct file *file, char __user *buffer, size_t len, loff
     return msg_len;
 }
 
+static ssize_t led_read(struct file *file, char __user *buffer, size_t len, loff_t *offset)
+{
+    u64 start = led_timing_start();
+    ssize_t ret = led_do_read(file, buffer, len, offset);
+
+    if (start)
+        led_timing_record(LED_OP_READ, start);
+    return ret;
+}
+
 /*
  * IOCTL file operation
  * Supports:
@@ -173,30 +1115,40 @@ static ssize_t led_read(struct file *file, char __user *buffer, size_t len, loff
  * - GPIO_IOC_LED_OFF: Turn LED off
  * - GPIO_IOC_LED_TOGGLE: Toggle LED state
  * - GPIO_IOC_GET_STATUS: Get current LED state
+ * - LED_IOC_WAVE_*: Waveform playback on all LEDs, see gpio_control.h
+ * - LED_IOC_EVENT_MODE: Switch this file between text and event reads
+ * - LED_IOC_SET_FILTER: Set the event filter of this file
  */
-static long led_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+static long led_do_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
-    struct my_led *dev = file->private_data;
+    struct led_file *lf = file->private_data;
+    struct my_led *dev = lf->led;
     int led_index = dev->index;
     int status;
+    struct led_wave_stats wave_stats;
+    struct gpio_event_filter filter;
+    unsigned long flags;
 
     switch(cmd){
         case GPIO_IOC_LED_ON:
-            led_state[led_index] = true;
-            gpiod_set_value(led_gpio[led_index], 1);
+            status = led_apply(led_index, LED_CMD_ON);
+            if (status < 0)
+                return status;
             pr_info("Led %s is ON by ioctl\n", dev->name);
             break;
 
         case GPIO_IOC_LED_OFF:  
-            led_state[led_index] = false;
-            gpiod_set_value(led_gpio[led_index], 0);
+            status = led_apply(led_index, LED_CMD_OFF);
+            if (status < 0)
+                return status;
             pr_info("Led %s is OFF by ioctl\n", dev->name);
             break;
 
         case GPIO_IOC_LED_TOGGLE:
-            led_state[led_index] = !led_state[led_index];
-            gpiod_set_value(led_gpio[led_index], led_state[led_index]);
-            pr_info("Led %s is %s by ioctl\n", dev->name, led_state[led_index] ? "ON" : "OFF");
+            status = led_apply(led_index, LED_CMD_TOGGLE);
+            if (status < 0)
+                return status;
+            pr_info("Led %s is %s by ioctl\n", dev->name, status ? "ON" : "OFF");
             break;
 
         case GPIO_IOC_GET_STATUS:
@@ -205,12 +1157,123 @@ static long led_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
                 return -EFAULT;
             break;
 
+        case LED_IOC_WAVE_QUEUE:
+            return led_wave_queue(file, arg);
+
+        case LED_IOC_WAVE_START:
+            return led_wave_start();
+
+        case LED_IOC_WAVE_STOP:
+            led_wave_stop();
+            break;
+
+        case LED_IOC_WAVE_STATS:
+            led_wave_get_stats(&wave_stats);
+            if (copy_to_user((void __user *)arg, &wave_stats, sizeof(wave_stats)))
+                return -EFAULT;
+            break;
+
+        case LED_IOC_EVENT_MODE:
+            if (copy_from_user(&status, (int __user *)arg, sizeof(status)))
+                return -EFAULT;
+            mutex_lock(&lf->lock);
+            lf->event_mode = status != 0;
+            spin_lock_irqsave(&led_event_lock, flags);
+            lf->next_seq = led_event_seq + 1;
+            spin_unlock_irqrestore(&led_event_lock, flags);
+            mutex_unlock(&lf->lock);
+            break;
+
+        case LED_IOC_SET_FILTER:
+            if (copy_from_user(&filter, (void __user *)arg, sizeof(filter)))
+                return -EFAULT;
+            spin_lock_irqsave(&led_event_lock, flags);
+            lf->filter_types = filter.types;
+            lf->filter_leds = filter.mask;
+            lf->min_interval_ns = (u64)filter.min_interval_ms * NSEC_PER_MSEC;
+            lf->last_delivered = 0;
+            spin_unlock_irqrestore(&led_event_lock, flags);
+            break;
+
         default:
             return -ENOTTY;
     }   
     return 0;
 }
 
+static long led_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    u64 start = led_timing_start();
+    long ret = led_do_ioctl(file, cmd, arg);
+
+    if (start)
+        led_timing_record(led_ioctl_op(cmd), start);
+    return ret;
+}
+
+/*
+ * io_uring command handler, see LED_URING_CMD_* in gpio_control.h
+ * Completes inline, no logging so batches of commands stay cheap
+ */
+static int led_do_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+    const struct led_uring_cmd *cmd = io_uring_sqe_cmd(ioucmd->sqe);
+    struct led_file *lf = ioucmd->file->private_data;
+    u32 bit = BIT(lf->led->index);
+    u32 mask, value = 0;
+    bool toggle = false;
+    int i, ret;
+
+    switch (ioucmd->cmd_op) {
+        case LED_URING_CMD_SET:
+            mask = bit;
+            value = READ_ONCE(cmd->value) ? bit : 0;
+            break;
+        case LED_URING_CMD_TOGGLE:
+            mask = bit;
+            toggle = true;
+            break;
+        case LED_URING_CMD_BANK_SET:
+            mask = READ_ONCE(cmd->mask) & LED_MASK_ALL;
+            value = READ_ONCE(cmd->value);
+            break;
+        default:
+            return -ENOTTY;
+    }
+
+    /* Sleeping GPIO controllers and a contended bank are retried from io-wq */
+    if (issue_flags & IO_URING_F_NONBLOCK) {
+        for (i = 0; i < NUM_DEVICES; i++) {
+            if (gpiod_cansleep(led_gpio[i]))
+                return -EAGAIN;
+        }
+        if (!mutex_trylock(&led_set_lock))
+            return -EAGAIN;
+    } else {
+        mutex_lock(&led_set_lock);
+    }
+    if (READ_ONCE(wave.running)) {
+        mutex_unlock(&led_set_lock);
+        return -EBUSY;
+    }
+    if (toggle)
+        value = ~led_current_mask();
+    ret = led_bank_write(mask, value, LED_SRC_URING);
+    mutex_unlock(&led_set_lock);
+
+    return ret;
+}
+
+static int led_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+    u64 start = led_timing_start();
+    int ret = led_do_uring_cmd(ioucmd, issue_flags);
+
+    if (start)
+        led_timing_record(LED_OP_URING, start);
+    return ret;
+}
+
 /*
  * Platform driver probe function
  * Initializes:
@@ -222,21 +1285,40 @@ static int led_probe(struct platform_device *pdev)
 {
     int ret, i;
     struct device *dev = &pdev->dev;
+    ktime_t start = ktime_get();
 
     pr_info("Probe led driver\n");
 
-    /* Initialize GPIO pins */
-    for(i = 0; i < NUM_DEVICES; i++){
-        led_gpio[i] = devm_gpiod_get_index(dev, "led", i, GPIOD_OUT_LOW);
-        if(IS_ERR(led_gpio[i])) {
-            dev_err(dev, "Failed to get led %d\n", i);
-            return PTR_ERR(led_gpio[i]);
-        }
+    /* Initialize GPIO pins as one array so all LEDs can be set in one write */
+    led_descs = devm_gpiod_get_array(dev, "led", GPIOD_OUT_LOW);
+    if(IS_ERR(led_descs)) {
+        dev_err(dev, "Failed to get leds\n");
+        return PTR_ERR(led_descs);
+    }
+    if(led_descs->ndescs != NUM_DEVICES) {
+        dev_err(dev, "Expected %d leds, got %u\n", NUM_DEVICES, led_descs->ndescs);
+        return -EINVAL;
+    }
 
+    for(i = 0; i < NUM_DEVICES; i++){
+        led_gpio[i] = led_descs->desc[i];
         led_state[i] = false;
         gpiod_set_value(led_gpio[i], 0);
     }
 
+    hrtimer_init(&wave.timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_HARD);
+    wave.timer.function = led_wave_timer_fn;
+    INIT_WORK(&wave.idle_work, led_wave_idle_work);
+
+    /* Runtime PM, active now; the bank idles once every LED is off */
+    led_pm_dev = dev;
+    pm_runtime_set_active(dev);
+    pm_runtime_set_autosuspend_delay(dev, LED_AUTOSUSPEND_MS);
+    pm_runtime_use_autosuspend(dev);
+    ret = devm_pm_runtime_enable(dev);
+    if (ret)
+        return ret;
+
     /* Allocate character device region */
     ret = alloc_chrdev_region(&dev_num, 0, NUM_DEVICES, DEVICE_NAME);
     if( ret < 0 ) {
@@ -274,7 +1356,19 @@ static int led_probe(struct platform_device *pdev)
         pr_info("Created device /dev/%s%d for %s\n", DEVICE_NAME, i, leds[i].name);
     }
 
-    pr_info("Led driver probe completed successfully\n");
+    led_debugfs_init();
+    gpio_status_attach(&led_status_source);
+
+    /* Ready, let deferred consumers in */
+    mutex_lock(&led_provider_lock);
+    led_provider = dev;
+    mutex_unlock(&led_provider_lock);
+
+    pm_runtime_mark_last_busy(dev);
+    pm_request_autosuspend(dev);
+
+    pr_info("Led driver probe completed successfully in %lld us\n",
+            ktime_us_delta(ktime_get(), start));
     return 0;
 
 cleanup_cdevs:
@@ -301,6 +1395,16 @@ static void led_remove(struct platform_device *pdev)
     int i;
     pr_info("Led driver remove\n");
 
+    /* Consumers were unbound through their device links already */
+    mutex_lock(&led_provider_lock);
+    led_provider = NULL;
+    mutex_unlock(&led_provider_lock);
+
+    gpio_status_detach(&led_status_source);
+    led_wave_stop();
+    cancel_work_sync(&wave.idle_work);
+    debugfs_remove_recursive(led_debugfs_dir);
+
     /* Turn off LEDs and clean up devices */
     for(i = 0; i < NUM_DEVICES; i++){
         led_state[i] = false;
@@ -316,13 +1420,67 @@ static void led_remove(struct platform_device *pdev)
     pr_info("Led driver removed successfully\n");
 }
 
-/* Device tree matching table */
-static const struct of_device_id led_of_match[] = {
-    { .compatible = "custom,gpio-led" },
-    { }    
-};
+/*
+ * Runtime PM. The bank only idles with every LED off and no waveform
+ * playing; idle LED pins go to their "sleep" pinctrl state, if any
+ */
+static int led_runtime_suspend(struct device *dev)
+{
+    if (READ_ONCE(wave.running) || led_current_mask())
+        return -EBUSY;
+    return pinctrl_pm_select_sleep_state(dev);
+}
 
-MODULE_DEVICE_TABLE(of, led_of_match);
+static int led_runtime_resume(struct device *dev)
+{
+    return pinctrl_pm_select_default_state(dev);
+}
+
+/*
+ * System sleep. The LEDs go dark while suspended but led_state keeps
+ * what they showed, plus any change made meanwhile, and resume puts it
+ * back with one array write. A playing waveform is stopped and its
+ * queued buffers dropped
+ */
+static int led_suspend(struct device *dev)
+{
+    unsigned long off = 0;
+
+    led_wave_stop();
+
+    /* Lit LEDs keep the bank runtime active, so it is safe to write */
+    mutex_lock(&led_set_lock);
+    led_asleep = true;
+    if (led_current_mask())
+        gpiod_set_array_value_cansleep(led_descs->ndescs, led_descs->desc, led_descs->info, &off);
+    mutex_unlock(&led_set_lock);
+
+    if (pm_runtime_status_suspended(dev))
+        return 0;
+    return pinctrl_pm_select_sleep_state(dev);
+}
+
+static int led_resume(struct device *dev)
+{
+    unsigned long bits;
+    int ret = 0;
+
+    if (!pm_runtime_status_suspended(dev))
+        ret = pinctrl_pm_select_default_state(dev);
+
+    mutex_lock(&led_set_lock);
+    led_asleep = false;
+    bits = led_current_mask();
+    if (bits)
+        led_hw_write(bits);
+    mutex_unlock(&led_set_lock);
+    return ret;
+}
+
+static const struct dev_pm_ops led_pm_ops = {
+    SYSTEM_SLEEP_PM_OPS(led_suspend, led_resume)
+    RUNTIME_PM_OPS(led_runtime_suspend, led_runtime_resume, NULL)
+};
 
 /* Platform driver structure */
 static struct platform_driver led_driver = {
@@ -331,6 +1489,8 @@ static struct platform_driver led_driver = {
     .driver = {
         .name = "led_driver",
         .of_match_table = led_of_match,
+        .pm = pm_ptr(&led_pm_ops),
+        .probe_type = PROBE_PREFER_ASYNCHRONOUS,
     },
 };
 
@@ -341,3 +1501,4 @@ module_platform_driver(led_driver);
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("AnhPH58");
 MODULE_DESCRIPTION("GPIO Led Driver");
+MODULE_SOFTDEP("pre: gpio_status");
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Tracepoint for LED changes, consumed by tools/pipeline_latency
+ *
+ *   led_change  the LED bank changed, fired with the LED event sequence number
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gpio_led
+
+#if !defined(_LED_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _LED_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(led_change,
+    TP_PROTO(u64 seq, u16 source, u32 changed, u32 value),
+    TP_ARGS(seq, source, changed, value),
+    TP_STRUCT__entry(
+        __field(u64, seq)
+        __field(u16, source)
+        __field(u32, changed)
+        __field(u32, value)
+    ),
+    TP_fast_assign(
+        __entry->seq = seq;
+        __entry->source = source;
+        __entry->changed = changed;
+        __entry->value = value;
+    ),
+    TP_printk("seq=%llu source=%u changed=0x%x value=0x%x",
+              __entry->seq, __entry->source, __entry->changed, __entry->value)
+);
+
+#endif /* _LED_TRACE_H */
+
+/* Out of tree: the header sits next to the driver, see ccflags-y */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE led_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,381 @@
+/*
+ * Shared userspace/kernel definitions for the Mock_project GPIO drivers
+ * Included by the drivers and by the applications/tools, so the event
+ * records and ioctl numbers only live in one place
+ */
+#ifndef _GPIO_CONTROL_H
+#define _GPIO_CONTROL_H
+
+#include <linux/types.h>        /* For __u32/__s32/__u64 */
+#include <linux/ioctl.h>        /* For _IO/_IOR/_IOW */
+
+/* Encoder device node */
+#define ENCODER_DEVICE          "/dev/gpio_encoder"
+
+/* Encoder event types */
+#define ENCODER_EV_STEP         1   /* Detent step, see delta/accel */
+#define ENCODER_EV_PUSH         2   /* Push switch pressed (value = 1) */
+#define ENCODER_EV_OVERRUN      3   /* Reader fell behind, value = lost events */
+
+/*
+ * Encoder event record returned by read() on /dev/gpio_encoder
+ * @seq:       Event sequence number (increments by one per event)
+ * @timestamp: ktime_get_ns() of the edge that produced the event
+ * @type:      ENCODER_EV_*
+ * @delta:     +1 clockwise, -1 counter-clockwise (STEP only)
+ * @accel:     Accelerated step count for this detent (STEP only)
+ * @position:  Accumulated accelerated position after this event
+ * @value:     Push state or lost event count
+ */
+struct encoder_event {
+    __u64 seq;
+    __u64 timestamp;
+    __u32 type;
+    __s32 delta;
+    __s32 accel;
+    __s32 position;
+    __u32 value;
+    __u32 reserved;
+};
+
+/*
+ * Encoder statistics returned by ENCODER_IOC_GET_STATS
+ * @steps:         Detent steps decoded
+ * @transitions:   Valid quadrature transitions seen
+ * @invalid:       Illegal transitions (both lines changed), i.e. missed edges
+ * @dropped:       Events lost by readers that fell a full ring behind
+ * @min_step_ns:   Shortest interval between two detents
+ */
+struct encoder_stats {
+    __u64 steps;
+    __u64 transitions;
+    __u64 invalid;
+    __u64 dropped;
+    __u64 min_step_ns;
+};
+
+/* Encoder IOCTL command definitions */
+#define ENCODER_IOC_MAGIC       'e'
+#define ENCODER_IOC_GET_STATS   _IOR(ENCODER_IOC_MAGIC, 1, struct encoder_stats) /* Read statistics */
+#define ENCODER_IOC_RESET       _IO(ENCODER_IOC_MAGIC, 2)   /* Zero position and statistics */
+
+/* Button device node */
+#define BUTTON_DEVICE           "/dev/gpio_button"
+#define BUTTON_MAX_KEYS         16  /* Maximum button-gpios entries */
+
+/* Button event types */
+#define BUTTON_EV_PRESS         1   /* Debounced press of one key */
+#define BUTTON_EV_CHORD         2   /* Keys pressed together, value = key mask */
+#define BUTTON_EV_MULTI_PRESS   3   /* Resolved multi-press, value = press count */
+#define BUTTON_EV_OVERRUN       4   /* Reader fell behind, value = lost events */
+
+/*
+ * Button event record returned by read() after BUTTON_IOC_EVENT_MODE
+ * @seq:       Global sequence number, shared by all keys of the instance
+ * @timestamp: ktime_get_ns() when the event was queued
+ * @type:      BUTTON_EV_*
+ * @key:       Key index in button-gpios (PRESS and MULTI_PRESS)
+ * @value:     Type specific, see BUTTON_EV_*
+ */
+struct button_event {
+    __u64 seq;
+    __u64 timestamp;
+    __u16 type;
+    __u16 key;
+    __u32 value;
+};
+
+/* Button IOCTL command definitions */
+#define BUTTON_IOC_MAGIC        'b'
+#define BUTTON_IOC_GET_STATUS   _IOR(BUTTON_IOC_MAGIC, 1, int)  /* Key 0 pressed state */
+#define BUTTON_IOC_EVENT_MODE   _IOW(BUTTON_IOC_MAGIC, 2, int)  /* 1 = read() returns events */
+#define BUTTON_IOC_SET_CHORD_WINDOW _IOW(BUTTON_IOC_MAGIC, 3, int) /* Chord window in ms */
+#define BUTTON_IOC_SET_RULES    _IOW(BUTTON_IOC_MAGIC, 4, struct button_rule_table)
+#define BUTTON_IOC_GET_RULES    _IOWR(BUTTON_IOC_MAGIC, 5, struct button_rule_table)
+#define BUTTON_IOC_SET_FILTER   _IOW(BUTTON_IOC_MAGIC, 6, struct gpio_event_filter)
+#define BUTTON_IOC_GET_DEBOUNCE _IOR(BUTTON_IOC_MAGIC, 7, struct button_debounce_info)
+#define BUTTON_IOC_GET_WAKE     _IOR(BUTTON_IOC_MAGIC, 8, struct button_wake_info)
+
+/*
+ * Adaptive debounce state of one key. An edge, press or release, is
+ * accepted once the line has been quiet for window_ns; edges inside the
+ * window are bounces and restart it. The longest bounce gap of each
+ * press and release feeds an average and mean deviation, and the window
+ * follows them between the bounds
+ * @window_ns:     Current window
+ * @bounce_avg_ns: Smoothed longest bounce gap per press
+ * @bounce_dev_ns: Smoothed mean deviation of that gap
+ * @accepted:      Edges accepted as presses
+ * @bounces:       Edges rejected inside the window, press or release
+ * @late:          Accepted edges closer than max_ns to the previous accepted
+ *                 edge in the same direction, most likely a bounce the
+ *                 window was too short for
+ */
+struct button_debounce_key {
+    __u32 window_ns;
+    __u32 bounce_avg_ns;
+    __u32 bounce_dev_ns;
+    __u32 accepted;
+    __u32 bounces;
+    __u32 late;
+};
+
+/*
+ * Argument of BUTTON_IOC_GET_DEBOUNCE
+ * @min_ns, @max_ns: Window bounds, from debounce-min-ms / debounce-max-ms
+ * @num_keys:        Valid entries in key[]
+ */
+struct button_debounce_info {
+    __u32 min_ns;
+    __u32 max_ns;
+    __u32 num_keys;
+    __u32 reserved;
+    struct button_debounce_key key[BUTTON_MAX_KEYS];
+};
+
+/*
+ * Resume latency of key wakes, BUTTON_IOC_GET_WAKE. Every time below is
+ * measured from the driver's resume_noirq callback, its first look after
+ * a system wakeup. The wake edge itself came earlier: the kernel keeps
+ * no timestamp of the wake IRQ, so firmware, CPU bring-up and the noirq
+ * phase before this driver are not included. A key IRQ within 500 ms of
+ * resume is taken as the edge that woke the system. The resume_* stages
+ * belong to the most recent key wake
+ * @resumes:                System resumes since the driver loaded
+ * @key_wakes:              Resumes followed by a key IRQ, i.e. woken by a key
+ * @delivered:              Key wakes whose first press reached read() or io_uring
+ * @asleep_ns:              Time suspended before the last resume
+ * @resume_irq_ns:          Resume to the first key IRQ
+ * @resume_event_ns:        Resume to its PRESS event being queued
+ * @resume_rules_ns:        Resume to the rule worker taking it, i.e. the LEDs reacting
+ * @resume_read_ns:         Resume to a reader or io_uring wait taking it
+ * @resume_read_max_ns:     Longest resume_read_ns over all delivered key wakes
+ * @resume_read_sum_ns:     Sum of resume_read_ns, divide by delivered for the mean
+ */
+struct button_wake_info {
+    __u32 resumes;
+    __u32 key_wakes;
+    __u32 delivered;
+    __u32 reserved;
+    __u64 asleep_ns;
+    __u64 resume_irq_ns;
+    __u64 resume_event_ns;
+    __u64 resume_rules_ns;
+    __u64 resume_read_ns;
+    __u64 resume_read_max_ns;
+    __u64 resume_read_sum_ns;
+};
+
+/*
+ * Per-open-file event filter, BUTTON_IOC_SET_FILTER and LED_IOC_SET_FILTER.
+ * Events that do not pass are skipped in the kernel and never copied to
+ * the reader; OVERRUN events always pass. All zero = deliver everything
+ * @types:           Bit N set = deliver event type N (BUTTON_EV_* / LED_EV_*)
+ * @mask:            Button: keys, an event passes if it involves one of
+ *                   them (the chord mask for CHORD). LED: LEDs, an event
+ *                   passes if one of them changed. 0 = any
+ * @min_interval_ms: Skip events less than this after the last one
+ *                   delivered to this file, 0 = no rate limit
+ */
+struct gpio_event_filter {
+    __u32 types;
+    __u32 mask;
+    __u32 min_interval_ms;
+    __u32 reserved;
+};
+
+/*
+ * Button to LED rules, evaluated in the kernel on every button event.
+ * Rules are checked in table order; the first match stops evaluation
+ * unless it has BUTTON_RULE_F_CONTINUE. The built-in table maps 1-3
+ * presses of key 0 to one LED, 4 to all on and 5 or more to all off
+ */
+#define BUTTON_RULES_MAX        32
+#define BUTTON_RULE_PATTERN_STEPS 8
+
+/* Rule actions */
+#define BUTTON_RULE_SET         1   /* LEDs in mask take the levels in value */
+#define BUTTON_RULE_CLEAR       2   /* LEDs in mask off */
+#define BUTTON_RULE_TOGGLE      3   /* LEDs in mask toggled */
+#define BUTTON_RULE_PATTERN     4   /* LEDs in mask play pattern */
+
+#define BUTTON_RULE_F_CONTINUE  0x01 /* Keep evaluating after this rule matched */
+
+#define BUTTON_RULE_ANY_KEY     0xffff /* @key of a PRESS rule that matches every key */
+
+/*
+ * One rule
+ * @type:    Trigger, BUTTON_EV_PRESS (edge of one key), BUTTON_EV_CHORD
+ *           (gesture) or BUTTON_EV_MULTI_PRESS (press count)
+ * @key:     Key index below BUTTON_MAX_KEYS for BUTTON_EV_PRESS,
+ *           BUTTON_RULE_ANY_KEY = any key
+ * @min:     Event value range that matches, inclusive: the press count
+ * @max:     for MULTI_PRESS, the key mask for CHORD, ignored for PRESS
+ * @action:  BUTTON_RULE_*
+ * @flags:   BUTTON_RULE_F_*
+ * @mask:    LEDs the action applies to, bit N = LED N
+ * @value:   New levels for BUTTON_RULE_SET
+ * @pattern: BUTTON_RULE_PATTERN levels, 4 bits per step, step 0 in the low bits
+ * @step_ms: Time per pattern step, 10-10000 ms
+ * @steps:   Pattern steps, 1-8
+ * @repeat:  Times to play the pattern, 0 = until another action
+ */
+struct button_rule {
+    __u16 type;
+    __u16 key;
+    __u32 min;
+    __u32 max;
+    __u8 action;
+    __u8 flags;
+    __u8 mask;
+    __u8 value;
+    __u32 pattern;
+    __u16 step_ms;
+    __u8 steps;
+    __u8 repeat;
+};
+
+/*
+ * Argument of BUTTON_IOC_SET_RULES and BUTTON_IOC_GET_RULES
+ * @count: SET: rules in the table, 0 = no rules. GET: capacity of the
+ *         array on input, rules in the active table on output
+ * @rules: User pointer to struct button_rule[count]. SET with rules = 0
+ *         restores the built-in table
+ */
+struct button_rule_table {
+    __u32 count;
+    __u32 reserved;
+    __u64 rules;
+};
+
+/*
+ * Button io_uring commands, IORING_OP_URING_CMD with cmd_op set to one of
+ * these and the payload in the 16 byte command area of a normal SQE
+ *
+ * BUTTON_URING_CMD_WAIT completes on the first matching event queued
+ * after submission. CQE res is the event type, or -ETIME, -ECANCELED,
+ * -EFAULT. Waits still pending when the ring is torn down or its task
+ * exits complete with -ECANCELED.
+ * BUTTON_URING_CMD_CANCEL completes every wait submitted through the same
+ * file with -ECANCELED; CQE res is the number cancelled.
+ */
+#define BUTTON_URING_CMD_WAIT   1
+#define BUTTON_URING_CMD_CANCEL 2
+#define BUTTON_URING_ANY_KEY    0xffff
+
+/*
+ * Payload of BUTTON_URING_CMD_WAIT
+ * @event:      User pointer receiving the struct button_event, may be 0
+ * @type:       BUTTON_EV_* to wait for, 0 = any type
+ * @key:        Key index to wait for, BUTTON_URING_ANY_KEY = any key
+ * @timeout_ms: Complete with -ETIME after this long, 0 = no timeout
+ */
+struct button_uring_wait {
+    __u64 event;
+    __u16 type;
+    __u16 key;
+    __u32 timeout_ms;
+};
+
+/* LED waveform playback, issued on any /dev/gpio_ledN */
+#define LED_WAVE_MAX_STEPS      1024    /* Steps per playback buffer */
+#define LED_WAVE_MIN_DELTA_NS   1000    /* Shortest step delay accepted */
+#define LED_WAVE_MORE           0x01    /* More buffers follow, count underruns */
+
+/*
+ * One waveform transition
+ * @delta_ns: Delay after the previous transition (or after start),
+ *            at least LED_WAVE_MIN_DELTA_NS
+ * @value:    LED levels, bit N drives LED N
+ */
+struct led_wave_step {
+    __u32 delta_ns;
+    __u32 value;
+};
+
+/*
+ * Buffer handed to LED_IOC_WAVE_QUEUE
+ * @steps: User pointer to count struct led_wave_step
+ * @count: Number of steps, 1..LED_WAVE_MAX_STEPS
+ * @flags: LED_WAVE_*
+ */
+struct led_wave_buffer {
+    __u64 steps;
+    __u32 count;
+    __u32 flags;
+};
+
+/*
+ * Playback statistics returned by LED_IOC_WAVE_STATS
+ * Lateness is the time between a transition's scheduled time and the
+ * moment its GPIO write was issued
+ * @late_hist: Bucket 0 counts < 1 us, bucket N counts [2^(N-1), 2^N) us
+ */
+struct led_wave_stats {
+    __u64 transitions;
+    __u64 late_min_ns;
+    __u64 late_max_ns;
+    __u64 late_mean_ns;
+    __u32 buffers;          /* Buffers played to completion */
+    __u32 underruns;        /* LED_WAVE_MORE buffer ended with nothing queued */
+    __u32 running;
+    __u32 reserved;
+    __u32 late_hist[16];
+};
+
+/* LED IOCTL command definitions, shares 'k' with GPIO_IOC_* in led_driver.c */
+#define LED_IOC_MAGIC           'k'
+#define LED_IOC_WAVE_QUEUE      _IOW(LED_IOC_MAGIC, 5, struct led_wave_buffer) /* Fill a free buffer */
+#define LED_IOC_WAVE_START      _IO(LED_IOC_MAGIC, 6)   /* Start playing queued buffers */
+#define LED_IOC_WAVE_STOP       _IO(LED_IOC_MAGIC, 7)   /* Stop and drop queued buffers */
+#define LED_IOC_WAVE_STATS      _IOR(LED_IOC_MAGIC, 8, struct led_wave_stats)
+#define LED_IOC_EVENT_MODE      _IOW(LED_IOC_MAGIC, 9, int)     /* 1 = read() returns events */
+#define LED_IOC_SET_FILTER      _IOW(LED_IOC_MAGIC, 10, struct gpio_event_filter)
+
+/* LED event types */
+#define LED_EV_CHANGE           1   /* One or more LEDs changed level */
+#define LED_EV_OVERRUN          2   /* Reader fell behind, changed = lost events */
+
+/* What changed the LEDs */
+#define LED_SRC_FILE            1   /* write() or ioctl() on /dev/gpio_ledN */
+#define LED_SRC_URING           2   /* LED_URING_CMD_* */
+#define LED_SRC_WAVE            3   /* Waveform playback */
+#define LED_SRC_PROVIDER        4   /* Another driver, e.g. button_driver rules */
+
+/*
+ * LED event record returned by read() after LED_IOC_EVENT_MODE. Every
+ * /dev/gpio_ledN reports the transitions of all LEDs
+ * @seq:       Sequence number, shared by all LEDs
+ * @timestamp: ktime_get_ns() of the change
+ * @type:      LED_EV_*
+ * @source:    LED_SRC_*
+ * @changed:   LEDs that changed, bit N = LED N
+ * @value:     All LED levels after the change
+ */
+struct led_event {
+    __u64 seq;
+    __u64 timestamp;
+    __u16 type;
+    __u16 source;
+    __u32 changed;
+    __u32 value;
+    __u32 reserved;
+};
+
+/*
+ * LED io_uring commands, IORING_OP_URING_CMD on any /dev/gpio_ledN with
+ * a struct led_uring_cmd payload. All LEDs touched by one command are
+ * written with a single array write. CQE res is the new LED bitmask
+ * (bit N = LED N), or -EBUSY while a waveform is playing
+ */
+#define LED_URING_CMD_SET       1   /* This file's LED on when value != 0 */
+#define LED_URING_CMD_TOGGLE    2   /* Toggle this file's LED */
+#define LED_URING_CMD_BANK_SET  3   /* LEDs in mask take the value bits */
+
+struct led_uring_cmd {
+    __u32 value;
+    __u32 mask;
+    __u64 reserved;
+};
+
+#endif /* _GPIO_CONTROL_H */
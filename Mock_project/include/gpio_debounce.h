@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Adaptive leading-edge debounce, shared by button_driver and gpio_driver_2
+ *
+ * The first edge after the line was quiet for the window is accepted
+ * straight away, so a clean press costs no latency; every edge restarts
+ * the quiet period. The longest bounce gap of each press or release is
+ * folded into an average and a mean deviation with gains 1/8 and 1/4,
+ * like the TCP RTT estimator, in shifts so it can run in the IRQ handler.
+ * The window is the average plus half of it as headroom plus four
+ * deviations, within the caller's bounds: clean presses feed a zero gap
+ * and walk it down to the lower bound, one bouncy press in a run of
+ * clean ones raises the deviation and keeps it open for the next.
+ *
+ * An accepted edge within the upper bound of the previous accepted edge
+ * in the same direction was most likely a bounce the window was too
+ * short for: it is counted as late and its gap is learnt so the window
+ * grows. The opposite direction is not compared, a quick tap is not a
+ * bounce.
+ *
+ * No locking: each struct gpio_debounce has a single writer, the IRQ
+ * handler of its line.
+ */
+#ifndef GPIO_DEBOUNCE_H
+#define GPIO_DEBOUNCE_H
+
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+#include <linux/types.h>
+
+struct gpio_debounce {
+    u64 last_edge;              /* ns of the last edge, accepted or not, 0 = none */
+    u64 last_accepted[2];       /* ns of the last accepted release, press */
+    u32 window_ns;              /* Current debounce window */
+    u32 avg;                    /* Smoothed longest bounce gap, ns */
+    u32 dev;                    /* Smoothed mean deviation, ns */
+    u32 burst_gap;              /* Longest bounce gap of the current press or release */
+    u32 edges;                  /* Edges accepted, presses and releases */
+    u32 bounces;                /* Edges rejected inside the window */
+    u32 late;                   /* Accepted edges that look like bounces */
+};
+
+/*
+ * Forget what was learnt, start from the conservative upper bound
+ */
+static inline void gpio_debounce_reset(struct gpio_debounce *db, u32 max_ns)
+{
+    *db = (struct gpio_debounce){ .window_ns = max_ns };
+}
+
+/*
+ * Fold the longest bounce gap of the press or release that just ended
+ * into the estimate and recompute the window, before the new edge is
+ * counted. The first completed one primes the estimator
+ */
+static inline void gpio_debounce_learn(struct gpio_debounce *db, u32 min_ns, u32 max_ns)
+{
+    s64 err, avg = db->avg, dev = db->dev;
+    u64 window;
+
+    if (db->edges == 1) {
+        avg = db->burst_gap;
+        dev = db->burst_gap / 2;
+    } else {
+        err = (s64)db->burst_gap - avg;
+        avg += err >> 3;
+        dev += (abs(err) - dev) >> 2;
+    }
+    db->avg = avg;
+    db->dev = dev;
+    db->burst_gap = 0;
+
+    window = avg + (avg >> 1) + 4 * dev;
+    db->window_ns = clamp_t(u64, window, min_ns, max_ns);
+}
+
+/*
+ * Run one edge through the filter
+ * @now:   Time of the edge, ns
+ * @press: Line level after the edge, true for a press
+ * Returns true if the edge was accepted
+ */
+static inline bool gpio_debounce_edge(struct gpio_debounce *db, u64 now, bool press,
+                                      u32 min_ns, u32 max_ns)
+{
+    u64 gap = now - db->last_edge;
+    bool first = !db->last_edge;
+    u64 prev;
+
+    db->last_edge = now;
+    if (!first && gap < db->window_ns) {
+        if (gap > db->burst_gap)
+            db->burst_gap = gap;
+        db->bounces++;
+        return false;
+    }
+
+    prev = db->last_accepted[press];
+    db->last_accepted[press] = now;
+    if (!first && prev && now - prev < max_ns) {
+        db->late++;
+        db->burst_gap = max_t(u64, db->burst_gap, gap);
+    }
+    if (db->edges)
+        gpio_debounce_learn(db, min_ns, max_ns);
+    db->edges++;
+    return true;
+}
+
+#endif /* GPIO_DEBOUNCE_H */
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Shared by the KUnit microbenchmarks of the GPIO control drivers
+ */
+#ifndef GPIO_KUNIT_BENCH_H
+#define GPIO_KUNIT_BENCH_H
+
+#include <kunit/test.h>         /* For kunit_info */
+#include <linux/math64.h>       /* For 64-bit division */
+
+/*
+ * Report the mean time per iteration as a "# name: N.N ns/op" KTAP line
+ * div_u64 helpers only: a plain u64 '/' or '%' does not link on 32-bit ARM
+ */
+static inline void gpio_kunit_bench_report(struct kunit *test, const char *name, u64 ns,
+                                           unsigned int iters)
+{
+    u32 tenth;
+    u64 whole = div_u64_rem(div_u64(ns * 10, iters), 10, &tenth);
+
+    kunit_info(test, "%s: %llu.%u ns/op\n", name, whole, tenth);
+}
+
+#endif /* GPIO_KUNIT_BENCH_H */
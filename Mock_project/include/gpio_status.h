@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Aggregated status of all GPIO control drivers, /proc/gpio_ctl_status
+ *
+ * One read returns every bound instance of gpio_driver, gpio_driver_2,
+ * led_driver and button_driver:
+ *
+ *   version=1 now_ns=<CLOCK_MONOTONIC>
+ *   driver=<name> dev=<node> <key>=<value> ...
+ *
+ * One line per instance, space separated key=value pairs. driver and dev
+ * always come first; values are decimal integers or words without
+ * spaces. Timestamps are CLOCK_MONOTONIC ns, 0 = never. New keys may be
+ * appended, parsers skip keys they do not know.
+ *
+ * The show callbacks run under rcu_read_lock() and must not sleep or take
+ * the driver's locks: they print a snapshot read with READ_ONCE() or a
+ * seqcount retry loop.
+ *
+ * The gpio_status module is optional. Drivers look it up with symbol_get()
+ * so they still load without it; MODULE_SOFTDEP("pre: gpio_status") makes
+ * modprobe load it first.
+ */
+#ifndef GPIO_STATUS_H
+#define GPIO_STATUS_H
+
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/seq_file.h>
+
+struct gpio_status_source {
+    void (*show)(struct seq_file *m);
+    struct list_head node;
+    bool attached;              /* Holding a reference on gpio_status */
+};
+
+void gpio_status_register(struct gpio_status_source *src);
+void gpio_status_unregister(struct gpio_status_source *src);
+
+/*
+ * Add @src to the status file if gpio_status is loaded
+ * The module reference is held until gpio_status_detach()
+ */
+static inline void gpio_status_attach(struct gpio_status_source *src)
+{
+    void (*reg)(struct gpio_status_source *) = symbol_get(gpio_status_register);
+
+    if (!reg)
+        return;
+    reg(src);
+    src->attached = true;
+}
+
+/*
+ * Remove @src, waits until no reader is inside its show callback
+ */
+static inline void gpio_status_detach(struct gpio_status_source *src)
+{
+    void (*unreg)(struct gpio_status_source *);
+
+    if (!src->attached)
+        return;
+    unreg = symbol_get(gpio_status_unregister);
+    if (unreg) {
+        unreg(src);
+        symbol_put(gpio_status_unregister);
+    }
+    symbol_put(gpio_status_register);
+    src->attached = false;
+}
+
+#endif /* GPIO_STATUS_H */
@@ -0,0 +1,495 @@
+/*
+ * Debounce strategy benchmark on synthetic bounce traces
+ *
+ * Generates a reproducible sequence of button presses for each bounce
+ * profile as timestamped edges (active low, idle high) and replays it
+ * through userspace models of several debounce strategies:
+ *  - jiffies:    the old fixed 50 ms window from the last accepted
+ *                falling edge, on a HZ=100 clock
+ *  - adaptive:   gpio_debounce_edge() from include/gpio_debounce.h as
+ *                button_driver runs it, leading edge on both edges with
+ *                a learnt quiet window (2-50 ms)
+ *  - hrtimer:    every edge restarts a 5 ms hrtimer, the level is
+ *                sampled when it fires (trailing edge, like gpio-keys)
+ *  - integrator: 1 ms polling, saturating counter with threshold 5
+ *  - hardware:   controller glitch filter clocked at 32768 Hz that
+ *                passes a level once stable for 164 ticks (~5 ms), IRQ
+ *                on the filtered falling edge
+ *
+ * Profiles:
+ *  - clean:   no bounce
+ *  - short:   2-8 bounces, 20-300 us apart, on press and release
+ *  - long:    6-20 bounces, 0.1-3 ms apart (worn switch)
+ *  - chatter: short bounce plus a 300 us open every 15 ms while held
+ *  - emi:     clean presses plus 1-50 us low spikes while idle, ~5/s
+ *
+ * An accept counts as a hit if it falls between the start of a press
+ * and its release and is the first for that press; every other accept
+ * is a false accept. Presses without a hit are missed. Latency is from
+ * the first edge of the press to the accept. The jiffies model only
+ * sees falling edges, as the old driver did, so release bounce that gets
+ * past it shows up as false accepts. Output is CSV, the same
+ * seed always gives the same table so runs can be diffed across changes.
+ * The models replay the driver logic, not the IRQ path; use the KUnit
+ * suite and gpio-sim for that.
+ *
+ * Usage: debounce_bench [presses] [seed]
+ *        debounce_bench trace <profile> [presses] [seed]
+ *  e.g.  debounce_bench 500 1 > debounce.csv
+ */
+#include <stdio.h>      /* For standard I/O operations */
+#include <stdlib.h>     /* For strtoul/qsort */
+#include <string.h>     /* For strcmp */
+#include <stdint.h>     /* For fixed width types */
+
+#define NSEC_PER_USEC 1000LL
+#define NSEC_PER_MSEC 1000000LL
+#define NSEC_PER_SEC  1000000000LL
+
+#define DEFAULT_PRESSES 200
+#define DEFAULT_SEED    1
+
+/* Strategy parameters */
+#define JIFFIES_HZ          100
+#define JIFFIES_WINDOW_MS   50
+#define ADAPTIVE_MIN_MS     2   /* DEBOUNCE_MIN_MS in button_driver.c */
+#define ADAPTIVE_MAX_MS     50  /* DEBOUNCE_MAX_MS */
+#define HRTIMER_WINDOW_MS   5
+#define INTEGRATOR_PERIOD_MS 1
+#define INTEGRATOR_MAX      5
+#define HW_CLOCK_HZ         32768
+#define HW_STABLE_TICKS     164
+
+struct edge {
+    int64_t t;
+    int level;
+};
+
+struct press {
+    int64_t start;      /* First falling edge */
+    int64_t release;    /* First rising edge of the release */
+};
+
+struct trace {
+    struct edge *edges;
+    size_t nedges, cap;
+    struct press *presses;
+    size_t npresses;
+};
+
+/* Accept timestamps produced by one strategy */
+struct accepts {
+    int64_t *t;
+    size_t n, cap;
+};
+
+static uint64_t rng_state;
+
+/* xorshift64*, good enough for test traces and the same on every host */
+static uint64_t rng(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+/* Uniform in [lo, hi] */
+static int64_t rng_range(int64_t lo, int64_t hi) {
+    return lo + (int64_t)(rng() % (uint64_t)(hi - lo + 1));
+}
+
+static void *grow(void *p, size_t *cap, size_t need, size_t size) {
+    if (need <= *cap)
+        return p;
+    *cap = *cap ? *cap * 2 : 1024;
+    if (*cap < need)
+        *cap = need;
+    p = realloc(p, *cap * size);
+    if (!p) {
+        perror("Out of memory");
+        exit(1);
+    }
+    return p;
+}
+
+static void add_edge(struct trace *tr, int64_t t, int level) {
+    tr->edges = grow(tr->edges, &tr->cap, tr->nedges + 1, sizeof(*tr->edges));
+    tr->edges[tr->nedges].t = t;
+    tr->edges[tr->nedges].level = level;
+    tr->nedges++;
+}
+
+/*
+ * Contact bounce after a transition to level: count extra edges that
+ * alternate away from and back to level, gaps in [gmin, gmax]
+ * Returns: time of the last edge
+ */
+static int64_t add_bounce(struct trace *tr, int64_t t, int level, int count,
+                          int64_t gmin, int64_t gmax) {
+    int i;
+
+    for (i = 0; i < count * 2; i++) {
+        t += rng_range(gmin, gmax);
+        add_edge(tr, t, i & 1 ? level : !level);
+    }
+    return t;
+}
+
+enum profile { P_CLEAN, P_SHORT, P_LONG, P_CHATTER, P_EMI, P_COUNT };
+
+static const char *const profile_names[P_COUNT] = {
+    "clean", "short", "long", "chatter", "emi",
+};
+
+/* Bounce of one transition for the profile, returns the last edge */
+static int64_t profile_bounce(struct trace *tr, enum profile p, int64_t t, int level) {
+    switch (p) {
+        case P_SHORT:
+        case P_CHATTER:
+            return add_bounce(tr, t, level, rng_range(1, 4), 20 * NSEC_PER_USEC,
+                              300 * NSEC_PER_USEC);
+        case P_LONG:
+            return add_bounce(tr, t, level, rng_range(3, 10), 100 * NSEC_PER_USEC,
+                              3 * NSEC_PER_MSEC);
+        default:
+            return t;
+    }
+}
+
+/* Build the press sequence of one profile */
+static void gen_trace(struct trace *tr, enum profile p, unsigned int presses, uint64_t seed) {
+    int64_t t = 100 * NSEC_PER_MSEC;
+    unsigned int i;
+
+    memset(tr, 0, sizeof(*tr));
+    rng_state = seed * 0x9E3779B97F4A7C15ULL + p + 1;
+    tr->presses = calloc(presses, sizeof(*tr->presses));
+    if (!tr->presses) {
+        perror("Out of memory");
+        exit(1);
+    }
+
+    for (i = 0; i < presses; i++) {
+        int64_t start = t, release, last;
+
+        add_edge(tr, start, 0);
+        last = profile_bounce(tr, p, start, 0);
+
+        release = start + rng_range(80 * NSEC_PER_MSEC, 300 * NSEC_PER_MSEC);
+        if (p == P_CHATTER) {
+            int64_t c;
+
+            for (c = last + 15 * NSEC_PER_MSEC; c + NSEC_PER_MSEC < release;
+                 c += 15 * NSEC_PER_MSEC) {
+                add_edge(tr, c, 1);
+                add_edge(tr, c + 300 * NSEC_PER_USEC, 0);
+            }
+        }
+
+        add_edge(tr, release, 1);
+        last = profile_bounce(tr, p, release, 1);
+        tr->presses[i].start = start;
+        tr->presses[i].release = release;
+
+        t = last + rng_range(250 * NSEC_PER_MSEC, 600 * NSEC_PER_MSEC);
+        if (p == P_EMI) {
+            /* Idle spikes, kept a ms away from the real edges */
+            int64_t s = last + rng_range(NSEC_PER_MSEC, 400 * NSEC_PER_MSEC);
+
+            while (s + NSEC_PER_MSEC < t) {
+                add_edge(tr, s, 0);
+                add_edge(tr, s + rng_range(NSEC_PER_USEC, 50 * NSEC_PER_USEC), 1);
+                s += rng_range(50 * NSEC_PER_MSEC, 350 * NSEC_PER_MSEC);
+            }
+        }
+    }
+    tr->npresses = presses;
+}
+
+static void free_trace(struct trace *tr) {
+    free(tr->edges);
+    free(tr->presses);
+}
+
+static void accept(struct accepts *a, int64_t t) {
+    a->t = grow(a->t, &a->cap, a->n + 1, sizeof(*a->t));
+    a->t[a->n++] = t;
+}
+
+/* Level of the line at time t; *pos walks forward, t must not go back */
+static int level_at(const struct trace *tr, size_t *pos, int64_t t) {
+    while (*pos < tr->nedges && tr->edges[*pos].t <= t)
+        (*pos)++;
+    return *pos ? tr->edges[*pos - 1].level : 1;
+}
+
+/* Old driver: fixed window from the last accepted falling edge, in jiffies */
+static void run_jiffies(const struct trace *tr, struct accepts *a) {
+    const int64_t tick = NSEC_PER_SEC / JIFFIES_HZ;
+    const int64_t window = (JIFFIES_WINDOW_MS * JIFFIES_HZ + 999) / 1000;
+    int64_t last = 0;
+    int first = 1;
+    size_t i;
+
+    for (i = 0; i < tr->nedges; i++) {
+        int64_t now;
+
+        if (tr->edges[i].level)
+            continue;
+        now = tr->edges[i].t / tick;
+        if (!first && now - last < window)
+            continue;
+        first = 0;
+        last = now;
+        accept(a, tr->edges[i].t);
+    }
+}
+
+/*
+ * Current driver: gpio_debounce_edge() and gpio_debounce_learn() from
+ * gpio_debounce.h, fed both edges as button_driver does. Keep in sync
+ * with the header
+ */
+struct adaptive_key {
+    uint64_t last_edge;
+    uint64_t last_accepted[2];  /* Release, press */
+    uint32_t window_ns, bounce_avg, bounce_dev, burst_gap, edges;
+};
+
+static void adaptive_learn(struct adaptive_key *key, uint32_t min_ns, uint32_t max_ns) {
+    int64_t err, avg = key->bounce_avg, dev = key->bounce_dev;
+    uint64_t window;
+
+    if (key->edges == 1) {
+        avg = key->burst_gap;
+        dev = key->burst_gap / 2;
+    } else {
+        err = (int64_t)key->burst_gap - avg;
+        avg += err >> 3;
+        dev += ((err < 0 ? -err : err) - dev) >> 2;
+    }
+    key->bounce_avg = avg;
+    key->bounce_dev = dev;
+    key->burst_gap = 0;
+
+    window = avg + (avg >> 1) + 4 * dev;
+    key->window_ns = window < min_ns ? min_ns : window > max_ns ? max_ns : window;
+}
+
+static void run_adaptive(const struct trace *tr, struct accepts *a) {
+    const uint32_t min_ns = ADAPTIVE_MIN_MS * NSEC_PER_MSEC;
+    const uint32_t max_ns = ADAPTIVE_MAX_MS * NSEC_PER_MSEC;
+    struct adaptive_key key = { .window_ns = max_ns };
+    size_t i;
+
+    for (i = 0; i < tr->nedges; i++) {
+        uint64_t now = tr->edges[i].t, gap = now - key.last_edge, prev;
+        int first = !key.last_edge, press = !tr->edges[i].level;
+
+        key.last_edge = now;
+        if (!first && gap < key.window_ns) {
+            if (gap > key.burst_gap)
+                key.burst_gap = gap;
+            continue;
+        }
+        prev = key.last_accepted[press];
+        key.last_accepted[press] = now;
+        if (!first && prev && now - prev < max_ns && gap > key.burst_gap)
+            key.burst_gap = gap;
+        if (key.edges)
+            adaptive_learn(&key, min_ns, max_ns);
+        key.edges++;
+        if (press)
+            accept(a, now);
+    }
+}
+
+/* Every edge restarts the timer, the expiry samples the settled level */
+static void run_hrtimer(const struct trace *tr, struct accepts *a) {
+    const int64_t window = HRTIMER_WINDOW_MS * NSEC_PER_MSEC;
+    int pressed = 0;
+    size_t i;
+
+    for (i = 0; i < tr->nedges; i++) {
+        int64_t expiry = tr->edges[i].t + window;
+
+        if (i + 1 < tr->nedges && tr->edges[i + 1].t < expiry)
+            continue;
+        if (!tr->edges[i].level && !pressed)
+            accept(a, expiry);
+        pressed = !tr->edges[i].level;
+    }
+}
+
+/* Polled saturating counter, pressed at INTEGRATOR_MAX, released at 0 */
+static void run_integrator(const struct trace *tr, struct accepts *a) {
+    const int64_t period = INTEGRATOR_PERIOD_MS * NSEC_PER_MSEC;
+    int64_t end = tr->edges[tr->nedges - 1].t + 2 * INTEGRATOR_MAX * period;
+    int count = 0, pressed = 0;
+    size_t pos = 0;
+    int64_t t;
+
+    for (t = 0; t < end; t += period) {
+        if (!level_at(tr, &pos, t)) {
+            if (count < INTEGRATOR_MAX && ++count == INTEGRATOR_MAX && !pressed) {
+                pressed = 1;
+                accept(a, t);
+            }
+        } else if (count > 0 && --count == 0) {
+            pressed = 0;
+        }
+    }
+}
+
+/*
+ * Controller glitch filter: the input is sampled on a slow clock and the
+ * output follows it once it has held for HW_STABLE_TICKS samples. Pulses
+ * between two samples are never seen
+ */
+static void run_hardware(const struct trace *tr, struct accepts *a) {
+    int64_t end = tr->edges[tr->nedges - 1].t + 2 * HW_STABLE_TICKS * NSEC_PER_SEC / HW_CLOCK_HZ;
+    int out = 1, stable = 0;
+    size_t pos = 0;
+    uint64_t k;
+    int64_t t;
+
+    for (k = 0; (t = k * NSEC_PER_SEC / HW_CLOCK_HZ) < end; k++) {
+        int in = level_at(tr, &pos, t);
+
+        if (in == out) {
+            stable = 0;
+            continue;
+        }
+        if (++stable < HW_STABLE_TICKS)
+            continue;
+        out = in;
+        stable = 0;
+        if (!out)
+            accept(a, t);
+    }
+}
+
+struct strategy {
+    const char *name;
+    void (*run)(const struct trace *tr, struct accepts *a);
+};
+
+static const struct strategy strategies[] = {
+    { "jiffies", run_jiffies },
+    { "adaptive", run_adaptive },
+    { "hrtimer", run_hrtimer },
+    { "integrator", run_integrator },
+    { "hardware", run_hardware },
+};
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Match accepts to presses and print one CSV row */
+static void score(const char *profile, const char *strategy, const struct trace *tr,
+                  const struct accepts *a) {
+    int64_t *lat = calloc(tr->npresses ? tr->npresses : 1, sizeof(*lat));
+    size_t i, p = 0, hits = 0, false_accepts = 0;
+    double sum = 0;
+
+    if (!lat) {
+        perror("Out of memory");
+        exit(1);
+    }
+
+    /* Both lists are in time order */
+    for (i = 0; i < a->n; i++) {
+        while (p < tr->npresses && tr->presses[p].release <= a->t[i])
+            p++;
+        if (p == tr->npresses || a->t[i] < tr->presses[p].start) {
+            false_accepts++;
+            continue;
+        }
+        lat[hits] = a->t[i] - tr->presses[p].start;
+        sum += lat[hits++];
+        /* Move past the press so later accepts in it are false */
+        p++;
+    }
+
+    qsort(lat, hits, sizeof(*lat), cmp_i64);
+    printf("%s,%s,%zu,%zu,%zu,%zu,%.1f,%.1f,%.1f\n", profile, strategy, tr->npresses, a->n,
+           false_accepts, tr->npresses - hits,
+           hits ? sum / hits / NSEC_PER_USEC : 0.0,
+           hits ? (double)lat[(hits - 1) * 99 / 100] / NSEC_PER_USEC : 0.0,
+           hits ? (double)lat[hits - 1] / NSEC_PER_USEC : 0.0);
+    free(lat);
+}
+
+static int find_profile(const char *name) {
+    int p;
+
+    for (p = 0; p < P_COUNT; p++)
+        if (strcmp(name, profile_names[p]) == 0)
+            return p;
+    return -1;
+}
+
+/* Dump one profile as t_ns,level so it can be replayed elsewhere */
+static int dump_trace(const char *name, unsigned int presses, uint64_t seed) {
+    struct trace tr;
+    int p = find_profile(name);
+    size_t i;
+
+    if (p < 0) {
+        fprintf(stderr, "Unknown profile '%s'\n", name);
+        return 1;
+    }
+    gen_trace(&tr, p, presses, seed);
+    printf("t_ns,level\n");
+    for (i = 0; i < tr.nedges; i++)
+        printf("%lld,%d\n", (long long)tr.edges[i].t, tr.edges[i].level);
+    free_trace(&tr);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int presses = DEFAULT_PRESSES;
+    uint64_t seed = DEFAULT_SEED;
+    size_t s;
+    int p;
+
+    if (argc > 1 && strcmp(argv[1], "trace") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s trace <profile> [presses] [seed]\n", argv[0]);
+            return 1;
+        }
+        if (argc > 3)
+            presses = strtoul(argv[3], NULL, 0);
+        if (argc > 4)
+            seed = strtoull(argv[4], NULL, 0);
+        return presses ? dump_trace(argv[2], presses, seed) : 1;
+    }
+
+    if (argc > 1)
+        presses = strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        seed = strtoull(argv[2], NULL, 0);
+    if (presses == 0) {
+        fprintf(stderr, "Usage: %s [presses] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    printf("profile,strategy,presses,accepted,false_accepts,missed,lat_mean_us,lat_p99_us,lat_max_us\n");
+    for (p = 0; p < P_COUNT; p++) {
+        struct trace tr;
+
+        gen_trace(&tr, p, presses, seed);
+        for (s = 0; s < sizeof(strategies) / sizeof(strategies[0]); s++) {
+            struct accepts a = { 0 };
+
+            strategies[s].run(&tr, &a);
+            score(profile_names[p], strategies[s].name, &tr, &a);
+            free(a.t);
+        }
+        free_trace(&tr);
+    }
+    return 0;
+}
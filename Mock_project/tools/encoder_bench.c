@@ -0,0 +1,186 @@
+/*
+ * Encoder step-rate benchmark
+ *
+ * Drives the encoder A/B lines of a gpio-sim chip with a clean
+ * quadrature sequence at increasing detent rates and checks that
+ * /dev/gpio_encoder reports every step. The highest rate with no missed
+ * steps and no invalid transitions is the maximum sustained step rate.
+ *
+ * The encoder node must use gpio-sim lines, e.g. with the gpio-sim
+ * controller from tools/gpio-sim-bench.dtso:
+ *     encoder-gpios = <&gpio_sim 0 0>, <&gpio_sim 1 0>;
+ *
+ * Usage: encoder_bench <gpio-sim chip sysfs dir> <line A> <line B> [detents]
+ *  e.g.  encoder_bench /sys/devices/platform/gpio-sim-bench/gpiochip2 0 1
+ */
+#define _GNU_SOURCE
+#include <stdio.h>      /* For standard I/O operations */
+#include <stdlib.h>     /* For atoi/strtoul */
+#include <string.h>     /* For strerror */
+#include <unistd.h>
+#include <fcntl.h>      /* For file control options */
+#include <errno.h>      /* For error number definitions */
+#include <time.h>       /* For clock_nanosleep */
+#include <sys/ioctl.h>  /* For device control operations */
+
+#include "../include/gpio_control.h"
+
+#define DEFAULT_DETENTS 2000   /* Detents generated per rate */
+#define DRAIN_DELAY_NS  50000000L /* Settle time before counting events */
+
+/* Detent rates to try, in detents per second */
+static const unsigned int rates[] = {
+    50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000,
+};
+
+/* Clockwise sequence, one entry per transition: which line to flip */
+static const int cw_flip[4] = { 1, 0, 1, 0 };  /* B, A, B, A */
+
+static int line_fd[2] = { -1, -1 };
+static int line_val[2];
+
+static long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void ns_to_ts(long long ns, struct timespec *ts) {
+    ts->tv_sec = ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+}
+
+/*
+ * Sets a simulated line by changing its pull, which gpio-sim turns into
+ * an input edge and IRQ
+ */
+static int set_line(int line, int value) {
+    const char *pull = value ? "pull-up" : "pull-down";
+
+    if (pwrite(line_fd[line], pull, strlen(pull), 0) < 0) {
+        fprintf(stderr, "Failed to set sim line: %s\n", strerror(errno));
+        return -1;
+    }
+    line_val[line] = value;
+    return 0;
+}
+
+static int open_line(const char *chip, const char *line, int idx) {
+    char path[256];
+
+    snprintf(path, sizeof(path), "%s/sim_gpio%s/pull", chip, line);
+    line_fd[idx] = open(path, O_WRONLY);
+    if (line_fd[idx] < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    return set_line(idx, 0);
+}
+
+/*
+ * Reads every pending event and counts STEP events
+ * Returns: step count, or -1 on error
+ */
+static long count_steps(int enc_fd, unsigned long *overruns) {
+    struct encoder_event ev[64];
+    long steps = 0;
+    ssize_t n;
+    size_t i;
+
+    for (;;) {
+        n = read(enc_fd, ev, sizeof(ev));
+        if (n < 0) {
+            if (errno == EAGAIN)
+                break;
+            perror("Failed to read encoder");
+            return -1;
+        }
+        for (i = 0; i < n / sizeof(ev[0]); i++) {
+            if (ev[i].type == ENCODER_EV_STEP)
+                steps++;
+            else if (ev[i].type == ENCODER_EV_OVERRUN)
+                *overruns += ev[i].value;
+        }
+    }
+    return steps;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int detents = DEFAULT_DETENTS;
+    unsigned int best = 0;
+    struct encoder_stats stats;
+    struct timespec ts;
+    int enc_fd;
+    size_t r;
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <gpio-sim chip sysfs dir> <line A> <line B> [detents]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 4)
+        detents = strtoul(argv[4], NULL, 0);
+
+    if (open_line(argv[1], argv[2], 0) < 0 || open_line(argv[1], argv[3], 1) < 0)
+        return 1;
+
+    enc_fd = open(ENCODER_DEVICE, O_RDONLY | O_NONBLOCK);
+    if (enc_fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", ENCODER_DEVICE, strerror(errno));
+        return 1;
+    }
+
+    printf("rate_hz,achieved_hz,detents,steps,missed,invalid,overruns,min_step_ns\n");
+
+    for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        long long period = 1000000000LL / (rates[r] * 4);
+        long long start, next, elapsed;
+        unsigned long overruns = 0;
+        unsigned int i;
+        long steps;
+        int t;
+
+        ioctl(enc_fd, ENCODER_IOC_RESET);
+        count_steps(enc_fd, &overruns);
+        overruns = 0;
+
+        start = next = now_ns();
+        for (i = 0; i < detents; i++) {
+            for (t = 0; t < 4; t++) {
+                int line = cw_flip[t];
+
+                next += period;
+                ns_to_ts(next, &ts);
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+                if (set_line(line, !line_val[line]) < 0)
+                    return 1;
+            }
+        }
+        elapsed = now_ns() - start;
+
+        ns_to_ts(now_ns() + DRAIN_DELAY_NS, &ts);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        steps = count_steps(enc_fd, &overruns);
+        if (steps < 0 || ioctl(enc_fd, ENCODER_IOC_GET_STATS, &stats) < 0) {
+            perror("Failed to collect results");
+            return 1;
+        }
+
+        printf("%u,%.0f,%u,%ld,%ld,%llu,%lu,%llu\n", rates[r],
+               detents * 1e9 / elapsed, detents, steps, (long)detents - steps,
+               (unsigned long long)stats.invalid, overruns,
+               (unsigned long long)stats.min_step_ns);
+
+        if (steps != (long)detents || stats.invalid || overruns)
+            break;
+        best = rates[r];
+    }
+
+    printf("max_sustained_rate_hz,%u\n", best);
+
+    close(enc_fd);
+    close(line_fd[0]);
+    close(line_fd[1]);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * LED waveform playback tool
+ *
+ * Streams a binary counter pattern (LED N toggles every 2^N periods) to
+ * the led_driver waveform player. Buffers are queued with
+ * LED_IOC_WAVE_QUEUE, which blocks while both kernel buffers are full, so
+ * one is refilled while the other plays and long sequences run without
+ * gaps. The kernel hrtimer drives every transition; this process only
+ * keeps the queue fed. Lateness statistics are printed as CSV at the end.
+ *
+ * Usage: led_wave <period_us> <transitions> [steps_per_buffer]
+ *  e.g.  led_wave 100 100000
+ */
+#include <stdio.h>      /* For standard I/O operations */
+#include <stdlib.h>     /* For strtoul */
+#include <string.h>     /* For strerror */
+#include <unistd.h>
+#include <fcntl.h>      /* For file control options */
+#include <errno.h>      /* For error number definitions */
+#include <stdint.h>     /* For uintptr_t */
+#include <sys/ioctl.h>  /* For device control operations */
+
+#include "../include/gpio_control.h"
+
+#define LED_DEVICE "/dev/gpio_led0"
+
+static struct led_wave_step steps[LED_WAVE_MAX_STEPS];
+
+static void print_stats(const struct led_wave_stats *st) {
+    int i;
+
+    printf("transitions,buffers,underruns,late_min_ns,late_mean_ns,late_max_ns\n");
+    printf("%llu,%u,%u,%llu,%llu,%llu\n", (unsigned long long)st->transitions,
+           st->buffers, st->underruns, (unsigned long long)st->late_min_ns,
+           (unsigned long long)st->late_mean_ns, (unsigned long long)st->late_max_ns);
+
+    printf("late_us_below,count\n");
+    for (i = 0; i < 16; i++)
+        printf("%u,%u\n", 1u << i, st->late_hist[i]);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long period_us, total, per_buf = LED_WAVE_MAX_STEPS;
+    unsigned long sent = 0;
+    struct led_wave_stats st;
+    int started = 0;
+    int fd;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <period_us> <transitions> [steps_per_buffer]\n", argv[0]);
+        return 1;
+    }
+    period_us = strtoul(argv[1], NULL, 0);
+    total = strtoul(argv[2], NULL, 0);
+    if (argc > 3)
+        per_buf = strtoul(argv[3], NULL, 0);
+    if (period_us == 0 || period_us > 4000000 || per_buf == 0 || per_buf > LED_WAVE_MAX_STEPS) {
+        fprintf(stderr, "Invalid period or buffer size\n");
+        return 1;
+    }
+
+    fd = open(LED_DEVICE, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", LED_DEVICE, strerror(errno));
+        return 1;
+    }
+    ioctl(fd, LED_IOC_WAVE_STOP);
+
+    while (sent < total) {
+        struct led_wave_buffer buf;
+        unsigned long i, n = total - sent < per_buf ? total - sent : per_buf;
+
+        for (i = 0; i < n; i++) {
+            steps[i].delta_ns = period_us * 1000;
+            steps[i].value = (sent + i + 1) & 0x7;
+        }
+        buf.steps = (uintptr_t)steps;
+        buf.count = n;
+        buf.flags = sent + n < total ? LED_WAVE_MORE : 0;
+
+        if (ioctl(fd, LED_IOC_WAVE_QUEUE, &buf) < 0) {
+            perror("Failed to queue waveform");
+            return 1;
+        }
+        sent += n;
+
+        // Start once both buffers are filled so the first switch has a spare
+        if (!started && (sent >= 2 * per_buf || sent == total)) {
+            if (ioctl(fd, LED_IOC_WAVE_START) < 0) {
+                perror("Failed to start playback");
+                return 1;
+            }
+            started = 1;
+        }
+    }
+
+    // Wait for the tail of the sequence to play out
+    do {
+        usleep(period_us < 10000 ? 10000 : period_us);
+        if (ioctl(fd, LED_IOC_WAVE_STATS, &st) < 0) {
+            perror("Failed to read stats");
+            return 1;
+        }
+    } while (st.running);
+
+    print_stats(&st);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,492 @@
+/*
+ * Button -> LED pipeline latency breakdown from ftrace or perf data
+ *
+ * Reads the gpio_button and gpio_led tracepoints (button_trace.h,
+ * led_trace.h), stitches every accepted press to the LED change it caused
+ * and splits the time into stages:
+ *   hardirq:   irq_handler_entry -> debounce accepted the edge
+ *   debounce:  first edge of the burst -> the accepted edge's IRQ. Zero
+ *              while the leading-edge filter takes the first edge; grows
+ *              when the learnt window swallowed the real press
+ *   window:    PRESS -> multi-press window closed (timeout or 5 presses),
+ *              zero when a PRESS rule drove the LEDs directly
+ *   workqueue: window closed (or PRESS) -> rule worker evaluated the event,
+ *              both work items included
+ *   write:     rule evaluated -> led_change, i.e. the GPIO array write
+ * Edges are tied to events by the button_event sequence number, events to
+ * rules by the same number and rules to LED changes by the worker's pid.
+ *
+ * Per stage min/p50/p90/p99/max are printed as CSV. The multi-press
+ * window is a designed delay that depends on where the press fell in the
+ * window, so outliers are judged on the total without it: edges above the
+ * threshold (-t, default p50 + k * MAD) are listed with the stage that
+ * exceeded its own median the most.
+ *
+ * Capture, e.g.:
+ *   cd /sys/kernel/tracing
+ *   echo 1 > events/gpio_button/enable; echo 1 > events/gpio_led/enable
+ *   echo 1 > events/irq/irq_handler_entry/enable    (optional, for hardirq)
+ *   ... press buttons ...; cat trace > /tmp/pipe.txt
+ * or  perf record -e 'gpio_button:*' -e 'gpio_led:*' -e irq:irq_handler_entry -a
+ *     perf script --ns > /tmp/pipe.txt
+ *
+ * Usage: pipeline_latency [-k factor] [-t threshold_us] [-q quiet_ms]
+ *                         [-n irq_name] [-r] [trace file|-]
+ *   -q: gap that starts a new burst, keep at debounce-max-ms
+ *   -r: print every stitched edge instead of the summary
+ */
+#include <stdio.h>      /* For standard I/O operations */
+#include <stdlib.h>     /* For strtoul/qsort */
+#include <string.h>     /* For strstr */
+#include <errno.h>      /* For error number definitions */
+#include <getopt.h>
+#include <stdint.h>
+#include <math.h>       /* For llround */
+
+#include "../include/gpio_control.h"
+
+#define MAX_CPUS        256
+#define MAX_KEYS        BUTTON_MAX_KEYS
+#define MAX_GROUP       16          /* Presses tracked per multi-press window */
+#define MAX_WRITERS     32          /* Rule workers with a pending LED write */
+#define SEQ_SLOTS       4096        /* Event sequence lookup, power of two */
+#define IRQ_MAX_NS      1000000     /* IRQ entry this close to the edge */
+#define DEFAULT_QUIET_MS 50
+#define DEFAULT_K       5.0
+
+enum stage { ST_HARDIRQ, ST_DEBOUNCE, ST_WINDOW, ST_WORKQUEUE, ST_WRITE, ST_TOTAL, NUM_STAGES };
+
+static const char *stage_names[NUM_STAGES] = {
+    "hardirq", "debounce", "window", "workqueue", "write", "total",
+};
+
+/* One accepted edge on its way to the LEDs */
+struct record {
+    uint64_t seq;       /* PRESS event sequence number */
+    int key;
+    int64_t start;      /* First edge of the burst */
+    int64_t irq;        /* IRQ entry of the accepted edge */
+    int64_t edge;       /* Debounce accepted the edge */
+    int64_t close;      /* Multi-press window closed, 0 on the direct path */
+    int64_t rule;       /* Rule worker evaluated the event */
+    int64_t led;        /* LED change */
+    int done;
+    int64_t stage[NUM_STAGES];
+};
+
+/* Presses of key 0 collected by one multi-press window */
+struct group {
+    uint64_t seq;       /* MULTI_PRESS event, 0 until queued */
+    int64_t close;
+    int n;
+    int rec[MAX_GROUP];
+};
+
+/* Event sequence number -> record (PRESS) or group (MULTI_PRESS) */
+struct seq_slot {
+    uint64_t seq;
+    int is_group;
+    int idx;
+};
+
+/* Rule worker waiting for its LED change */
+struct writer {
+    long pid;
+    int64_t rule;
+    int is_group;
+    int idx;
+};
+
+static struct record *recs;
+static size_t num_recs, cap_recs;
+static struct group *groups;
+static size_t num_groups, cap_groups;
+static int open_group = -1;     /* Collecting presses */
+static int closed_group = -1;   /* Window closed, MULTI_PRESS not queued yet */
+
+static struct seq_slot seq_map[SEQ_SLOTS];
+static struct writer writers[MAX_WRITERS];
+static int64_t last_irq[MAX_CPUS];
+static int64_t burst_start[MAX_KEYS];
+static int pending_edge[MAX_CPUS];  /* Record waiting for its PRESS event, -1 if none */
+
+static int64_t quiet_ns = DEFAULT_QUIET_MS * 1000000LL;
+static const char *irq_name = "button_irq";
+static unsigned long edges, releases, rejected, lines;
+
+static void *grow(void *p, size_t *cap, size_t size) {
+    size_t n = *cap ? *cap * 2 : 256;
+
+    p = realloc(p, n * size);
+    if (!p) {
+        perror("realloc");
+        exit(1);
+    }
+    *cap = n;
+    return p;
+}
+
+/* Value of "name=" in the tracepoint arguments, 0 if missing */
+static uint64_t field(const char *args, const char *name) {
+    size_t len = strlen(name);
+    const char *p = args;
+
+    while ((p = strstr(p, name)) != NULL) {
+        if ((p == args || p[-1] == ' ') && p[len] == '=')
+            return strtoull(p + len + 1, NULL, 0);
+        p += len;
+    }
+    return 0;
+}
+
+static void seq_put(uint64_t seq, int is_group, int idx) {
+    struct seq_slot *s = &seq_map[seq & (SEQ_SLOTS - 1)];
+
+    s->seq = seq;
+    s->is_group = is_group;
+    s->idx = idx;
+}
+
+static struct seq_slot *seq_get(uint64_t seq) {
+    struct seq_slot *s = &seq_map[seq & (SEQ_SLOTS - 1)];
+
+    return s->seq == seq ? s : NULL;
+}
+
+static struct writer *writer_get(long pid, int create) {
+    struct writer *free_w = NULL;
+    int i;
+
+    for (i = 0; i < MAX_WRITERS; i++) {
+        if (writers[i].pid == pid)
+            return &writers[i];
+        if (!writers[i].pid && !free_w)
+            free_w = &writers[i];
+    }
+    if (create && !free_w)
+        free_w = &writers[0];
+    if (create)
+        free_w->pid = pid;
+    return create ? free_w : NULL;
+}
+
+static void finish(int idx, int64_t close, int64_t rule, int64_t led) {
+    struct record *r = &recs[idx];
+
+    if (r->done)
+        return;
+    r->close = close;
+    r->rule = rule;
+    r->led = led;
+    r->done = 1;
+
+    r->stage[ST_HARDIRQ] = r->edge - r->irq;
+    r->stage[ST_DEBOUNCE] = r->irq - r->start;
+    r->stage[ST_WINDOW] = close ? close - r->edge : 0;
+    r->stage[ST_WORKQUEUE] = rule - (close ? close : r->edge);
+    r->stage[ST_WRITE] = led - rule;
+    r->stage[ST_TOTAL] = led - r->start;
+}
+
+static void on_irq(int cpu, int64_t ts, const char *args) {
+    const char *name = strstr(args, "name=");
+
+    if (name && !strncmp(name + 5, irq_name, strlen(irq_name)))
+        last_irq[cpu] = ts;
+}
+
+static void on_edge(int cpu, int64_t ts, const char *args) {
+    unsigned int key = field(args, "key");
+    uint64_t gap = field(args, "gap_ns");
+    int64_t t = ts;
+    struct record *r;
+
+    if (key >= MAX_KEYS)
+        return;
+    if (last_irq[cpu] && ts - last_irq[cpu] >= 0 && ts - last_irq[cpu] < IRQ_MAX_NS)
+        t = last_irq[cpu];
+    last_irq[cpu] = 0;
+
+    /* gap_ns is 0 on the first edge of a key */
+    if (!gap || (int64_t)gap >= quiet_ns || !burst_start[key])
+        burst_start[key] = t;
+
+    if (!field(args, "accepted")) {
+        rejected++;
+        return;
+    }
+    /* Accepted releases end a bounce burst but queue no event */
+    if (field(args, "release")) {
+        releases++;
+        return;
+    }
+    edges++;
+    if (num_recs == cap_recs)
+        recs = grow(recs, &cap_recs, sizeof(*recs));
+    r = &recs[num_recs];
+    memset(r, 0, sizeof(*r));
+    r->key = key;
+    r->start = burst_start[key] < t ? burst_start[key] : t;
+    r->irq = t;
+    r->edge = ts;
+    pending_edge[cpu] = num_recs++;
+}
+
+static void on_event(int cpu, int64_t ts, const char *args) {
+    uint64_t seq = field(args, "seq");
+    unsigned int type = field(args, "type");
+    int idx = pending_edge[cpu];
+    struct group *g;
+
+    (void)ts;
+    if (type == BUTTON_EV_PRESS && idx >= 0) {
+        pending_edge[cpu] = -1;
+        recs[idx].seq = seq;
+        seq_put(seq, 0, idx);
+        if (recs[idx].key != 0)
+            return;
+
+        if (open_group < 0) {
+            if (num_groups == cap_groups)
+                groups = grow(groups, &cap_groups, sizeof(*groups));
+            memset(&groups[num_groups], 0, sizeof(groups[0]));
+            open_group = num_groups++;
+        }
+        g = &groups[open_group];
+        if (g->n < MAX_GROUP)
+            g->rec[g->n++] = idx;
+    } else if (type == BUTTON_EV_MULTI_PRESS && closed_group >= 0) {
+        groups[closed_group].seq = seq;
+        seq_put(seq, 1, closed_group);
+        closed_group = -1;
+    }
+}
+
+static void on_window(int64_t ts) {
+    if (open_group < 0)
+        return;
+    groups[open_group].close = ts;
+    closed_group = open_group;
+    open_group = -1;
+}
+
+static void on_rule(long pid, int64_t ts, const char *args) {
+    struct seq_slot *s = seq_get(field(args, "seq"));
+    struct writer *w;
+
+    if (!s)
+        return;
+    w = writer_get(pid, 1);
+    if (!field(args, "leds")) {
+        w->pid = 0;
+        return;
+    }
+    w->rule = ts;
+    w->is_group = s->is_group;
+    w->idx = s->idx;
+}
+
+static void on_led(long pid, int64_t ts, const char *args) {
+    struct writer *w = writer_get(pid, 0);
+    struct group *g;
+    int i;
+
+    if (!w || field(args, "source") != LED_SRC_PROVIDER)
+        return;
+    if (w->is_group) {
+        g = &groups[w->idx];
+        for (i = 0; i < g->n; i++)
+            finish(g->rec[i], g->close, w->rule, ts);
+    } else {
+        finish(w->idx, 0, w->rule, ts);
+    }
+    w->pid = 0;
+}
+
+/*
+ * Parse one ftrace or perf script line
+ *   ftrace: <comm>-<pid> [cpu] <flags> <sec.usec>: <event>: <args>
+ *   perf:   <comm> <pid> [cpu] <sec.nsec>: <system>:<event>: <args>
+ */
+static void parse_line(char *line) {
+    char *tok[32], *end = line + strlen(line), *args, *name, *p;
+    int n = 0, cpu = -1, ev = -1;
+    long pid = 0;
+    int64_t ts = -1;
+
+    lines++;
+    if (line[0] == '#')
+        return;
+    for (p = strtok(line, " \t\n"); p && n < 32; p = strtok(NULL, " \t\n")) {
+        tok[n++] = p;
+        /* The event is the first token after the timestamp */
+        if (ts >= 0 && ev < 0) {
+            ev = n - 1;
+            break;
+        }
+        if (p[0] == '[' && cpu < 0 && n > 1) {
+            cpu = atoi(p + 1);
+            p = strrchr(tok[n - 2], '-');
+            p = p ? p + 1 : tok[n - 2];
+            pid = strtol(p, NULL, 10);
+        } else if (cpu >= 0 && p[strlen(p) - 1] == ':' && strchr(p, '.')) {
+            ts = llround(strtod(p, NULL) * 1e9);
+        }
+    }
+    if (ev < 0 || cpu < 0 || cpu >= MAX_CPUS)
+        return;
+
+    /* Arguments start past the '\0' strtok wrote after the event */
+    name = tok[ev];
+    args = name + strlen(name) + 1;
+    if (args > end)
+        args = end;
+    args += strspn(args, " \t");
+    name[strlen(name) - 1] = '\0';
+    p = strrchr(name, ':');
+    if (p)
+        name = p + 1;
+
+    if (!strcmp(name, "irq_handler_entry"))
+        on_irq(cpu, ts, args);
+    else if (!strcmp(name, "button_edge"))
+        on_edge(cpu, ts, args);
+    else if (!strcmp(name, "button_event"))
+        on_event(cpu, ts, args);
+    else if (!strcmp(name, "button_press_window"))
+        on_window(ts);
+    else if (!strcmp(name, "button_rule"))
+        on_rule(pid, ts, args);
+    else if (!strcmp(name, "led_change"))
+        on_led(pid, ts, args);
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int64_t pct(const int64_t *v, size_t n, int p) {
+    return v[(n - 1) * p / 100];
+}
+
+static double us(int64_t ns) {
+    return ns / 1000.0;
+}
+
+/* Latency the pipeline added on top of the multi-press window */
+static int64_t active(const struct record *r) {
+    return r->stage[ST_TOTAL] - r->stage[ST_WINDOW];
+}
+
+int main(int argc, char *argv[]) {
+    static char line[4096];
+    int64_t *v, med[NUM_STAGES] = { 0 }, *dev, med_active, mad, threshold = -1;
+    double k = DEFAULT_K;
+    int raw = 0, opt, s;
+    size_t i, n;
+    FILE *in = stdin;
+
+    while ((opt = getopt(argc, argv, "k:t:q:n:r")) != -1) {
+        switch (opt) {
+            case 'k': k = strtod(optarg, NULL); break;
+            case 't': threshold = strtoll(optarg, NULL, 0) * 1000; break;
+            case 'q': quiet_ns = strtoll(optarg, NULL, 0) * 1000000LL; break;
+            case 'n': irq_name = optarg; break;
+            case 'r': raw = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-k factor] [-t threshold_us] [-q quiet_ms] "
+                        "[-n irq_name] [-r] [trace file|-]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind < argc && strcmp(argv[optind], "-")) {
+        in = fopen(argv[optind], "r");
+        if (!in) {
+            fprintf(stderr, "Failed to open %s: %s\n", argv[optind], strerror(errno));
+            return 1;
+        }
+    }
+
+    memset(pending_edge, -1, sizeof(pending_edge));
+    while (fgets(line, sizeof(line), in))
+        parse_line(line);
+    if (in != stdin)
+        fclose(in);
+
+    /* Keep only the stitched edges */
+    for (i = n = 0; i < num_recs; i++) {
+        if (recs[i].done)
+            recs[n++] = recs[i];
+    }
+    fprintf(stderr, "%lu lines, %lu presses and %lu releases accepted, %lu rejected, "
+            "%zu stitched to an LED change\n", lines, edges, releases, rejected, n);
+    if (!n)
+        return edges ? 2 : 1;
+
+    if (raw) {
+        printf("seq,key,hardirq_us,debounce_us,window_us,workqueue_us,write_us,total_us\n");
+        for (i = 0; i < n; i++) {
+            printf("%llu,%d", (unsigned long long)recs[i].seq, recs[i].key);
+            for (s = 0; s < NUM_STAGES; s++)
+                printf(",%.1f", us(recs[i].stage[s]));
+            printf("\n");
+        }
+        return 0;
+    }
+
+    v = malloc(n * sizeof(*v));
+    dev = malloc(n * sizeof(*dev));
+    if (!v || !dev) {
+        perror("malloc");
+        return 1;
+    }
+
+    printf("stage,count,min_us,p50_us,p90_us,p99_us,max_us\n");
+    for (s = 0; s < NUM_STAGES; s++) {
+        for (i = 0; i < n; i++)
+            v[i] = recs[i].stage[s];
+        qsort(v, n, sizeof(*v), cmp_i64);
+        med[s] = pct(v, n, 50);
+        printf("%s,%zu,%.1f,%.1f,%.1f,%.1f,%.1f\n", stage_names[s], n, us(v[0]),
+               us(med[s]), us(pct(v, n, 90)), us(pct(v, n, 99)), us(v[n - 1]));
+    }
+
+    for (i = 0; i < n; i++)
+        v[i] = active(&recs[i]);
+    qsort(v, n, sizeof(*v), cmp_i64);
+    med_active = pct(v, n, 50);
+
+    /* Median absolute deviation, at least 1 us */
+    if (threshold < 0) {
+        for (i = 0; i < n; i++)
+            dev[i] = llabs(active(&recs[i]) - med_active);
+        qsort(dev, n, sizeof(*dev), cmp_i64);
+        mad = pct(dev, n, 50);
+        if (mad < 1000)
+            mad = 1000;
+        threshold = med_active + (int64_t)(k * mad);
+    }
+
+    printf("\noutlier_seq,key,total_us,active_us,stage,stage_us,stage_p50_us\n");
+    for (i = 0; i < n; i++) {
+        struct record *r = &recs[i];
+        int worst = ST_HARDIRQ;
+
+        if (active(r) <= threshold)
+            continue;
+        for (s = ST_HARDIRQ; s < ST_TOTAL; s++) {
+            if (s != ST_WINDOW && r->stage[s] - med[s] > r->stage[worst] - med[worst])
+                worst = s;
+        }
+        printf("%llu,%d,%.1f,%.1f,%s,%.1f,%.1f\n", (unsigned long long)r->seq, r->key,
+               us(r->stage[ST_TOTAL]), us(active(r)), stage_names[worst],
+               us(r->stage[worst]), us(med[worst]));
+    }
+    fprintf(stderr, "Outlier threshold %.1f us without the multi-press window\n", us(threshold));
+
+    free(v);
+    free(dev);
+    return 0;
+}
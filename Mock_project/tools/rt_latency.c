@@ -0,0 +1,380 @@
+/*
+ * Edge delivery latency test, in the style of cyclictest
+ *
+ * A generator thread presses a simulated button at a steady rate by
+ * flipping the pull of a gpio-sim line, and a SCHED_FIFO, mlockall'd
+ * reader blocked in read() on the driver's event interface timestamps
+ * its wakeup. Per edge three latencies are measured on CLOCK_MONOTONIC:
+ *   irq:   edge injected -> event timestamp (driver IRQ path)
+ *   wake:  event timestamp -> reader running (scheduler wakeup)
+ *   total: edge injected -> reader running, histogrammed in 1 us bins
+ *
+ * The generator runs one priority below the reader so the wakeup is not
+ * delayed behind it. A status line is printed every second and the full
+ * histogram, cyclictest format, when the run ends (-D or Ctrl-C).
+ *
+ * With -b <us>, every new maximum above the threshold takes an ftrace
+ * snapshot (/sys/kernel/tracing/snapshot, needs CONFIG_TRACER_SNAPSHOT)
+ * so the worst wakeup can be inspected after the run. Set up tracing
+ * first, e.g. the sched_wakeup/sched_switch and irq events.
+ *
+ * The button or push line must be on gpio-sim, see gpio-sim-bench.dtso.
+ * Keep the interval well above the debounce window (button_driver:
+ * debounce-max-ms) or presses get rejected and show up as missed.
+ *
+ * Usage: rt_latency [-d button|encoder] [-i interval_us] [-p prio]
+ *                   [-D seconds] [-H buckets] [-b threshold_us] [-q]
+ *                   <gpio-sim chip sysfs dir> <line>
+ *  e.g.  rt_latency -D 7200 -b 200 /sys/devices/platform/gpio-sim-bench/gpiochip2 3
+ */
+#define _GNU_SOURCE
+#include <stdio.h>      /* For standard I/O operations */
+#include <stdlib.h>     /* For strtoul/calloc */
+#include <string.h>     /* For strerror */
+#include <unistd.h>
+#include <fcntl.h>      /* For file control options */
+#include <errno.h>      /* For error number definitions */
+#include <signal.h>     /* For Ctrl-C handling */
+#include <time.h>       /* For clock_nanosleep */
+#include <pthread.h>    /* For the generator thread */
+#include <sched.h>      /* For SCHED_FIFO */
+#include <getopt.h>
+#include <stdint.h>
+#include <sys/ioctl.h>  /* For device control operations */
+#include <sys/mman.h>   /* For mlockall */
+
+#include "../include/gpio_control.h"
+
+#define DEFAULT_INTERVAL_US 100000  /* 10 presses per second */
+#define DEFAULT_PRIO        80
+#define DEFAULT_BUCKETS     1000    /* 1 us bins, 0-999 us */
+#define PRESS_HOLD_US       10000   /* Line held low this long per press */
+#define SNAPSHOT_PATH       "/sys/kernel/tracing/snapshot"
+#define READ_EVENTS         16
+
+enum dev_kind { DEV_BUTTON, DEV_ENCODER };
+
+struct lat_stat {
+    int64_t min, max;
+    double sum;
+};
+
+static volatile sig_atomic_t stop;
+static int pull_fd = -1;
+static enum dev_kind kind = DEV_BUTTON;
+static unsigned int interval_us = DEFAULT_INTERVAL_US;
+static int prio = DEFAULT_PRIO;
+
+/* Written by the generator, read by the reader after the wakeup */
+static int64_t edge_ns;             /* Injection time of the last press */
+static unsigned long edges;         /* Presses injected */
+
+static void handle_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void ns_to_ts(int64_t ns, struct timespec *ts) {
+    ts->tv_sec = ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+}
+
+/* Active low: pull-down presses, pull-up releases */
+static int set_pressed(int pressed) {
+    const char *pull = pressed ? "pull-down" : "pull-up";
+
+    if (pwrite(pull_fd, pull, strlen(pull), 0) < 0) {
+        fprintf(stderr, "Failed to set sim line: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int set_fifo(int p) {
+    struct sched_param sp = { .sched_priority = p };
+    int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+
+    if (ret)
+        fprintf(stderr, "Failed to set SCHED_FIFO %d: %s\n", p, strerror(ret));
+    return ret ? -1 : 0;
+}
+
+static void *generator(void *arg) {
+    int64_t next = now_ns();
+    struct timespec ts;
+
+    (void)arg;
+    set_fifo(prio > 1 ? prio - 1 : 1);
+
+    while (!stop) {
+        next += (int64_t)interval_us * 1000;
+        ns_to_ts(next, &ts);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        __atomic_store_n(&edge_ns, now_ns(), __ATOMIC_RELEASE);
+        __atomic_add_fetch(&edges, 1, __ATOMIC_RELEASE);
+        if (set_pressed(1) < 0)
+            break;
+
+        ns_to_ts(next + PRESS_HOLD_US * 1000LL, &ts);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        if (set_pressed(0) < 0)
+            break;
+    }
+    stop = 1;
+    return NULL;
+}
+
+/* Put the device in event mode and keep only press events */
+static int open_device(void) {
+    const char *path = kind == DEV_BUTTON ? BUTTON_DEVICE : ENCODER_DEVICE;
+    int fd = open(path, O_RDONLY);
+    int on = 1;
+
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (kind == DEV_BUTTON) {
+        struct gpio_event_filter filter = {
+            .types = 1u << BUTTON_EV_PRESS | 1u << BUTTON_EV_OVERRUN,
+        };
+
+        if (ioctl(fd, BUTTON_IOC_EVENT_MODE, &on) < 0 ||
+            ioctl(fd, BUTTON_IOC_SET_FILTER, &filter) < 0) {
+            perror("Failed to set up button event mode");
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+/*
+ * Block until the next press event
+ * Returns: event timestamp, 0 if the read was interrupted, -1 on error
+ */
+static int64_t wait_press(int fd, unsigned long *overruns) {
+    union {
+        struct button_event button[READ_EVENTS];
+        struct encoder_event encoder[READ_EVENTS];
+    } ev;
+    ssize_t n;
+    size_t i;
+
+    n = read(fd, &ev, sizeof(ev));
+    if (n < 0)
+        return errno == EINTR ? 0 : -1;
+
+    if (kind == DEV_BUTTON) {
+        for (i = 0; i < n / sizeof(ev.button[0]); i++) {
+            if (ev.button[i].type == BUTTON_EV_OVERRUN)
+                *overruns += ev.button[i].value;
+            else if (ev.button[i].type == BUTTON_EV_PRESS)
+                return ev.button[i].timestamp;
+        }
+    } else {
+        for (i = 0; i < n / sizeof(ev.encoder[0]); i++) {
+            if (ev.encoder[i].type == ENCODER_EV_OVERRUN)
+                *overruns += ev.encoder[i].value;
+            else if (ev.encoder[i].type == ENCODER_EV_PUSH)
+                return ev.encoder[i].timestamp;
+        }
+    }
+    return 0;
+}
+
+static void stat_add(struct lat_stat *s, int64_t v, unsigned long n) {
+    if (n == 1 || v < s->min)
+        s->min = v;
+    if (n == 1 || v > s->max)
+        s->max = v;
+    s->sum += v;
+}
+
+static int take_snapshot(void) {
+    int fd = open(SNAPSHOT_PATH, O_WRONLY);
+    int ret = 0;
+
+    if (fd < 0 || write(fd, "1", 1) != 1)
+        ret = -1;
+    if (fd >= 0)
+        close(fd);
+    return ret;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-d button|encoder] [-i interval_us] [-p prio] [-D seconds]\n"
+            "          [-H buckets] [-b threshold_us] [-q] <gpio-sim chip dir> <line>\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int buckets = DEFAULT_BUCKETS, duration = 0, threshold_us = 0;
+    unsigned long samples = 0, overflows = 0, overruns = 0, spurious = 0, snapshots = 0;
+    unsigned long last_edges = 0, *hist;
+    struct lat_stat irq = { 0 }, wake = { 0 }, total = { 0 };
+    struct sigaction sa = { .sa_handler = handle_signal };
+    sigset_t sigs, old;
+    int64_t start, next_status, end = 0;
+    char path[256];
+    pthread_t gen;
+    int quiet = 0, fd, opt;
+    unsigned int i;
+
+    while ((opt = getopt(argc, argv, "d:i:p:D:H:b:q")) != -1) {
+        switch (opt) {
+            case 'd':
+                if (strcmp(optarg, "button") == 0) {
+                    kind = DEV_BUTTON;
+                } else if (strcmp(optarg, "encoder") == 0) {
+                    kind = DEV_ENCODER;
+                } else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'i': interval_us = strtoul(optarg, NULL, 0); break;
+            case 'p': prio = atoi(optarg); break;
+            case 'D': duration = strtoul(optarg, NULL, 0); break;
+            case 'H': buckets = strtoul(optarg, NULL, 0); break;
+            case 'b': threshold_us = strtoul(optarg, NULL, 0); break;
+            case 'q': quiet = 1; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind != 2 || interval_us <= PRESS_HOLD_US * 2 || buckets == 0 ||
+        prio < 1 || prio > 99) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    hist = calloc(buckets, sizeof(*hist));
+    if (!hist) {
+        perror("Out of memory");
+        return 1;
+    }
+
+    snprintf(path, sizeof(path), "%s/sim_gpio%s/pull", argv[optind], argv[optind + 1]);
+    pull_fd = open(path, O_WRONLY);
+    if (pull_fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    if (set_pressed(0) < 0)
+        return 1;
+
+    fd = open_device();
+    if (fd < 0)
+        return 1;
+
+    /* No page faults once measuring; the histogram was touched by calloc */
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+        perror("mlockall failed, page faults may show up as latency");
+    if (set_fifo(prio) < 0)
+        fprintf(stderr, "Running without RT priority, results are not meaningful\n");
+
+    /* No SA_RESTART so Ctrl-C gets the reader out of read() */
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGALRM, &sa, NULL);
+
+    /* Signals must hit the reader, the generator inherits them blocked */
+    sigfillset(&sigs);
+    pthread_sigmask(SIG_BLOCK, &sigs, &old);
+    if (pthread_create(&gen, NULL, generator, NULL)) {
+        fprintf(stderr, "Failed to start generator thread\n");
+        return 1;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (duration)
+        alarm(duration);
+
+    start = now_ns();
+    next_status = start + 1000000000LL;
+    while (!stop) {
+        int64_t ts = wait_press(fd, &overruns);
+        int64_t woke = now_ns();
+        int64_t injected, lat;
+        unsigned long seen;
+
+        if (ts < 0) {
+            perror("Failed to read events");
+            break;
+        }
+        if (ts == 0)
+            continue;
+
+        seen = __atomic_load_n(&edges, __ATOMIC_ACQUIRE);
+        injected = __atomic_load_n(&edge_ns, __ATOMIC_ACQUIRE);
+        if (seen == last_edges || ts < injected) {
+            /* Not caused by a press we injected (or a late duplicate) */
+            spurious++;
+            continue;
+        }
+        last_edges = seen;
+        samples++;
+
+        lat = (woke - injected) / 1000;
+        stat_add(&irq, ts - injected, samples);
+        stat_add(&wake, woke - ts, samples);
+        stat_add(&total, woke - injected, samples);
+        if (lat < buckets)
+            hist[lat]++;
+        else
+            overflows++;
+
+        if (threshold_us && lat > threshold_us && woke - injected == total.max) {
+            int ok = take_snapshot() == 0;
+
+            snapshots += ok;
+            fprintf(stderr, "Latency %lld us above %u us, %s\n", (long long)lat, threshold_us,
+                    ok ? "ftrace snapshot taken" : "ftrace snapshot failed");
+        }
+
+        if (!quiet && woke >= next_status) {
+            fprintf(stderr, "T:%6lds C:%9lu Min:%7lld Avg:%7.0f Max:%7lld us\n",
+                    (long)((woke - start) / 1000000000LL), samples,
+                    (long long)total.min / 1000, total.sum / samples / 1000,
+                    (long long)total.max / 1000);
+            next_status += 1000000000LL;
+        }
+    }
+    stop = 1;
+    end = now_ns();
+    pthread_join(gen, NULL);
+    set_pressed(0);
+
+    printf("# Edge delivery latency, %s, interval %u us, prio %d, %.0f s\n",
+           kind == DEV_BUTTON ? "button" : "encoder push", interval_us, prio,
+           (end - start) / 1e9);
+    printf("# Histogram (total, us)\n");
+    for (i = 0; i < buckets; i++)
+        if (hist[i])
+            printf("%06u %06lu\n", i, hist[i]);
+    printf("# Total: %09lu\n", samples);
+    if (samples) {
+        printf("# Min Latencies: irq %lld wake %lld total %lld ns\n",
+               (long long)irq.min, (long long)wake.min, (long long)total.min);
+        printf("# Avg Latencies: irq %.0f wake %.0f total %.0f ns\n",
+               irq.sum / samples, wake.sum / samples, total.sum / samples);
+        printf("# Max Latencies: irq %lld wake %lld total %lld ns\n",
+               (long long)irq.max, (long long)wake.max, (long long)total.max);
+    }
+    printf("# Histogram Overflows: %05lu\n", overflows);
+    printf("# Presses: %lu Missed: %lu Spurious: %lu Overruns: %lu Snapshots: %lu\n",
+           edges, edges > samples ? edges - samples : 0, spurious, overruns, snapshots);
+
+    free(hist);
+    close(fd);
+    close(pull_fd);
+    return 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * LED command submission benchmark: ioctl vs io_uring vs SQPOLL io_uring
+ *
+ * Toggles one LED ops times in each mode and prints CSV:
+ *  - ioctl:  one GPIO_IOC_LED_TOGGLE syscall per op
+ *  - uring:  LED_URING_CMD_TOGGLE, batch ops per io_uring_enter
+ *  - sqpoll: same commands, submitted by the kernel SQ thread; this
+ *            process only enters the kernel to wake an idle SQ thread
+ *
+ * The ioctl path logs every op with pr_info, the uring_cmd path does
+ * not, so part of the gap is logging. syscalls counts kernel entries
+ * made by this process; cpu time does not include the SQ thread.
+ * Uses the raw io_uring syscalls so no liburing is needed.
+ *
+ * Usage: uring_bench [ops] [batch] [led]
+ *  e.g.  uring_bench 100000 64 0
+ */
+#include <stdio.h>      /* For standard I/O operations */
+#include <stdlib.h>     /* For strtoul */
+#include <string.h>     /* For memset/strerror */
+#include <unistd.h>
+#include <fcntl.h>      /* For file control options */
+#include <errno.h>      /* For error number definitions */
+#include <time.h>       /* For clock_gettime */
+#include <sys/ioctl.h>  /* For device control operations */
+#include <sys/mman.h>   /* For mapping the rings */
+#include <sys/resource.h> /* For getrusage */
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "../include/gpio_control.h"
+
+#define LED_IOC_TOGGLE _IO(LED_IOC_MAGIC, 3)   /* GPIO_IOC_LED_TOGGLE in led_driver.c */
+#define SQ_IDLE_MS 1000
+
+/* Minimal io_uring, single mmap rings (5.4+) */
+struct ring {
+    int fd;
+    unsigned int *sq_tail, *sq_mask, *sq_flags, *sq_array;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+};
+
+static int ring_setup(struct ring *r, unsigned int entries, int sqpoll) {
+    struct io_uring_params p;
+    size_t sq_size, cq_size;
+    void *rings;
+
+    memset(&p, 0, sizeof(p));
+    if (sqpoll) {
+        p.flags = IORING_SETUP_SQPOLL;
+        p.sq_thread_idle = SQ_IDLE_MS;
+    }
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0)
+        return -1;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        errno = ENOSYS;
+        return -1;
+    }
+
+    sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    rings = mmap(NULL, sq_size > cq_size ? sq_size : cq_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED)
+        return -1;
+    r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED)
+        return -1;
+
+    r->sq_tail = (unsigned int *)((char *)rings + p.sq_off.tail);
+    r->sq_mask = (unsigned int *)((char *)rings + p.sq_off.ring_mask);
+    r->sq_flags = (unsigned int *)((char *)rings + p.sq_off.flags);
+    r->sq_array = (unsigned int *)((char *)rings + p.sq_off.array);
+    r->cq_head = (unsigned int *)((char *)rings + p.cq_off.head);
+    r->cq_tail = (unsigned int *)((char *)rings + p.cq_off.tail);
+    r->cq_mask = (unsigned int *)((char *)rings + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)((char *)rings + p.cq_off.cqes);
+    return 0;
+}
+
+/* Queue n LED_URING_CMD_TOGGLE commands, published with one tail store */
+static void ring_queue_toggles(struct ring *r, int led_fd, unsigned int n) {
+    unsigned int tail = *r->sq_tail;
+    unsigned int i;
+
+    for (i = 0; i < n; i++, tail++) {
+        unsigned int idx = tail & *r->sq_mask;
+        struct io_uring_sqe *sqe = &r->sqes[idx];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_URING_CMD;
+        sqe->fd = led_fd;
+        sqe->cmd_op = LED_URING_CMD_TOGGLE;
+        sqe->user_data = i;
+        r->sq_array[idx] = idx;
+    }
+    __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+}
+
+/* Reap up to n completions without blocking, returns how many */
+static unsigned int ring_reap(struct ring *r, unsigned int n, unsigned long *errors, int *first_err) {
+    unsigned int head = *r->cq_head;
+    unsigned int tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned int got = 0;
+
+    while (head != tail && got < n) {
+        int res = r->cqes[head & *r->cq_mask].res;
+
+        if (res < 0) {
+            if (!*errors)
+                *first_err = -res;
+            (*errors)++;
+        }
+        head++;
+        got++;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    return got;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *mode, unsigned long ops, unsigned int batch, double ns,
+                   unsigned long syscalls, const struct rusage *before) {
+    struct rusage after;
+
+    getrusage(RUSAGE_SELF, &after);
+    printf("%s,%lu,%u,%.1f,%lu,%.1f,%.1f\n", mode, ops, batch, ns / ops, syscalls,
+           (after.ru_utime.tv_sec - before->ru_utime.tv_sec) * 1e3 +
+           (after.ru_utime.tv_usec - before->ru_utime.tv_usec) / 1e3,
+           (after.ru_stime.tv_sec - before->ru_stime.tv_sec) * 1e3 +
+           (after.ru_stime.tv_usec - before->ru_stime.tv_usec) / 1e3);
+}
+
+static int bench_ioctl(int fd, unsigned long ops) {
+    struct rusage ru;
+    unsigned long i;
+    double start;
+
+    getrusage(RUSAGE_SELF, &ru);
+    start = now_ns();
+    for (i = 0; i < ops; i++) {
+        if (ioctl(fd, LED_IOC_TOGGLE) < 0) {
+            perror("LED toggle ioctl failed");
+            return -1;
+        }
+    }
+    report("ioctl", ops, 1, now_ns() - start, ops, &ru);
+    return 0;
+}
+
+static int bench_uring(int fd, unsigned long ops, unsigned int batch, int sqpoll) {
+    struct ring r;
+    struct rusage ru;
+    unsigned long done = 0, syscalls = 0, errors = 0;
+    int first_err = 0;
+    double start;
+
+    if (ring_setup(&r, batch, sqpoll) < 0) {
+        fprintf(stderr, "io_uring setup failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    getrusage(RUSAGE_SELF, &ru);
+    start = now_ns();
+    while (done < ops) {
+        unsigned int n = ops - done < batch ? ops - done : batch;
+        unsigned int reaped = 0;
+
+        ring_queue_toggles(&r, fd, n);
+        if (sqpoll) {
+            // Only enter the kernel when the SQ thread went idle
+            if (__atomic_load_n(r.sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP) {
+                syscall(__NR_io_uring_enter, r.fd, 0, 0, IORING_ENTER_SQ_WAKEUP, NULL, 0);
+                syscalls++;
+            }
+            while (reaped < n)
+                reaped += ring_reap(&r, n - reaped, &errors, &first_err);
+        } else {
+            if (syscall(__NR_io_uring_enter, r.fd, n, n, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+                perror("io_uring_enter failed");
+                return -1;
+            }
+            syscalls++;
+            while (reaped < n)
+                reaped += ring_reap(&r, n - reaped, &errors, &first_err);
+        }
+        done += n;
+    }
+    report(sqpoll ? "sqpoll" : "uring", ops, batch, now_ns() - start, syscalls, &ru);
+
+    if (errors)
+        fprintf(stderr, "%lu commands failed, first: %s\n", errors, strerror(first_err));
+    close(r.fd);
+    return errors ? -1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long ops = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+    unsigned int batch = argc > 2 ? strtoul(argv[2], NULL, 0) : 64;
+    int led = argc > 3 ? atoi(argv[3]) : 0;
+    char path[32];
+    int fd, ret = 0;
+
+    if (ops == 0 || batch == 0 || batch > 4096) {
+        fprintf(stderr, "Usage: %s [ops] [batch 1-4096] [led]\n", argv[0]);
+        return 1;
+    }
+
+    snprintf(path, sizeof(path), "/dev/gpio_led%d", led);
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    printf("mode,ops,batch,ns_per_op,syscalls,user_ms,sys_ms\n");
+    ret |= bench_ioctl(fd, ops);
+    ret |= bench_uring(fd, ops, batch, 0);
+    ret |= bench_uring(fd, ops, batch, 1);
+
+    close(fd);
+    return ret ? 1 : 0;
+}
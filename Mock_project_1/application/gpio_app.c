@@ -4,16 +4,117 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "gpio_app_probes.h"  // USDT probes
 
 #define DEVICE_PATH "/dev/gpio_ctl"
 #define BUFFER_SIZE 256
 
+// IOCTL commands, must match gpio_driver.c
+#define GPIO_IOC_MAGIC 'g'
+#define GPIO_IOC_MEASURE_START _IOW(GPIO_IOC_MAGIC, 5, uint32_t)
+#define GPIO_IOC_MEASURE_STOP  _IO(GPIO_IOC_MAGIC, 6)
+#define GPIO_IOC_MEASURE_READ  _IOR(GPIO_IOC_MAGIC, 7, struct gpio_pulse_stats)
+#define GPIO_IOC_WATCH       _IOW(GPIO_IOC_MAGIC, 11, int)
+#define GPIO_IOC_WATCH_READ  _IOR(GPIO_IOC_MAGIC, 12, struct gpio_watch_state)
+
+#define NSEC_PER_SEC 1000000000ULL
+#define NSEC_PER_MSEC 1000000ULL
+
+// Structured output, see --format
+#define OUT_BUF_SIZE (64 * 1024)   // Bytes buffered between writes
+#define DEFAULT_FLUSH_MS 100
+
+enum out_format {
+    FMT_TEXT,       // Human readable, the default
+    FMT_JSONL,      // One JSON object per line
+    FMT_CSV,        // Header line, then one row per record
+    FMT_BINARY,     // struct out_record_hdr + payload, native endian
+};
+
+enum out_kind {
+    REC_WATCH = 1,  // Payload struct gpio_watch_state
+    REC_PULSE = 2,  // Payload struct gpio_pulse_stats
+};
+
+// Binary stream: every record starts with this header, followed by len
+// payload bytes. Readers skip kinds they do not know by len
+struct out_record_hdr {
+    uint16_t kind;
+    uint16_t len;
+    uint32_t reserved;
+    uint64_t timestamp_ns;  // CLOCK_MONOTONIC
+};
+
+struct gpio_pulse_stats {
+    uint32_t gate_ms;
+    uint32_t gate_edges;
+    uint64_t freq_mhz;
+    uint64_t total_edges;
+    uint64_t high_min_ns;
+    uint64_t high_max_ns;
+    uint64_t high_mean_ns;
+    uint64_t low_min_ns;
+    uint64_t low_max_ns;
+    uint64_t low_mean_ns;
+    uint32_t high_count;
+    uint32_t low_count;
+    uint32_t missed;
+    uint32_t reserved;
+};
+
+struct gpio_watch_state {
+    uint64_t seq;
+    uint64_t edges;
+    uint64_t led_changes;
+    uint64_t last_edge_ns;  // CLOCK_MONOTONIC
+    uint32_t led;
+    uint32_t button;
+};
+
+// Event rate over roughly the last second
+struct rate_window {
+    uint64_t start_ns;
+    uint64_t start_count;
+    uint64_t rate;
+};
+
+// One line of the monitor screen, redrawn only when its text changes
+struct monitor_field {
+    int row;
+    const char *label;
+    char last[64];
+};
+
 static int device_fd = -1;
 static int running = 1;
 
+// Output buffer, written out in large chunks
+static struct {
+    enum out_format format;
+    char buf[OUT_BUF_SIZE];
+    size_t len;
+    uint64_t flush_ns;
+    uint64_t last_flush;
+    enum out_kind csv_kind;  // Kind whose CSV header was printed
+} out = { .format = FMT_TEXT, .flush_ns = DEFAULT_FLUSH_MS * NSEC_PER_MSEC };
+
+static const char *const format_names[] = { "text", "jsonl", "csv", "binary" };
+
 void signal_handler(int sig) {
+    static const char msg[] = "\nShutting down...\n";
+    
     running = 0;
-    printf("\nShutting down...\n");
+    // stderr, stdout may carry a binary stream
+    if (write(STDERR_FILENO, msg, sizeof(msg) - 1) < 0) {
+        // Nothing to do about it in a signal handler
+    }
 }
 
 void print_usage(const char *program_name) {
@@ -24,7 +125,22 @@ void print_usage(const char *program_name) {
     printf("  -1             Turn LED ON\n");
     printf("  -0             Turn LED OFF\n");
     printf("  -s, --status   Read GPIO status\n");
-    printf("  -m, --monitor  Monitor mode (continuous status)\n");
+    printf("  -m, --monitor  Monitor mode, redraws when the LED or button changes\n");
+    printf("  -p, --pulse <gate_ms>  Measure input frequency and pulse widths\n");
+    printf("  --format <text|jsonl|csv|binary>  Output format for -s, -m and -p\n");
+    printf("  --flush-ms <ms>  Longest time output is buffered (default %d)\n", DEFAULT_FLUSH_MS);
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+// Time since t0 for a probe, 0 if no timestamp was taken
+static uint64_t probe_latency(uint64_t t0) {
+    return t0 ? monotonic_ns() - t0 : 0;
 }
 
 int open_device() {
@@ -46,11 +162,15 @@ void close_device() {
 int read_status() {
     char buffer[BUFFER_SIZE];
     ssize_t bytes_read;
+    uint64_t t0;
     
     if (device_fd < 0) return -1;
     
+    t0 = GPIO_PROBE_ACTIVE(status_read) ? monotonic_ns() : 0;
     lseek(device_fd, 0, SEEK_SET);
     bytes_read = read(device_fd, buffer, sizeof(buffer) - 1);
+    GPIO_PROBE4(status_read, DEVICE_PATH, "read", probe_latency(t0),
+                bytes_read < 0 ? -errno : (int)bytes_read);
     
     if (bytes_read < 0) {
         perror("Failed to read from device");
@@ -64,10 +184,15 @@ int read_status() {
 
 int send_command(const char *command) {
     ssize_t bytes_written;
+    uint64_t t0;
     
     if (device_fd < 0) return -1;
     
+    t0 = GPIO_PROBE_ACTIVE(cmd_done) ? monotonic_ns() : 0;
+    GPIO_PROBE2(cmd_start, DEVICE_PATH, command);
     bytes_written = write(device_fd, command, strlen(command));
+    GPIO_PROBE4(cmd_done, DEVICE_PATH, command, probe_latency(t0),
+                bytes_written < 0 ? -errno : 0);
     if (bytes_written < 0) {
         perror("Failed to write to device");
         return -1;
@@ -105,9 +230,214 @@ void interactive_mode() {
     }
 }
 
-void monitor_mode() {
-    printf("=== GPIO Monitor Mode (Press Ctrl+C to exit) ===\n");
+// Write the output buffer to stdout, retrying short writes
+static int out_flush(void) {
+    uint64_t t0 = GPIO_PROBE_ACTIVE(render) ? monotonic_ns() : 0;
+    size_t done = 0, len = out.len;
+    
+    while (done < out.len) {
+        ssize_t n = write(STDOUT_FILENO, out.buf + done, out.len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            GPIO_PROBE4(render, format_names[out.format], done, probe_latency(t0), -errno);
+            perror("Failed to write output");
+            out.len = 0;
+            return -1;
+        }
+        done += n;
+    }
+    out.len = 0;
+    out.last_flush = monotonic_ns();
+    if (len)
+        GPIO_PROBE4(render, format_names[out.format], len, probe_latency(t0), 0);
+    return 0;
+}
+
+static void out_maybe_flush(uint64_t now) {
+    if (out.len && now - out.last_flush >= out.flush_ns) out_flush();
+}
+
+// poll() timeout until buffered output is due, -1 when nothing is buffered
+static int out_flush_timeout(uint64_t now) {
+    uint64_t due = out.last_flush + out.flush_ns;
+    
+    if (!out.len) return -1;
+    return due > now ? (int)((due - now) / NSEC_PER_MSEC) + 1 : 0;
+}
+
+static void out_append(const void *data, size_t len) {
+    if (out.len + len > sizeof(out.buf)) out_flush();
+    memcpy(out.buf + out.len, data, len);
+    out.len += len;
+}
+
+static void out_printf(const char *fmt, ...) {
+    va_list ap;
+    int n;
+    
+    va_start(ap, fmt);
+    n = vsnprintf(out.buf + out.len, sizeof(out.buf) - out.len, fmt, ap);
+    va_end(ap);
+    
+    if (n >= 0 && out.len + n >= sizeof(out.buf)) {
+        // Did not fit, flush and format again into the empty buffer
+        out_flush();
+        va_start(ap, fmt);
+        n = vsnprintf(out.buf, sizeof(out.buf), fmt, ap);
+        va_end(ap);
+    }
+    if (n > 0) out.len += n;
+}
+
+static void out_binary(enum out_kind kind, uint64_t ts, const void *payload, uint16_t len) {
+    struct out_record_hdr hdr = { .kind = kind, .len = len, .timestamp_ns = ts };
+    
+    out_append(&hdr, sizeof(hdr));
+    out_append(payload, len);
+}
+
+static void out_csv_header(enum out_kind kind, const char *header) {
+    if (out.csv_kind == kind) return;
+    out_printf("%s\n", header);
+    out.csv_kind = kind;
+}
+
+static void out_watch(uint64_t ts, const struct gpio_watch_state *st) {
+    switch (out.format) {
+    case FMT_JSONL:
+        out_printf("{\"ts\":%llu,\"record\":\"watch\",\"seq\":%llu,\"led\":%u,\"button\":%u,"
+                   "\"edges\":%llu,\"led_changes\":%llu,\"last_edge_ns\":%llu}\n",
+                   (unsigned long long)ts, (unsigned long long)st->seq, st->led, st->button,
+                   (unsigned long long)st->edges, (unsigned long long)st->led_changes,
+                   (unsigned long long)st->last_edge_ns);
+        break;
+    case FMT_CSV:
+        out_csv_header(REC_WATCH, "timestamp_ns,seq,led,button,edges,led_changes,last_edge_ns");
+        out_printf("%llu,%llu,%u,%u,%llu,%llu,%llu\n",
+                   (unsigned long long)ts, (unsigned long long)st->seq, st->led, st->button,
+                   (unsigned long long)st->edges, (unsigned long long)st->led_changes,
+                   (unsigned long long)st->last_edge_ns);
+        break;
+    case FMT_BINARY:
+        out_binary(REC_WATCH, ts, st, sizeof(*st));
+        break;
+    default:
+        break;
+    }
+}
+
+static void out_pulse(uint64_t ts, const struct gpio_pulse_stats *st) {
+    switch (out.format) {
+    case FMT_JSONL:
+        out_printf("{\"ts\":%llu,\"record\":\"pulse\",\"gate_ms\":%u,\"freq_mhz\":%llu,"
+                   "\"gate_edges\":%u,\"total_edges\":%llu,\"missed\":%u,"
+                   "\"high_min_ns\":%llu,\"high_mean_ns\":%llu,\"high_max_ns\":%llu,\"high_count\":%u,"
+                   "\"low_min_ns\":%llu,\"low_mean_ns\":%llu,\"low_max_ns\":%llu,\"low_count\":%u}\n",
+                   (unsigned long long)ts, st->gate_ms, (unsigned long long)st->freq_mhz,
+                   st->gate_edges, (unsigned long long)st->total_edges, st->missed,
+                   (unsigned long long)st->high_min_ns, (unsigned long long)st->high_mean_ns,
+                   (unsigned long long)st->high_max_ns, st->high_count,
+                   (unsigned long long)st->low_min_ns, (unsigned long long)st->low_mean_ns,
+                   (unsigned long long)st->low_max_ns, st->low_count);
+        break;
+    case FMT_CSV:
+        out_csv_header(REC_PULSE, "timestamp_ns,gate_ms,freq_mhz,gate_edges,total_edges,missed,"
+                       "high_min_ns,high_mean_ns,high_max_ns,high_count,"
+                       "low_min_ns,low_mean_ns,low_max_ns,low_count");
+        out_printf("%llu,%u,%llu,%u,%llu,%u,%llu,%llu,%llu,%u,%llu,%llu,%llu,%u\n",
+                   (unsigned long long)ts, st->gate_ms, (unsigned long long)st->freq_mhz,
+                   st->gate_edges, (unsigned long long)st->total_edges, st->missed,
+                   (unsigned long long)st->high_min_ns, (unsigned long long)st->high_mean_ns,
+                   (unsigned long long)st->high_max_ns, st->high_count,
+                   (unsigned long long)st->low_min_ns, (unsigned long long)st->low_mean_ns,
+                   (unsigned long long)st->low_max_ns, st->low_count);
+        break;
+    case FMT_BINARY:
+        out_binary(REC_PULSE, ts, st, sizeof(*st));
+        break;
+    default:
+        break;
+    }
+}
+
+// Strip --format and --flush-ms from argv, leaving the mode options
+static int parse_output_options(int *argc, char *argv[]) {
+    int i, n = 1;
+    
+    for (i = 1; i < *argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < *argc) {
+            const char *f = argv[++i];
+            if (strcmp(f, "text") == 0) out.format = FMT_TEXT;
+            else if (strcmp(f, "jsonl") == 0) out.format = FMT_JSONL;
+            else if (strcmp(f, "csv") == 0) out.format = FMT_CSV;
+            else if (strcmp(f, "binary") == 0) out.format = FMT_BINARY;
+            else {
+                fprintf(stderr, "Unknown format: %s (text, jsonl, csv, binary)\n", f);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--flush-ms") == 0 && i + 1 < *argc) {
+            out.flush_ns = strtoull(argv[++i], NULL, 0) * NSEC_PER_MSEC;
+        } else {
+            argv[n++] = argv[i];
+        }
+    }
+    *argc = n;
+    return 0;
+}
+
+// GPIO_IOC_WATCH_READ with a status_read probe around it
+static int watch_read(struct gpio_watch_state *st) {
+    uint64_t t0 = GPIO_PROBE_ACTIVE(status_read) ? monotonic_ns() : 0;
+    int ret = ioctl(device_fd, GPIO_IOC_WATCH_READ, st);
+    
+    GPIO_PROBE4(status_read, DEVICE_PATH, "watch_read", probe_latency(t0),
+                ret < 0 ? -errno : 0);
+    return ret;
+}
+
+// Structured status is one watch snapshot
+static int print_status(void) {
+    struct gpio_watch_state st;
+    
+    if (out.format == FMT_TEXT) return read_status();
+    if (watch_read(&st) < 0) {
+        perror("Failed to read watch state");
+        return -1;
+    }
+    out_watch(monotonic_ns(), &st);
+    return out_flush();
+}
+
+// Close the window once a second has passed, rate is events per second
+static void rate_update(struct rate_window *w, uint64_t now, uint64_t count) {
+    uint64_t elapsed = now - w->start_ns;
+    
+    if (elapsed < NSEC_PER_SEC) return;
+    w->rate = (count - w->start_count) * NSEC_PER_SEC / elapsed;
+    w->start_ns = now;
+    w->start_count = count;
+}
+
+// True while the rate can still change without a new event
+static int rate_settling(const struct rate_window *w, uint64_t count) {
+    return w->rate != 0 || count != w->start_count;
+}
+
+static void field_update(struct monitor_field *f, const char *fmt, ...) {
+    char text[sizeof(f->last)];
+    va_list ap;
+    
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
     
+    if (strcmp(text, f->last) == 0) return;
+    strcpy(f->last, text);
+    printf("\033[%d;1H%-20s%s\033[K", f->row, f->label, text);
+}
+
+// Old drivers have no watch ioctl, redraw the text status once a second
+static void monitor_poll_loop(void) {
     while (running) {
         printf("\033[2J\033[H"); // Clear screen
         printf("GPIO Status:\n");
@@ -117,10 +447,169 @@ void monitor_mode() {
     }
 }
 
+// One record per observed change. The driver coalesces changes between
+// reads into one snapshot, the edge and LED counters still account for
+// every one of them, and seq gaps show where snapshots were merged
+static void monitor_stream(void) {
+    struct gpio_watch_state st;
+    struct pollfd pfd = { .fd = device_fd, .events = POLLIN };
+    uint64_t last_seq = 0;
+    int first = 1;
+    
+    out.last_flush = monotonic_ns();
+    while (running) {
+        if (watch_read(&st) < 0) {
+            perror("Failed to read watch state");
+            break;
+        }
+        if (first || st.seq != last_seq) {
+            uint64_t now = monotonic_ns();
+            
+            GPIO_PROBE4(event_recv, DEVICE_PATH, "watch",
+                        st.last_edge_ns && now >= st.last_edge_ns ? now - st.last_edge_ns : 0,
+                        st.seq);
+            out_watch(now, &st);
+            last_seq = st.seq;
+            first = 0;
+        }
+        out_maybe_flush(monotonic_ns());
+        
+        if (poll(&pfd, 1, out_flush_timeout(monotonic_ns())) < 0 && errno != EINTR) {
+            perror("poll failed");
+            break;
+        }
+    }
+    out_flush();
+}
+
+// Block in poll() until the driver reports a change, then redraw the
+// fields that changed. While the lines are idle nothing wakes us, except
+// one wakeup per second until the event rates have decayed to zero
+void monitor_mode() {
+    struct monitor_field led = { .row = 3, .label = "LED:" };
+    struct monitor_field button = { .row = 4, .label = "Button:" };
+    struct monitor_field edges = { .row = 5, .label = "Button edges:" };
+    struct monitor_field changes = { .row = 6, .label = "LED changes:" };
+    struct monitor_field latency = { .row = 7, .label = "Last edge latency:" };
+    struct rate_window edge_rate = { 0 }, led_rate = { 0 };
+    struct gpio_watch_state st, prev = { 0 };
+    struct pollfd pfd = { .fd = device_fd, .events = POLLIN };
+    int on = 1, timeout;
+    uint64_t now;
+    
+    if (ioctl(device_fd, GPIO_IOC_WATCH, &on) < 0) {
+        if (errno != ENOTTY && errno != EINVAL) {
+            perror("Failed to enable watch mode");
+            return;
+        }
+        fprintf(stderr, "Driver has no watch mode, falling back to 1 s polling\n");
+        if (out.format == FMT_TEXT) monitor_poll_loop();
+        return;
+    }
+    
+    if (out.format != FMT_TEXT) {
+        monitor_stream();
+        on = 0;
+        ioctl(device_fd, GPIO_IOC_WATCH, &on);
+        return;
+    }
+    
+    printf("\033[2J\033[H=== GPIO Monitor Mode (Press Ctrl+C to exit) ===\n");
+    edge_rate.start_ns = led_rate.start_ns = monotonic_ns();
+    
+    while (running) {
+        if (watch_read(&st) < 0) {
+            perror("Failed to read watch state");
+            break;
+        }
+        now = monotonic_ns();
+        if (st.seq != prev.seq)
+            GPIO_PROBE4(event_recv, DEVICE_PATH, "watch",
+                        st.last_edge_ns && now >= st.last_edge_ns ? now - st.last_edge_ns : 0,
+                        st.seq);
+        
+        if (st.edges != prev.edges && st.last_edge_ns && now >= st.last_edge_ns) {
+            field_update(&latency, "%llu us", (unsigned long long)(now - st.last_edge_ns) / 1000);
+        } else if (!st.edges) {
+            field_update(&latency, "-");
+        }
+        rate_update(&edge_rate, now, st.edges);
+        rate_update(&led_rate, now, st.led_changes);
+        
+        field_update(&led, "%s", st.led ? "ON" : "OFF");
+        field_update(&button, "%s", st.button ? "PRESSED" : "RELEASED");
+        field_update(&edges, "%llu (%llu /s)", (unsigned long long)st.edges,
+                     (unsigned long long)edge_rate.rate);
+        field_update(&changes, "%llu (%llu /s)", (unsigned long long)st.led_changes,
+                     (unsigned long long)led_rate.rate);
+        fflush(stdout);
+        prev = st;
+        
+        // Sleep until the next change, or until the current rate window closes
+        timeout = -1;
+        if (rate_settling(&edge_rate, st.edges) || rate_settling(&led_rate, st.led_changes)) {
+            uint64_t end = (edge_rate.start_ns < led_rate.start_ns ? edge_rate.start_ns : led_rate.start_ns) + NSEC_PER_SEC;
+            timeout = end > now ? (int)((end - now) / 1000000) + 1 : 0;
+        }
+        if (poll(&pfd, 1, timeout) < 0 && errno != EINTR) {
+            perror("poll failed");
+            break;
+        }
+    }
+    
+    printf("\033[%d;1H\n", latency.row + 1);
+    on = 0;
+    ioctl(device_fd, GPIO_IOC_WATCH, &on);
+}
+
+void pulse_mode(uint32_t gate_ms) {
+    struct gpio_pulse_stats st;
+    
+    if (ioctl(device_fd, GPIO_IOC_MEASURE_START, &gate_ms) < 0) {
+        perror("Failed to start pulse measurement");
+        return;
+    }
+    
+    if (out.format == FMT_TEXT)
+        printf("=== Pulse Measurement, gate %u ms (Press Ctrl+C to exit) ===\n", gate_ms);
+    out.last_flush = monotonic_ns();
+    while (running) {
+        uint64_t t0;
+        int ret;
+        
+        usleep(gate_ms * 1000);
+        t0 = GPIO_PROBE_ACTIVE(status_read) ? monotonic_ns() : 0;
+        ret = ioctl(device_fd, GPIO_IOC_MEASURE_READ, &st);
+        GPIO_PROBE4(status_read, DEVICE_PATH, "measure_read", probe_latency(t0),
+                    ret < 0 ? -errno : 0);
+        if (ret < 0) {
+            perror("Failed to read pulse measurement");
+            break;
+        }
+        if (out.format != FMT_TEXT) {
+            out_pulse(monotonic_ns(), &st);
+            out_maybe_flush(monotonic_ns());
+            continue;
+        }
+        printf("freq %llu.%03llu Hz | high min/mean/max %llu/%llu/%llu ns | "
+               "low min/mean/max %llu/%llu/%llu ns | edges %llu missed %u\n",
+               (unsigned long long)st.freq_mhz / 1000, (unsigned long long)st.freq_mhz % 1000,
+               (unsigned long long)st.high_min_ns, (unsigned long long)st.high_mean_ns,
+               (unsigned long long)st.high_max_ns, (unsigned long long)st.low_min_ns,
+               (unsigned long long)st.low_mean_ns, (unsigned long long)st.low_max_ns,
+               (unsigned long long)st.total_edges, st.missed);
+    }
+    
+    out_flush();
+    ioctl(device_fd, GPIO_IOC_MEASURE_STOP);
+}
+
 int main(int argc, char *argv[]) {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
+    if (parse_output_options(&argc, argv) < 0) return 1;
+    
     if (open_device() < 0) {
         fprintf(stderr, "Error: Cannot open device %s\n", DEVICE_PATH);
         fprintf(stderr, "Make sure the gpio_driver module is loaded.\n");
@@ -128,7 +617,7 @@ int main(int argc, char *argv[]) {
     }
     
     if (argc == 1) {
-        read_status();
+        print_status();
     } else if (argc == 2) {
         if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
             print_usage(argv[0]);
@@ -139,7 +628,7 @@ int main(int argc, char *argv[]) {
         } else if (strcmp(argv[1], "-0") == 0) {
             send_command("0");
         } else if (strcmp(argv[1], "-s") == 0 || strcmp(argv[1], "--status") == 0) {
-            read_status();
+            print_status();
         } else if (strcmp(argv[1], "-m") == 0 || strcmp(argv[1], "--monitor") == 0) {
             monitor_mode();
         } else {
@@ -148,6 +637,8 @@ int main(int argc, char *argv[]) {
             close_device();
             return 1;
         }
+    } else if (argc == 3 && (strcmp(argv[1], "-p") == 0 || strcmp(argv[1], "--pulse") == 0)) {
+        pulse_mode((uint32_t)atoi(argv[2]));
     } else {
         print_usage(argv[0]);
         close_device();
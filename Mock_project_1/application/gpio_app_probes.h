@@ -0,0 +1,60 @@
+// USDT probes for gpio_app, provider "gpio_app"
+//
+//   cmd_start(device, op)                  Command about to be written
+//   cmd_done(device, op, latency_ns, result)   result: 0 or -errno
+//   status_read(device, op, latency_ns, result) result: value or -errno
+//   event_recv(device, type, latency_ns, seq)  watch snapshot, latency:
+//                                          last edge to receipt
+//   render(format, bytes, latency_ns, result)  one output write
+//
+// device, op, type and format are strings. Every probe has a semaphore
+// that the tracer sets while it is attached; timestamps for latency_ns
+// are only taken when GPIO_PROBE_ACTIVE() says someone is listening, so
+// an untraced run only pays for a predicted not-taken branch.
+//
+//   bpftrace -l 'usdt:./gpio_app:*'
+//   bpftrace -e 'usdt:./gpio_app:gpio_app:cmd_done { @[str(arg1)] = hist(arg2); }'
+//
+// Needs <sys/sdt.h> (systemtap-sdt-dev) at build time. Without it, or
+// with -DGPIO_APP_NO_SDT, the probes compile to nothing.
+#ifndef GPIO_APP_PROBES_H
+#define GPIO_APP_PROBES_H
+
+#if !defined(GPIO_APP_NO_SDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define GPIO_APP_SDT 1
+#endif
+#endif
+
+#ifdef GPIO_APP_SDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+// Semaphore layout expected by perf, bpftrace and systemtap
+#define GPIO_PROBE_SEMAPHORE(name) \
+    __extension__ unsigned short gpio_app_##name##_semaphore \
+    __attribute__((unused)) __attribute__((section(".probes")))
+
+GPIO_PROBE_SEMAPHORE(cmd_start);
+GPIO_PROBE_SEMAPHORE(cmd_done);
+GPIO_PROBE_SEMAPHORE(status_read);
+GPIO_PROBE_SEMAPHORE(event_recv);
+GPIO_PROBE_SEMAPHORE(render);
+
+#define GPIO_PROBE_ACTIVE(name) __builtin_expect(gpio_app_##name##_semaphore, 0)
+#define GPIO_PROBE2(name, a, b) DTRACE_PROBE2(gpio_app, name, a, b)
+#define GPIO_PROBE4(name, a, b, c, d) DTRACE_PROBE4(gpio_app, name, a, b, c, d)
+
+#else
+
+// Arguments are type checked but never evaluated
+#define GPIO_PROBE_ACTIVE(name) 0
+#define GPIO_PROBE2(name, a, b) \
+    do { if (0) { (void)(a); (void)(b); } } while (0)
+#define GPIO_PROBE4(name, a, b, c, d) \
+    do { if (0) { (void)(a); (void)(b); (void)(c); (void)(d); } } while (0)
+
+#endif
+
+#endif // GPIO_APP_PROBES_H
@@ -7,6 +7,21 @@
 #include <linux/uaccess.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
+#include <linux/interrupt.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/hrtimer.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/slab.h>
+#include <linux/seqlock.h>
+#include <kunit/static_stub.h>
+
+#include "gpio_status.h"
 
 #define DEVICE_NAME "gpio_ctl"
 #define CLASS_NAME "gpio_class"
@@ -17,6 +32,99 @@
 #define GPIO_IOC_LED_OFF   _IO(GPIO_IOC_MAGIC, 2)
 #define GPIO_IOC_LED_TOGGLE _IO(GPIO_IOC_MAGIC, 3)
 #define GPIO_IOC_GET_STATUS _IOR(GPIO_IOC_MAGIC, 4, int)
+#define GPIO_IOC_MEASURE_START _IOW(GPIO_IOC_MAGIC, 5, __u32)  // Gate time in ms
+#define GPIO_IOC_MEASURE_STOP  _IO(GPIO_IOC_MAGIC, 6)
+#define GPIO_IOC_MEASURE_READ  _IOR(GPIO_IOC_MAGIC, 7, struct gpio_pulse_stats)
+
+#define GPIO_IOC_CAPTURE_START _IOW(GPIO_IOC_MAGIC, 8, __u32)  // Sample rate in Hz
+#define GPIO_IOC_CAPTURE_STOP  _IO(GPIO_IOC_MAGIC, 9)
+#define GPIO_IOC_CAPTURE_STATS _IOR(GPIO_IOC_MAGIC, 10, struct gpio_capture_stats)
+
+#define GPIO_IOC_WATCH       _IOW(GPIO_IOC_MAGIC, 11, int)  // 1 = poll() waits for changes
+#define GPIO_IOC_WATCH_READ  _IOR(GPIO_IOC_MAGIC, 12, struct gpio_watch_state)
+
+#define PULSE_GATE_MIN_MS 10
+#define PULSE_GATE_MAX_MS 10000
+
+// Capture buffer layout: one control page followed by a ring of blocks
+#define CAPTURE_LINES 2             // Bit 0 = button, bit 1 = LED readback
+#define CAPTURE_BLOCK_SIZE 512
+#define CAPTURE_NBLOCKS 256         // 128 KiB of samples
+#define CAPTURE_BLOCK_DATA (CAPTURE_BLOCK_SIZE - 16)
+#define CAPTURE_BLOCK_SAMPLES (CAPTURE_BLOCK_DATA * 8 / CAPTURE_LINES)
+#define CAPTURE_RATE_MAX 200000     // 5 us sample period
+#define CAPTURE_BUF_SIZE (PAGE_SIZE + CAPTURE_NBLOCKS * CAPTURE_BLOCK_SIZE)
+#define CAPTURE_FLAG_OVERRUN 0x01   // Samples were dropped before this block
+#define CAPTURE_FLAG_GAP     0x02   // Timer ticks were missed before this block
+
+// Pulse measurement results, returned by GPIO_IOC_MEASURE_READ
+struct gpio_pulse_stats {
+    __u32 gate_ms;          // Configured gate time
+    __u32 gate_edges;       // Rising edges in the last completed gate
+    __u64 freq_mhz;         // Frequency of the last completed gate, in milli-Hz
+    __u64 total_edges;      // All edges since GPIO_IOC_MEASURE_START
+    __u64 high_min_ns;
+    __u64 high_max_ns;
+    __u64 high_mean_ns;
+    __u64 low_min_ns;
+    __u64 low_max_ns;
+    __u64 low_mean_ns;
+    __u32 high_count;       // Completed high pulses
+    __u32 low_count;        // Completed low pulses
+    __u32 missed;           // Edges where the level did not change (lost edge)
+    __u32 reserved;
+};
+
+// One block of packed samples. Sample i of line l is bit (i * nlines + l)
+// of data[], and sample i was taken at timestamp + i * period_ns
+struct gpio_capture_block {
+    __u64 timestamp;        // ktime ns of the first sample
+    __u32 seq;              // Block number since capture start
+    __u16 nsamples;         // Valid samples, less than full only at stop or gap
+    __u8 nlines;
+    __u8 flags;             // CAPTURE_FLAG_*
+    __u8 data[CAPTURE_BLOCK_DATA];
+};
+
+// Control page at offset 0 of the mmap, blocks follow at PAGE_SIZE.
+// The mmap reader consumes blocks by advancing tail itself
+struct gpio_capture_ctrl {
+    __u32 head;             // Blocks committed by the driver (free running)
+    __u32 tail;             // Blocks consumed (free running)
+    __u32 nblocks;
+    __u32 block_size;
+    __u32 rate_hz;
+    __u32 period_ns;
+};
+
+// Capture statistics, returned by GPIO_IOC_CAPTURE_STATS
+struct gpio_capture_stats {
+    __u32 rate_hz;
+    __u32 period_ns;
+    __u64 samples;          // Samples stored
+    __u64 dropped;          // Samples dropped because the ring was full
+    __u64 missed_ticks;     // Timer periods that fired too late to sample
+    __u32 head;
+    __u32 tail;
+};
+
+// Commands accepted by write()
+enum gpio_command {
+    GPIO_CMD_OFF,
+    GPIO_CMD_ON,
+    GPIO_CMD_TOGGLE,
+};
+
+// Status snapshot for watchers, returned by GPIO_IOC_WATCH_READ.
+// seq changes whenever any other field does
+struct gpio_watch_state {
+    __u64 seq;
+    __u64 edges;            // Button edges seen while watched
+    __u64 led_changes;
+    __u64 last_edge_ns;     // ktime (CLOCK_MONOTONIC) of the last button edge
+    __u32 led;
+    __u32 button;
+};
 
 // Device variables
 static dev_t dev_number;
@@ -29,6 +137,74 @@ static struct gpio_desc *led_gpio = NULL;
 static struct gpio_desc *button_gpio = NULL;
 static bool led_status = false;
 
+// Button IRQ, only enabled while measuring or watched
+static int button_irq = -1;
+static int button_irq_users;
+static DEFINE_MUTEX(button_irq_mutex);
+
+// Change tracking for GPIO_IOC_WATCH, updated under watch_lock
+static struct {
+    u64 seq;
+    u64 edges;
+    u64 led_changes;
+    u64 last_edge_ns;
+    int button;
+} watch;
+static int watchers;
+static DEFINE_SPINLOCK(watch_lock);
+// Lets /proc/gpio_ctl_status read the 64-bit counters without watch_lock
+static seqcount_spinlock_t watch_seqcount = SEQCNT_SPINLOCK_ZERO(watch_seqcount, &watch_lock);
+static DEFINE_MUTEX(watch_mutex);       // Serializes GPIO_IOC_WATCH
+static DECLARE_WAIT_QUEUE_HEAD(watch_wait);
+
+// Per-open-file state
+struct gpio_file {
+    bool watching;
+    u64 seen_seq;           // watch.seq at the last GPIO_IOC_WATCH_READ
+};
+
+// Pulse measurement state, updated in the IRQ under pulse_lock
+struct pulse_width {
+    u64 min;
+    u64 max;
+    u64 sum;
+    u32 count;
+};
+
+static struct {
+    bool active;
+    u64 gate_ns;
+    u64 gate_start;         // Start of the current gate
+    u32 gate_rising;        // Rising edges in the current gate
+    u32 gate_edges;         // Latched from the last completed gate
+    u64 freq_mhz;           // Latched from the last completed gate
+    u64 total_edges;
+    u64 last_edge;          // Timestamp of the previous edge
+    int last_level;
+    u32 missed;
+    struct pulse_width high;
+    struct pulse_width low;
+} pulse;
+static DEFINE_SPINLOCK(pulse_lock);
+
+// Capture state. The hrtimer is the only producer; the owning file reads
+// through read() or mmap
+static struct {
+    void *buf;                      // vmalloc_user, control page + blocks
+    struct gpio_capture_ctrl *ctrl;
+    struct gpio_capture_block *cur; // Block being filled, NULL if none
+    struct hrtimer timer;
+    ktime_t period;
+    u32 seq;
+    u8 pending_flags;
+    u64 samples;
+    u64 dropped;
+    u64 missed_ticks;
+    struct file *owner;             // File that started the capture
+} capture;
+static DEFINE_MUTEX(capture_mutex);
+static DECLARE_WAIT_QUEUE_HEAD(capture_wait);
+
 // Platform driver data
 struct gpio_ctrl_data {
     struct gpio_desc *led_gpio;
@@ -44,6 +220,8 @@ static int gpio_release(struct inode *inode, struct file *file);
 static ssize_t gpio_read(struct file *file, char __user *buffer, size_t len, loff_t *offset);
 static ssize_t gpio_write(struct file *file, const char __user *buffer, size_t len, loff_t *offset);
 static long gpio_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+static __poll_t gpio_poll(struct file *file, poll_table *wait);
+static int gpio_mmap(struct file *file, struct vm_area_struct *vma);
 
 // File operations structure
 static struct file_operations fops = {
@@ -52,16 +230,430 @@ static struct file_operations fops = {
     .write = gpio_write,
     .release = gpio_release,
     .unlocked_ioctl = gpio_ioctl,
+    .poll = gpio_poll,
+    .mmap = gpio_mmap,
     .owner = THIS_MODULE,
 };
 
+// Line readers for the IRQ, pulse and capture paths, redirected to fake
+// pins by the KUnit suite
+static int gpio_get_button(void) {
+    KUNIT_STATIC_STUB_REDIRECT(gpio_get_button);
+    return gpiod_get_value(button_gpio);
+}
+
+static int gpio_get_led(void) {
+    KUNIT_STATIC_STUB_REDIRECT(gpio_get_led);
+    return gpiod_get_value(led_gpio);
+}
+
+// Pulse measurement helpers, called with pulse_lock held
+
+static void pulse_close_gate(u64 now) {
+    u64 elapsed = now - pulse.gate_start;
+
+    pulse.gate_edges = pulse.gate_rising;
+    pulse.freq_mhz = elapsed ? div64_u64((u64)pulse.gate_rising * 1000 * NSEC_PER_SEC, elapsed) : 0;
+    pulse.gate_rising = 0;
+    pulse.gate_start = now;
+}
+
+static void pulse_add_width(struct pulse_width *w, u64 width) {
+    if (!w->count || width < w->min)
+        w->min = width;
+    if (width > w->max)
+        w->max = width;
+    w->sum += width;
+    w->count++;
+}
+
+static void pulse_record_edge(u64 now, int level) {
+    if (now - pulse.gate_start >= pulse.gate_ns)
+        pulse_close_gate(now);
+
+    pulse.total_edges++;
+    if (level == pulse.last_level) {
+        // Both edges of a pulse arrived before we sampled, width unknown.
+        // The lost pulse still had one rising edge
+        pulse.missed++;
+        pulse.gate_rising++;
+    } else {
+        if (pulse.last_edge)
+            pulse_add_width(pulse.last_level ? &pulse.high : &pulse.low, now - pulse.last_edge);
+        if (level)
+            pulse.gate_rising++;
+    }
+    pulse.last_level = level;
+    pulse.last_edge = now;
+}
+
+// Bump the change sequence and wake pollers, called with watch_lock held
+static void watch_changed(void) {
+    watch.seq++;
+    wake_up_interruptible(&watch_wait);
+}
+
+static void watch_record_edge(u64 now, int level) {
+    unsigned long flags;
+
+    spin_lock_irqsave(&watch_lock, flags);
+    write_seqcount_begin(&watch_seqcount);
+    watch.edges++;
+    watch.last_edge_ns = now;
+    watch.button = level;
+    write_seqcount_end(&watch_seqcount);
+    watch_changed();
+    spin_unlock_irqrestore(&watch_lock, flags);
+}
+
+// Both-edge IRQ handler for measurement and watch mode, no allocation and no sleeping
+static irqreturn_t button_irq_handler(int irq, void *dev_id) {
+    u64 now = ktime_get_ns();
+    int level = gpio_get_button();
+    unsigned long flags;
+
+    spin_lock_irqsave(&pulse_lock, flags);
+    if (pulse.active)
+        pulse_record_edge(now, level);
+    spin_unlock_irqrestore(&pulse_lock, flags);
+
+    if (READ_ONCE(watchers))
+        watch_record_edge(now, level);
+
+    return IRQ_HANDLED;
+}
+
+// The button IRQ is shared by pulse measurement and watchers, enabled
+// while either needs it
+static void button_irq_get(void) {
+    mutex_lock(&button_irq_mutex);
+    if (button_irq_users++ == 0)
+        enable_irq(button_irq);
+    mutex_unlock(&button_irq_mutex);
+}
+
+static void button_irq_put(void) {
+    mutex_lock(&button_irq_mutex);
+    if (--button_irq_users == 0)
+        disable_irq(button_irq);
+    mutex_unlock(&button_irq_mutex);
+}
+
+static int pulse_start(u32 gate_ms) {
+    unsigned long flags;
+
+    if (button_irq < 0)
+        return -ENODEV;
+    if (gate_ms < PULSE_GATE_MIN_MS || gate_ms > PULSE_GATE_MAX_MS)
+        return -EINVAL;
+
+    spin_lock_irqsave(&pulse_lock, flags);
+    if (pulse.active) {
+        spin_unlock_irqrestore(&pulse_lock, flags);
+        return -EBUSY;
+    }
+    memset(&pulse, 0, sizeof(pulse));
+    pulse.gate_ns = (u64)gate_ms * NSEC_PER_MSEC;
+    pulse.gate_start = ktime_get_ns();
+    pulse.last_level = gpio_get_button();
+    pulse.active = true;
+    spin_unlock_irqrestore(&pulse_lock, flags);
+
+    button_irq_get();
+    printk(KERN_INFO "GPIO_CTL: Pulse measurement started (gate %u ms)\n", gate_ms);
+    return 0;
+}
+
+static void pulse_stop(void) {
+    unsigned long flags;
+    bool was_active;
+
+    spin_lock_irqsave(&pulse_lock, flags);
+    was_active = pulse.active;
+    pulse.active = false;
+    spin_unlock_irqrestore(&pulse_lock, flags);
+
+    if (was_active) {
+        button_irq_put();
+        printk(KERN_INFO "GPIO_CTL: Pulse measurement stopped\n");
+    }
+}
+
+static u64 pulse_mean(const struct pulse_width *w) {
+    return w->count ? div64_u64(w->sum, w->count) : 0;
+}
+
+static void pulse_read(struct gpio_pulse_stats *st) {
+    unsigned long flags;
+    u64 now = ktime_get_ns();
+
+    spin_lock_irqsave(&pulse_lock, flags);
+    // Close an expired gate so an idle input reads 0 Hz instead of stale data
+    if (pulse.active && now - pulse.gate_start >= pulse.gate_ns)
+        pulse_close_gate(now);
+
+    st->gate_ms = div64_u64(pulse.gate_ns, NSEC_PER_MSEC);
+    st->gate_edges = pulse.gate_edges;
+    st->freq_mhz = pulse.freq_mhz;
+    st->total_edges = pulse.total_edges;
+    st->high_min_ns = pulse.high.min;
+    st->high_max_ns = pulse.high.max;
+    st->high_mean_ns = pulse_mean(&pulse.high);
+    st->low_min_ns = pulse.low.min;
+    st->low_max_ns = pulse.low.max;
+    st->low_mean_ns = pulse_mean(&pulse.low);
+    st->high_count = pulse.high.count;
+    st->low_count = pulse.low.count;
+    st->missed = pulse.missed;
+    st->reserved = 0;
+    spin_unlock_irqrestore(&pulse_lock, flags);
+}
+
+// Capture helpers
+
+static struct gpio_capture_block *capture_block(u32 n) {
+    return capture.buf + PAGE_SIZE + (n % CAPTURE_NBLOCKS) * CAPTURE_BLOCK_SIZE;
+}
+
+static void capture_commit(void) {
+    if (!capture.cur)
+        return;
+    smp_store_release(&capture.ctrl->head, capture.ctrl->head + 1);
+    capture.cur = NULL;
+    wake_up_interruptible(&capture_wait);
+}
+
+// Store one sample, opening a new block when needed. Drops the sample if
+// the reader has not freed a block yet
+static void capture_sample(u64 ts) {
+    struct gpio_capture_ctrl *ctrl = capture.ctrl;
+    struct gpio_capture_block *blk = capture.cur;
+    unsigned int bit, bits;
+
+    if (!blk) {
+        if (ctrl->head - READ_ONCE(ctrl->tail) >= CAPTURE_NBLOCKS) {
+            capture.dropped++;
+            capture.pending_flags |= CAPTURE_FLAG_OVERRUN;
+            return;
+        }
+        blk = capture_block(ctrl->head);
+        blk->timestamp = ts;
+        blk->seq = capture.seq++;
+        blk->nsamples = 0;
+        blk->nlines = CAPTURE_LINES;
+        blk->flags = capture.pending_flags;
+        memset(blk->data, 0, sizeof(blk->data));
+        capture.pending_flags = 0;
+        capture.cur = blk;
+    }
+
+    bits = gpio_get_button() | (gpio_get_led() << 1);
+    bit = blk->nsamples * CAPTURE_LINES;
+    blk->data[bit >> 3] |= bits << (bit & 7);
+    capture.samples++;
+
+    if (++blk->nsamples == CAPTURE_BLOCK_SAMPLES)
+        capture_commit();
+}
+
+static enum hrtimer_restart capture_timer_fn(struct hrtimer *timer) {
+    u64 ts = ktime_to_ns(hrtimer_get_expires(timer));
+    u64 overrun = hrtimer_forward_now(timer, capture.period);
+
+    capture_sample(ts);
+
+    // Late by more than one period: close the block so every block
+    // timestamp stays exact, and mark the gap on the next one
+    if (overrun > 1) {
+        capture.missed_ticks += overrun - 1;
+        capture.pending_flags |= CAPTURE_FLAG_GAP;
+        capture_commit();
+    }
+    return HRTIMER_RESTART;
+}
+
+// Called with capture_mutex held
+static int capture_start(struct file *file, u32 rate_hz) {
+    if (!capture.buf)
+        return -ENOMEM;
+    if (rate_hz == 0 || rate_hz > CAPTURE_RATE_MAX)
+        return -EINVAL;
+    if (capture.owner)
+        return -EBUSY;
+    if (gpiod_cansleep(button_gpio) || gpiod_cansleep(led_gpio))
+        return -EOPNOTSUPP;
+
+    capture.ctrl->head = 0;
+    capture.ctrl->tail = 0;
+    capture.ctrl->rate_hz = rate_hz;
+    capture.ctrl->period_ns = div_u64(NSEC_PER_SEC, rate_hz);
+    capture.period = ns_to_ktime(capture.ctrl->period_ns);
+    capture.cur = NULL;
+    capture.seq = 0;
+    capture.pending_flags = 0;
+    capture.samples = 0;
+    capture.dropped = 0;
+    capture.missed_ticks = 0;
+    WRITE_ONCE(capture.owner, file);
+
+    hrtimer_start(&capture.timer, capture.period, HRTIMER_MODE_REL_HARD);
+    printk(KERN_INFO "GPIO_CTL: Capture started at %u Hz\n", rate_hz);
+    return 0;
+}
+
+// Called with capture_mutex held
+static void capture_stop(void) {
+    if (!capture.owner)
+        return;
+
+    hrtimer_cancel(&capture.timer);
+    capture_commit();
+    WRITE_ONCE(capture.owner, NULL);
+    wake_up_interruptible(&capture_wait);
+    printk(KERN_INFO "GPIO_CTL: Capture stopped, %llu samples, %llu dropped, %llu missed ticks\n",
+           capture.samples, capture.dropped, capture.missed_ticks);
+}
+
+static bool capture_ready(struct file *file) {
+    return smp_load_acquire(&capture.ctrl->head) != READ_ONCE(capture.ctrl->tail) ||
+           READ_ONCE(capture.owner) != file;
+}
+
+// Bulk read of whole committed blocks for the capture owner
+static ssize_t capture_read(struct file *file, char __user *buffer, size_t len) {
+    struct gpio_capture_ctrl *ctrl = capture.ctrl;
+    size_t copied = 0;
+    u32 head, tail;
+    int ret;
+
+    if (len < CAPTURE_BLOCK_SIZE)
+        return -EINVAL;
+
+    if (!(file->f_flags & O_NONBLOCK)) {
+        ret = wait_event_interruptible(capture_wait, capture_ready(file));
+        if (ret)
+            return ret;
+    }
+
+    head = smp_load_acquire(&ctrl->head);
+    tail = READ_ONCE(ctrl->tail);
+    while (tail != head && copied + CAPTURE_BLOCK_SIZE <= len) {
+        if (copy_to_user(buffer + copied, capture_block(tail), CAPTURE_BLOCK_SIZE))
+            break;
+        copied += CAPTURE_BLOCK_SIZE;
+        tail++;
+    }
+    smp_store_release(&ctrl->tail, tail);
+
+    if (!copied)
+        return tail != head ? -EFAULT : -EAGAIN;
+    return copied;
+}
+
+// LED backend, redirected to a fake by the KUnit suite
+static void gpio_set_led(bool on) {
+    KUNIT_STATIC_STUB_REDIRECT(gpio_set_led, on);
+    gpiod_set_value(led_gpio, on ? 1 : 0);
+}
+
+static void gpio_apply_led(bool on) {
+    unsigned long flags;
+
+    led_status = on;
+    gpio_set_led(on);
+
+    spin_lock_irqsave(&watch_lock, flags);
+    write_seqcount_begin(&watch_seqcount);
+    watch.led_changes++;
+    write_seqcount_end(&watch_seqcount);
+    watch_changed();
+    spin_unlock_irqrestore(&watch_lock, flags);
+}
+
+// Lockless check for poll, a stale answer is fixed by the next wakeup
+static bool watch_pending(struct gpio_file *gf) {
+    return gf->watching && READ_ONCE(watch.seq) != READ_ONCE(gf->seen_seq);
+}
+
+static int watch_set(struct gpio_file *gf, bool on) {
+    unsigned long flags;
+
+    mutex_lock(&watch_mutex);
+    if (gf->watching == on) {
+        mutex_unlock(&watch_mutex);
+        return 0;
+    }
+
+    if (on) {
+        // Seed the level so the first snapshot is right before any edge
+        spin_lock_irqsave(&watch_lock, flags);
+        watch.button = gpiod_get_value(button_gpio);
+        watchers++;
+        spin_unlock_irqrestore(&watch_lock, flags);
+        if (button_irq >= 0)
+            button_irq_get();
+        gf->seen_seq = 0;   // First poll reports readable for the initial draw
+    } else {
+        if (button_irq >= 0)
+            button_irq_put();
+        spin_lock_irqsave(&watch_lock, flags);
+        watchers--;
+        spin_unlock_irqrestore(&watch_lock, flags);
+    }
+    gf->watching = on;
+    mutex_unlock(&watch_mutex);
+    return 0;
+}
+
+static void watch_read(struct gpio_file *gf, struct gpio_watch_state *st) {
+    unsigned long flags;
+
+    spin_lock_irqsave(&watch_lock, flags);
+    st->seq = watch.seq;
+    st->edges = watch.edges;
+    st->led_changes = watch.led_changes;
+    st->last_edge_ns = watch.last_edge_ns;
+    st->led = led_status;
+    // Without an IRQ the level is only as fresh as this read
+    st->button = button_irq >= 0 ? watch.button : gpiod_get_value(button_gpio);
+    gf->seen_seq = watch.seq;
+    spin_unlock_irqrestore(&watch_lock, flags);
+}
+
+// Parse a write() command, one trailing newline is allowed.
+// Returns a gpio_command or -EINVAL
+static int gpio_parse_command(const char *buf, size_t len) {
+    if (len > 0 && buf[len - 1] == '\n')
+        len--;
+
+    if ((len == 1 && buf[0] == '1') || (len == 2 && !memcmp(buf, "on", 2)))
+        return GPIO_CMD_ON;
+    if ((len == 1 && buf[0] == '0') || (len == 3 && !memcmp(buf, "off", 3)))
+        return GPIO_CMD_OFF;
+    if (len == 6 && !memcmp(buf, "toggle", 6))
+        return GPIO_CMD_TOGGLE;
+    return -EINVAL;
+}
+
 // File operations implementations
 static int gpio_open(struct inode *inode, struct file *file) {
+    struct gpio_file *gf = kzalloc(sizeof(*gf), GFP_KERNEL);
+
+    if (!gf) return -ENOMEM;
+    file->private_data = gf;
     printk(KERN_INFO "GPIO_CTL: Device opened\n");
     return 0;
 }
 
 static int gpio_release(struct inode *inode, struct file *file) {
+    struct gpio_file *gf = file->private_data;
+
+    mutex_lock(&capture_mutex);
+    if (capture.owner == file)
+        capture_stop();
+    mutex_unlock(&capture_mutex);
+    watch_set(gf, false);
+    kfree(gf);
     printk(KERN_INFO "GPIO_CTL: Device closed\n");
     return 0;
 }
@@ -71,6 +663,8 @@ static ssize_t gpio_read(struct file *file, char __user *buffer, size_t len, lof
     char msg[64];
     int msg_len;
     
+    if (READ_ONCE(capture.owner) == file) return capture_read(file, buffer, len);
+    
     if (*offset > 0) return 0; // EOF
     
     // Đọc trạng thái button (polling)
@@ -99,53 +693,76 @@ static ssize_t gpio_write(struct file *file, const char __user *buffer, size_t l
         return -EFAULT;
     }
     
-    command[len] = '\0';
-    
-    // Remove newline if present
-    if (len > 0 && command[len-1] == '\n') {
-        command[len-1] = '\0';
-    }
-    
     // Process commands
-    if (strcmp(command, "1") == 0 || strcmp(command, "on") == 0) {
-        gpiod_set_value(led_gpio, 1);
-        led_status = true;
-        printk(KERN_INFO "GPIO_CTL: LED turned ON\n");
-    } else if (strcmp(command, "0") == 0 || strcmp(command, "off") == 0) {
-        gpiod_set_value(led_gpio, 0);
-        led_status = false;
-        printk(KERN_INFO "GPIO_CTL: LED turned OFF\n");
-    } else if (strcmp(command, "toggle") == 0) {
-        led_status = !led_status;
-        gpiod_set_value(led_gpio, led_status ? 1 : 0);
-        printk(KERN_INFO "GPIO_CTL: LED toggled to %s\n", led_status ? "ON" : "OFF");
-    } else {
-        printk(KERN_WARNING "GPIO_CTL: Invalid command. Use '1', '0', 'on', 'off', or 'toggle'\n");
-        return -EINVAL;
+    switch (gpio_parse_command(command, len)) {
+        case GPIO_CMD_ON:
+            gpio_apply_led(true);
+            printk(KERN_INFO "GPIO_CTL: LED turned ON\n");
+            break;
+        case GPIO_CMD_OFF:
+            gpio_apply_led(false);
+            printk(KERN_INFO "GPIO_CTL: LED turned OFF\n");
+            break;
+        case GPIO_CMD_TOGGLE:
+            gpio_apply_led(!led_status);
+            printk(KERN_INFO "GPIO_CTL: LED toggled to %s\n", led_status ? "ON" : "OFF");
+            break;
+        default:
+            printk(KERN_WARNING "GPIO_CTL: Invalid command. Use '1', '0', 'on', 'off', or 'toggle'\n");
+            return -EINVAL;
     }
     
     return len;
 }
 
+static __poll_t gpio_poll(struct file *file, poll_table *wait) {
+    struct gpio_file *gf = file->private_data;
+    
+    if (gf->watching) {
+        poll_wait(file, &watch_wait, wait);
+        return watch_pending(gf) ? EPOLLIN | EPOLLRDNORM : 0;
+    }
+    
+    if (READ_ONCE(capture.owner) != file)
+        return EPOLLIN | EPOLLRDNORM;
+    
+    poll_wait(file, &capture_wait, wait);
+    if (capture_ready(file))
+        return EPOLLIN | EPOLLRDNORM;
+    return 0;
+}
+
+// Maps the capture control page and block ring, see struct gpio_capture_ctrl
+static int gpio_mmap(struct file *file, struct vm_area_struct *vma) {
+    unsigned long size = vma->vm_end - vma->vm_start;
+    
+    if (!capture.buf) return -ENOMEM;
+    if (vma->vm_pgoff != 0 || size > PAGE_ALIGN(CAPTURE_BUF_SIZE)) return -EINVAL;
+    
+    return remap_vmalloc_range(vma, capture.buf, 0);
+}
+
 static long gpio_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
     int button_state;
+    struct gpio_pulse_stats stats;
+    struct gpio_capture_stats cstats;
+    struct gpio_watch_state wstate;
+    u32 gate_ms, rate_hz;
+    int ret, on;
     
     switch (cmd) {
         case GPIO_IOC_LED_ON:
-            gpiod_set_value(led_gpio, 1);
-            led_status = true;
+            gpio_apply_led(true);
             printk(KERN_INFO "GPIO_CTL: LED turned ON via IOCTL\n");
             break;
             
         case GPIO_IOC_LED_OFF:
-            gpiod_set_value(led_gpio, 0);
-            led_status = false;
+            gpio_apply_led(false);
             printk(KERN_INFO "GPIO_CTL: LED turned OFF via IOCTL\n");
             break;
             
         case GPIO_IOC_LED_TOGGLE:
-            led_status = !led_status;
-            gpiod_set_value(led_gpio, led_status ? 1 : 0);
+            gpio_apply_led(!led_status);
             printk(KERN_INFO "GPIO_CTL: LED toggled via IOCTL\n");
             break;
             
@@ -155,6 +772,73 @@ static long gpio_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
                 return -EFAULT;
             }
             break;
+
+        case GPIO_IOC_MEASURE_START:
+            if (copy_from_user(&gate_ms, (u32 __user *)arg, sizeof(gate_ms))) {
+                return -EFAULT;
+            }
+            return pulse_start(gate_ms);
+
+        case GPIO_IOC_MEASURE_STOP:
+            pulse_stop();
+            break;
+
+        case GPIO_IOC_MEASURE_READ:
+            pulse_read(&stats);
+            if (copy_to_user((struct gpio_pulse_stats __user *)arg, &stats, sizeof(stats))) {
+                return -EFAULT;
+            }
+            break;
+
+        case GPIO_IOC_CAPTURE_START:
+            if (copy_from_user(&rate_hz, (u32 __user *)arg, sizeof(rate_hz))) {
+                return -EFAULT;
+            }
+            mutex_lock(&capture_mutex);
+            ret = capture_start(file, rate_hz);
+            mutex_unlock(&capture_mutex);
+            return ret;
+
+        case GPIO_IOC_CAPTURE_STOP:
+            mutex_lock(&capture_mutex);
+            if (capture.owner == file) {
+                capture_stop();
+                ret = 0;
+            } else {
+                ret = capture.owner ? -EBUSY : 0;
+            }
+            mutex_unlock(&capture_mutex);
+            return ret;
+
+        case GPIO_IOC_CAPTURE_STATS:
+            if (!capture.buf) {
+                return -ENOMEM;
+            }
+            // Counters are only written by the timer, a torn read is harmless
+            cstats.rate_hz = READ_ONCE(capture.ctrl->rate_hz);
+            cstats.period_ns = READ_ONCE(capture.ctrl->period_ns);
+            cstats.samples = READ_ONCE(capture.samples);
+            cstats.dropped = READ_ONCE(capture.dropped);
+            cstats.missed_ticks = READ_ONCE(capture.missed_ticks);
+            cstats.head = smp_load_acquire(&capture.ctrl->head);
+            cstats.tail = READ_ONCE(capture.ctrl->tail);
+            if (copy_to_user((struct gpio_capture_stats __user *)arg, &cstats, sizeof(cstats))) {
+                return -EFAULT;
+            }
+            break;
+
+        case GPIO_IOC_WATCH:
+            if (copy_from_user(&on, (int __user *)arg, sizeof(on))) {
+                return -EFAULT;
+            }
+            return watch_set(file->private_data, on != 0);
+
+        case GPIO_IOC_WATCH_READ:
+            watch_read(file->private_data, &wstate);
+            if (copy_to_user((struct gpio_watch_state __user *)arg, &wstate, sizeof(wstate))) {
+                return -EFAULT;
+            }
+            break;
             
         default:
             return -EINVAL;
@@ -214,6 +898,29 @@ static void cleanup_char_device(void) {
     printk(KERN_INFO "GPIO_CTL: Character device cleanup complete\n");
 }
 
+// One /proc/gpio_ctl_status line. button is -1 unless a watcher keeps the
+// IRQ on; edges and last_edge_ns only count while it is on
+static void gpio_status_show_ctl(struct seq_file *m) {
+    u64 edges, led_changes, last_edge;
+    unsigned int seq;
+
+    do {
+        seq = read_seqcount_begin(&watch_seqcount);
+        edges = watch.edges;
+        led_changes = watch.led_changes;
+        last_edge = watch.last_edge_ns;
+    } while (read_seqcount_retry(&watch_seqcount, seq));
+
+    seq_printf(m, "driver=gpio_driver dev=%s led=%d button=%d edges=%llu led_changes=%llu "
+               "last_edge_ns=%llu measuring=%d capturing=%d\n",
+               DEVICE_NAME, READ_ONCE(led_status), READ_ONCE(watchers) ? READ_ONCE(watch.button) : -1,
+               edges, led_changes, last_edge, READ_ONCE(pulse.active), READ_ONCE(capture.owner) != NULL);
+}
+
+static struct gpio_status_source gpio_status_source = {
+    .show = gpio_status_show_ctl,
+};
+
 // Platform driver probe function
 static int gpio_ctrl_probe(struct platform_device *pdev) {
     int result;
@@ -246,13 +953,50 @@ static int gpio_ctrl_probe(struct platform_device *pdev) {
     gpio_data->led_gpio = led_gpio;
     gpio_data->button_gpio = button_gpio;
     
+    // Button IRQ for pulse measurement and watchers, left disabled until requested.
+    // The handler reads the level in hard IRQ context, so a button behind a
+    // GPIO that can sleep (I2C/SPI expander) gets no IRQ
+    if (gpiod_cansleep(button_gpio)) {
+        dev_warn(dev, "Button GPIO can sleep, pulse measurement and button watch unavailable\n");
+        button_irq = -EOPNOTSUPP;
+    } else {
+        button_irq = gpiod_to_irq(button_gpio);
+        if (button_irq < 0)
+            dev_warn(dev, "Button GPIO has no IRQ, pulse measurement and button watch unavailable\n");
+    }
+    if (button_irq >= 0) {
+        result = devm_request_irq(dev, button_irq, button_irq_handler,
+                                  IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING | IRQF_NO_AUTOEN,
+                                  "gpio_ctl_pulse", gpio_data);
+        if (result) {
+            dev_err(dev, "Failed to request button IRQ\n");
+            return result;
+        }
+    }
+    
+    // Capture buffer, allocated once so mappings stay valid across sessions
+    capture.buf = vmalloc_user(CAPTURE_BUF_SIZE);
+    if (!capture.buf) {
+        return -ENOMEM;
+    }
+    capture.ctrl = capture.buf;
+    capture.ctrl->nblocks = CAPTURE_NBLOCKS;
+    capture.ctrl->block_size = CAPTURE_BLOCK_SIZE;
+    hrtimer_init(&capture.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_HARD);
+    capture.timer.function = capture_timer_fn;
+    
     // Setup character device
     result = setup_char_device(dev);
     if (result) {
+        vfree(capture.buf);
+        capture.buf = NULL;
         return result;
     }
     
-    dev_info(dev, "GPIO Control driver initialized successfully (GPIO only, no interrupts)\n");
+    gpio_status_attach(&gpio_status_source);
+    
+    dev_info(dev, "GPIO Control driver initialized successfully (GPIO polling, pulse measurement %s)\n",
+             button_irq >= 0 ? "available" : "unavailable");
     return 0;
 }
 
@@ -260,6 +1004,14 @@ static int gpio_ctrl_probe(struct platform_device *pdev) {
 static void gpio_ctrl_remove(struct platform_device *pdev) {
     printk(KERN_INFO "GPIO_CTL: Platform device removed\n");
     
+    gpio_status_detach(&gpio_status_source);
+    
+    pulse_stop();
+    
+    mutex_lock(&capture_mutex);
+    capture_stop();
+    mutex_unlock(&capture_mutex);
+    
     // Turn off LED before removing
     if (led_gpio) {
         gpiod_set_value(led_gpio, 0);
@@ -267,6 +1019,8 @@ static void gpio_ctrl_remove(struct platform_device *pdev) {
     
     // Cleanup character device
     cleanup_char_device();
+    vfree(capture.buf);
+    capture.buf = NULL;
     
     printk(KERN_INFO "GPIO_CTL: Platform device removal complete\n");
 }
@@ -309,3 +1063,8 @@ MODULE_AUTHOR("AnhPh58");
 MODULE_DESCRIPTION("GPIO Control Driver for Raspberry Pi - GPIO only (no interrupts)");
 MODULE_VERSION("3.1");
 MODULE_ALIAS("platform:gpio-control");
+MODULE_SOFTDEP("pre: gpio_status");
+
+#ifdef GPIO_CTL_KUNIT
+#include "gpio_driver_kunit.c"
+#endif
@@ -0,0 +1,313 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests and microbenchmarks for gpio_driver.c
+ *
+ * Included at the end of gpio_driver.c when GPIO_CTL_KUNIT is defined
+ * (make KUNIT=1). The LED and button lines are redirected to fake pins,
+ * so the write() parser, the LED ioctls, pulse measurement and capture
+ * sampling run without the platform device. Benchmarks are marked slow
+ * and report ns/op through kunit_info()
+ */
+#include <kunit/test.h>
+
+#include "gpio_kunit_bench.h"
+
+#define GPIO_BENCH_ITERS 100000
+
+// Fake LED and button backend
+static int fake_led = -1;
+static unsigned int fake_led_writes;
+static int fake_button;
+
+static void fake_gpio_set_led(bool on) {
+    fake_led = on;
+    fake_led_writes++;
+}
+
+static int fake_gpio_get_led(void) {
+    return fake_led > 0;
+}
+
+static int fake_gpio_get_button(void) {
+    return fake_button;
+}
+
+static int gpio_test_init(struct kunit *test) {
+    // led_status is shared with a bound device, leave it alone
+    if (gpio_device)
+        kunit_skip(test, "gpio_driver is bound to a device");
+
+    led_status = false;
+    fake_led = -1;
+    fake_led_writes = 0;
+    fake_button = 1;
+    memset(&pulse, 0, sizeof(pulse));
+    kunit_activate_static_stub(test, gpio_set_led, fake_gpio_set_led);
+    kunit_activate_static_stub(test, gpio_get_led, fake_gpio_get_led);
+    kunit_activate_static_stub(test, gpio_get_button, fake_gpio_get_button);
+    return 0;
+}
+
+static void gpio_test_exit(struct kunit *test) {
+    if (gpio_device)
+        return;
+    memset(&pulse, 0, sizeof(pulse));
+    vfree(capture.buf);
+    memset(&capture, 0, sizeof(capture));
+}
+
+// write() command parser
+
+struct parse_case {
+    const char *input;
+    int expected;
+};
+
+static const struct parse_case parse_cases[] = {
+    { "1", GPIO_CMD_ON },
+    { "on", GPIO_CMD_ON },
+    { "1\n", GPIO_CMD_ON },
+    { "on\n", GPIO_CMD_ON },
+    { "0", GPIO_CMD_OFF },
+    { "off", GPIO_CMD_OFF },
+    { "toggle", GPIO_CMD_TOGGLE },
+    { "toggle\n", GPIO_CMD_TOGGLE },
+    { "", -EINVAL },
+    { "\n", -EINVAL },
+    { "2", -EINVAL },
+    { "ON", -EINVAL },
+    { "on ", -EINVAL },
+    { "on\n\n", -EINVAL },
+    { "togglex", -EINVAL },
+};
+
+static void parse_case_desc(const struct parse_case *c, char *desc) {
+    snprintf(desc, KUNIT_PARAM_DESC_SIZE, "\"%*pE\"", (int)strlen(c->input), c->input);
+}
+
+KUNIT_ARRAY_PARAM(parse, parse_cases, parse_case_desc);
+
+static void gpio_test_parse(struct kunit *test) {
+    const struct parse_case *c = test->param_value;
+
+    KUNIT_EXPECT_EQ(test, gpio_parse_command(c->input, strlen(c->input)), c->expected);
+}
+
+// The parser must not read past len, the write() buffer is not terminated
+static void gpio_test_parse_unterminated(struct kunit *test) {
+    const char buf[] = { 'o', 'n', 'x' };
+
+    KUNIT_EXPECT_EQ(test, gpio_parse_command(buf, 2), GPIO_CMD_ON);
+    KUNIT_EXPECT_EQ(test, gpio_parse_command(buf, 1), -EINVAL);
+}
+
+// LED ioctls through the fake backend
+
+static void gpio_test_ioctl_led(struct kunit *test) {
+    KUNIT_ASSERT_EQ(test, gpio_ioctl(NULL, GPIO_IOC_LED_ON, 0), 0L);
+    KUNIT_EXPECT_EQ(test, fake_led, 1);
+    KUNIT_EXPECT_TRUE(test, led_status);
+
+    KUNIT_ASSERT_EQ(test, gpio_ioctl(NULL, GPIO_IOC_LED_TOGGLE, 0), 0L);
+    KUNIT_EXPECT_EQ(test, fake_led, 0);
+    KUNIT_EXPECT_FALSE(test, led_status);
+
+    KUNIT_ASSERT_EQ(test, gpio_ioctl(NULL, GPIO_IOC_LED_TOGGLE, 0), 0L);
+    KUNIT_EXPECT_EQ(test, fake_led, 1);
+
+    KUNIT_ASSERT_EQ(test, gpio_ioctl(NULL, GPIO_IOC_LED_OFF, 0), 0L);
+    KUNIT_EXPECT_EQ(test, fake_led, 0);
+    KUNIT_EXPECT_FALSE(test, led_status);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 4U);
+}
+
+static void gpio_test_ioctl_unknown(struct kunit *test) {
+    KUNIT_EXPECT_EQ(test, gpio_ioctl(NULL, _IO(GPIO_IOC_MAGIC, 0x7f), 0), (long)-EINVAL);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 0U);
+}
+
+// Pulse measurement: a 1 kHz square wave, 500 us high and 500 us low
+
+#define PULSE_T0 (100 * NSEC_PER_SEC)
+#define PULSE_HALF (500 * NSEC_PER_USEC)
+
+static void pulse_setup(void) {
+    pulse.active = true;
+    pulse.gate_ns = 10 * NSEC_PER_MSEC;
+    pulse.gate_start = PULSE_T0;
+    pulse.last_level = 0;
+}
+
+// Edge k at k half periods, rising on odd k. Edge 20 closes the 10 ms gate
+static void pulse_wave(int skip) {
+    int k;
+
+    for (k = 1; k <= 20; k++) {
+        if (k == skip)
+            continue;
+        pulse_record_edge(PULSE_T0 + k * PULSE_HALF, k & 1);
+    }
+}
+
+static void gpio_test_pulse_wave(struct kunit *test) {
+    pulse_setup();
+    pulse_wave(0);
+
+    KUNIT_EXPECT_EQ(test, pulse.gate_edges, 10U);
+    KUNIT_EXPECT_EQ(test, pulse.freq_mhz, 1000000ULL);
+    KUNIT_EXPECT_EQ(test, pulse.total_edges, 20ULL);
+    KUNIT_EXPECT_EQ(test, pulse.missed, 0U);
+    KUNIT_EXPECT_EQ(test, pulse.high.count, 10U);
+    KUNIT_EXPECT_EQ(test, pulse.low.count, 9U);
+    KUNIT_EXPECT_EQ(test, pulse.high.min, (u64)PULSE_HALF);
+    KUNIT_EXPECT_EQ(test, pulse.high.max, (u64)PULSE_HALF);
+    KUNIT_EXPECT_EQ(test, pulse_mean(&pulse.low), (u64)PULSE_HALF);
+}
+
+// Edges 5 and 6 land in one IRQ that reads the level after both: the
+// widths of that pulse are lost but its rising edge still counts
+static void gpio_test_pulse_missed_edge(struct kunit *test) {
+    pulse_setup();
+    pulse_wave(5);
+
+    KUNIT_EXPECT_EQ(test, pulse.missed, 1U);
+    KUNIT_EXPECT_EQ(test, pulse.gate_edges, 10U);
+    KUNIT_EXPECT_EQ(test, pulse.freq_mhz, 1000000ULL);
+    KUNIT_EXPECT_EQ(test, pulse.high.count, 9U);
+    KUNIT_EXPECT_EQ(test, pulse.low.count, 8U);
+}
+
+// The IRQ handler feeds the pulse counters from the button line
+static void gpio_test_pulse_irq(struct kunit *test) {
+    int i;
+
+    pulse.active = true;
+    pulse.gate_ns = U64_MAX;
+    pulse.gate_start = ktime_get_ns();
+    pulse.last_level = 1;
+
+    for (i = 0; i < 6; i++) {
+        fake_button = i & 1;
+        button_irq_handler(0, NULL);
+    }
+    KUNIT_EXPECT_EQ(test, pulse.total_edges, 6ULL);
+    KUNIT_EXPECT_EQ(test, pulse.gate_rising, 3U);
+    KUNIT_EXPECT_EQ(test, pulse.missed, 0U);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 0U);
+}
+
+// Capture sampling into the block ring, without the hrtimer
+
+static void capture_setup(struct kunit *test) {
+    capture.buf = vzalloc(CAPTURE_BUF_SIZE);
+    KUNIT_ASSERT_NOT_NULL(test, capture.buf);
+    capture.ctrl = capture.buf;
+    capture.ctrl->nblocks = CAPTURE_NBLOCKS;
+    capture.ctrl->block_size = CAPTURE_BLOCK_SIZE;
+    capture.ctrl->period_ns = 10 * NSEC_PER_USEC;
+}
+
+static void gpio_test_capture_block(struct kunit *test) {
+    struct gpio_capture_block *blk;
+    unsigned int i;
+
+    capture_setup(test);
+    fake_led = 1;
+    for (i = 0; i < CAPTURE_BLOCK_SAMPLES; i++) {
+        fake_button = i & 1;
+        capture_sample(PULSE_T0 + i * 10 * NSEC_PER_USEC);
+    }
+    KUNIT_EXPECT_EQ(test, capture.ctrl->head, 1U);
+    KUNIT_EXPECT_PTR_EQ(test, capture.cur, NULL);
+    KUNIT_EXPECT_EQ(test, capture.samples, (u64)CAPTURE_BLOCK_SAMPLES);
+
+    blk = capture_block(0);
+    KUNIT_EXPECT_EQ(test, blk->timestamp, (u64)PULSE_T0);
+    KUNIT_EXPECT_EQ(test, blk->seq, 0U);
+    KUNIT_EXPECT_EQ(test, blk->nsamples, (u16)CAPTURE_BLOCK_SAMPLES);
+    KUNIT_EXPECT_EQ(test, blk->nlines, CAPTURE_LINES);
+    KUNIT_EXPECT_EQ(test, blk->flags, 0);
+    // Four samples per byte, (button 0, LED 1) and (button 1, LED 1) in turn
+    KUNIT_EXPECT_EQ(test, blk->data[0], 0xee);
+    KUNIT_EXPECT_EQ(test, blk->data[CAPTURE_BLOCK_DATA - 1], 0xee);
+}
+
+// A full ring drops samples and flags the next block
+static void gpio_test_capture_overrun(struct kunit *test) {
+    struct gpio_capture_block *blk;
+
+    capture_setup(test);
+    capture.ctrl->head = CAPTURE_NBLOCKS;
+    capture_sample(PULSE_T0);
+    capture_sample(PULSE_T0 + 10 * NSEC_PER_USEC);
+    KUNIT_EXPECT_EQ(test, capture.dropped, 2ULL);
+    KUNIT_EXPECT_EQ(test, capture.samples, 0ULL);
+    KUNIT_EXPECT_PTR_EQ(test, capture.cur, NULL);
+
+    capture.ctrl->tail = 1;
+    capture_sample(PULSE_T0 + 20 * NSEC_PER_USEC);
+    blk = capture.cur;
+    KUNIT_ASSERT_PTR_EQ(test, blk, capture_block(CAPTURE_NBLOCKS));
+    KUNIT_EXPECT_EQ(test, blk->flags, CAPTURE_FLAG_OVERRUN);
+    KUNIT_EXPECT_EQ(test, blk->nsamples, 1);
+    KUNIT_EXPECT_EQ(test, capture.pending_flags, 0);
+
+    capture_commit();
+    KUNIT_EXPECT_EQ(test, capture.ctrl->head, CAPTURE_NBLOCKS + 1U);
+}
+
+// Microbenchmarks
+
+static void gpio_bench_parse(struct kunit *test) {
+    static const char *const inputs[] = { "on\n", "off\n", "toggle\n", "bogus\n" };
+    unsigned int i, hits = 0;
+    u64 start;
+
+    start = ktime_get_ns();
+    for (i = 0; i < GPIO_BENCH_ITERS; i++) {
+        const char *in = inputs[i & 3];
+
+        if (gpio_parse_command(in, strlen(in)) >= 0)
+            hits++;
+    }
+    gpio_kunit_bench_report(test, "parse_command", ktime_get_ns() - start, GPIO_BENCH_ITERS);
+    KUNIT_EXPECT_EQ(test, hits, GPIO_BENCH_ITERS / 4 * 3);
+}
+
+// Dispatch cost of a cheap ioctl: MEASURE_STOP is a no-op while idle
+static void gpio_bench_ioctl_dispatch(struct kunit *test) {
+    unsigned int i;
+    u64 start;
+
+    if (pulse.active)
+        kunit_skip(test, "pulse measurement is running");
+
+    start = ktime_get_ns();
+    for (i = 0; i < GPIO_BENCH_ITERS; i++)
+        gpio_ioctl(NULL, GPIO_IOC_MEASURE_STOP, 0);
+    gpio_kunit_bench_report(test, "ioctl_dispatch", ktime_get_ns() - start, GPIO_BENCH_ITERS);
+}
+
+static struct kunit_case gpio_test_cases[] = {
+    KUNIT_CASE_PARAM(gpio_test_parse, parse_gen_params),
+    KUNIT_CASE(gpio_test_parse_unterminated),
+    KUNIT_CASE(gpio_test_ioctl_led),
+    KUNIT_CASE(gpio_test_ioctl_unknown),
+    KUNIT_CASE(gpio_test_pulse_wave),
+    KUNIT_CASE(gpio_test_pulse_missed_edge),
+    KUNIT_CASE(gpio_test_pulse_irq),
+    KUNIT_CASE(gpio_test_capture_block),
+    KUNIT_CASE(gpio_test_capture_overrun),
+    KUNIT_CASE_SLOW(gpio_bench_parse),
+    KUNIT_CASE_SLOW(gpio_bench_ioctl_dispatch),
+    {}
+};
+
+static struct kunit_suite gpio_test_suite = {
+    .name = "gpio_ctl",
+    .init = gpio_test_init,
+    .exit = gpio_test_exit,
+    .test_cases = gpio_test_cases,
+};
+
+kunit_test_suite(gpio_test_suite);
@@ -0,0 +1,215 @@
+/*
+ * Capture (logic analyzer) benchmark for /dev/gpio_ctl
+ *
+ * Runs GPIO_IOC_CAPTURE_START at a series of sample rates and drains the
+ * block ring with bulk read() or through the mmap'd control page. Prints
+ * one CSV row per rate:
+ *   achieved_hz   samples stored per second of wall time
+ *   dropped       samples lost because the ring was full (reader too slow)
+ *   missed_ticks  timer periods that fired too late to be sampled
+ *   gap_blocks    blocks flagged CAPTURE_FLAG_GAP (timestamps re-anchored)
+ *   ovr_blocks    blocks flagged CAPTURE_FLAG_OVERRUN (data lost before them)
+ *   seq_errors    blocks whose seq did not follow the previous one
+ *
+ * A rate is sustained when dropped and missed_ticks are both zero.
+ * -d <us> adds a delay after every read to show overrun behaviour: once
+ * the 256-block ring fills, new samples are dropped (the oldest data is
+ * kept) and the next block written carries CAPTURE_FLAG_OVERRUN.
+ *
+ * Usage: capture_bench [-m] [-t seconds] [-d reader_delay_us] [rate_hz...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#define DEVICE_PATH "/dev/gpio_ctl"
+
+// IOCTL commands and capture layout, must match gpio_driver.c
+#define GPIO_IOC_MAGIC 'g'
+#define GPIO_IOC_CAPTURE_START _IOW(GPIO_IOC_MAGIC, 8, uint32_t)
+#define GPIO_IOC_CAPTURE_STOP  _IO(GPIO_IOC_MAGIC, 9)
+#define GPIO_IOC_CAPTURE_STATS _IOR(GPIO_IOC_MAGIC, 10, struct gpio_capture_stats)
+
+#define CAPTURE_BLOCK_SIZE 512
+#define CAPTURE_BLOCK_DATA (CAPTURE_BLOCK_SIZE - 16)
+#define CAPTURE_FLAG_OVERRUN 0x01
+#define CAPTURE_FLAG_GAP     0x02
+#define READ_BLOCKS 64
+
+struct gpio_capture_block {
+    uint64_t timestamp;
+    uint32_t seq;
+    uint16_t nsamples;
+    uint8_t nlines;
+    uint8_t flags;
+    uint8_t data[CAPTURE_BLOCK_DATA];
+};
+
+struct gpio_capture_ctrl {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t nblocks;
+    uint32_t block_size;
+    uint32_t rate_hz;
+    uint32_t period_ns;
+};
+
+struct gpio_capture_stats {
+    uint32_t rate_hz;
+    uint32_t period_ns;
+    uint64_t samples;
+    uint64_t dropped;
+    uint64_t missed_ticks;
+    uint32_t head;
+    uint32_t tail;
+};
+
+struct bench_result {
+    unsigned long blocks;
+    unsigned long gap_blocks;
+    unsigned long ovr_blocks;
+    unsigned long seq_errors;
+    uint32_t next_seq;
+};
+
+static const uint32_t default_rates[] = { 1000, 5000, 10000, 20000, 50000, 100000, 200000 };
+
+static double now_sec(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void account_block(struct bench_result *res, const struct gpio_capture_block *blk) {
+    if (blk->seq != res->next_seq)
+        res->seq_errors++;
+    res->next_seq = blk->seq + 1;
+    res->blocks++;
+    if (blk->flags & CAPTURE_FLAG_GAP)
+        res->gap_blocks++;
+    if (blk->flags & CAPTURE_FLAG_OVERRUN)
+        res->ovr_blocks++;
+}
+
+// Drain whatever is committed, through read() or the mapping
+static int drain(int fd, void *map, struct bench_result *res) {
+    static struct gpio_capture_block buf[READ_BLOCKS];
+    ssize_t n;
+    int i;
+
+    if (map) {
+        struct gpio_capture_ctrl *ctrl = map;
+        uint32_t head = __atomic_load_n(&ctrl->head, __ATOMIC_ACQUIRE);
+        uint32_t tail = ctrl->tail;
+
+        while (tail != head) {
+            account_block(res, (void *)((char *)map + 4096 +
+                          (tail % ctrl->nblocks) * ctrl->block_size));
+            tail++;
+        }
+        __atomic_store_n(&ctrl->tail, tail, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    n = read(fd, buf, sizeof(buf));
+    if (n < 0)
+        return errno == EAGAIN ? 0 : -1;
+    for (i = 0; i < n / CAPTURE_BLOCK_SIZE; i++)
+        account_block(res, &buf[i]);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const uint32_t *rates = default_rates;
+    size_t nrates = sizeof(default_rates) / sizeof(default_rates[0]);
+    uint32_t user_rates[32];
+    double seconds = 5.0;
+    long delay_us = 0;
+    int use_mmap = 0;
+    size_t r;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "mt:d:")) != -1) {
+        switch (opt) {
+        case 'm': use_mmap = 1; break;
+        case 't': seconds = atof(optarg); break;
+        case 'd': delay_us = atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-m] [-t seconds] [-d reader_delay_us] [rate_hz...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc) {
+        for (nrates = 0; optind < argc && nrates < 32; optind++)
+            user_rates[nrates++] = strtoul(argv[optind], NULL, 0);
+        rates = user_rates;
+    }
+
+    printf("rate_hz,mode,seconds,samples,achieved_hz,dropped,missed_ticks,blocks,gap_blocks,ovr_blocks,seq_errors\n");
+
+    for (r = 0; r < nrates; r++) {
+        struct bench_result res = { 0 };
+        struct gpio_capture_stats st;
+        uint32_t rate = rates[r];
+        void *map = NULL;
+        size_t map_len = 4096 + 256 * CAPTURE_BLOCK_SIZE;
+        double start, elapsed;
+        int fd;
+
+        fd = open(DEVICE_PATH, O_RDWR | (use_mmap ? O_NONBLOCK : 0));
+        if (fd < 0) {
+            perror("Failed to open device");
+            return 1;
+        }
+        if (use_mmap) {
+            map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                perror("Failed to map capture buffer");
+                return 1;
+            }
+        }
+        if (ioctl(fd, GPIO_IOC_CAPTURE_START, &rate) < 0) {
+            perror("Failed to start capture");
+            return 1;
+        }
+
+        start = now_sec();
+        while ((elapsed = now_sec() - start) < seconds) {
+            if (drain(fd, map, &res) < 0) {
+                perror("Failed to read capture");
+                break;
+            }
+            if (delay_us)
+                usleep(delay_us);
+            else if (use_mmap)
+                usleep(1000);
+        }
+
+        ioctl(fd, GPIO_IOC_CAPTURE_STATS, &st);
+        ioctl(fd, GPIO_IOC_CAPTURE_STOP);
+        // The partial last block is only reachable through the mapping,
+        // read() on the file returns text status once the capture stops
+        if (map)
+            drain(fd, map, &res);
+
+        printf("%u,%s,%.2f,%llu,%.0f,%llu,%llu,%lu,%lu,%lu,%lu\n", rate,
+               use_mmap ? "mmap" : "read", elapsed, (unsigned long long)st.samples,
+               st.samples / elapsed, (unsigned long long)st.dropped,
+               (unsigned long long)st.missed_ticks, res.blocks, res.gap_blocks,
+               res.ovr_blocks, res.seq_errors);
+
+        if (map)
+            munmap(map, map_len);
+        close(fd);
+    }
+
+    return 0;
+}
@@ -8,7 +8,16 @@
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/interrupt.h>
+#include <linux/irq.h>
 #include <linux/delay.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/seqlock.h>
+#include <kunit/static_stub.h>
+
+#include "gpio_status.h"
+#include "gpio_debounce.h"
 
 #define DEVICE_NAME "gpio_ctl2" 
 #define CLASS_NAME "gpio_class2"
@@ -19,6 +28,48 @@
 #define GPIO_IOC_LED_OFF   _IO(GPIO_IOC_MAGIC, 2)
 #define GPIO_IOC_LED_TOGGLE _IO(GPIO_IOC_MAGIC, 3)
 #define GPIO_IOC_GET_STATUS _IOR(GPIO_IOC_MAGIC, 4, int)
+#define GPIO_IOC_MEASURE_START _IOW(GPIO_IOC_MAGIC, 5, __u32)  // Gate time in ms
+#define GPIO_IOC_MEASURE_STOP  _IO(GPIO_IOC_MAGIC, 6)
+#define GPIO_IOC_MEASURE_READ  _IOR(GPIO_IOC_MAGIC, 7, struct gpio_pulse_stats)
+#define GPIO_IOC_DEBOUNCE_READ _IOR(GPIO_IOC_MAGIC, 8, struct gpio_debounce_stats)
+
+#define PULSE_GATE_MIN_MS 10
+#define PULSE_GATE_MAX_MS 10000
+
+// Adaptive debounce window bounds, overridable with debounce-min-ms / debounce-max-ms
+#define DEBOUNCE_MIN_MS 2
+#define DEBOUNCE_MAX_MS 50
+#define DEBOUNCE_LIMIT_MS 1000
+
+// Pulse measurement results, returned by GPIO_IOC_MEASURE_READ
+struct gpio_pulse_stats {
+    __u32 gate_ms;          // Configured gate time
+    __u32 gate_edges;       // Rising edges in the last completed gate
+    __u64 freq_mhz;         // Frequency of the last completed gate, in milli-Hz
+    __u64 total_edges;      // All edges since GPIO_IOC_MEASURE_START
+    __u64 high_min_ns;
+    __u64 high_max_ns;
+    __u64 high_mean_ns;
+    __u64 low_min_ns;
+    __u64 low_max_ns;
+    __u64 low_mean_ns;
+    __u32 high_count;       // Completed high pulses
+    __u32 low_count;        // Completed low pulses
+    __u32 missed;           // Edges where the level did not change (lost edge)
+    __u32 reserved;
+};
+
+// Adaptive debounce state, returned by GPIO_IOC_DEBOUNCE_READ
+struct gpio_debounce_stats {
+    __u32 window_ns;        // Current window, the line must be quiet this long
+    __u32 min_ns;           // Window bounds
+    __u32 max_ns;
+    __u32 bounce_avg_ns;    // Smoothed longest bounce gap per press
+    __u32 bounce_dev_ns;    // Smoothed mean deviation of that gap
+    __u32 accepted;         // Edges accepted as presses
+    __u32 bounces;          // Edges rejected inside the window
+    __u32 late;             // Accepted edges closer than max_ns to the previous accepted one
+};
 
 // Device variables
 static dev_t dev_num;
@@ -40,20 +91,154 @@ static bool led_state = false;
 static int button_irq;
 static bool last_button_state = true; // Default HIGH (pull-up)
 
+// Adaptive debounce state, only touched by the IRQ handler. The IRQ is
+// falling edge only, so every edge is fed in as a press: release bounce
+// is only filtered if it falls inside the window of the press, and a
+// release itself never restarts the quiet period
+static struct gpio_debounce debounce = {
+    .window_ns = DEBOUNCE_MAX_MS * NSEC_PER_MSEC,
+};
+static u32 debounce_min_ns = DEBOUNCE_MIN_MS * NSEC_PER_MSEC;
+static u32 debounce_max_ns = DEBOUNCE_MAX_MS * NSEC_PER_MSEC;
+// Bumped by the IRQ handler around gpio_debounce_edge(), so /proc/gpio_ctl_status
+// reads last_edge in one piece on 32-bit
+static seqcount_t debounce_seqcount = SEQCNT_ZERO(debounce_seqcount);
+
+// Pulse measurement state, updated in the IRQ under pulse_lock
+struct pulse_width {
+    u64 min;
+    u64 max;
+    u64 sum;
+    u32 count;
+};
+
+static struct {
+    bool active;
+    u64 gate_ns;
+    u64 gate_start;         // Start of the current gate
+    u32 gate_rising;        // Rising edges in the current gate
+    u32 gate_edges;         // Latched from the last completed gate
+    u64 freq_mhz;           // Latched from the last completed gate
+    u64 total_edges;
+    u64 last_edge;          // Timestamp of the previous edge
+    int last_level;
+    u32 missed;
+    struct pulse_width high;
+    struct pulse_width low;
+} pulse;
+static DEFINE_SPINLOCK(pulse_lock);
+
+// Pulse measurement helpers, called with pulse_lock held
+static void pulse_close_gate(u64 now)
+{
+    u64 elapsed = now - pulse.gate_start;
+
+    pulse.gate_edges = pulse.gate_rising;
+    pulse.freq_mhz = elapsed ? div64_u64((u64)pulse.gate_rising * 1000 * NSEC_PER_SEC, elapsed) : 0;
+    pulse.gate_rising = 0;
+    pulse.gate_start = now;
+}
+
+static void pulse_add_width(struct pulse_width *w, u64 width)
+{
+    if (!w->count || width < w->min)
+        w->min = width;
+    if (width > w->max)
+        w->max = width;
+    w->sum += width;
+    w->count++;
+}
+
+static void pulse_record_edge(u64 now, int level)
+{
+    if (now - pulse.gate_start >= pulse.gate_ns)
+        pulse_close_gate(now);
+
+    pulse.total_edges++;
+    if (level == pulse.last_level) {
+        // Both edges of a pulse arrived before we sampled, width unknown.
+        // The lost pulse still had one rising edge
+        pulse.missed++;
+        pulse.gate_rising++;
+    } else {
+        if (pulse.last_edge)
+            pulse_add_width(pulse.last_level ? &pulse.high : &pulse.low, now - pulse.last_edge);
+        if (level)
+            pulse.gate_rising++;
+    }
+    pulse.last_level = level;
+    pulse.last_edge = now;
+}
+
+// Clock and GPIO accessors used by the IRQ handler. The KUnit suite
+// redirects them to a fake clock and fake pins. The clock is in ns,
+// bounce gaps are far below a jiffy
+static u64 gpio2_now(void)
+{
+    KUNIT_STATIC_STUB_REDIRECT(gpio2_now);
+    return ktime_get_ns();
+}
+
+static int gpio2_get_button(void)
+{
+    KUNIT_STATIC_STUB_REDIRECT(gpio2_get_button);
+    return gpiod_get_value(button_gpio);
+}
+
+static void gpio2_set_led(bool on)
+{
+    KUNIT_STATIC_STUB_REDIRECT(gpio2_set_led, on);
+    gpiod_set_value(led_gpio, on);
+}
+
+// Forget the learnt bounce profile and start from the upper bound
+static void debounce_reset(u32 min_ns, u32 max_ns)
+{
+    debounce_min_ns = min_ns;
+    debounce_max_ns = max_ns;
+    gpio_debounce_reset(&debounce, max_ns);
+}
+
+// Snapshot for GPIO_IOC_DEBOUNCE_READ. The handler updates the fields
+// without a lock, so the numbers may straddle an edge
+static void debounce_read(struct gpio_debounce_stats *st)
+{
+    st->window_ns = READ_ONCE(debounce.window_ns);
+    st->min_ns = debounce_min_ns;
+    st->max_ns = debounce_max_ns;
+    st->bounce_avg_ns = READ_ONCE(debounce.avg);
+    st->bounce_dev_ns = READ_ONCE(debounce.dev);
+    st->accepted = READ_ONCE(debounce.edges);
+    st->bounces = READ_ONCE(debounce.bounces);
+    st->late = READ_ONCE(debounce.late);
+}
+
 // Button interrupt handler - SIMPLIFIED VERSION
+// In measurement mode every edge is timestamped instead of toggling the LED
 static irqreturn_t button_irq_handler(int irq, void *dev_id)
 {
-    static unsigned long last_interrupt_time = 0;
-    unsigned long interrupt_time = jiffies;
+    bool accepted;
     
-    if (interrupt_time - last_interrupt_time < msecs_to_jiffies(50)) {
+    if (pulse.active) {
+        u64 now = ktime_get_ns();
+        int level = gpio2_get_button();
+
+        spin_lock(&pulse_lock);
+        if (pulse.active)
+            pulse_record_edge(now, level);
+        spin_unlock(&pulse_lock);
         return IRQ_HANDLED;
     }
-    last_interrupt_time = interrupt_time;
+    
+    write_seqcount_begin(&debounce_seqcount);
+    accepted = gpio_debounce_edge(&debounce, gpio2_now(), true, debounce_min_ns, debounce_max_ns);
+    write_seqcount_end(&debounce_seqcount);
+    if (!accepted)
+        return IRQ_HANDLED;
     
     // Toggle LED ngay lập tức - không cần check state
     led_state = !led_state;
-    gpiod_set_value(led_gpio, led_state);
+    gpio2_set_led(led_state);
     
     printk(KERN_INFO "GPIO_CTL2: Button pressed! LED %s\n", 
            led_state ? "ON" : "OFF");
@@ -61,6 +246,95 @@ static irqreturn_t button_irq_handler(int irq, void *dev_id)
     return IRQ_HANDLED;
 }
 
+// Switch the button IRQ to both edges and start counting
+static int pulse_start(u32 gate_ms)
+{
+    unsigned long flags;
+    int ret;
+
+    if (gate_ms < PULSE_GATE_MIN_MS || gate_ms > PULSE_GATE_MAX_MS)
+        return -EINVAL;
+
+    disable_irq(button_irq);
+    spin_lock_irqsave(&pulse_lock, flags);
+    if (pulse.active) {
+        spin_unlock_irqrestore(&pulse_lock, flags);
+        enable_irq(button_irq);
+        return -EBUSY;
+    }
+    memset(&pulse, 0, sizeof(pulse));
+    pulse.gate_ns = (u64)gate_ms * NSEC_PER_MSEC;
+    pulse.gate_start = ktime_get_ns();
+    pulse.last_level = gpiod_get_value(button_gpio);
+    pulse.active = true;
+    spin_unlock_irqrestore(&pulse_lock, flags);
+
+    ret = irq_set_irq_type(button_irq, IRQ_TYPE_EDGE_BOTH);
+    enable_irq(button_irq);
+    if (ret) {
+        printk(KERN_ERR "GPIO_CTL2: Failed to set both-edge trigger\n");
+        spin_lock_irqsave(&pulse_lock, flags);
+        pulse.active = false;
+        spin_unlock_irqrestore(&pulse_lock, flags);
+        return ret;
+    }
+
+    printk(KERN_INFO "GPIO_CTL2: Pulse measurement started (gate %u ms)\n", gate_ms);
+    return 0;
+}
+
+// Return the button IRQ to falling-edge LED toggling
+static void pulse_stop(void)
+{
+    unsigned long flags;
+    bool was_active;
+
+    disable_irq(button_irq);
+    spin_lock_irqsave(&pulse_lock, flags);
+    was_active = pulse.active;
+    pulse.active = false;
+    spin_unlock_irqrestore(&pulse_lock, flags);
+
+    if (was_active)
+        irq_set_irq_type(button_irq, IRQ_TYPE_EDGE_FALLING);
+    enable_irq(button_irq);
+
+    if (was_active)
+        printk(KERN_INFO "GPIO_CTL2: Pulse measurement stopped\n");
+}
+
+static u64 pulse_mean(const struct pulse_width *w)
+{
+    return w->count ? div64_u64(w->sum, w->count) : 0;
+}
+
+static void pulse_read(struct gpio_pulse_stats *st)
+{
+    unsigned long flags;
+    u64 now = ktime_get_ns();
+
+    spin_lock_irqsave(&pulse_lock, flags);
+    // Close an expired gate so an idle input reads 0 Hz instead of stale data
+    if (pulse.active && now - pulse.gate_start >= pulse.gate_ns)
+        pulse_close_gate(now);
+
+    st->gate_ms = div64_u64(pulse.gate_ns, NSEC_PER_MSEC);
+    st->gate_edges = pulse.gate_edges;
+    st->freq_mhz = pulse.freq_mhz;
+    st->total_edges = pulse.total_edges;
+    st->high_min_ns = pulse.high.min;
+    st->high_max_ns = pulse.high.max;
+    st->high_mean_ns = pulse_mean(&pulse.high);
+    st->low_min_ns = pulse.low.min;
+    st->low_max_ns = pulse.low.max;
+    st->low_mean_ns = pulse_mean(&pulse.low);
+    st->high_count = pulse.high.count;
+    st->low_count = pulse.low.count;
+    st->missed = pulse.missed;
+    st->reserved = 0;
+    spin_unlock_irqrestore(&pulse_lock, flags);
+}
+
 // Character device file operations
 static int gpio_open(struct inode *inode, struct file *file)
 {
@@ -143,6 +417,9 @@ static ssize_t gpio_write(struct file *file, const char __user *buffer, size_t l
 static long gpio_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
     int status;
+    struct gpio_pulse_stats stats;
+    struct gpio_debounce_stats db;
+    u32 gate_ms;
     
     switch (cmd) {
         case GPIO_IOC_LED_ON:
@@ -169,6 +446,27 @@ static long gpio_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
             if (copy_to_user((int __user *)arg, &status, sizeof(status)))
                 return -EFAULT;
             break;
+
+        case GPIO_IOC_MEASURE_START:
+            if (copy_from_user(&gate_ms, (u32 __user *)arg, sizeof(gate_ms)))
+                return -EFAULT;
+            return pulse_start(gate_ms);
+
+        case GPIO_IOC_MEASURE_STOP:
+            pulse_stop();
+            break;
+
+        case GPIO_IOC_MEASURE_READ:
+            pulse_read(&stats);
+            if (copy_to_user((struct gpio_pulse_stats __user *)arg, &stats, sizeof(stats)))
+                return -EFAULT;
+            break;
+
+        case GPIO_IOC_DEBOUNCE_READ:
+            debounce_read(&db);
+            if (copy_to_user((struct gpio_debounce_stats __user *)arg, &db, sizeof(db)))
+                return -EFAULT;
+            break;
             
         default:
             return -ENOTTY;
@@ -186,15 +484,50 @@ static struct file_operations gpio_fops = {
     .unlocked_ioctl = gpio_ioctl,
 };
 
+// One /proc/gpio_ctl_status line with the LED and the debounce counters
+static void gpio2_status_show(struct seq_file *m)
+{
+    struct gpio_debounce_stats st;
+    unsigned int seq;
+    u64 last_edge;
+
+    do {
+        seq = read_seqcount_begin(&debounce_seqcount);
+        last_edge = debounce.last_edge;
+    } while (read_seqcount_retry(&debounce_seqcount, seq));
+    debounce_read(&st);
+
+    seq_printf(m, "driver=gpio_driver_2 dev=%s led=%d accepted=%u bounces=%u late=%u window_ns=%u "
+               "last_edge_ns=%llu measuring=%d\n",
+               DEVICE_NAME, READ_ONCE(led_state), st.accepted, st.bounces, st.late, st.window_ns,
+               last_edge, READ_ONCE(pulse.active));
+}
+
+static struct gpio_status_source gpio2_status_source = {
+    .show = gpio2_status_show,
+};
+
 // Platform driver probe function - FIXED VERSION
 static int gpio_probe(struct platform_device *pdev)
 {
     int ret;
+    u32 min_ms = DEBOUNCE_MIN_MS, max_ms = DEBOUNCE_MAX_MS;
     
     printk(KERN_INFO "GPIO_CTL2: Platform device probed\n");
     
     pdev_global = pdev;
     
+    // Debounce window bounds, the window adapts between them
+    of_property_read_u32(pdev->dev.of_node, "debounce-min-ms", &min_ms);
+    of_property_read_u32(pdev->dev.of_node, "debounce-max-ms", &max_ms);
+    if (min_ms == 0 || min_ms > max_ms || max_ms > DEBOUNCE_LIMIT_MS) {
+        printk(KERN_WARNING "GPIO_CTL2: Bad debounce bounds %u-%u ms, using defaults\n",
+               min_ms, max_ms);
+        min_ms = DEBOUNCE_MIN_MS;
+        max_ms = DEBOUNCE_MAX_MS;
+    }
+    debounce_reset(min_ms * NSEC_PER_MSEC, max_ms * NSEC_PER_MSEC);
+    
     // Get LED GPIO (GPIO25) - Output, initially LOW
     // No need to set flag 
     led_gpio = devm_gpiod_get(&pdev->dev, "led", 0);
@@ -204,7 +537,7 @@ static int gpio_probe(struct platform_device *pdev)
     }
     
     // Get Button GPIO (GPIO16) - Input 
-    button_gpio = devm_gpiod_get(&pdev->dev, "button", 0;
+    button_gpio = devm_gpiod_get(&pdev->dev, "button", 0);
     if (IS_ERR(button_gpio)) {
         printk(KERN_ERR "GPIO_CTL2: Failed to get Button GPIO (GPIO16)\n");
         return PTR_ERR(button_gpio);
@@ -278,6 +611,8 @@ static int gpio_probe(struct platform_device *pdev)
     printk(KERN_INFO "GPIO_CTL2: Character device created: /dev/%s (major: %d)\n", 
            DEVICE_NAME, MAJOR(dev_num));
     
+    gpio_status_attach(&gpio2_status_source);
+    
     dev_info(&pdev->dev, "GPIO Control driver 2 initialized (GPIO25=LED, GPIO16=Button, pull-up from DT)\n");
     
     return 0;
@@ -288,6 +623,10 @@ static void gpio_remove(struct platform_device *pdev)
 {
     printk(KERN_INFO "GPIO_CTL2: Platform device removed\n");
     
+    gpio_status_detach(&gpio2_status_source);
+    
+    pulse_stop();
+    
     // Cleanup device
     device_destroy(gpio_class, dev_num);
     class_destroy(gpio_class);
@@ -347,4 +686,8 @@ module_exit(gpio_driver_exit);
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("GPIO Control Driver 2");
 MODULE_DESCRIPTION("GPIO Control Driver 2 for LED (GPIO25) and 2-pin Button (GPIO16→GND)");
-MODULE_VERSION("3.0"); 
\ No newline at end of file
+MODULE_VERSION("3.0"); 
+MODULE_SOFTDEP("pre: gpio_status");
+#ifdef GPIO_CTL2_KUNIT
+#include "gpio_driver_2_kunit.c"
+#endif
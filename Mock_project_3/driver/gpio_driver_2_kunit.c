@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests and microbenchmarks for gpio_driver_2.c
+ *
+ * Included at the end of gpio_driver_2.c when GPIO_CTL2_KUNIT is defined
+ * (make KUNIT=1). The IRQ handler is called directly with a fake
+ * ns clock and fake pins, so debounce and the pulse measurement path
+ * run without the button wired up. Benchmarks are marked slow and report
+ * ns/op through kunit_info()
+ */
+#include <kunit/test.h>
+
+#include "gpio_kunit_bench.h"
+
+#define GPIO2_BENCH_ITERS 100000
+
+// Fake clock and pins
+static u64 fake_ns;
+static int fake_button;
+static unsigned int fake_led_writes;
+
+static u64 fake_gpio2_now(void)
+{
+    return fake_ns;
+}
+
+static int fake_gpio2_get_button(void)
+{
+    return fake_button;
+}
+
+static void fake_gpio2_set_led(bool on)
+{
+    fake_led_writes++;
+}
+
+static int gpio2_test_init(struct kunit *test)
+{
+    // The handler state is shared with a bound device
+    if (pdev_global)
+        kunit_skip(test, "gpio_driver_2 is bound to a device");
+
+    memset(&pulse, 0, sizeof(pulse));
+    led_state = false;
+    debounce_reset(DEBOUNCE_MIN_MS * NSEC_PER_MSEC, DEBOUNCE_MAX_MS * NSEC_PER_MSEC);
+    fake_ns = 100 * NSEC_PER_SEC;
+    fake_button = 1;
+    fake_led_writes = 0;
+    kunit_activate_static_stub(test, gpio2_now, fake_gpio2_now);
+    kunit_activate_static_stub(test, gpio2_get_button, fake_gpio2_get_button);
+    kunit_activate_static_stub(test, gpio2_set_led, fake_gpio2_set_led);
+    return 0;
+}
+
+// Like a real hardirq: the handler's seqcount writer needs preemption off
+static void press(void)
+{
+    local_irq_disable();
+    button_irq_handler(0, NULL);
+    local_irq_enable();
+}
+
+// Debounce
+
+static void gpio2_test_debounce(struct kunit *test)
+{
+    u64 window = debounce.window_ns;
+
+    KUNIT_EXPECT_EQ(test, window, DEBOUNCE_MAX_MS * NSEC_PER_MSEC);
+    press();
+    KUNIT_EXPECT_TRUE(test, led_state);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 1U);
+
+    fake_ns += window - 1;
+    press();
+    KUNIT_EXPECT_TRUE(test, led_state);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 1U);
+
+    // The bounce restarted the quiet period
+    fake_ns += window - 1;
+    press();
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 1U);
+
+    fake_ns += window;
+    press();
+    KUNIT_EXPECT_FALSE(test, led_state);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 2U);
+    KUNIT_EXPECT_EQ(test, debounce.bounces, 2U);
+}
+
+static void gpio2_test_debounce_adapt(struct kunit *test)
+{
+    int i;
+
+    // Clean presses shrink the window to the lower bound
+    for (i = 0; i < 3; i++) {
+        press();
+        fake_ns += 200 * NSEC_PER_MSEC;
+    }
+    KUNIT_EXPECT_EQ(test, debounce.window_ns, debounce_min_ns);
+
+    // A 3 ms bounce slips through the 2 ms window once, then is learnt
+    press();
+    fake_ns += NSEC_PER_MSEC;
+    press();
+    fake_ns += 3 * NSEC_PER_MSEC;
+    press();
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 5U);
+    KUNIT_EXPECT_EQ(test, debounce.late, 1U);
+    KUNIT_EXPECT_GT(test, debounce.window_ns, 3 * NSEC_PER_MSEC);
+
+    fake_ns += 200 * NSEC_PER_MSEC;
+    press();
+    fake_ns += NSEC_PER_MSEC;
+    press();
+    fake_ns += 3 * NSEC_PER_MSEC;
+    press();
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 6U);
+    KUNIT_EXPECT_EQ(test, debounce.late, 1U);
+    KUNIT_EXPECT_LE(test, debounce.window_ns, debounce_max_ns);
+}
+
+// Pulse measurement bypasses debounce and leaves the LED alone
+
+static void gpio2_test_pulse_bypass(struct kunit *test)
+{
+    int i;
+
+    pulse.active = true;
+    pulse.gate_ns = U64_MAX;
+    pulse.gate_start = ktime_get_ns();
+    pulse.last_level = 1;
+
+    for (i = 0; i < 6; i++) {
+        fake_button = i & 1;
+        press();
+    }
+    KUNIT_EXPECT_EQ(test, pulse.total_edges, 6ULL);
+    KUNIT_EXPECT_EQ(test, pulse.gate_rising, 3U);
+    KUNIT_EXPECT_EQ(test, pulse.missed, 0U);
+    KUNIT_EXPECT_EQ(test, pulse.high.count, 2U);
+    KUNIT_EXPECT_EQ(test, pulse.low.count, 3U);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 0U);
+    KUNIT_EXPECT_FALSE(test, led_state);
+}
+
+static void gpio2_test_pulse_missed_edge(struct kunit *test)
+{
+    pulse.active = true;
+    pulse.gate_ns = U64_MAX;
+    pulse.last_level = 1;
+
+    fake_button = 1;
+    press();
+    KUNIT_EXPECT_EQ(test, pulse.missed, 1U);
+    KUNIT_EXPECT_EQ(test, pulse.gate_rising, 1U);
+    KUNIT_EXPECT_EQ(test, pulse.high.count, 0U);
+}
+
+// Microbenchmarks
+
+static void gpio2_bench_debounce_reject(struct kunit *test)
+{
+    u64 start;
+    int i;
+
+    press();
+    start = ktime_get_ns();
+    for (i = 0; i < GPIO2_BENCH_ITERS; i++)
+        press();
+    gpio_kunit_bench_report(test, "irq_debounce_reject", ktime_get_ns() - start, GPIO2_BENCH_ITERS);
+    KUNIT_EXPECT_EQ(test, fake_led_writes, 1U);
+}
+
+static void gpio2_bench_pulse_edge(struct kunit *test)
+{
+    u64 start;
+    int i;
+
+    pulse.active = true;
+    pulse.gate_ns = U64_MAX;
+    pulse.gate_start = ktime_get_ns();
+
+    start = ktime_get_ns();
+    for (i = 0; i < GPIO2_BENCH_ITERS; i++) {
+        fake_button = i & 1;
+        press();
+    }
+    gpio_kunit_bench_report(test, "irq_pulse_edge", ktime_get_ns() - start, GPIO2_BENCH_ITERS);
+    KUNIT_EXPECT_EQ(test, pulse.total_edges, (u64)GPIO2_BENCH_ITERS);
+}
+
+static struct kunit_case gpio2_test_cases[] = {
+    KUNIT_CASE(gpio2_test_debounce),
+    KUNIT_CASE(gpio2_test_debounce_adapt),
+    KUNIT_CASE(gpio2_test_pulse_bypass),
+    KUNIT_CASE(gpio2_test_pulse_missed_edge),
+    KUNIT_CASE_SLOW(gpio2_bench_debounce_reject),
+    KUNIT_CASE_SLOW(gpio2_bench_pulse_edge),
+    {}
+};
+
+static struct kunit_suite gpio2_test_suite = {
+    .name = "gpio_ctl2",
+    .init = gpio2_test_init,
+    .test_cases = gpio2_test_cases,
+};
+
+kunit_test_suite(gpio2_test_suite);
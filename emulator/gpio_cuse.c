@@ -0,0 +1,1858 @@
+/*
+ * CUSE emulator for the GPIO control device nodes
+ *
+ * Creates /dev/gpio_ctl (Mock_project_1), /dev/gpio_ctl2 (Mock_project_3),
+ * /dev/gpio_led0-2 and /dev/gpio_button (Mock_project) from userspace, so
+ * the applications and benchmarks run unmodified on machines that cannot
+ * load the ARM modules. Every node implements the read/write/ioctl/poll
+ * behaviour of its driver on top of a simulated pin model: LED outputs
+ * keep the level last written, button inputs change only when an edge is
+ * injected on the command channel, and each edge goes through the same
+ * debounce, multi-press, chord and pulse measurement logic as the IRQ
+ * handlers. Timestamps use CLOCK_MONOTONIC like ktime_get_ns().
+ *
+ * Differences from the kernel drivers:
+ *  - gpio_ctl capture has no mmap (CUSE cannot map pages), use read()
+ *  - capture and waveform timers are threads, so lateness is that of a
+ *    userspace thread, not a hard hrtimer
+ *
+ * Needs libfuse3 and access to /dev/cuse (usually root).
+ *
+ * Usage: gpio_cuse [-v] [-k keys] [-c command_fifo]
+ *   -v  log driver messages to stderr
+ *   -k  number of button-gpios keys on /dev/gpio_button (default 1)
+ *   -c  also read commands from a FIFO, e.g. created with mkfifo
+ *
+ * Commands, one per line on stdin or the FIFO:
+ *   press <button>            drive a button to its pressed level
+ *   release <button>          drive a button to its released level
+ *   click <button> [hold_ms]  press, hold (default 100 ms), release
+ *   bounce <button> <edges> <gap_us>
+ *                             chatter for <edges> edges, settle pressed
+ *   square <button> <hz> <cycles>
+ *                             square wave for pulse measurement
+ *   level <pin> <0|1>         set any pin level directly
+ *   sleep <ms>                pause command processing
+ *   show                      print all pins
+ *   quit
+ * Buttons are key0..key15 (gpio_button), ctl (gpio_ctl) and ctl2
+ * (gpio_ctl2). Outputs are led0..led2, ctl_led and ctl2_led.
+ */
+#define FUSE_USE_VERSION 31
+#define _GNU_SOURCE
+#include <cuse_lowlevel.h>  /* For the CUSE lowlevel API */
+#include <stdio.h>          /* For standard I/O operations */
+#include <stdlib.h>         /* For malloc/strtoul */
+#include <stdarg.h>         /* For log formatting */
+#include <string.h>         /* For string functions */
+#include <stdint.h>         /* For fixed width types */
+#include <unistd.h>
+#include <fcntl.h>          /* For file control options */
+#include <errno.h>          /* For error number definitions */
+#include <poll.h>           /* For command channel polling */
+#include <signal.h>         /* For SIGINT/SIGTERM */
+#include <pthread.h>        /* For device, timer and player threads */
+#include <time.h>           /* For CLOCK_MONOTONIC */
+#include <sys/uio.h>        /* For struct iovec */
+#include <sys/ioctl.h>      /* For _IO/_IOR/_IOW */
+
+#include "../Mock_project/include/gpio_control.h"
+
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_SEC  1000000000ULL
+
+/* gpio_ctl IOCTL commands and records, must match Mock_project_1 gpio_driver.c */
+#define CTL_IOC_MAGIC 'g'
+#define CTL_IOC_LED_ON        _IO(CTL_IOC_MAGIC, 1)
+#define CTL_IOC_LED_OFF       _IO(CTL_IOC_MAGIC, 2)
+#define CTL_IOC_LED_TOGGLE    _IO(CTL_IOC_MAGIC, 3)
+#define CTL_IOC_GET_STATUS    _IOR(CTL_IOC_MAGIC, 4, int)
+#define CTL_IOC_MEASURE_START _IOW(CTL_IOC_MAGIC, 5, __u32)
+#define CTL_IOC_MEASURE_STOP  _IO(CTL_IOC_MAGIC, 6)
+#define CTL_IOC_MEASURE_READ  _IOR(CTL_IOC_MAGIC, 7, struct gpio_pulse_stats)
+#define CTL_IOC_CAPTURE_START _IOW(CTL_IOC_MAGIC, 8, __u32)
+#define CTL_IOC_CAPTURE_STOP  _IO(CTL_IOC_MAGIC, 9)
+#define CTL_IOC_CAPTURE_STATS _IOR(CTL_IOC_MAGIC, 10, struct gpio_capture_stats)
+
+/* gpio_ctl2 IOCTL commands, must match Mock_project_3 gpio_driver_2.c */
+#define CTL2_IOC_MAGIC 'h'
+#define CTL2_IOC_LED_ON        _IO(CTL2_IOC_MAGIC, 1)
+#define CTL2_IOC_LED_OFF       _IO(CTL2_IOC_MAGIC, 2)
+#define CTL2_IOC_LED_TOGGLE    _IO(CTL2_IOC_MAGIC, 3)
+#define CTL2_IOC_GET_STATUS    _IOR(CTL2_IOC_MAGIC, 4, int)
+#define CTL2_IOC_MEASURE_START _IOW(CTL2_IOC_MAGIC, 5, __u32)
+#define CTL2_IOC_MEASURE_STOP  _IO(CTL2_IOC_MAGIC, 6)
+#define CTL2_IOC_MEASURE_READ  _IOR(CTL2_IOC_MAGIC, 7, struct gpio_pulse_stats)
+
+/* gpio_ledN IOCTL commands, must match led_driver.c */
+#define LED_IOC_LED_ON     _IO(LED_IOC_MAGIC, 1)
+#define LED_IOC_LED_OFF    _IO(LED_IOC_MAGIC, 2)
+#define LED_IOC_LED_TOGGLE _IO(LED_IOC_MAGIC, 3)
+#define LED_IOC_GET_STATUS _IOR(LED_IOC_MAGIC, 4, int)
+
+#define PULSE_GATE_MIN_MS 10
+#define PULSE_GATE_MAX_MS 10000
+
+#define CAPTURE_LINES 2
+#define CAPTURE_BLOCK_SIZE 512
+#define CAPTURE_NBLOCKS 256
+#define CAPTURE_BLOCK_DATA (CAPTURE_BLOCK_SIZE - 16)
+#define CAPTURE_BLOCK_SAMPLES (CAPTURE_BLOCK_DATA * 8 / CAPTURE_LINES)
+#define CAPTURE_RATE_MAX 200000
+#define CAPTURE_FLAG_OVERRUN 0x01
+#define CAPTURE_FLAG_GAP     0x02
+
+#define DEBOUNCE_NS (50 * NSEC_PER_MSEC)
+#define MULTI_PRESS_TIMEOUT_MS 1000
+#define DEFAULT_CHORD_WINDOW_MS 150
+#define EVENT_RING_SIZE 256
+#define EVENT_RING_MASK (EVENT_RING_SIZE - 1)
+
+struct gpio_pulse_stats {
+    __u32 gate_ms;
+    __u32 gate_edges;
+    __u64 freq_mhz;
+    __u64 total_edges;
+    __u64 high_min_ns;
+    __u64 high_max_ns;
+    __u64 high_mean_ns;
+    __u64 low_min_ns;
+    __u64 low_max_ns;
+    __u64 low_mean_ns;
+    __u32 high_count;
+    __u32 low_count;
+    __u32 missed;
+    __u32 reserved;
+};
+
+struct gpio_capture_block {
+    __u64 timestamp;
+    __u32 seq;
+    __u16 nsamples;
+    __u8 nlines;
+    __u8 flags;
+    __u8 data[CAPTURE_BLOCK_DATA];
+};
+
+struct gpio_capture_stats {
+    __u32 rate_hz;
+    __u32 period_ns;
+    __u64 samples;
+    __u64 dropped;
+    __u64 missed_ticks;
+    __u32 head;
+    __u32 tail;
+};
+
+/* Simulated pins */
+enum sim_pin_id {
+    PIN_LED0, PIN_LED1, PIN_LED2,     /* Mock_project LEDs, shared by led and button */
+    PIN_CTL_LED, PIN_CTL_BTN,         /* Mock_project_1 */
+    PIN_CTL2_LED, PIN_CTL2_BTN,       /* Mock_project_3 */
+    PIN_KEY0,                         /* Mock_project button-gpios */
+    NUM_PINS = PIN_KEY0 + BUTTON_MAX_KEYS,
+};
+
+struct sim_pin {
+    char name[12];
+    int level;          /* Value the driver reads with gpiod_get_value() */
+    int pressed;        /* Level of a pressed button, -1 for outputs */
+};
+
+/* Emulated device nodes */
+enum sim_dev_id { DEV_CTL, DEV_CTL2, DEV_LED0, DEV_LED1, DEV_LED2, DEV_BUTTON, NUM_DEVS };
+
+struct sim_file;
+
+struct sim_device {
+    int id;
+    const char *name;
+    const struct cuse_lowlevel_ops *ops;
+    struct fuse_session *se;
+    pthread_t thread;
+    struct sim_file *files;     /* Open files, for poll notification */
+};
+
+/* Per-open-file state, stored in fuse_file_info.fh */
+struct sim_file {
+    struct sim_file *next;
+    struct sim_device *dev;
+    int flags;                  /* open() flags */
+    int event_mode;             /* gpio_button: read() returns events */
+    uint64_t next_seq;          /* gpio_button: next event to return */
+    struct fuse_pollhandle *ph; /* Pending poll, notified on the next change */
+};
+
+/* Pulse measurement, same algorithm as the drivers */
+struct pulse_width {
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint32_t count;
+};
+
+struct sim_pulse {
+    int active;
+    uint64_t gate_ns;
+    uint64_t gate_start;
+    uint32_t gate_rising;
+    uint32_t gate_edges;
+    uint64_t freq_mhz;
+    uint64_t total_edges;
+    uint64_t last_edge;
+    int last_level;
+    uint32_t missed;
+    struct pulse_width high;
+    struct pulse_width low;
+};
+
+/* Waveform playback buffer, see led_driver.c */
+enum wave_buf_state { WAVE_FREE, WAVE_READY, WAVE_PLAYING };
+
+struct wave_buf {
+    struct led_wave_step steps[LED_WAVE_MAX_STEPS];
+    uint32_t count;
+    uint32_t flags;
+    uint32_t seq;
+    enum wave_buf_state state;
+};
+
+/* All emulator state is protected by sim_lock; sim_cond is broadcast on every change */
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_cond;
+static struct sim_pin pins[NUM_PINS];
+static struct sim_device devs[NUM_DEVS];
+static int verbose;
+static volatile sig_atomic_t quit;
+
+/* gpio_ctl state */
+static struct {
+    int led_status;
+    struct sim_pulse pulse;
+    struct sim_file *owner;             /* Capture owner */
+    unsigned int gen;                   /* Bumped on every start/stop */
+    struct gpio_capture_block ring[CAPTURE_NBLOCKS];
+    struct gpio_capture_block *cur;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t rate_hz;
+    uint32_t period_ns;
+    uint32_t seq;
+    uint8_t pending_flags;
+    uint64_t samples;
+    uint64_t dropped;
+    uint64_t missed_ticks;
+} ctl;
+
+/* gpio_ctl2 state */
+static struct {
+    int led_state;
+    uint64_t last_irq;
+    struct sim_pulse pulse;
+} ctl2;
+
+/* gpio_ledN state */
+static struct {
+    int led_state[3];
+    struct wave_buf buf[2];
+    uint64_t next;
+    int play;
+    uint32_t pos;
+    uint32_t queue_seq;
+    int running;
+    unsigned int gen;
+    struct led_wave_stats stats;
+    uint64_t late_sum;
+} led;
+
+static const char *const led_names[3] = { "green_led", "white_led", "yellow_led" };
+
+/* gpio_button state */
+static struct {
+    unsigned int num_keys;
+    uint64_t last_irq[BUTTON_MAX_KEYS];
+    int press_count;
+    int button_pressed;
+    int current_led_state;
+    uint64_t press_deadline;            /* Multi-press timeout, 0 when idle */
+    unsigned long chord_mask;
+    uint64_t chord_deadline;            /* Chord window close, 0 when idle */
+    unsigned int chord_window_ms;
+    struct button_event ring[EVENT_RING_SIZE];
+    uint64_t seq;
+} btn;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void ns_to_ts(uint64_t ns, struct timespec *ts) {
+    ts->tv_sec = ns / NSEC_PER_SEC;
+    ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+static void sim_log(const char *fmt, ...) {
+    va_list ap;
+
+    if (!verbose)
+        return;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+/*
+ * Wait for a state change or until @deadline (0 = at most 100 ms)
+ * Called with sim_lock held
+ */
+static void sim_wait_until(uint64_t deadline) {
+    struct timespec ts;
+
+    if (!deadline)
+        deadline = now_ns() + 100 * NSEC_PER_MSEC;
+    ns_to_ts(deadline, &ts);
+    pthread_cond_timedwait(&sim_cond, &sim_lock, &ts);
+}
+
+/*
+ * Wait in a request handler, returns -EINTR once the caller gave up
+ * Called with sim_lock held
+ */
+static int sim_wait_req(fuse_req_t req) {
+    sim_wait_until(0);
+    return fuse_req_interrupted(req) ? -EINTR : 0;
+}
+
+/*
+ * Wake pending polls on a device
+ * Called with sim_lock held
+ */
+static void sim_notify(int dev_id) {
+    struct sim_file *f;
+
+    for (f = devs[dev_id].files; f; f = f->next) {
+        if (f->ph) {
+            fuse_lowlevel_notify_poll(f->ph);
+            fuse_pollhandle_destroy(f->ph);
+            f->ph = NULL;
+        }
+    }
+}
+
+static int nonblock(const struct fuse_file_info *fi, const struct sim_file *f) {
+    return (fi->flags | f->flags) & O_NONBLOCK;
+}
+
+static void reply_text(fuse_req_t req, size_t size, off_t off, const char *msg, int len) {
+    if (off > 0)
+        fuse_reply_buf(req, NULL, 0);
+    else if (size < (size_t)len)
+        fuse_reply_err(req, EINVAL);
+    else
+        fuse_reply_buf(req, msg, len);
+}
+
+/* Reply to an ioctl with a driver style return value */
+static void reply_ioctl(fuse_req_t req, int ret, const void *buf, size_t size) {
+    if (ret < 0)
+        fuse_reply_err(req, -ret);
+    else
+        fuse_reply_ioctl(req, ret, buf, size);
+}
+
+/*
+ * CUSE ioctls are unrestricted: the kernel copies nothing until told
+ * which user ranges to use. Asks for @in bytes in and @out bytes back
+ * at @arg. Returns 1 when a retry was requested
+ */
+static int ioctl_retry(fuse_req_t req, void *arg, size_t in, size_t in_bufsz,
+                       size_t out, size_t out_bufsz) {
+    struct iovec in_iov = { arg, in };
+    struct iovec out_iov = { arg, out };
+
+    if (in_bufsz >= in && out_bufsz >= out)
+        return 0;
+    fuse_reply_ioctl_retry(req, in ? &in_iov : NULL, in ? 1 : 0, out ? &out_iov : NULL, out ? 1 : 0);
+    return 1;
+}
+
+/* Pulse measurement helpers, called with sim_lock held */
+
+static void pulse_close_gate(struct sim_pulse *p, uint64_t now) {
+    uint64_t elapsed = now - p->gate_start;
+
+    p->gate_edges = p->gate_rising;
+    p->freq_mhz = elapsed ? (uint64_t)p->gate_rising * 1000 * NSEC_PER_SEC / elapsed : 0;
+    p->gate_rising = 0;
+    p->gate_start = now;
+}
+
+static void pulse_add_width(struct pulse_width *w, uint64_t width) {
+    if (!w->count || width < w->min)
+        w->min = width;
+    if (width > w->max)
+        w->max = width;
+    w->sum += width;
+    w->count++;
+}
+
+static void pulse_record_edge(struct sim_pulse *p, uint64_t now, int level) {
+    if (now - p->gate_start >= p->gate_ns)
+        pulse_close_gate(p, now);
+
+    p->total_edges++;
+    if (level == p->last_level) {
+        p->missed++;
+    } else {
+        if (p->last_edge)
+            pulse_add_width(p->last_level ? &p->high : &p->low, now - p->last_edge);
+        if (level)
+            p->gate_rising++;
+    }
+    p->last_level = level;
+    p->last_edge = now;
+}
+
+static int pulse_start(struct sim_pulse *p, int pin, uint32_t gate_ms) {
+    if (gate_ms < PULSE_GATE_MIN_MS || gate_ms > PULSE_GATE_MAX_MS)
+        return -EINVAL;
+    if (p->active)
+        return -EBUSY;
+
+    memset(p, 0, sizeof(*p));
+    p->gate_ns = gate_ms * NSEC_PER_MSEC;
+    p->gate_start = now_ns();
+    p->last_level = pins[pin].level;
+    p->active = 1;
+    return 0;
+}
+
+static uint64_t pulse_mean(const struct pulse_width *w) {
+    return w->count ? w->sum / w->count : 0;
+}
+
+static void pulse_read(struct sim_pulse *p, struct gpio_pulse_stats *st) {
+    uint64_t now = now_ns();
+
+    if (p->active && now - p->gate_start >= p->gate_ns)
+        pulse_close_gate(p, now);
+
+    st->gate_ms = p->gate_ns / NSEC_PER_MSEC;
+    st->gate_edges = p->gate_edges;
+    st->freq_mhz = p->freq_mhz;
+    st->total_edges = p->total_edges;
+    st->high_min_ns = p->high.min;
+    st->high_max_ns = p->high.max;
+    st->high_mean_ns = pulse_mean(&p->high);
+    st->low_min_ns = p->low.min;
+    st->low_max_ns = p->low.max;
+    st->low_mean_ns = pulse_mean(&p->low);
+    st->high_count = p->high.count;
+    st->low_count = p->low.count;
+    st->missed = p->missed;
+    st->reserved = 0;
+}
+
+/* gpio_button event queue, multi-press and chord logic */
+
+/* Called with sim_lock held */
+static void button_queue_event(uint16_t type, uint16_t key, uint32_t value) {
+    struct button_event *ev = &btn.ring[++btn.seq & EVENT_RING_MASK];
+
+    ev->seq = btn.seq;
+    ev->timestamp = now_ns();
+    ev->type = type;
+    ev->key = key;
+    ev->value = value;
+    sim_notify(DEV_BUTTON);
+}
+
+static void button_set_leds(int mask) {
+    int i;
+
+    for (i = 0; i < 3; i++)
+        pins[PIN_LED0 + i].level = (mask >> i) & 1;
+}
+
+/* Same LED mapping as button_work_handler(), called with sim_lock held */
+static void button_process_presses(void) {
+    sim_log("Processing %d button presses\n", btn.press_count);
+    button_queue_event(BUTTON_EV_MULTI_PRESS, 0, btn.press_count);
+
+    switch (btn.press_count) {
+        case 1: btn.current_led_state = 1; button_set_leds(0x1); break;
+        case 2: btn.current_led_state = 2; button_set_leds(0x2); break;
+        case 3: btn.current_led_state = 3; button_set_leds(0x4); break;
+        case 4: btn.current_led_state = 4; button_set_leds(0x7); break;
+        default: btn.current_led_state = 0; button_set_leds(0x0); break;
+    }
+    btn.press_count = 0;
+}
+
+/* Falling edge on a key, called with sim_lock held */
+static void button_key_edge(unsigned int key, uint64_t now) {
+    if (btn.last_irq[key] && now - btn.last_irq[key] < DEBOUNCE_NS)
+        return;
+    btn.last_irq[key] = now;
+
+    btn.button_pressed = 1;
+    button_queue_event(BUTTON_EV_PRESS, key, 0);
+    if (btn.num_keys > 1) {
+        if (!btn.chord_mask)
+            btn.chord_deadline = now + btn.chord_window_ms * NSEC_PER_MSEC;
+        btn.chord_mask |= 1UL << key;
+    }
+
+    if (key != 0)
+        return;
+
+    btn.press_count++;
+    sim_log("Button pressed! Count: %d\n", btn.press_count);
+    btn.press_deadline = btn.press_count >= 5 ? now : now + MULTI_PRESS_TIMEOUT_MS * NSEC_PER_MSEC;
+}
+
+/*
+ * Stands in for press_timer, chord_timer and button_work
+ */
+static void *button_timer_thread(void *arg) {
+    uint64_t now, deadline;
+
+    (void)arg;
+    pthread_mutex_lock(&sim_lock);
+    for (;;) {
+        now = now_ns();
+        if (btn.press_deadline && now >= btn.press_deadline) {
+            btn.press_deadline = 0;
+            if (btn.press_count > 0)
+                button_process_presses();
+        }
+        if (btn.chord_deadline && now >= btn.chord_deadline) {
+            btn.chord_deadline = 0;
+            if (__builtin_popcountl(btn.chord_mask) >= 2) {
+                sim_log("Chord detected: key mask 0x%lx\n", btn.chord_mask);
+                button_queue_event(BUTTON_EV_CHORD, 0, btn.chord_mask);
+            }
+            btn.chord_mask = 0;
+        }
+
+        deadline = btn.press_deadline;
+        if (btn.chord_deadline && (!deadline || btn.chord_deadline < deadline))
+            deadline = btn.chord_deadline;
+        sim_wait_until(deadline);
+    }
+    return NULL;
+}
+
+/* gpio_ctl2 button edge, called with sim_lock held */
+static void ctl2_button_edge(uint64_t now, int level) {
+    if (ctl2.pulse.active) {
+        pulse_record_edge(&ctl2.pulse, now, level);
+        return;
+    }
+    if (level != 0)
+        return;
+    if (ctl2.last_irq && now - ctl2.last_irq < DEBOUNCE_NS)
+        return;
+    ctl2.last_irq = now;
+
+    ctl2.led_state = !ctl2.led_state;
+    pins[PIN_CTL2_LED].level = ctl2.led_state;
+    sim_log("GPIO_CTL2: Button pressed! LED %s\n", ctl2.led_state ? "ON" : "OFF");
+}
+
+/*
+ * Change a pin level and run the edge logic the IRQ handlers would
+ * Called with sim_lock held
+ */
+static void sim_set_level(int pin, int level) {
+    uint64_t now = now_ns();
+
+    if (pins[pin].level == level)
+        return;
+    pins[pin].level = level;
+
+    if (pin == PIN_CTL_BTN) {
+        if (ctl.pulse.active)
+            pulse_record_edge(&ctl.pulse, now, level);
+    } else if (pin == PIN_CTL2_BTN) {
+        ctl2_button_edge(now, level);
+    } else if (pin >= PIN_KEY0 && pin < PIN_KEY0 + (int)btn.num_keys && level == 0) {
+        button_key_edge(pin - PIN_KEY0, now);
+    }
+    pthread_cond_broadcast(&sim_cond);
+}
+
+/* Common file operations */
+
+static void sim_open(fuse_req_t req, struct fuse_file_info *fi) {
+    struct sim_device *dev = fuse_req_userdata(req);
+    struct sim_file *f = calloc(1, sizeof(*f));
+
+    if (!f) {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+    f->dev = dev;
+    f->flags = fi->flags;
+
+    pthread_mutex_lock(&sim_lock);
+    f->next = dev->files;
+    dev->files = f;
+    pthread_mutex_unlock(&sim_lock);
+
+    fi->fh = (uintptr_t)f;
+    fuse_reply_open(req, fi);
+}
+
+static void capture_stop(void);
+
+static void sim_release(fuse_req_t req, struct fuse_file_info *fi) {
+    struct sim_file *f = (struct sim_file *)(uintptr_t)fi->fh;
+    struct sim_file **p;
+
+    pthread_mutex_lock(&sim_lock);
+    if (ctl.owner == f)
+        capture_stop();
+    for (p = &f->dev->files; *p; p = &(*p)->next) {
+        if (*p == f) {
+            *p = f->next;
+            break;
+        }
+    }
+    if (f->ph)
+        fuse_pollhandle_destroy(f->ph);
+    pthread_mutex_unlock(&sim_lock);
+
+    free(f);
+    fuse_reply_err(req, 0);
+}
+
+/* gpio_ctl capture, see capture_* in gpio_driver.c; called with sim_lock held */
+
+static void capture_commit(void) {
+    if (!ctl.cur)
+        return;
+    ctl.head++;
+    ctl.cur = NULL;
+    pthread_cond_broadcast(&sim_cond);
+    sim_notify(DEV_CTL);
+}
+
+static void capture_sample(uint64_t ts) {
+    struct gpio_capture_block *blk = ctl.cur;
+    unsigned int bit, bits;
+
+    if (!blk) {
+        if (ctl.head - ctl.tail >= CAPTURE_NBLOCKS) {
+            ctl.dropped++;
+            ctl.pending_flags |= CAPTURE_FLAG_OVERRUN;
+            return;
+        }
+        blk = &ctl.ring[ctl.head % CAPTURE_NBLOCKS];
+        blk->timestamp = ts;
+        blk->seq = ctl.seq++;
+        blk->nsamples = 0;
+        blk->nlines = CAPTURE_LINES;
+        blk->flags = ctl.pending_flags;
+        memset(blk->data, 0, sizeof(blk->data));
+        ctl.pending_flags = 0;
+        ctl.cur = blk;
+    }
+
+    bits = pins[PIN_CTL_BTN].level | (pins[PIN_CTL_LED].level << 1);
+    bit = blk->nsamples * CAPTURE_LINES;
+    blk->data[bit >> 3] |= bits << (bit & 7);
+    ctl.samples++;
+
+    if (++blk->nsamples == CAPTURE_BLOCK_SAMPLES)
+        capture_commit();
+}
+
+/* Sampling thread, replaces the hrtimer. Exits when ctl.gen changes */
+static void *capture_thread(void *arg) {
+    unsigned int gen = (uintptr_t)arg;
+    uint64_t next, now, late;
+
+    pthread_mutex_lock(&sim_lock);
+    next = now_ns() + ctl.period_ns;
+    while (ctl.gen == gen) {
+        now = now_ns();
+        if (now < next) {
+            sim_wait_until(next);
+            continue;
+        }
+
+        capture_sample(next);
+        late = (now - next) / ctl.period_ns;
+        next += (late + 1) * ctl.period_ns;
+        if (late) {
+            ctl.missed_ticks += late;
+            ctl.pending_flags |= CAPTURE_FLAG_GAP;
+            capture_commit();
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return NULL;
+}
+
+static int capture_start(struct sim_file *f, uint32_t rate_hz) {
+    pthread_t thread;
+
+    if (rate_hz == 0 || rate_hz > CAPTURE_RATE_MAX)
+        return -EINVAL;
+    if (ctl.owner)
+        return -EBUSY;
+
+    ctl.head = 0;
+    ctl.tail = 0;
+    ctl.rate_hz = rate_hz;
+    ctl.period_ns = NSEC_PER_SEC / rate_hz;
+    ctl.cur = NULL;
+    ctl.seq = 0;
+    ctl.pending_flags = 0;
+    ctl.samples = 0;
+    ctl.dropped = 0;
+    ctl.missed_ticks = 0;
+    ctl.gen++;
+    if (pthread_create(&thread, NULL, capture_thread, (void *)(uintptr_t)ctl.gen))
+        return -ENOMEM;
+    pthread_detach(thread);
+    ctl.owner = f;
+
+    sim_log("GPIO_CTL: Capture started at %u Hz\n", rate_hz);
+    return 0;
+}
+
+static void capture_stop(void) {
+    if (!ctl.owner)
+        return;
+
+    ctl.gen++;
+    capture_commit();
+    ctl.owner = NULL;
+    pthread_cond_broadcast(&sim_cond);
+    sim_notify(DEV_CTL);
+    sim_log("GPIO_CTL: Capture stopped, %llu samples, %llu dropped, %llu missed ticks\n",
+            (unsigned long long)ctl.samples, (unsigned long long)ctl.dropped,
+            (unsigned long long)ctl.missed_ticks);
+}
+
+static int capture_ready(const struct sim_file *f) {
+    return ctl.head != ctl.tail || ctl.owner != f;
+}
+
+/* Called with sim_lock held, replies to the request */
+static void capture_read(fuse_req_t req, struct sim_file *f, size_t size, struct fuse_file_info *fi) {
+    char *buf;
+    size_t copied = 0;
+
+    if (size < CAPTURE_BLOCK_SIZE) {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+    while (!nonblock(fi, f) && !capture_ready(f)) {
+        if (sim_wait_req(req)) {
+            fuse_reply_err(req, EINTR);
+            return;
+        }
+    }
+
+    buf = malloc(size - size % CAPTURE_BLOCK_SIZE);
+    if (!buf) {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+    while (ctl.tail != ctl.head && copied + CAPTURE_BLOCK_SIZE <= size) {
+        memcpy(buf + copied, &ctl.ring[ctl.tail % CAPTURE_NBLOCKS], CAPTURE_BLOCK_SIZE);
+        copied += CAPTURE_BLOCK_SIZE;
+        ctl.tail++;
+    }
+
+    if (copied)
+        fuse_reply_buf(req, buf, copied);
+    else
+        fuse_reply_err(req, EAGAIN);
+    free(buf);
+}
+
+/* /dev/gpio_ctl */
+
+static void ctl_read(fuse_req_t req, size_t size, off_t off, struct fuse_file_info *fi) {
+    struct sim_file *f = (struct sim_file *)(uintptr_t)fi->fh;
+    char msg[64];
+    int len;
+
+    pthread_mutex_lock(&sim_lock);
+    if (ctl.owner == f) {
+        capture_read(req, f, size, fi);
+        pthread_mutex_unlock(&sim_lock);
+        return;
+    }
+    len = snprintf(msg, sizeof(msg), "LED: %s, Button: %s\n",
+                   ctl.led_status ? "ON" : "OFF",
+                   pins[PIN_CTL_BTN].level ? "PRESSED" : "RELEASED");
+    pthread_mutex_unlock(&sim_lock);
+
+    reply_text(req, size, off, msg, len);
+}
+
+static void ctl_write(fuse_req_t req, const char *buf, size_t size, off_t off, struct fuse_file_info *fi) {
+    char command[16];
+
+    (void)off;
+    (void)fi;
+    if (size >= sizeof(command)) {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+    memcpy(command, buf, size);
+    command[size] = '\0';
+    if (size > 0 && command[size - 1] == '\n')
+        command[size - 1] = '\0';
+
+    pthread_mutex_lock(&sim_lock);
+    if (strcmp(command, "1") == 0 || strcmp(command, "on") == 0) {
+        ctl.led_status = 1;
+    } else if (strcmp(command, "0") == 0 || strcmp(command, "off") == 0) {
+        ctl.led_status = 0;
+    } else if (strcmp(command, "toggle") == 0) {
+        ctl.led_status = !ctl.led_status;
+    } else {
+        pthread_mutex_unlock(&sim_lock);
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+    pins[PIN_CTL_LED].level = ctl.led_status;
+    sim_log("GPIO_CTL: LED turned %s\n", ctl.led_status ? "ON" : "OFF");
+    pthread_mutex_unlock(&sim_lock);
+
+    fuse_reply_write(req, size);
+}
+
+static void ctl_ioctl(fuse_req_t req, int cmd, void *arg, struct fuse_file_info *fi,
+                      unsigned int flags, const void *in_buf, size_t in_bufsz, size_t out_bufsz) {
+    struct sim_file *f = (struct sim_file *)(uintptr_t)fi->fh;
+    struct gpio_pulse_stats stats;
+    struct gpio_capture_stats cstats;
+    int value, ret = 0;
+
+    (void)flags;
+    switch ((unsigned int)cmd) {
+        case CTL_IOC_GET_STATUS:
+            if (ioctl_retry(req, arg, 0, in_bufsz, sizeof(value), out_bufsz))
+                return;
+            break;
+        case CTL_IOC_MEASURE_START:
+        case CTL_IOC_CAPTURE_START:
+            if (ioctl_retry(req, arg, sizeof(__u32), in_bufsz, 0, out_bufsz))
+                return;
+            break;
+        case CTL_IOC_MEASURE_READ:
+            if (ioctl_retry(req, arg, 0, in_bufsz, sizeof(stats), out_bufsz))
+                return;
+            break;
+        case CTL_IOC_CAPTURE_STATS:
+            if (ioctl_retry(req, arg, 0, in_bufsz, sizeof(cstats), out_bufsz))
+                return;
+            break;
+    }
+
+    pthread_mutex_lock(&sim_lock);
+    switch ((unsigned int)cmd) {
+        case CTL_IOC_LED_ON:
+            ctl.led_status = 1;
+            pins[PIN_CTL_LED].level = 1;
+            break;
+
+        case CTL_IOC_LED_OFF:
+            ctl.led_status = 0;
+            pins[PIN_CTL_LED].level = 0;
+            break;
+
+        case CTL_IOC_LED_TOGGLE:
+            ctl.led_status = !ctl.led_status;
+            pins[PIN_CTL_LED].level = ctl.led_status;
+            break;
+
+        case CTL_IOC_GET_STATUS:
+            value = pins[PIN_CTL_BTN].level;
+            pthread_mutex_unlock(&sim_lock);
+            reply_ioctl(req, 0, &value, sizeof(value));
+            return;
+
+        case CTL_IOC_MEASURE_START:
+            ret = pulse_start(&ctl.pulse, PIN_CTL_BTN, *(const __u32 *)in_buf);
+            break;
+
+        case CTL_IOC_MEASURE_STOP:
+            ctl.pulse.active = 0;
+            break;
+
+        case CTL_IOC_MEASURE_READ:
+            pulse_read(&ctl.pulse, &stats);
+            pthread_mutex_unlock(&sim_lock);
+            reply_ioctl(req, 0, &stats, sizeof(stats));
+            return;
+
+        case CTL_IOC_CAPTURE_START:
+            ret = capture_start(f, *(const __u32 *)in_buf);
+            break;
+
+        case CTL_IOC_CAPTURE_STOP:
+            if (ctl.owner == f)
+                capture_stop();
+            else if (ctl.owner)
+                ret = -EBUSY;
+            break;
+
+        case CTL_IOC_CAPTURE_STATS:
+            cstats.rate_hz = ctl.rate_hz;
+            cstats.period_ns = ctl.period_ns;
+            cstats.samples = ctl.samples;
+            cstats.dropped = ctl.dropped;
+            cstats.missed_ticks = ctl.missed_ticks;
+            cstats.head = ctl.head;
+            cstats.tail = ctl.tail;
+            pthread_mutex_unlock(&sim_lock);
+            reply_ioctl(req, 0, &cstats, sizeof(cstats));
+            return;
+
+        default:
+            ret = -EINVAL;
+            break;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    reply_ioctl(req, ret, NULL, 0);
+}
+
+static void ctl_poll(fuse_req_t req, struct fuse_file_info *fi, struct fuse_pollhandle *ph) {
+    struct sim_file *f = (struct sim_file *)(uintptr_t)fi->fh;
+    unsigned int revents = POLLIN | POLLRDNORM;
+
+    pthread_mutex_lock(&sim_lock);
+    if (ctl.owner == f && !capture_ready(f)) {
+        revents = 0;
+        if (ph) {
+            if (f->ph)
+                fuse_pollhandle_destroy(f->ph);
+            f->ph = ph;
+            ph = NULL;
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+
+    if (ph)
+        fuse_pollhandle_destroy(ph);
+    fuse_reply_poll(req, revents);
+}
+
+/* /dev/gpio_ctl2 */
+
+static void ctl2_read(fuse_req_t req, size_t size, off_t off, struct fuse_file_info *fi) {
+    char msg[100];
+    int len, level;
+
+    (void)fi;
+    pthread_mutex_lock(&sim_lock);
+    level = pins[PIN_CTL2_BTN].level;
+    len = snprintf(msg, sizeof(msg), "LED: %s, Button: %s (GPIO16=%d)\n",
+                   ctl2.led_state ? "ON" : "OFF",
+                   level == 0 ? "PRESSED" : "RELEASED", level);
+    pthread_mutex_unlock(&sim_lock);
+
+    reply_text(req, size, off, msg, len);
+}
+
+static void ctl2_write(fuse_req_t req, const char *buf, size_t size, off_t off, struct fuse_file_info *fi) {
+    (void)off;
+    (void)fi;
+    if (size == 0) {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+
+    pthread_mutex_lock(&sim_lock);
+    switch (buf[0]) {
+        case '1':
+            ctl2.led_state = 1;
+            break;
+        case '0':
+            ctl2.led_state = 0;
+            break;
+        case 't':
+        case 'T':
+            ctl2.led_state = !ctl2.led_state;
+            break;
+        default:
+            pthread_mutex_unlock(&sim_lock);
+            fuse_reply_err(req, EINVAL);
+            return;
+    }
+    pins[PIN_CTL2_LED].level = ctl2.led_state;
+    sim_log("GPIO_CTL2: LED turned %s\n", ctl2.led_state ? "ON" : "OFF");
+    pthread_mutex_unlock(&sim_lock);
+
+    fuse_reply_write(req, size);
+}
+
+static void ctl2_ioctl(fuse_req_t req, int cmd, void *arg, struct fuse_file_info *fi,
+                       unsigned int flags, const void *in_buf, size_t in_bufsz, size_t out_bufsz) {
+    struct gpio_pulse_stats stats;
+    int status, ret = 0;
+
+    (void)fi;
+    (void)flags;
+    switch ((unsigned int)cmd) {
+        case CTL2_IOC_GET_STATUS:
+            if (ioctl_retry(req, arg, 0, in_bufsz, sizeof(status), out_bufsz))
+                return;
+            break;
+        case CTL2_IOC_MEASURE_START:
+            if (ioctl_retry(req, arg, sizeof(__u32), in_bufsz, 0, out_bufsz))
+                return;
+            break;
+        case CTL2_IOC_MEASURE_READ:
+            if (ioctl_retry(req, arg, 0, in_bufsz, sizeof(stats), out_bufsz))
+                return;
+            break;
+    }
+
+    pthread_mutex_lock(&sim_lock);
+    switch ((unsigned int)cmd) {
+        case CTL2_IOC_LED_ON:
+            ctl2.led_state = 1;
+            pins[PIN_CTL2_LED].level = 1;
+            break;
+
+        case CTL2_IOC_LED_OFF:
+            ctl2.led_state = 0;
+            pins[PIN_CTL2_LED].level = 0;
+            break;
+
+        case CTL2_IOC_LED_TOGGLE:
+            ctl2.led_state = !ctl2.led_state;
+            pins[PIN_CTL2_LED].level = ctl2.led_state;
+            break;
+
+        case CTL2_IOC_GET_STATUS:
+            // Bit 0: LED state, Bit 1: Button pressed
+            status = ctl2.led_state | (pins[PIN_CTL2_BTN].level == 0 ? 2 : 0);
+            pthread_mutex_unlock(&sim_lock);
+            reply_ioctl(req, 0, &status, sizeof(status));
+            return;
+
+        case CTL2_IOC_MEASURE_START:
+            ret = pulse_start(&ctl2.pulse, PIN_CTL2_BTN, *(const __u32 *)in_buf);
+            break;
+
+        case CTL2_IOC_MEASURE_STOP:
+            ctl2.pulse.active = 0;
+            break;
+
+        case CTL2_IOC_MEASURE_READ:
+            pulse_read(&ctl2.pulse, &stats);
+            pthread_mutex_unlock(&sim_lock);
+            reply_ioctl(req, 0, &stats, sizeof(stats));
+            return;
+
+        default:
+            ret = -ENOTTY;
+            break;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    reply_ioctl(req, ret, NULL, 0);
+}
+
+/* /dev/gpio_ledN, waveform playback mirrors led_wave_* in led_driver.c */
+
+static int led_index(const struct sim_file *f) {
+    return f->dev->id - DEV_LED0;
+}
+
+/* Called with sim_lock held */
+static void led_wave_apply(uint32_t value) {
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        led.led_state[i] = (value >> i) & 1;
+        pins[PIN_LED0 + i].level = led.led_state[i];
+    }
+}
+
+static void led_wave_account(uint64_t late) {
+    struct led_wave_stats *st = &led.stats;
+    uint64_t us = late / 1000;
+    int bucket = us ? 64 - __builtin_clzll(us) : 0;
+
+    if (bucket > 15)
+        bucket = 15;
+    if (!st->transitions || late < st->late_min_ns)
+        st->late_min_ns = late;
+    if (late > st->late_max_ns)
+        st->late_max_ns = late;
+    led.late_sum += late;
+    st->transitions++;
+    st->late_hist[bucket]++;
+}
+
+static int led_wave_next_ready(void) {
+    int i, best = -1;
+
+    for (i = 0; i < 2; i++) {
+        if (led.buf[i].state == WAVE_READY &&
+            (best < 0 || (int32_t)(led.buf[i].seq - led.buf[best].seq) < 0))
+            best = i;
+    }
+    return best;
+}
+
+/* Player thread, replaces the hrtimer. Exits when led.gen changes */
+static void *led_wave_thread(void *arg) {
+    unsigned int gen = (uintptr_t)arg;
+    struct wave_buf *buf;
+    uint64_t now;
+    int next;
+
+    pthread_mutex_lock(&sim_lock);
+    while (led.gen == gen && led.running) {
+        now = now_ns();
+        if (now < led.next) {
+            sim_wait_until(led.next);
+            continue;
+        }
+
+        buf = &led.buf[led.play];
+        led_wave_apply(buf->steps[led.pos].value);
+        led_wave_account(now - led.next);
+
+        if (++led.pos == buf->count) {
+            buf->state = WAVE_FREE;
+            led.stats.buffers++;
+            pthread_cond_broadcast(&sim_cond);
+
+            next = led_wave_next_ready();
+            if (next < 0) {
+                if (buf->flags & LED_WAVE_MORE)
+                    led.stats.underruns++;
+                led.running = 0;
+                break;
+            }
+            led.play = next;
+            led.pos = 0;
+            led.buf[next].state = WAVE_PLAYING;
+            buf = &led.buf[next];
+        }
+        led.next += buf->steps[led.pos].delta_ns;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return NULL;
+}
+
+/* Called with sim_lock held */
+static int led_wave_queue(fuse_req_t req, struct sim_file *f, const struct led_wave_buffer *wb,
+                          const struct led_wave_step *steps) {
+    struct wave_buf *buf;
+    int i;
+
+    for (;;) {
+        for (i = 0; i < 2; i++) {
+            if (led.buf[i].state == WAVE_FREE)
+                break;
+        }
+        if (i < 2)
+            break;
+        if (f->flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (sim_wait_req(req))
+            return -EINTR;
+    }
+
+    buf = &led.buf[i];
+    memcpy(buf->steps, steps, wb->count * sizeof(steps[0]));
+    buf->count = wb->count;
+    buf->flags = wb->flags;
+    buf->seq = led.queue_seq++;
+    buf->state = WAVE_READY;
+    return 0;
+}
+
+static int led_wave_start(void) {
+    pthread_t thread;
+    int next;
+
+    if (led.running)
+        return -EBUSY;
+    next = led_wave_next_ready();
+    if (next < 0)
+        return -ENODATA;
+
+    memset(&led.stats, 0, sizeof(led.stats));
+    led.late_sum = 0;
+    led.play = next;
+    led.pos = 0;
+    led.buf[next].state = WAVE_PLAYING;
+    led.next = now_ns() + led.buf[next].steps[0].delta_ns;
+    led.running = 1;
+    led.gen++;
+    if (pthread_create(&thread, NULL, led_wave_thread, (void *)(uintptr_t)led.gen)) {
+        led.running = 0;
+        return -ENOMEM;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+static void led_wave_stop(void) {
+    led.running = 0;
+    led.gen++;
+    led.buf[0].state = WAVE_FREE;
+    led.buf[1].state = WAVE_FREE;
+    pthread_cond_broadcast(&sim_cond);
+}
+
+static void led_read(fuse_req_t req, size_t size, off_t off, struct fuse_file_info *fi) {
+    struct sim_file *f = (struct sim_file *)(uintptr_t)fi->fh;
+    int idx = led_index(f);
+    char msg[100];
+    int len;
+
+    pthread_mutex_lock(&sim_lock);
+    len = snprintf(msg, sizeof(msg), "%s is %s\n", led_names[idx], led.led_state[idx] ? "ON" : "OFF");
+    pthread_mutex_unlock(&sim_lock);
+
+    reply_text(req, size, off, msg, len);
+}
+
+static void led_write(fuse_req_t req, const char *buf, size_t size, off_t off, struct fuse_file_info *fi) {
+    struct sim_file *f = (struct sim_file *)(uintptr_t)fi->fh;
+    int idx = led_index(f);
+
+    (void)off;
+    if (size < 1) {
+        fuse_reply_err(req, EFAULT);
+        return;
+    }
+
+    pthread_mutex_lock(&sim_lock);
+    switch (buf[0]) {
+        case '1':
+            led.led_state[idx] = 1;
+            break;
+        case '0':
+            led.led_state[idx] = 0;
+            break;
+        case 't':
+            led.led_state[idx] = !led.led_state[idx];
+            break;
+        default:
+            pthread_mutex_unlock(&sim_lock);
+            fuse_reply_err(req, EINVAL);
+            return;
+    }
+    pins[PIN_LED0 + idx].level = led.led_state[idx];
+    sim_log("Led %s is %s\n", led_names[idx], led.led_state[idx] ? "ON" : "OFF");
+    pthread_mutex_unlock(&sim_lock);
+
+    fuse_reply_write(req, size);
+}
+
+static void led_ioctl(fuse_req_t req, int cmd, void *arg, struct fuse_file_info *fi,
+                      unsigned int flags, const void *in_buf, size_t in_bufsz, size_t out_bufsz) {
+    struct sim_file *f = (struct sim_file *)(uintptr_t)fi->fh;
+    const struct led_wave_buffer *wb = in_buf;
+    struct led_wave_stats st;
+    int idx = led_index(f);
+    int status, ret = 0;
+
+    (void)flags;
+    switch ((unsigned int)cmd) {
+        case LED_IOC_GET_STATUS:
+            if (ioctl_retry(req, arg, 0, in_bufsz, sizeof(status), out_bufsz))
+                return;
+            break;
+        case LED_IOC_WAVE_STATS:
+            if (ioctl_retry(req, arg, 0, in_bufsz, sizeof(st), out_bufsz))
+                return;
+            break;
+        case LED_IOC_WAVE_QUEUE:
+            // Two rounds: the header first, then the header and its steps
+            if (ioctl_retry(req, arg, sizeof(*wb), in_bufsz, 0, out_bufsz))
+                return;
+            if (wb->count == 0 || wb->count > LED_WAVE_MAX_STEPS) {
+                fuse_reply_err(req, EINVAL);
+                return;
+            }
+            if (in_bufsz < sizeof(*wb) + wb->count * sizeof(struct led_wave_step)) {
+                struct iovec iov[2] = {
+                    { arg, sizeof(*wb) },
+                    { (void *)(uintptr_t)wb->steps, wb->count * sizeof(struct led_wave_step) },
+                };
+
+                fuse_reply_ioctl_retry(req, iov, 2, NULL, 0);
+                return;
+            }
+            break;
+    }
+
+    pthread_mutex_lock(&sim_lock);
+    switch ((unsigned int)cmd) {
+        case LED_IOC_LED_ON:
+            led.led_state[idx] = 1;
+            pins[PIN_LED0 + idx].level = 1;
+            break;
+
+        case LED_IOC_LED_OFF:
+            led.led_state[idx] = 0;
+            pins[PIN_LED0 + idx].level = 0;
+            break;
+
+        case LED_IOC_LED_TOGGLE:
+            led.led_state[idx] = !led.led_state[idx];
+            pins[PIN_LED0 + idx].level = led.led_state[idx];
+            break;
+
+        case LED_IOC_GET_STATUS:
+            status = led.led_state[idx];
+            pthread_mutex_unlock(&sim_lock);
+            reply_ioctl(req, 0, &status, sizeof(status));
+            return;
+
+        case LED_IOC_WAVE_QUEUE:
+            ret = led_wave_queue(req, f, wb, (const struct led_wave_step *)(wb + 1));
+            break;
+
+        case LED_IOC_WAVE_START:
+            ret = led_wave_start();
+            break;
+
+        case LED_IOC_WAVE_STOP:
+            led_wave_stop();
+            break;
+
+        case LED_IOC_WAVE_STATS:
+            st = led.stats;
+            st.late_mean_ns = st.transitions ? led.late_sum / st.transitions : 0;
+            st.running = led.running;
+            pthread_mutex_unlock(&sim_lock);
+            reply_ioctl(req, 0, &st, sizeof(st));
+            return;
+
+        default:
+            ret = -ENOTTY;
+            break;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    reply_ioctl(req, ret, NULL, 0);
+}
+
+/* /dev/gpio_button */
+
+static int button_event_ready(const struct sim_file *f) {
+    return f->next_seq <= btn.seq;
+}
+
+/* Same batching and OVERRUN reporting as button_fetch_events(), called with sim_lock held */
+static size_t button_fetch_events(struct sim_file *f, struct button_event *out, size_t max) {
+    uint64_t lost;
+    size_t n = 0;
+
+    if (btn.seq >= EVENT_RING_SIZE && f->next_seq <= btn.seq - EVENT_RING_SIZE) {
+        lost = btn.seq - EVENT_RING_SIZE + 1 - f->next_seq;
+        memset(&out[n], 0, sizeof(out[n]));
+        out[n].seq = f->next_seq;
+        out[n].timestamp = now_ns();
+        out[n].type = BUTTON_EV_OVERRUN;
+        out[n].value = lost;
+        f->next_seq += lost;
+        n++;
+    }
+    while (n < max && f->next_seq <= btn.seq) {
+        out[n++] = btn.ring[f->next_seq & EVENT_RING_MASK];
+        f->next_seq++;
+    }
+    return n;
+}
+
+static void button_read(fuse_req_t req, size_t size, off_t off, struct fuse_file_info *fi) {
+    struct sim_file *f = (struct sim_file *)(uintptr_t)fi->fh;
+    struct button_event *events;
+    static const char *const states[] = {
+        "All LEDs OFF", "LED 0 (Green) ON", "LED 1 (White) ON", "LED 2 (Yellow) ON", "All LEDs ON",
+    };
+    char msg[200];
+    size_t n;
+    int len;
+
+    pthread_mutex_lock(&sim_lock);
+    if (!f->event_mode) {
+        len = snprintf(msg, sizeof(msg), "Button Status: %s\nPress Count: %d\nCurrent State: %s\n",
+                       btn.button_pressed ? "Pressed" : "Released", btn.press_count,
+                       states[btn.current_led_state]);
+        if (off == 0 && size >= (size_t)len)
+            btn.button_pressed = 0;
+        pthread_mutex_unlock(&sim_lock);
+        reply_text(req, size, off, msg, len);
+        return;
+    }
+
+    if (size < sizeof(struct button_event)) {
+        pthread_mutex_unlock(&sim_lock);
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+    while (!nonblock(fi, f) && !button_event_ready(f)) {
+        if (sim_wait_req(req)) {
+            pthread_mutex_unlock(&sim_lock);
+            fuse_reply_err(req, EINTR);
+            return;
+        }
+    }
+
+    events = malloc(size);
+    if (!events) {
+        pthread_mutex_unlock(&sim_lock);
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+    n = button_fetch_events(f, events, size / sizeof(*events));
+    pthread_mutex_unlock(&sim_lock);
+
+    if (n)
+        fuse_reply_buf(req, (const char *)events, n * sizeof(*events));
+    else
+        fuse_reply_err(req, EAGAIN);
+    free(events);
+}
+
+static void button_write(fuse_req_t req, const char *buf, size_t size, off_t off, struct fuse_file_info *fi) {
+    (void)off;
+    (void)fi;
+    if (size < 1) {
+        fuse_reply_err(req, EFAULT);
+        return;
+    }
+
+    pthread_mutex_lock(&sim_lock);
+    switch (buf[0]) {
+        case 'r':
+            btn.press_count = 0;
+            btn.current_led_state = 0;
+            button_set_leds(0);
+            sim_log("Button driver reset\n");
+            break;
+        case 's':
+            fprintf(stderr, "Current LED state: %d, Press count: %d\n",
+                    btn.current_led_state, btn.press_count);
+            break;
+        default:
+            pthread_mutex_unlock(&sim_lock);
+            fuse_reply_err(req, EINVAL);
+            return;
+    }
+    pthread_mutex_unlock(&sim_lock);
+
+    fuse_reply_write(req, size);
+}
+
+static void button_ioctl(fuse_req_t req, int cmd, void *arg, struct fuse_file_info *fi,
+                         unsigned int flags, const void *in_buf, size_t in_bufsz, size_t out_bufsz) {
+    struct sim_file *f = (struct sim_file *)(uintptr_t)fi->fh;
+    int value, ret = 0;
+
+    (void)flags;
+    switch ((unsigned int)cmd) {
+        case BUTTON_IOC_GET_STATUS:
+            if (ioctl_retry(req, arg, 0, in_bufsz, sizeof(value), out_bufsz))
+                return;
+            break;
+        case BUTTON_IOC_EVENT_MODE:
+        case BUTTON_IOC_SET_CHORD_WINDOW:
+            if (ioctl_retry(req, arg, sizeof(value), in_bufsz, 0, out_bufsz))
+                return;
+            memcpy(&value, in_buf, sizeof(value));
+            break;
+    }
+
+    pthread_mutex_lock(&sim_lock);
+    switch ((unsigned int)cmd) {
+        case BUTTON_IOC_GET_STATUS:
+            value = pins[PIN_KEY0].level == 0;
+            pthread_mutex_unlock(&sim_lock);
+            reply_ioctl(req, 0, &value, sizeof(value));
+            return;
+
+        case BUTTON_IOC_EVENT_MODE:
+            f->event_mode = value != 0;
+            f->next_seq = btn.seq + 1;
+            break;
+
+        case BUTTON_IOC_SET_CHORD_WINDOW:
+            if (value < 1 || value > MULTI_PRESS_TIMEOUT_MS)
+                ret = -EINVAL;
+            else
+                btn.chord_window_ms = value;
+            break;
+
+        default:
+            ret = -ENOTTY;
+            break;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    reply_ioctl(req, ret, NULL, 0);
+}
+
+static void button_poll(fuse_req_t req, struct fuse_file_info *fi, struct fuse_pollhandle *ph) {
+    struct sim_file *f = (struct sim_file *)(uintptr_t)fi->fh;
+    unsigned int revents = POLLIN | POLLRDNORM;
+
+    pthread_mutex_lock(&sim_lock);
+    if (f->event_mode && !button_event_ready(f)) {
+        revents = 0;
+        if (ph) {
+            if (f->ph)
+                fuse_pollhandle_destroy(f->ph);
+            f->ph = ph;
+            ph = NULL;
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+
+    if (ph)
+        fuse_pollhandle_destroy(ph);
+    fuse_reply_poll(req, revents);
+}
+
+static const struct cuse_lowlevel_ops ctl_ops = {
+    .open = sim_open,
+    .release = sim_release,
+    .read = ctl_read,
+    .write = ctl_write,
+    .ioctl = ctl_ioctl,
+    .poll = ctl_poll,
+};
+
+static const struct cuse_lowlevel_ops ctl2_ops = {
+    .open = sim_open,
+    .release = sim_release,
+    .read = ctl2_read,
+    .write = ctl2_write,
+    .ioctl = ctl2_ioctl,
+};
+
+static const struct cuse_lowlevel_ops led_ops = {
+    .open = sim_open,
+    .release = sim_release,
+    .read = led_read,
+    .write = led_write,
+    .ioctl = led_ioctl,
+};
+
+static const struct cuse_lowlevel_ops button_ops = {
+    .open = sim_open,
+    .release = sim_release,
+    .read = button_read,
+    .write = button_write,
+    .ioctl = button_ioctl,
+    .poll = button_poll,
+};
+
+/* Device setup */
+
+static void *sim_device_loop(void *arg) {
+    struct sim_device *dev = arg;
+
+    fuse_session_loop_mt(dev->se, 0);
+    return NULL;
+}
+
+static int sim_start_device(struct sim_device *dev) {
+    static char prog[] = "gpio_cuse", fg[] = "-f";
+    char *argv[] = { prog, fg, NULL };
+    char devname[64];
+    const char *dev_info_argv[] = { devname };
+    struct cuse_info ci;
+    int multithreaded;
+
+    snprintf(devname, sizeof(devname), "DEVNAME=%s", dev->name);
+    memset(&ci, 0, sizeof(ci));
+    ci.dev_info_argc = 1;
+    ci.dev_info_argv = dev_info_argv;
+    ci.flags = CUSE_UNRESTRICTED_IOCTL;
+
+    dev->se = cuse_lowlevel_setup(2, argv, &ci, dev->ops, &multithreaded, dev);
+    if (!dev->se) {
+        fprintf(stderr, "Failed to create /dev/%s\n", dev->name);
+        return -1;
+    }
+    if (pthread_create(&dev->thread, NULL, sim_device_loop, dev)) {
+        fprintf(stderr, "Failed to start /dev/%s\n", dev->name);
+        return -1;
+    }
+    return 0;
+}
+
+static void sim_init_pins(void) {
+    static const char *const outputs[] = { "led0", "led1", "led2", "ctl_led", NULL, "ctl2_led", NULL };
+    int i;
+
+    for (i = 0; i < PIN_KEY0; i++) {
+        if (outputs[i]) {
+            snprintf(pins[i].name, sizeof(pins[i].name), "%s", outputs[i]);
+            pins[i].level = 0;
+            pins[i].pressed = -1;
+        }
+    }
+    /* gpio_ctl reads 1 when pressed, the others are pulled up and read 0 */
+    snprintf(pins[PIN_CTL_BTN].name, sizeof(pins[0].name), "ctl");
+    pins[PIN_CTL_BTN].level = 0;
+    pins[PIN_CTL_BTN].pressed = 1;
+    snprintf(pins[PIN_CTL2_BTN].name, sizeof(pins[0].name), "ctl2");
+    pins[PIN_CTL2_BTN].level = 1;
+    pins[PIN_CTL2_BTN].pressed = 0;
+    for (i = 0; i < BUTTON_MAX_KEYS; i++) {
+        snprintf(pins[PIN_KEY0 + i].name, sizeof(pins[0].name), "key%d", i);
+        pins[PIN_KEY0 + i].level = 1;
+        pins[PIN_KEY0 + i].pressed = 0;
+    }
+}
+
+/* Command channel */
+
+static int find_pin(const char *name, int button) {
+    int i;
+
+    for (i = 0; i < NUM_PINS; i++) {
+        if (strcmp(pins[i].name, name) == 0) {
+            if (button && pins[i].pressed < 0)
+                return -1;
+            if (i >= PIN_KEY0 + (int)btn.num_keys)
+                return -1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void set_pin(int pin, int level) {
+    pthread_mutex_lock(&sim_lock);
+    sim_set_level(pin, level);
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static void sleep_until(uint64_t deadline) {
+    struct timespec ts;
+
+    ns_to_ts(deadline, &ts);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !quit)
+        ;
+}
+
+static void show_pins(void) {
+    int i;
+
+    pthread_mutex_lock(&sim_lock);
+    for (i = 0; i < PIN_KEY0 + (int)btn.num_keys; i++) {
+        if (!pins[i].name[0])
+            continue;
+        printf("%-9s %d%s\n", pins[i].name, pins[i].level,
+               pins[i].pressed < 0 ? "" : pins[i].level == pins[i].pressed ? " (pressed)" : "");
+    }
+    pthread_mutex_unlock(&sim_lock);
+    fflush(stdout);
+}
+
+static void run_command(char *line) {
+    char cmd[16], name[16];
+    unsigned long a = 0, b = 0;
+    uint64_t t;
+    int n, pin;
+    unsigned long i;
+
+    n = sscanf(line, "%15s %15s %lu %lu", cmd, name, &a, &b);
+    if (n < 1)
+        return;
+
+    if (strcmp(cmd, "quit") == 0) {
+        quit = 1;
+        return;
+    }
+    if (strcmp(cmd, "show") == 0) {
+        show_pins();
+        return;
+    }
+    if (strcmp(cmd, "sleep") == 0 && n >= 2) {
+        sleep_until(now_ns() + strtoul(name, NULL, 0) * NSEC_PER_MSEC);
+        return;
+    }
+    if (n < 2) {
+        fprintf(stderr, "Invalid command: %s", line);
+        return;
+    }
+
+    pin = find_pin(name, strcmp(cmd, "level") != 0);
+    if (pin < 0) {
+        fprintf(stderr, "Unknown pin: %s\n", name);
+        return;
+    }
+
+    if (strcmp(cmd, "press") == 0) {
+        set_pin(pin, pins[pin].pressed);
+    } else if (strcmp(cmd, "release") == 0) {
+        set_pin(pin, !pins[pin].pressed);
+    } else if (strcmp(cmd, "click") == 0) {
+        set_pin(pin, pins[pin].pressed);
+        sleep_until(now_ns() + (n >= 3 ? a : 100) * NSEC_PER_MSEC);
+        set_pin(pin, !pins[pin].pressed);
+    } else if (strcmp(cmd, "bounce") == 0 && n >= 4) {
+        t = now_ns();
+        for (i = 0; i < a && !quit; i++) {
+            set_pin(pin, i % 2 == 0 ? pins[pin].pressed : !pins[pin].pressed);
+            t += b * 1000;
+            sleep_until(t);
+        }
+        set_pin(pin, pins[pin].pressed);
+    } else if (strcmp(cmd, "square") == 0 && n >= 4 && a > 0) {
+        uint64_t half = NSEC_PER_SEC / (2 * a);
+
+        t = now_ns();
+        for (i = 0; i < 2 * b && !quit; i++) {
+            set_pin(pin, !pins[pin].level);
+            t += half;
+            sleep_until(t);
+        }
+    } else if (strcmp(cmd, "level") == 0 && n >= 3) {
+        set_pin(pin, a != 0);
+    } else {
+        fprintf(stderr, "Invalid command: %s", line);
+    }
+}
+
+/* Line buffered command input on a raw fd, so poll() sees every byte */
+struct cmd_input {
+    int fd;
+    size_t len;
+    char buf[256];
+};
+
+/* Returns -1 at EOF */
+static int cmd_input_read(struct cmd_input *in) {
+    char *nl;
+    ssize_t n;
+
+    n = read(in->fd, in->buf + in->len, sizeof(in->buf) - 1 - in->len);
+    if (n <= 0)
+        return n < 0 && errno == EINTR ? 0 : -1;
+    in->len += n;
+    in->buf[in->len] = '\0';
+
+    while ((nl = strchr(in->buf, '\n')) != NULL && !quit) {
+        *nl = '\0';
+        run_command(in->buf);
+        in->len -= nl + 1 - in->buf;
+        memmove(in->buf, nl + 1, in->len + 1);
+    }
+    // Drop an over-long line instead of stalling on it
+    if (in->len == sizeof(in->buf) - 1)
+        in->len = 0;
+    return 0;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    quit = 1;
+}
+
+int main(int argc, char *argv[]) {
+    static const struct cuse_lowlevel_ops *const ops[NUM_DEVS] = {
+        &ctl_ops, &ctl2_ops, &led_ops, &led_ops, &led_ops, &button_ops,
+    };
+    static const char *const names[NUM_DEVS] = {
+        "gpio_ctl", "gpio_ctl2", "gpio_led0", "gpio_led1", "gpio_led2", "gpio_button",
+    };
+    struct cmd_input in[2] = { { .fd = STDIN_FILENO } };
+    struct pollfd pfd[2];
+    pthread_condattr_t attr;
+    pthread_t timer;
+    struct sigaction sa;
+    int nfds = 1;
+    int i, opt;
+
+    btn.num_keys = 1;
+    btn.chord_window_ms = DEFAULT_CHORD_WINDOW_MS;
+
+    while ((opt = getopt(argc, argv, "vk:c:")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = 1;
+            break;
+        case 'k':
+            btn.num_keys = strtoul(optarg, NULL, 0);
+            if (btn.num_keys < 1 || btn.num_keys > BUTTON_MAX_KEYS) {
+                fprintf(stderr, "Keys must be 1..%d\n", BUTTON_MAX_KEYS);
+                return 1;
+            }
+            break;
+        case 'c':
+            // O_RDWR keeps a writer open so the FIFO never reports EOF
+            in[1].fd = open(optarg, O_RDWR);
+            if (in[1].fd < 0) {
+                fprintf(stderr, "Failed to open %s: %s\n", optarg, strerror(errno));
+                return 1;
+            }
+            nfds = 2;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-v] [-k keys] [-c command_fifo]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sim_cond, &attr);
+    sim_init_pins();
+
+    if (pthread_create(&timer, NULL, button_timer_thread, NULL)) {
+        fprintf(stderr, "Failed to start timer thread\n");
+        return 1;
+    }
+
+    for (i = 0; i < NUM_DEVS; i++) {
+        devs[i].id = i;
+        devs[i].name = names[i];
+        devs[i].ops = ops[i];
+        if (sim_start_device(&devs[i]) < 0)
+            return 1;
+    }
+
+    // cuse_lowlevel_setup() installs handlers for one session only
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+
+    fprintf(stderr, "gpio_cuse: %d devices ready, %u button keys\n", NUM_DEVS, btn.num_keys);
+
+    while (!quit) {
+        for (i = 0; i < nfds; i++) {
+            pfd[i].fd = in[i].fd;
+            pfd[i].events = POLLIN;
+        }
+        // Devices keep running after stdin closes, until a signal or quit
+        if (poll(pfd, nfds, -1) < 0)
+            continue;
+        for (i = 0; i < nfds && !quit; i++) {
+            if ((pfd[i].revents & (POLLIN | POLLHUP)) && cmd_input_read(&in[i]) < 0)
+                in[i].fd = -1;
+        }
+    }
+
+    // The kernel removes the device nodes once the CUSE channels close
+    for (i = 0; i < NUM_DEVS; i++)
+        fuse_session_exit(devs[i].se);
+    return 0;
+}